@@ -26,20 +26,42 @@
 // CONFIGURATION I2S
 // ============================================================================
 #define AUDIO_SAMPLE_RATE       44100   // Hz
-#define AUDIO_BITS_PER_SAMPLE   16      // bits
+#define AUDIO_BITS_PER_SAMPLE   (AUDIO_SAMPLE_32 ? 24 : 16) // bits, résolution de l'ES8311 (-DAUDIO_SAMPLE_32, audio_sample.h)
 #define AUDIO_DMA_BUF_COUNT     8
-#define AUDIO_DMA_BUF_LEN       1024
+#define AUDIO_DMA_BUF_LEN       0       // trames par tampon DMA, 0 = le maximum du pilote (4092 octets : 1023 en 16 bit, 511 en 32 bit)
+#define AUDIO_TASK_CORE         0       // cœur de la tâche audio (loop() tourne sur le cœur 1)
+#define AUDIO_TASK_PRIORITY     2       // la tâche de lecture SD tourne une priorité au-dessus
+#define AUDIO_TASK_TARGET       0       // blocs de sortie décodés d'avance, 0 = tous (DMA + réserve)
+#define AUDIO_MP3_QUALITY       0       // MP3 : 0 = complet, 1 = bande limitée à fs/4 (11 kHz), 2 = idem, sortie à fs/2 (moins de CPU)
+#define AUDIO_FLAC_DUAL_CORE    false   // FLAC : une trame sur deux décodée sur l'autre cœur (prend du temps à loop())
+#define AUDIO_FLAC_CRC_CHECK    true    // FLAC : CRC de chaque trame, une trame corrompue est masquée (tables de 8 Ko, voir flac_decoder.cpp)
+#define AUDIO_FLAC_REPEAT       false   // FLAC : trame corrompue remplacée par la précédente au lieu du silence (2 tampons PSRAM)
 
 // ============================================================================
 // VOLUME
 // ============================================================================
 #define AUDIO_DEFAULT_VOLUME    2      // 0-100
+#define AUDIO_VOLUME_RAMP_MS    20     // rampe (linéaire en dB) des changements de volume / muet
+#define AUDIO_FADE_MS           150    // fondu de sortie de stop()
+#define AUDIO_INTERRUPT_FADE_MS 30     // fondu quand play() interrompt un son en cours
+#define AUDIO_HW_FADE           false  // true : volume réglé dans l'ES8311, avec sa rampe matérielle
+#define AUDIO_HW_FADE_RATE      2      // es8311_fade_t : 0.25 dB toutes les 2^(n+1) LRCK (2 = ES8311_FADE_8LRCK)
+
+// ============================================================================
+// CACHE PCM 48 kHz (voir drivers/AudioCache.h)
+// ============================================================================
+#define AUDIO_CACHE_ENABLED     true
+#define AUDIO_CACHE_PATH        "/audio/.cache"   // dans SD_AUDIO_PATH, ignoré par l'analyse
+#define AUDIO_CACHE_IDLE_MS     3000   // silence avant de décoder un fichier vers le cache
+#define AUDIO_CACHE_FLAC_MD5    true   // relit les sources FLAC quand rien ne joue (MD5 de STREAMINFO), signale les fichiers abîmés
 
 // ============================================================================
 // FORMATS SUPPORTÉS
 // ============================================================================
-#define SUPPORT_MP3             true
-#define SUPPORT_WAV             true
-#define SUPPORT_AAC             false
+// Les décodeurs sont choisis à la compilation par -DAUDIO_SUPPORT_xxx=0/1 dans
+// platformio.ini : un décodeur à 0 n'occupe ni flash ni RAM (audio_codec.h).
+#define SUPPORT_MP3             (AUDIO_SUPPORT_MP3 != 0)
+#define SUPPORT_WAV             true   // sans décodeur
+#define SUPPORT_AAC             (AUDIO_SUPPORT_AAC != 0)
 
 #endif // AUDIO_CONFIG_H
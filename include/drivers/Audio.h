@@ -18,6 +18,7 @@
 #include "es8311.h"
 #include "esp_check.h"
 #include "config/audio_config.h"
+#include "drivers/AudioCache.h"
 #include "features.h"
 
 #define TAG "Audio"
@@ -33,7 +34,7 @@ public:
     /**
      * @brief Constructeur
      */
-    AudioDriver() : audio(nullptr), initialized(false) {
+    AudioDriver() : audio(nullptr), es(nullptr), initialized(false) {
         audio = new Audio();
     }
 
@@ -64,6 +65,33 @@ public:
         audio->setPinout(I2S_BCLK, I2S_LRCK, I2S_DOUT, I2S_MCLK);
         audio->setVolume(DEFAULT_AUDIO_VOLUME / 5);  // 0...21 (scale from 0-100)
 
+        // Rampes de volume / muet (anti-clic), appliquées par bloc dans l'étage de sortie
+        audio->setVolumeRamp(AUDIO_VOLUME_RAMP_MS);
+
+        // Profondeur DMA I2S (blocs de sortie alimentés par l'interruption on_sent)
+        audio->setDmaBuffers(AUDIO_DMA_BUF_COUNT, AUDIO_DMA_BUF_LEN);
+
+        // Tâche audio : cœur, priorité et avance de décodage (getAudioTaskStats() pour la charge CPU et la pile)
+        audio->setAudioTaskCore(AUDIO_TASK_CORE, AUDIO_TASK_PRIORITY);
+        audio->setAudioTaskTarget(AUDIO_TASK_TARGET);
+
+        // Décodage MP3 réduit : le petit haut-parleur ne rend rien au-dessus de 11 kHz (le cache reste complet)
+        audio->setMP3Quality(AUDIO_MP3_QUALITY);
+
+        // FLAC haute résolution : deux trames décodées en parallèle, la seconde sur le cœur de loop()
+        audio->setFLACDualCore(AUDIO_FLAC_DUAL_CORE);
+
+        // FLAC : trames vérifiées (CRC), les trames abîmées de la carte SD sont masquées au lieu d'un arrêt
+        audio->setFLACCrcCheck(AUDIO_FLAC_CRC_CHECK, AUDIO_FLAC_REPEAT);
+
+        // Mesure de latence (audio_latency() + temps de décodage par codec)
+        audio->setLatencyMeasurement(AUDIO_DEBUG_ENABLED);
+
+        #if AUDIO_CACHE_ENABLED
+        // Les sons compressés sont décodés vers le cache PCM quand rien ne joue
+        cache.begin(audio);
+        #endif
+
         initialized = true;
         return true;
     }
@@ -83,9 +111,38 @@ public:
             return false;
         }
 
-        // Lancer la lecture
-        audio->connecttoFS(SD_MMC, filename);
-        return true;
+        // Le décodage vers le cache rend l'objet Audio
+        cache.abort();
+
+        // Lancer la lecture, depuis le cache PCM 48 kHz s'il est prêt. Un son en cours est coupé par un fondu court
+        // plutôt qu'au milieu de l'onde : audio->loop() démarre le nouveau fichier à la fin du fondu, sans attente ici
+        String cachePath;
+        if (cache.resolve(filename, cachePath)) {
+            return audio->fadeToFS(SD_MMC, cachePath.c_str(), AUDIO_INTERRUPT_FADE_MS);
+        }
+        return audio->fadeToFS(SD_MMC, filename, AUDIO_INTERRUPT_FADE_MS);
+    }
+
+    /**
+     * @brief Enchaîne un fichier après celui en cours, sans blanc (gapless)
+     * @param filename Nom du fichier (ex: "/audio/jingle.mp3")
+     * @return true si le fichier est en file d'attente (ou lancé si rien ne joue)
+     */
+    bool queue(const char* filename) {
+        if (!initialized || !audio) {
+            return false;
+        }
+
+        if (!SD_MMC.exists(filename)) {
+            return false;
+        }
+
+        cache.abort();
+        String cachePath;
+        if (cache.resolve(filename, cachePath)) {
+            return audio->queueFS(SD_MMC, cachePath.c_str());
+        }
+        return audio->queueFS(SD_MMC, filename);
     }
 
     /**
@@ -94,15 +151,27 @@ public:
     void loop() {
         if (initialized && audio) {
             audio->loop();
+            cache.loop();
+        }
+    }
+
+    /**
+     * @brief Arrête la lecture en cours par un fondu de sortie (non bloquant)
+     * @param fadeMs Durée du fondu en ms, 0 = arrêt immédiat
+     */
+    void stop(uint16_t fadeMs = AUDIO_FADE_MS) {
+        if (audio && !cache.isBusy()) {
+            audio->fadeOutAndStop(fadeMs);
         }
     }
 
     /**
-     * @brief Arrête la lecture en cours
+     * @brief Coupe / rétablit le son avec une rampe
+     * @param mute true = muet
      */
-    void stop() {
+    void setMute(bool mute) {
         if (audio) {
-            audio->stopSong();
+            audio->setMute(mute);
         }
     }
 
@@ -111,7 +180,20 @@ public:
      * @return true si lecture en cours
      */
     bool isPlaying() {
-        return (audio && audio->isRunning());
+        return (audio && audio->isRunning() && !cache.isBusy());
+    }
+
+    /**
+     * @brief Niveaux de la sortie (crête, RMS, 8 bandes), sans verrou : utilisable depuis la boucle ou les LEDs
+     * @param m Copie du dernier relevé (toutes les 21 ms), mise à zéro hors lecture
+     * @return true si lecture en cours
+     */
+    bool getMeter(audioMeter_t* m) {
+        if (!audio || cache.isBusy()) {
+            memset(m, 0, sizeof(audioMeter_t));
+            return false;
+        }
+        return audio->getMeter(m);
     }
 
     /**
@@ -119,11 +201,19 @@ public:
      * @param vol Volume 0-100
      */
     void setVolume(uint8_t vol) {
+        #if AUDIO_HW_FADE
+        if (audio && es) {
+            // Rampe matérielle de l'ES8311, le gain numérique reste au maximum
+            audio->setVolume(21);
+            es8311_voice_volume_set(es, constrain(vol, 0, 100), NULL);
+        }
+        #else
         if (audio) {
             // ESP32-audioI2S utilise 0-21
             uint8_t scaledVol = map(constrain(vol, 0, 100), 0, 100, 0, 21);
             audio->setVolume(scaledVol);
         }
+        #endif
     }
 
     /**
@@ -135,7 +225,9 @@ public:
 
 private:
     Audio* audio;
+    es8311_handle_t es;
     bool initialized;
+    AudioCache cache;
 
     /**
      * @brief Initialise le codec ES8311
@@ -154,7 +246,9 @@ private:
             .sample_frequency = EXAMPLE_SAMPLE_RATE
         };
 
-        esp_err_t ret = es8311_init(es_handle, &es_clk, ES8311_RESOLUTION_16, ES8311_RESOLUTION_16);
+        // 16 bit, ou 24 bit dans des slots I2S de 32 bit avec -DAUDIO_SAMPLE_32=1
+        const es8311_resolution_t res = (AUDIO_BITS_PER_SAMPLE == 24) ? ES8311_RESOLUTION_24 : ES8311_RESOLUTION_16;
+        esp_err_t ret = es8311_init(es_handle, &es_clk, res, res);
         if (ret != ESP_OK) {
             return false;
         }
@@ -163,6 +257,12 @@ private:
         if (ret != ESP_OK) {
         }
 
+        #if AUDIO_HW_FADE
+        // Les changements de volume du DAC sont rampés par le codec
+        es8311_voice_fade(es_handle, (es8311_fade_t)AUDIO_HW_FADE_RATE);
+        #endif
+        es = es_handle;
+
         ret = es8311_microphone_config(es_handle, false);
         if (ret != ESP_OK) {
         }
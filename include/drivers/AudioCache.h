@@ -0,0 +1,377 @@
+/**
+ * @file AudioCache.h
+ * @brief Cache PCM 48 kHz des sons de la carte SD
+ *
+ * Les fichiers de SD_AUDIO_PATH (MP3, AAC, FLAC, Opus, Vorbis, WAV d'une autre fréquence) sont décodés une fois,
+ * quand rien ne joue, vers AUDIO_CACHE_PATH en WAV 48 kHz 16 bit (mono si la source est mono). Les lectures
+ * suivantes passent par la lecture directe de la bibliothèque, sans décodeur ni rééchantillonnage.
+ *
+ * Le décodage utilise les décodeurs de la lecture (Audio::renderToFile()) : il tourne dans la tâche audio, plus vite
+ * que le temps réel, et s'interrompt dès que play() a besoin de l'objet Audio (le fichier est refait plus tard).
+ *
+ * Format : en-tête WAV de 68 octets, "fmt " puis un bloc "bzsc" (version, taille et date de la source, CRC32 des
+ * données PCM) puis "data". Au démarrage, les caches périmés ou orphelins sont supprimés, le CRC des autres est
+ * vérifié par petits morceaux. tools/build_pcm_cache.py (ffmpeg) et tools/pcm_cache_cli.cpp (les décodeurs de l'ESP32,
+ * MP3 et FLAC) produisent les mêmes fichiers sur le PC (date 0 = ignorée).
+ *
+ * Quand tout est décodé, les sources FLAC sont relues en entier (CRC de chaque trame et MD5 de STREAMINFO, FlacVerify,
+ * avec son propre décodeur) pour signaler une carte SD qui abîme les fichiers. AUDIO_CACHE_FLAC_MD5 le désactive.
+ *
+ * @date 2026
+ */
+
+#ifndef AUDIO_CACHE_H
+#define AUDIO_CACHE_H
+
+#include <Arduino.h>
+#include <Audio.h>  // ESP32-audioI2S library
+#include <SD_MMC.h>
+#include <vector>
+#include "esp_rom_crc.h"
+#include "config/audio_config.h"
+#include "features.h"
+#include <pcm_cache/pcm_cache.h>
+#if AUDIO_SUPPORT_FLAC
+#include <flac_verify/flac_verify.h>
+#endif
+
+#define AUDIO_CACHE_HEADER_SIZE PCM_CACHE_HEADER_SIZE
+
+class AudioCache {
+public:
+    AudioCache() : audio(nullptr), state(CACHE_OFF), idleSince(0), verifyPos(0), verifyCrc(0) {}
+
+    /**
+     * @brief Active le cache, le répertoire est analysé au premier loop() (la carte doit être montée)
+     */
+    void begin(Audio* a) {
+        audio = a;
+        state = CACHE_SCAN;
+        idleSince = millis();
+    }
+
+    /**
+     * @brief Chemin du cache d'un son, s'il est prêt
+     * @param src Chemin de la source (ex: "/audio/tada.mp3")
+     * @param cachePath Chemin du fichier WAV 48 kHz
+     * @return true si le cache existe et a été vérifié
+     */
+    bool resolve(const char* src, String& cachePath) {
+        for (const String& s : ready) {
+            if (s == src) {
+                cachePath = cachePathOf(src);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief L'objet Audio décode un fichier vers le cache
+     */
+    bool isBusy() {
+        return state == CACHE_RENDER;
+    }
+
+    /**
+     * @brief Interrompt le décodage en cours (play() a besoin de l'objet Audio), le fichier est refait plus tard
+     */
+    void abort() {
+        idleSince = millis();
+#if AUDIO_SUPPORT_FLAC
+        if (state == CACHE_CHECK) {
+            flacVerify.end();
+            out.close();
+            toCheck.push_back(current);  // recommencé plus tard
+            state = CACHE_IDLE;
+            return;
+        }
+#endif
+        if (state != CACHE_RENDER) return;
+        audio->stopSong();
+        out.close();
+        SD_MMC.remove(AUDIO_CACHE_PATH "/tmp.wav");
+        todo.push_back(current);  // à la fin de la liste, les autres avancent
+        state = CACHE_IDLE;
+    }
+
+    /**
+     * @brief À appeler dans loop(), une petite étape par appel
+     */
+    void loop() {
+        switch (state) {
+            case CACHE_SCAN:   scan(); break;
+            case CACHE_VERIFY: verifyStep(); break;
+            case CACHE_IDLE:   startRender(); break;
+            case CACHE_RENDER: finishRender(); break;
+#if AUDIO_SUPPORT_FLAC
+            case CACHE_CHECK:  checkStep(); break;
+#endif
+            default: break;
+        }
+    }
+
+private:
+    enum CacheState { CACHE_OFF, CACHE_SCAN, CACHE_VERIFY, CACHE_IDLE, CACHE_RENDER, CACHE_CHECK };
+
+    Audio* audio;
+    CacheState state;
+    uint32_t idleSince;               // millis() de la dernière lecture
+    std::vector<String> todo;         // sources à décoder
+    std::vector<String> toVerify;     // sources dont le cache doit être vérifié (CRC)
+    std::vector<String> ready;        // sources dont le cache est bon
+    std::vector<String> toCheck;      // sources FLAC à relire en entier (MD5)
+    String current;                   // source en cours de décodage ou de vérification
+    File out;
+    uint32_t verifyPos;
+    uint32_t verifyCrc;
+#if AUDIO_SUPPORT_FLAC
+    FlacVerify flacVerify;
+#endif
+
+    /**
+     * @brief "/audio/sfx/tada.mp3" -> AUDIO_CACHE_PATH "/audio_sfx_tada.mp3.wav"
+     */
+    static String cachePathOf(const char* src) {
+        String name = src;
+        while (name.startsWith("/")) name.remove(0, 1);
+        name.replace("/", "_");
+        return String(AUDIO_CACHE_PATH "/") + name + ".wav";
+    }
+
+    static bool isSource(const String& path) {
+        String p = path;
+        p.toLowerCase();
+        const char* ext[] = {".mp3", ".mp2", ".m4a", ".aac", ".flac", ".ogg", ".oga", ".opus", ".wav"};
+        for (const char* e : ext) {
+            if (p.endsWith(e)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief En-tête d'un cache, le format est celui de PcmCache (pcm_cache.h), partagé avec tools/pcm_cache_cli.cpp
+     */
+    static bool readHeader(File& f, pcmCacheHeader_t* c) {
+        uint8_t h[AUDIO_CACHE_HEADER_SIZE];
+        if (f.read(h, sizeof(h)) != sizeof(h)) return false;
+        return PcmCache::parseHeader(h, f.size(), c);
+    }
+
+    /**
+     * @brief Compare les sources et les caches, supprime les caches périmés ou orphelins
+     */
+    void scan() {
+        SD_MMC.mkdir(AUDIO_CACHE_PATH);
+        SD_MMC.remove(AUDIO_CACHE_PATH "/tmp.wav");  // décodage interrompu par un reset
+        std::vector<String> dirs = {SD_AUDIO_PATH};
+        std::vector<String> names;                   // caches attendus
+        while (!dirs.empty()) {
+            File dir = SD_MMC.open(dirs.back());
+            dirs.pop_back();
+            if (!dir || !dir.isDirectory()) continue;
+            for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+                String path = f.path();
+                if (f.isDirectory()) {
+                    if (path != AUDIO_CACHE_PATH) dirs.push_back(path);
+                    continue;
+                }
+                if (!isSource(path)) continue;
+                uint32_t size = f.size();
+                uint32_t time = (uint32_t)f.getLastWrite();
+                f.close();
+                String lower = path;
+                lower.toLowerCase();
+                if (AUDIO_CACHE_FLAC_MD5 && lower.endsWith(".flac")) toCheck.push_back(path);
+                String cachePath = cachePathOf(path.c_str());
+                names.push_back(cachePath);
+                File c = SD_MMC.open(cachePath);
+                pcmCacheHeader_t h;
+                bool ok = c && readHeader(c, &h) && h.srcSize == size && (h.srcTime == 0 || h.srcTime == time);
+                if (c) c.close();
+                if (ok) {
+                    toVerify.push_back(path);
+                } else {
+                    SD_MMC.remove(cachePath);
+                    todo.push_back(path);
+                }
+            }
+        }
+        File dir = SD_MMC.open(AUDIO_CACHE_PATH);
+        std::vector<String> orphans;
+        for (File f = dir ? dir.openNextFile() : File(); f; f = dir.openNextFile()) {
+            String path = f.path();
+            bool used = false;
+            for (const String& n : names) used |= (n == path);
+            if (!used) orphans.push_back(path);
+        }
+        dir.close();
+        for (const String& p : orphans) SD_MMC.remove(p);
+        if (AUDIO_DEBUG_ENABLED) {
+            Serial.printf("[AUDIO] cache : %u à vérifier, %u à décoder, %u orphelins supprimés\n",
+                          (unsigned)toVerify.size(), (unsigned)todo.size(), (unsigned)orphans.size());
+        }
+        state = CACHE_VERIFY;
+    }
+
+    /**
+     * @brief Vérifie le CRC d'un cache, 16 Ko par appel
+     */
+    void verifyStep() {
+        if (!out) {
+            if (toVerify.empty()) {
+                state = CACHE_IDLE;
+                return;
+            }
+            current = toVerify.back();
+            toVerify.pop_back();
+            out = SD_MMC.open(cachePathOf(current.c_str()));
+            verifyPos = 0;
+            verifyCrc = 0;
+            if (!out || !out.seek(AUDIO_CACHE_HEADER_SIZE)) {
+                if (out) out.close();
+                todo.push_back(current);
+            }
+            return;
+        }
+        static uint8_t buf[4096];
+        for (int i = 0; i < 4; i++) {
+            int n = out.read(buf, sizeof(buf));
+            if (n <= 0) break;
+            verifyCrc = esp_rom_crc32_le(verifyCrc, buf, n);
+            verifyPos += n;
+        }
+        if (verifyPos + AUDIO_CACHE_HEADER_SIZE < out.size()) return;
+        pcmCacheHeader_t h;
+        out.seek(0);
+        bool ok = readHeader(out, &h) && h.crc == verifyCrc;
+        out.close();
+        if (ok) {
+            ready.push_back(current);
+        } else {
+            SD_MMC.remove(cachePathOf(current.c_str()));
+            todo.push_back(current);
+        }
+    }
+
+    /**
+     * @brief Lance le décodage du fichier suivant quand rien ne joue depuis AUDIO_CACHE_IDLE_MS
+     */
+    void startRender() {
+        if ((todo.empty() && toCheck.empty()) || audio->isRunning()) {
+            idleSince = millis();
+            return;
+        }
+        if (millis() - idleSince < AUDIO_CACHE_IDLE_MS) return;
+        if (todo.empty()) {
+            startCheck();
+            return;
+        }
+        current = todo.front();
+        todo.erase(todo.begin());
+        out = SD_MMC.open(AUDIO_CACHE_PATH "/tmp.wav", FILE_WRITE);
+        if (!out) return;
+        uint8_t h[AUDIO_CACHE_HEADER_SIZE] = {0};
+        out.write(h, sizeof(h));  // réécrit à la fin
+        if (!audio->renderToFile(SD_MMC, current.c_str(), &out)) {
+            out.close();  // format inconnu, non compilé ou déjà en 48 kHz 16 bit : pas de cache
+            SD_MMC.remove(AUDIO_CACHE_PATH "/tmp.wav");
+            return;
+        }
+        state = CACHE_RENDER;
+    }
+
+    /**
+     * @brief Fin du décodage : en-tête, renommage en cache, sauf si le décodeur a trouvé la source abîmée
+     */
+    void finishRender() {
+        if (audio->isRunning()) return;
+        audio_render_t r;
+        audio->getRenderResult(&r);
+        audio->stopSong();  // fin de fichier ou erreur, quitte le mode rendu
+        state = CACHE_IDLE;
+        idleSince = millis();
+        File src = SD_MMC.open(current);
+        if (!r.done || !r.frames || !src) {
+            out.close();
+            SD_MMC.remove(AUDIO_CACHE_PATH "/tmp.wav");
+            if (AUDIO_DEBUG_ENABLED) Serial.printf("[AUDIO] cache : échec %s\n", current.c_str());
+            return;
+        }
+        if (r.md5 < 0 || r.corrupt > 0) {
+            // source abîmée : pas de cache (il serait vérifié par son CRC et joué tel quel), la source reste jouée
+            src.close();
+            out.close();
+            SD_MMC.remove(AUDIO_CACHE_PATH "/tmp.wav");
+            Serial.printf("[AUDIO] cache : %s abîmé, pas de cache (MD5 FLAC %s, %u trames masquées)\n",
+                          current.c_str(), r.md5 < 0 ? "faux" : "non vérifié", (unsigned)r.corrupt);
+            return;
+        }
+        pcmCacheHeader_t c;
+        c.channels = r.channels;
+        c.dataSize = r.frames * 2 * r.channels;
+        c.srcSize = src.size();
+        c.srcTime = (uint32_t)src.getLastWrite();
+        c.crc = r.crc32;
+        src.close();
+        uint8_t h[AUDIO_CACHE_HEADER_SIZE];
+        PcmCache::makeHeader(h, &c);
+        out.seek(0);
+        out.write(h, sizeof(h));
+        out.close();
+        String cachePath = cachePathOf(current.c_str());
+        SD_MMC.remove(cachePath);
+        if (SD_MMC.rename(AUDIO_CACHE_PATH "/tmp.wav", cachePath)) {
+            ready.push_back(current);
+            if (AUDIO_DEBUG_ENABLED) Serial.printf("[AUDIO] cache : %s (%lu octets)\n", cachePath.c_str(), (unsigned long)c.dataSize);
+        }
+    }
+
+    /**
+     * @brief Commence la relecture d'une source FLAC (après les décodages)
+     */
+    void startCheck() {
+#if AUDIO_SUPPORT_FLAC
+        current = toCheck.front();
+        toCheck.erase(toCheck.begin());
+        out = SD_MMC.open(current);
+        if (!out) return;
+        if (!flacVerify.begin()) {
+            out.close();
+            toCheck.clear();  // pas assez de mémoire : abandonné jusqu'au prochain démarrage
+            return;
+        }
+        state = CACHE_CHECK;
+#else
+        toCheck.clear();
+#endif
+    }
+
+#if AUDIO_SUPPORT_FLAC
+    /**
+     * @brief Relit 16 Ko de la source FLAC, le résultat est connu à la fin du fichier
+     */
+    void checkStep() {
+        size_t len;
+        uint8_t* p = flacVerify.space(&len);
+        if (len > 16384) len = 16384;
+        int n = out.read(p, len);
+        if (n < 0) n = 0;
+        int8_t r = flacVerify.step(n, out.position() >= out.size());
+        if (r == FLAC_VERIFY_RUNNING) return;
+        out.close();
+        flacVerify.end();
+        state = CACHE_IDLE;
+        idleSince = millis();
+        if (r == FLAC_VERIFY_WRONG) {
+            Serial.printf("[AUDIO] cache : %s abîmé sur la carte SD (MD5 FLAC faux, %u trames corrompues)\n",
+                          current.c_str(), (unsigned)flacVerify.corruptFrames());
+        } else if (AUDIO_DEBUG_ENABLED) {
+            Serial.printf("[AUDIO] cache : %s %s\n", current.c_str(),
+                          r == FLAC_VERIFY_OK ? "MD5 FLAC bon" : r == FLAC_VERIFY_NO_MD5 ? "sans MD5, trames bonnes" : "illisible");
+        }
+    }
+#endif
+};
+
+#endif // AUDIO_CACHE_H
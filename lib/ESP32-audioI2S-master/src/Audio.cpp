@@ -20,150 +20,28 @@
 #include "mp3_decoder/mp3_decoder.h"
 #include "opus_decoder/opus_decoder.h"
 #include "vorbis_decoder/vorbis_decoder.h"
+#include "esp_rom_crc.h"
 
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-AudioBuffer::AudioBuffer(size_t maxBlockSize) {
-    if(maxBlockSize) m_resBuffSizeRAM = maxBlockSize;
-    if(maxBlockSize) m_maxBlockSize = maxBlockSize;
-}
-
-AudioBuffer::~AudioBuffer() {
-    if(m_buffer) free(m_buffer);
-    m_buffer = NULL;
-}
-
-int32_t AudioBuffer::getBufsize() { return m_buffSize; }
-
-void AudioBuffer::setBufsize(size_t mbs) {
-    m_buffSizePSRAM = m_buffSizeRAM = m_buffSize = mbs;
-    return;
-}
-
-size_t AudioBuffer::init() {
-    if(m_buffer) free(m_buffer);
-    m_buffer = NULL;
-    if(m_buffSizePSRAM > 0) { // PSRAM found, AudioBuffer will be allocated in PSRAM
-        m_f_psram = true;
-        m_buffSize = m_buffSizePSRAM;
-        m_buffer = (uint8_t*)ps_calloc(m_buffSize, sizeof(uint8_t));
-        m_buffSize = m_buffSizePSRAM - m_resBuffSizePSRAM;
-    }
-    if(!m_buffer) return 0;
-    m_f_init = true;
-    resetBuffer();
-    return m_buffSize;
-}
-
-void AudioBuffer::changeMaxBlockSize(uint16_t mbs) {
-    m_maxBlockSize = mbs;
-    return;
-}
-
-uint16_t AudioBuffer::getMaxBlockSize() { return m_maxBlockSize; }
-
-size_t AudioBuffer::freeSpace() {
-    if(m_readPtr == m_writePtr) {
-        if(m_f_isEmpty == true) m_freeSpace = m_buffSize;
-        else m_freeSpace = 0;
-    }
-    if(m_readPtr < m_writePtr) {
-        m_freeSpace = (m_endPtr - m_writePtr) + (m_readPtr - m_buffer);
-    }
-    if(m_readPtr > m_writePtr) {
-        m_freeSpace = m_readPtr - m_writePtr;
-    }
-    return m_freeSpace;
-}
-
-size_t AudioBuffer::writeSpace() {
-    if(m_readPtr == m_writePtr) {
-        if(m_f_isEmpty == true) m_writeSpace = m_endPtr - m_writePtr;
-        else m_writeSpace = 0;
-    }
-    if(m_readPtr < m_writePtr) {
-        m_writeSpace = m_endPtr - m_writePtr;
-    }
-    if(m_readPtr > m_writePtr) {
-        m_writeSpace = m_readPtr - m_writePtr;
-    }
-    return m_writeSpace;
-}
-
-size_t AudioBuffer::bufferFilled() {
-    if(m_readPtr == m_writePtr) {
-        if(m_f_isEmpty == true) m_dataLength = 0;
-        else m_dataLength = m_buffSize;
-    }
-    if(m_readPtr < m_writePtr) {
-        m_dataLength = m_writePtr - m_readPtr;
-    }
-    if(m_readPtr > m_writePtr) {
-        m_dataLength = (m_endPtr - m_readPtr) + (m_writePtr - m_buffer);
-    }
-    return m_dataLength;
-}
-
-size_t AudioBuffer::getMaxAvailableBytes() {
-    if(m_readPtr == m_writePtr) {
-    //   if(m_f_start)m_dataLength = 0;
-        if(m_f_isEmpty == true) m_dataLength = 0;
-        else m_dataLength = (m_endPtr - m_readPtr);
-    }
-    if(m_readPtr < m_writePtr) {
-        m_dataLength = m_writePtr - m_readPtr;
-    }
-    if(m_readPtr > m_writePtr) {
-        m_dataLength = (m_endPtr - m_readPtr);
-    }
-    return m_dataLength;
-}
-
-void AudioBuffer::bytesWritten(size_t bw) {
-    if(!bw) return;
-    m_writePtr += bw;
-    if(m_writePtr == m_endPtr) { m_writePtr = m_buffer; }
-    if(m_writePtr > m_endPtr) log_e("m_writePtr %i, m_endPtr %i", m_writePtr, m_endPtr);
-    m_f_isEmpty = false;
-}
-
-void AudioBuffer::bytesWasRead(size_t br) {
-    if(!br) return;
-    m_readPtr += br;
-    if(m_readPtr >= m_endPtr) {
-        size_t tmp = m_readPtr - m_endPtr;
-        m_readPtr = m_buffer + tmp;
-    }
-    if(m_readPtr == m_writePtr) m_f_isEmpty = true;
-}
-
-uint8_t* AudioBuffer::getWritePtr() { return m_writePtr; }
-
-uint8_t* AudioBuffer::getReadPtr() {
-    int32_t len = m_endPtr - m_readPtr;
-    if(len < m_maxBlockSize) {                            // be sure the last frame is completed
-        memcpy(m_endPtr, m_buffer, m_maxBlockSize - (len)); // cpy from m_buffer to m_endPtr with len
-    }
-    return m_readPtr;
-}
-
-void AudioBuffer::resetBuffer() {
-    m_writePtr = m_buffer;
-    m_readPtr = m_buffer;
-    m_endPtr = m_buffer + m_buffSize;
-    m_f_isEmpty = true;
-}
-
-uint32_t AudioBuffer::getWritePos() { return m_writePtr - m_buffer; }
+#if AUDIO_SAMPLE_32
+    #define I2S_SAMPLE_BITS I2S_DATA_BIT_WIDTH_32BIT // 24 bit samples left aligned, see audio_sample.h
+#else
+    #define I2S_SAMPLE_BITS I2S_DATA_BIT_WIDTH_16BIT
+#endif
 
-uint32_t AudioBuffer::getReadPos() { return m_readPtr - m_buffer; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // clang-format off
 Audio::Audio(uint8_t i2sPort) {
 
     mutex_playAudioData = xSemaphoreCreateMutex();
     mutex_audioTask     = xSemaphoreCreateMutex();
+    mutex_prefetch      = xSemaphoreCreateMutex();
 
     if(!psramFound()) log_e("audioI2S requires PSRAM!");
+    else { // decoder buffers are taken from the arena, sized for the largest decoder, AAC (libfaad) uses the heap
+        size_t arenaSize = AudioCodec_MaxStateSize(); // of the decoders compiled in
+        if(!m_arena.init(arenaSize)) log_e("audio arena (%u bytes) could not be allocated", arenaSize);
+        AudioArena_Bind(&m_arena);
+    }
 
 #ifdef AUDIO_LOG
     m_f_Log = true;
@@ -177,11 +55,11 @@ Audio::Audio(uint8_t i2sPort) {
     m_i2s_chan_cfg.id            = (i2s_port_t)m_i2s_num;  // I2S_NUM_AUTO, I2S_NUM_0, I2S_NUM_1
     m_i2s_chan_cfg.role          = I2S_ROLE_MASTER;        // I2S controller master role, bclk and lrc signal will be set to output
     m_i2s_chan_cfg.dma_desc_num  = 8;                      // number of DMA buffer
-    m_i2s_chan_cfg.dma_frame_num = 1024;                   // I2S frame number in one DMA buffer.
+    m_i2s_chan_cfg.dma_frame_num = OutputStage::dmaFrames(0); // I2S frame number in one DMA buffer, the largest one (4092 bytes)
     m_i2s_chan_cfg.auto_clear    = true;                   // i2s will always send zero automatically if no data to send
     i2s_new_channel(&m_i2s_chan_cfg, &m_i2s_tx_handle, NULL);
 
-    m_i2s_std_cfg.slot_cfg                = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO); // Set to enable bit shift in Philips mode
+    m_i2s_std_cfg.slot_cfg                = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_SAMPLE_BITS, I2S_SLOT_MODE_STEREO); // Set to enable bit shift in Philips mode
     m_i2s_std_cfg.gpio_cfg.bclk           = I2S_GPIO_UNUSED;           // BCLK, Assignment in setPinout()
     m_i2s_std_cfg.gpio_cfg.din            = I2S_GPIO_UNUSED;           // not used
     m_i2s_std_cfg.gpio_cfg.dout           = I2S_GPIO_UNUSED;           // DOUT, Assignment in setPinout()
@@ -194,24 +72,26 @@ Audio::Audio(uint8_t i2sPort) {
     m_i2s_std_cfg.clk_cfg.clk_src        = I2S_CLK_SRC_DEFAULT;        // Select PLL_F160M as the default source clock
     m_i2s_std_cfg.clk_cfg.mclk_multiple  = I2S_MCLK_MULTIPLE_128;      // mclk = sample_rate * 256
     i2s_channel_init_std_mode(m_i2s_tx_handle, &m_i2s_std_cfg);
+    i2s_event_callbacks_t cbs = {};
+    cbs.on_sent = &Audio::i2sOnSent;                                   // consumer clock of the output stage
+    i2s_channel_register_event_callback(m_i2s_tx_handle, &cbs, this);
+    // the driver hands out at most dma_desc_num - 1 free DMA buffers, one block of the output stage fills one DMA buffer
+    if(!m_output.init(4, m_i2s_chan_cfg.dma_frame_num, m_i2s_chan_cfg.dma_desc_num - 1)) log_e("oom, output stage");
+    m_sched.begin(m_output.capacity(), m_schedTarget);
     I2Sstart();
     m_sampleRate = m_i2s_std_cfg.clk_cfg.sample_rate_hz;
 
-    for(int i = 0; i < 3; i++) {
-        m_filter[i].a0 = 1;
-        m_filter[i].a1 = 0;
-        m_filter[i].a2 = 0;
-        m_filter[i].b1 = 0;
-        m_filter[i].b2 = 0;
-    }
     computeLimit();  // first init, vol = 21, vol_steps = 21
     startAudioTask();
+    startPrefetchTask();
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 Audio::~Audio() {
     // I2Sstop(m_i2s_num);
     // InBuff.~AudioBuffer(); #215 the AudioBuffer is automatically destroyed by the destructor
     setDefaults();
+    for(AudioCodec* c : m_codecs) delete c;
+    AudioArena_Bind(nullptr); // m_arena is freed with this object
 
     i2s_channel_disable(m_i2s_tx_handle);
     i2s_del_channel(m_i2s_tx_handle);
@@ -219,6 +99,7 @@ Audio::~Audio() {
     x_ps_free(&m_playlistBuff);
     x_ps_free(&m_chbuf);
     x_ps_free(&m_lastHost);
+    x_ps_free(&m_fadeNextPath);
     x_ps_free(&m_outBuff);
     x_ps_free(&m_samplesBuff48K);
     x_ps_free(&m_ibuff);
@@ -226,8 +107,10 @@ Audio::~Audio() {
     x_ps_free(&m_speechtxt);
 
     stopAudioTask();
+    stopPrefetchTask();
     vSemaphoreDelete(mutex_playAudioData);
     vSemaphoreDelete(mutex_audioTask);
+    vSemaphoreDelete(mutex_prefetch);
 }
 // clang-format on
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -242,15 +125,98 @@ void Audio::initInBuff() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 esp_err_t Audio::I2Sstart() {
     zeroI2Sbuff();
+    m_output.reset();
+    m_outPending = 0;
     return i2s_channel_enable(m_i2s_tx_handle);
 }
 
 esp_err_t Audio::I2Sstop() {
-    memset(m_outBuff, 0, m_outbuffSize * sizeof(int16_t)); // Clear OutputBuffer
-    memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(int16_t)); // Clear samplesBuff48K
+    memset(m_outBuff, 0, m_outbuffSize * sizeof(audio_sample_t)); // Clear OutputBuffer
+    memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(audio_sample_t)); // Clear samplesBuff48K
     return i2s_channel_disable(m_i2s_tx_handle);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::i2sOnSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) { // ISR, one DMA buffer is transmitted
+    Audio* self = static_cast<Audio*>(user_ctx);
+    self->m_output.onDmaSent();
+    BaseType_t hpTaskWoken = pdFALSE;
+    if(self->m_audioTaskHandle) vTaskNotifyGiveFromISR(self->m_audioTaskHandle, &hpTaskWoken); // wake up the audio task
+    return hpTaskWoken == pdTRUE;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::i2sFeed() { // write the queued blocks as long as DMA buffers are free, never blocks
+    size_t   bytes = 0;
+    uint8_t* blk = NULL;
+    while((blk = m_output.front(&bytes)) != NULL) {
+        size_t    written = 0;
+        esp_err_t err = i2s_channel_write(m_i2s_tx_handle, blk, bytes, &written, 0);
+        if(written) {
+            m_output.consumed(written);
+            if(m_f_measureLatency) latencyMark(LAT_I2S);
+        }
+        if(err == ESP_OK && written == bytes) continue;
+        if     (err == ESP_OK || err == ESP_ERR_TIMEOUT) {} // DMA is full, try again after the next 'on_sent' event
+        else if(err == ESP_ERR_INVALID_ARG)   log_e("NULL pointer or this handle is not tx handle");
+        else if(err == ESP_ERR_INVALID_STATE) log_e("I2S is not ready to write");
+        else log_e("i2s err %i", err);
+        break;
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::i2sDrain() { // loop task, end of file: true when all samples are in the DMA, never waits
+    // the first call hands the drain over to the audio task, loop() asks again until the output stage is empty
+    if(!m_f_drain) {
+        m_f_drained = false;
+        m_f_drain = true;
+        if(m_audioTaskHandle) xTaskNotifyGive(m_audioTaskHandle);
+        return false;
+    }
+    if(!m_f_drained) return false;
+    m_f_drain = false;
+    return true;
+}
+
+void Audio::i2sDrainStep() { // audio task, play the pending samples, pad the last block and write the queued blocks to the DMA
+    if(m_outPending > 0) playChunk();
+    if(m_outPending == 0) m_output.flush();
+    i2sFeed(); // front() gives a block only for a free DMA buffer, the next 'on_sent' event wakes the task again
+    if(m_outPending == 0 && m_output.queued() == 0) {
+        m_validSamples = 0;
+        m_f_drained = true;
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::setDmaBuffers(uint8_t dmaDescNum, uint16_t dmaFrameNum, uint8_t poolBlocks) {
+    // the I2S channel must be deleted and created again, a smaller DMA depth reduces the latency, check getOutputStats() for underruns
+    // dmaFrameNum 0: the largest DMA buffer, see OUTPUT_MAX_BLOCK_FRAMES
+    if(dmaDescNum < 2 || (dmaFrameNum && dmaFrameNum < 64) || poolBlocks < 2) return false;
+    if(dmaFrameNum > OUTPUT_MAX_BLOCK_FRAMES) log_w("DMA buffer of %u frames is above 4092 bytes, %u frames are used", dmaFrameNum, OUTPUT_MAX_BLOCK_FRAMES);
+    dmaFrameNum = OutputStage::dmaFrames(dmaFrameNum); // one output block must fill exactly one DMA buffer
+    xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+    i2s_channel_disable(m_i2s_tx_handle);
+    i2s_del_channel(m_i2s_tx_handle);
+    m_i2s_chan_cfg.dma_desc_num  = dmaDescNum;
+    m_i2s_chan_cfg.dma_frame_num = dmaFrameNum;
+    bool res = (i2s_new_channel(&m_i2s_chan_cfg, &m_i2s_tx_handle, NULL) == ESP_OK);
+    if(res) res = (i2s_channel_init_std_mode(m_i2s_tx_handle, &m_i2s_std_cfg) == ESP_OK);
+    if(res) {
+        i2s_event_callbacks_t cbs = {};
+        cbs.on_sent = &Audio::i2sOnSent;
+        i2s_channel_register_event_callback(m_i2s_tx_handle, &cbs, this);
+        res = m_output.init(poolBlocks, dmaFrameNum, dmaDescNum - 1);
+        m_sched.begin(m_output.capacity(), m_schedTarget);
+        I2Sstart();
+    }
+    if(res) { AUDIO_INFO("DMA buffers: %u x %u frames, output pool: %u blocks", dmaDescNum, dmaFrameNum, poolBlocks); }
+    else    { log_e("I2S channel could not be created"); }
+    xSemaphoreGive(mutex_audioTask);
+    return res;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::getOutputStats(outputStats_t* st) { m_output.getStats(st); }
+
+void Audio::resetOutputStats() { m_output.resetStats(); }
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::zeroI2Sbuff(){
     uint8_t *buff = (uint8_t*)calloc(128, sizeof(uint8_t)); // From IDF V5 there is no longer the zero_dma_buff() function.
     size_t bytes_loaded = 0;                                // As a replacement, we write a small amount of zeros in the buffer and thus reset the entire buffer.
@@ -263,13 +229,10 @@ void Audio::setDefaults() {
     stopSong();
     initInBuff(); // initialize InputBuffer if not already done
     InBuff.resetBuffer();
-    MP3Decoder_FreeBuffers();
-    FLACDecoder_FreeBuffers();
-    AACDecoder_FreeBuffers();
-    OPUSDecoder_FreeBuffers();
-    VORBISDecoder_FreeBuffers();
-    memset(m_outBuff, 0, m_outbuffSize * sizeof(int16_t)); // Clear OutputBuffer
-    memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(int16_t)); // Clear samplesBuff48K
+    releaseDecoders();
+    m_arena.reset(); // all decoder buffers are released
+    memset(m_outBuff, 0, m_outbuffSize * sizeof(audio_sample_t)); // Clear OutputBuffer
+    memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(audio_sample_t)); // Clear samplesBuff48K
     x_ps_free(&m_playlistBuff);
     vector_clear_and_shrink(m_playlistURL);
     vector_clear_and_shrink(m_playlistContent);
@@ -310,6 +273,7 @@ void Audio::setDefaults() {
     m_f_ID3v1TagFound = false;
     m_f_lockInBuffer = false;
     m_f_acceptRanges = false;
+    m_f_directPCM = false;
 
     m_streamType = ST_NONE;
     m_codec = CODEC_NONE;
@@ -339,7 +303,17 @@ void Audio::setDefaults() {
     m_M4A_objectType = 0;
     m_M4A_sampleRate = 0;
     m_sumBytesDecoded = 0;
-    m_vuLeft = m_vuRight = 0; // #835
+    m_trimSkip = 0;
+    m_trimRemain = -1;
+    m_gaplessSkip = 0;
+    m_gaplessTotal = -1;
+    m_streamSample = -1;
+    m_seekTrimSkip = 0;
+    m_seekTrimRemain = -1;
+    m_f_seekExact = false;
+    m_seekIndex.clear();
+    m_m4aIndex.clear();
+    memset(m_latencyT, 0, sizeof(m_latencyT)); // LAT_PLAY will be set again in connecttoFS()
 
     if(m_f_reset_m3u8Codec){m_m3u8Codec = CODEC_AAC;} // reset to default
     m_f_reset_m3u8Codec = true;
@@ -858,25 +832,23 @@ void Audio::UTF8toASCII(char* str) {
 bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t fileStartPos) {
 
     xSemaphoreTakeRecursive(mutex_playAudioData, 0.3 * configTICK_RATE_HZ);
+    int64_t t0 = esp_timer_get_time(); // start of the latency measurement
     bool res = false;
     int16_t dotPos;
     char* audioPath = NULL;
     m_fileStartPos = fileStartPos;
     uint8_t codec = CODEC_NONE;
+    bool raw = false;
 
     if(!path) {printProcessLog(AUDIOLOG_PATH_IS_NULL); goto exit;}  // guard
+    if(path != m_fadeNextPath) x_ps_free(&m_fadeNextPath); // a pending fadeToFS() is replaced
     dotPos = lastIndexOf(path, ".");
     if(dotPos == -1) {AUDIO_INFO("No file extension found"); goto exit;}  // guard
     setDefaults(); // free buffers an set defaults
+    if(m_f_measureLatency) m_latencyT[LAT_PLAY] = t0;
 
-    if(endsWith(path, ".mp3"))  codec = CODEC_MP3;
-    if(endsWith(path, ".m4a"))  codec = CODEC_M4A;
-    if(endsWith(path, ".aac"))  codec = CODEC_AAC;
-    if(endsWith(path, ".wav"))  codec = CODEC_WAV;
-    if(endsWith(path, ".flac")) codec = CODEC_FLAC;
-    if(endsWith(path, ".opus")) {codec = CODEC_OPUS; m_f_ogg = true;}
-    if(endsWith(path, ".ogg"))  {codec = CODEC_OGG;  m_f_ogg = true;}
-    if(endsWith(path, ".oga"))  {codec = CODEC_OGG;  m_f_ogg = true;}
+    codec = codecFromFileName(path);
+    m_f_ogg = (codec == CODEC_OPUS || codec == CODEC_OGG);
     if(codec == CODEC_NONE) {AUDIO_INFO("The %s format is not supported", path + dotPos); goto exit;}   // guard
 
     audioPath = (char *)x_ps_calloc(strlen(path) + 2, sizeof(char));
@@ -889,11 +861,28 @@ bool Audio::connecttoFS(fs::FS& fs, const char* path, int32_t fileStartPos) {
     audiofile = fs.open(audioPath);
     m_dataMode = AUDIO_LOCALFILE;
     m_fileSize = audiofile.size();
+    m_fileFS = &fs;
+    readGaplessInfo(audiofile, codec, &m_trimSkip, &m_trimRemain);
+    m_gaplessSkip = m_trimSkip;
+    m_gaplessTotal = m_trimRemain;
+    m_streamSample = 0;
+    if(m_f_seekIndex) loadSeekIndex(fs, audioPath);
+
+    raw = endsWith(audioPath, ".pcm") || endsWith(audioPath, ".raw"); // no header, always 48kHz 16 bit stereo
+    if(codec == CODEC_WAV && (raw || m_f_directPCMEnabled) && openDirectPCM(raw)) {
+        m_codec = codec;
+        m_f_running = true;
+        res = true;
+        if(m_f_measureLatency) latencyMark(LAT_OPEN);
+        goto exit;
+    }
+    if(raw) {AUDIO_INFO("%s is empty", audioPath); audiofile.close(); goto exit;}
 
     res = initializeDecoder(codec);
     m_codec = codec;
     if(res) m_f_running = true;
     else audiofile.close();
+    if(res && m_f_measureLatency) latencyMark(LAT_OPEN);
 
 exit:
     x_ps_free(&audioPath);
@@ -1515,7 +1504,18 @@ int Audio::read_FLAC_Header(uint8_t* data, size_t len) {
         m_controlCounter = FLAC_OKAY;
         m_audioDataStart = headerSize;
         m_audioDataSize = m_contentlength - m_audioDataStart;
-        FLACSetRawBlockParams(m_flacNumChannels, m_flacSampleRate, m_flacBitsPerSample, m_flacTotalSamplesInStream, m_audioDataSize);
+#if AUDIO_SUPPORT_FLAC
+        if(decoderOf(CODEC_FLAC)) {
+            audioCodecRaw_t raw = {};
+            raw.sampleRate = m_flacSampleRate;
+            raw.totalSamples = m_flacTotalSamplesInStream;
+            raw.audioDataSize = m_audioDataSize;
+            raw.channels = m_flacNumChannels;
+            raw.bitsPerSample = m_flacBitsPerSample;
+            decoderOf(CODEC_FLAC)->setRawParams(&raw);
+            decoderOf(CODEC_FLAC)->startMD5(m_renderFile ? m_flacMD5 : NULL); // the cache is made at idle time, there is time for the MD5
+        }
+#endif
         if(picLen) {
             size_t pos = audiofile.position();
             if(audio_id3image) audio_id3image(audiofile, picPos, picLen);
@@ -1552,13 +1552,14 @@ int Audio::read_FLAC_Header(uint8_t* data, size_t len) {
         uint8_t bps = (nextval & 0x01) << 4;
         bps += (*(data + 16) >> 4) + 1;
         m_flacBitsPerSample = bps;
-        if((bps != 8) && (bps != 16)) {
-            log_e("bits per sample must be 8 or 16, is %i", bps);
+        if((bps != 8) && (bps != 16) && (bps < 17 || bps > 24)) { // 17...24 bit: scaled by the decoder, see setDecoderItems()
+            log_e("bits per sample must be 8, 16 or 17...24, is %i", bps);
             stopSong();
             return -1;
         }
         AUDIO_INFO("FLAC bitsPerSample: %u", m_flacBitsPerSample);
         m_flacTotalSamplesInStream = bigEndian(data + 17, 4);
+        memcpy(m_flacMD5, data + 21, 16);
         if(m_flacTotalSamplesInStream) { AUDIO_INFO("total samples in stream: %lu", (long unsigned int)m_flacTotalSamplesInStream); }
         else { AUDIO_INFO("total samples in stream: N/A"); }
         if(bps != 0 && m_flacTotalSamplesInStream) { AUDIO_INFO("audio file duration: %lu seconds", (long unsigned int)m_flacTotalSamplesInStream / (long unsigned int)m_flacSampleRate); }
@@ -2205,40 +2206,10 @@ int Audio::read_M4A_Header(uint8_t* data, size_t len) {
     }
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_controlCounter == M4A_ILST) { // ilst
-        const char info[12][6] = {"nam\0", "ART\0", "alb\0", "too\0", "cmt\0", "wrt\0", "tmpo\0", "trkn\0", "day\0", "cpil\0", "aART\0", "gen\0"};
-        int        offset = 0;
+        int offset = 0;
         // If it's a local file, the metadata has already been read, even if it comes after the audio block.
         // In the event that they are in front of the audio block in a web stream, read them now
-        if(!m_f_m4aID3dataAreRead) {
-            for(int i = 0; i < 12; i++) {
-                offset = specialIndexOf(data, info[i], len, true); // seek info[] with '\0'
-                if(offset > 0) {
-                    offset += 19;
-                    if(*(data + offset) == 0) offset++;
-                    char   value[256] = {0};
-                    size_t tmp = strlen((const char*)data + offset);
-                    if(tmp > 254) tmp = 254;
-                    memcpy(value, (data + offset), tmp);
-                    value[tmp] = '\0';
-                    m_chbuf[0] = '\0';
-                    if(i == 0) sprintf(m_chbuf, "Title: %s", value);
-                    if(i == 1) sprintf(m_chbuf, "Artist: %s", value);
-                    if(i == 2) sprintf(m_chbuf, "Album: %s", value);
-                    if(i == 3) sprintf(m_chbuf, "Encoder: %s", value);
-                    if(i == 4) sprintf(m_chbuf, "Comment: %s", value);
-                    if(i == 5) sprintf(m_chbuf, "Composer: %s", value);
-                    if(i == 6) sprintf(m_chbuf, "BPM: %s", value);
-                    if(i == 7) sprintf(m_chbuf, "Track Number: %s", value);
-                    if(i == 8) sprintf(m_chbuf, "Year: %s", value);
-                    if(i == 9) sprintf(m_chbuf, "Compile: %s", value);
-                    if(i == 10) sprintf(m_chbuf, "Album Artist: %s", value);
-                    if(i == 11) sprintf(m_chbuf, "Types of: %s", value);
-                    if(m_chbuf[0] != 0) {
-                        if(audio_id3data) audio_id3data(m_chbuf);
-                    }
-                }
-            }
-        }
+        if(!m_f_m4aID3dataAreRead) m4a_ilstMetadata(data, len);
         offset = specialIndexOf(data, "covr", len);
         if(offset > 0){
             picLen = bigEndian(data + offset + 4, 4) - 4;
@@ -2342,6 +2313,8 @@ uint32_t Audio::stopSong() {
         static uint8_t maxWait = 0;
         while(m_f_audioTaskIsDecoding) {vTaskDelay(1); maxWait++; if(maxWait > 100) break;} // in case of error wait max 100ms
         maxWait = 0;
+        stopFilePrefetch(); // no reads after closing the file
+        clearFSQueue();
         uint32_t pos = 0;
         if(m_f_running) {
             m_f_running = false;
@@ -2355,13 +2328,15 @@ uint32_t Audio::stopSong() {
             AUDIO_INFO("Closing audio file \"%s\"", audiofile.name());
             audiofile.close();
         }
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
-        if(m_codec == CODEC_MP3) MP3Decoder_FreeBuffers();
-        if(m_codec == CODEC_AAC) AACDecoder_FreeBuffers();
-        if(m_codec == CODEC_M4A) AACDecoder_FreeBuffers();
-        if(m_codec == CODEC_FLAC) FLACDecoder_FreeBuffers();
-        if(m_codec == CODEC_OPUS) OPUSDecoder_FreeBuffers();
-        if(m_codec == CODEC_VORBIS) VORBISDecoder_FreeBuffers();
+        m_dsp.clearFilters();
+        m_output.drop();     // drop the queued blocks, the DMA plays the rest
+        m_sched.restart();
+        m_f_drain = false;
+        m_f_drained = false;
+        m_renderFile = nullptr;
+        m_outPending = 0;
+        if(decoderOf(m_codec)) decoderOf(m_codec)->release();
+        m_decoder = NULL;
         m_validSamples = 0;
         m_audioCurrentTime = 0;
         m_audioFileDuration = 0;
@@ -2369,6 +2344,7 @@ uint32_t Audio::stopSong() {
         m_dataMode = AUDIO_NONE;
         m_streamType = ST_NONE;
         m_playlistFormat = FORMAT_NONE;
+        if(m_f_fadeStop) {m_f_fadeStop = false; computeLimit(true);} // volume for the next stream
         m_f_lockInBuffer = false;
     return pos;
 }
@@ -2380,9 +2356,11 @@ bool Audio::pauseResume() {
         m_f_running = !m_f_running;
         retVal = true;
         if(!m_f_running) {
-            memset(m_outBuff, 0, m_outbuffSize * sizeof(int16_t)); // Clear OutputBuffer
-            memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(int16_t)); // Clear SamplesBuffer
+            memset(m_outBuff, 0, m_outbuffSize * sizeof(audio_sample_t)); // Clear OutputBuffer
+            memset(m_samplesBuff48K, 0, m_samplesBuff48KSize * sizeof(audio_sample_t)); // Clear SamplesBuffer
             m_validSamples = 0;
+            m_outPending = 0;
+            m_output.drop(); // the DMA still plays its buffers, their credits come back with 'on_sent'
         }
     }
     xSemaphoreGive(mutex_audioTask);
@@ -2390,130 +2368,95 @@ bool Audio::pauseResume() {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-size_t Audio::resampleTo48kStereo(const int16_t* input, size_t inputFrames) {
-
-    float exactOutputFrames = inputFrames * m_resampleRatio;;
-    size_t outputFrames = static_cast<size_t>(std::floor(exactOutputFrames + m_resampleError));
-    m_resampleError += exactOutputFrames - outputFrames;
-
-    std::vector<int16_t> output(outputFrames * 2);
-
-    for (size_t i = 0; i < outputFrames; ++i) {
-        float inFramePos = i / m_resampleRatio;
-        size_t idx = static_cast<size_t>(inFramePos);
-        float frac = inFramePos - idx;
-
-        size_t i1 = idx * 2;
-        size_t i2 = (idx + 1 < inputFrames) ? (idx + 1) * 2 : i1;
-
-        int16_t left1 = input[i1];
-        int16_t right1 = input[i1 + 1];
-        int16_t left2 = input[i2];
-        int16_t right2 = input[i2 + 1];
-
-        m_samplesBuff48K[i * 2]     = static_cast<int16_t>(left1 * (1.0f - frac) + left2 * frac);
-        m_samplesBuff48K[i * 2 + 1] = static_cast<int16_t>(right1 * (1.0f - frac) + right2 * frac);
-    }
-
-    return outputFrames;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void IRAM_ATTR Audio::playChunk() {
 
-    int32_t validSamples = 0;
-    static int32_t samples48K = 0; // samples in 48kHz
-    static uint32_t count = 0;
-    size_t i2s_bytesConsumed = 0;
-    int16_t* sample[2] = {0};
-    int16_t* s2;
-    int sampleSize = 4; // 2 bytes per sample (int16_t) * 2 channels
-    esp_err_t err = ESP_OK;
-    int i= 0;
-
-    if(count > 0) goto i2swrite;
-
-    if(getChannels() == 1){
-        for (int i = m_validSamples - 1; i >= 0; --i) {
-            int16_t sample = m_outBuff[i];
-            m_outBuff[2 * i] = sample;
-            m_outBuff[2 * i + 1] = sample;
-        }
-    //    m_validSamples *= 2;
-    }
-
-    validSamples = m_validSamples;
-
-    while(validSamples) {
-        *sample = m_outBuff + i;
-        computeVUlevel(*sample);
+    if(m_outPending > 0) goto output; // the output stage was full, continue with the remaining frames
+    if(m_renderFile) {renderChunk(); return;}
 
-        //---------- Filterchain, can commented out if not used-------------
-        {
-            if(m_corr > 1) {
-                s2 = *sample;
-                s2[LEFTCHANNEL] /= m_corr;
-                s2[RIGHTCHANNEL] /= m_corr;
-            }
-            IIR_filterChain0(*sample);
-            IIR_filterChain1(*sample);
-            IIR_filterChain2(*sample);
-        }
-        //------------------------------------------------------------------
-        if(m_f_forceMono && m_channels == 2){
-            int32_t xy = ((*sample)[RIGHTCHANNEL] + (*sample)[LEFTCHANNEL]) / 2;
-            (*sample)[RIGHTCHANNEL] = (int16_t)xy;
-            (*sample)[LEFTCHANNEL]  = (int16_t)xy;
-        }
-        Gain(*sample);
-        i += 2;
-        validSamples -= 1;
-    }
-    //------------------------------------------------------------------------------------------
-    samples48K = resampleTo48kStereo(m_outBuff, m_validSamples);
+    // tone filters (the level correction m_corr is part of the first one) and forceMono, mono stays mono up to the
+    // resampler: half the work
+    m_dsp.filter(m_outBuff, m_validSamples, getChannels(), m_f_forceMono);
+    m_outPending = m_dsp.resample(m_outBuff, m_validSamples, getChannels(), m_samplesBuff48K);
+    m_outPos = 0;
+    m_meter.process(m_samplesBuff48K, m_outPending);    // levels before the volume
+    m_gainRamp.process(m_samplesBuff48K, m_outPending); // volume, balance, mute and their ramps, 32 bit: -> I2S slots
+    if(m_f_measureLatency) latencyMark(LAT_RESAMPLE);
 
     if(audio_process_i2s) {
         // processing the audio samples from external before forwarding them to i2s
         bool continueI2S = false;
-        audio_process_i2s((int16_t*)m_samplesBuff48K, samples48K, &continueI2S); // 48KHz stereo 16bps
+        audio_process_i2s(m_samplesBuff48K, m_outPending, &continueI2S); // 48KHz stereo, 16 or 32 bit slots
         if(!continueI2S) {
-            samples48K = 0;
-            count = 0;
+            m_outPending = 0;
+            m_validSamples = 0;
             return;
         }
     }
 
-i2swrite:
-
-    err = i2s_channel_write(m_i2s_tx_handle, (int16_t*)m_samplesBuff48K + count, samples48K * sampleSize, &i2s_bytesConsumed, 10);
-    if( ! (err == ESP_OK || err == ESP_ERR_TIMEOUT)) goto exit;
-    samples48K -= i2s_bytesConsumed / sampleSize;
-    count += i2s_bytesConsumed / 2;
-    if(samples48K <= 0) { m_validSamples = 0; count = 0; }
-
-// ---- statistics, bytes written to I2S (every 10s)
-    // static int cnt = 0;
-    // static uint32_t t = millis();
-
-    // if(t + 10000 < millis()){
-    //     log_w("%i", cnt);
-    //     cnt = 0;
-    //     t = millis();
-    // }
-    // cnt+= i2s_bytesConsumed;
-//-------------------------------------------
-
-
-    return;
-exit:
-    if     (err == ESP_OK) return;
-    else if(err == ESP_ERR_INVALID_ARG)   log_e("NULL pointer or this handle is not tx handle");
-    else if(err == ESP_ERR_TIMEOUT)       log_e("Writing timeout, no writing event received from ISR within ticks_to_wait");
-    else if(err == ESP_ERR_INVALID_STATE) log_e("I2S is not ready to write");
-    else log_e("i2s err %i", err);
+output:
+    while(m_outPending > 0) { // copy into the DMA sized blocks of the output stage
+        uint16_t room = 0;
+        audio_sample_t* blk = m_output.acquire(&room);
+        if(!blk) break; // all blocks are queued, wait for the DMA
+        uint16_t n = min((int32_t)room, m_outPending);
+        memcpy(blk, m_samplesBuff48K + m_outPos * 2, n * 2 * sizeof(audio_sample_t));
+        m_output.produced(n);
+        m_outPos += n;
+        m_outPending -= n;
+    }
+    i2sFeed();
+    if(m_outPending == 0) m_validSamples = 0;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::renderToFile(fs::FS& fs, const char* path, File* out) {
+    // the file is decoded as fast as the audio task can, gapless trim and resampling as for playing, no tone, no volume.
+    // Mono stays mono. The caller writes the container header and waits for !isRunning(), see getRenderResult()
+    if(!out || !*out) return false;
+    uint8_t quality = m_mp3Quality;
+    m_mp3Quality = MP3_QUALITY_FULL; // the cache is made while nothing plays, there is time for the full quality
+    bool ok = connecttoFS(fs, path);
+    m_mp3Quality = quality;
+    if(!ok) return false;
+    if(m_f_directPCM) {stopSong(); return false;} // already 48kHz 16 bit
+    xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+    memset(&m_render, 0, sizeof(m_render));
+    m_renderFile = out;
+    xSemaphoreGive(mutex_audioTask);
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::renderChunk() { // audio task, renderToFile(): 48kHz frames -> file
+    uint32_t frames = m_dsp.resample(m_outBuff, m_validSamples, getChannels(), m_samplesBuff48K);
+    m_validSamples = 0;
+    if(!frames) return;
+    if(!m_render.channels) m_render.channels = getChannels();
+    int16_t* pcm = AudioDsp::toPcm16(m_samplesBuff48K, frames, m_render.channels); // the cache is 16 bit
+    uint32_t bytes = frames * m_render.channels * sizeof(int16_t);
+    if(m_renderFile->write((uint8_t*)pcm, bytes) != bytes) { // card full
+        AUDIO_INFO("render: write error");
+        m_f_running = false; // processLocalFile() does not reach the end of file, done stays false
+        return;
+    }
+    m_render.crc32 = esp_rom_crc32_le(m_render.crc32, (uint8_t*)pcm, bytes);
+    m_render.frames += frames;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::loop() {
-    if(!m_f_running) return;
+    if(!m_f_running) {
+        if(m_fadeNextPath) fadeNext(); // the stream has ended while it faded out
+        return;
+    }
+
+    if(m_f_fadeStop && m_gainRamp.isSilent()) { // fadeOutAndStop(), the faded blocks must be sent before stopping
+        outputStats_t st;
+        m_output.getStats(&st);
+        if(!m_fadeStopBlock) m_fadeStopBlock = st.blocksSent + st.queued + m_outPending / max((uint16_t)1, m_output.blockFrames()) + 2;
+        else if((int32_t)(st.blocksSent - m_fadeStopBlock) >= 0) {
+            stopSong();
+            if(m_fadeNextPath) fadeNext();
+            return;
+        }
+    }
 
     if(m_playlistFormat != FORMAT_M3U8) { // normal process
         switch(m_dataMode) {
@@ -3278,10 +3221,37 @@ void Audio::processLocalFile() {
     static bool     audioHeaderFound = false;
     const uint32_t  timeout = 8000;                          // ms
     const uint32_t  maxFrameSize = InBuff.getMaxBlockSize(); // every mp3/aac frame is not bigger
-    uint32_t        availableBytes = 0;
     int32_t         bytesAddedToBuffer = 0;
     int32_t         offset = 0;
 
+    if(m_f_drain) { // end of file, the audio task empties the output stage
+        if(i2sDrain()) localFileEnded();
+        return;
+    }
+
+    if(m_f_directPCM) { // the audio task copies the file to the output stage, see directPCMFill()
+        if(m_fileStartPos > 0) {
+            setFilePos(m_fileStartPos);
+            m_fileStartPos = -1;
+        }
+        if(m_resumeFilePos >= 0) { // setFilePos(), full frames only
+            xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+            uint32_t frameSize = 2 * m_channels;
+            uint32_t frames = (max((uint32_t)m_resumeFilePos, m_audioDataStart) - m_audioDataStart) / frameSize;
+            if(frames * frameSize > m_audioDataSize) frames = m_audioDataSize / frameSize;
+            audiofile.seek(m_audioDataStart + frames * frameSize);
+            m_directRemain = m_audioDataSize - frames * frameSize;
+            m_directPlayed = frames;
+            m_resumeFilePos = -1;
+            m_f_eof = false;
+            xSemaphoreGive(mutex_audioTask);
+        }
+        if(!m_f_eof) return;
+        if(m_nextFile && spliceNextFile()) return; // gapless, the output continues with the next file
+        i2sDrain();
+        return;
+    }
+
     if(m_f_firstCall) { // runs only one time per connection, prepare for start
         m_f_firstCall = false;
         m_f_stream = false;
@@ -3289,8 +3259,7 @@ void Audio::processLocalFile() {
         newFilePos = 0;
         byteCounter = 0;
         ctime = millis();
-        if(m_codec == CODEC_M4A) seek_m4a_stsz(); // determine the pos of atom stsz
-        if(m_codec == CODEC_M4A) seek_m4a_ilst(); // looking for metadata
+        if(m_codec == CODEC_M4A) parse_m4a_moov(); // sample tables and metadata
         m_audioDataSize = 0;
         m_audioDataStart = 0;
         m_f_allDataReceived = false;
@@ -3302,6 +3271,7 @@ void Audio::processLocalFile() {
         if(m_resumeFilePos <  (int32_t)m_audioDataStart) m_resumeFilePos = m_audioDataStart;
         if(m_resumeFilePos >= (int32_t)m_audioDataStart + m_audioDataSize) {goto exit;}
 
+        stopFilePrefetch(); // the file pointer will be changed
         m_f_lockInBuffer = true;                          // lock the buffer, the InBuffer must not be re-entered in playAudioData()
             while(m_f_audioTaskIsDecoding) vTaskDelay(1); // We can't reset the InBuffer while the decoding is in progress
             InBuff.resetBuffer();
@@ -3313,9 +3283,13 @@ void Audio::processLocalFile() {
         return;
     }
 
-    availableBytes = InBuff.writeSpace();
-    bytesAddedToBuffer = audiofile.read(InBuff.getWritePtr(), availableBytes);
-    if(bytesAddedToBuffer > 0) {byteCounter += bytesAddedToBuffer; InBuff.bytesWritten(bytesAddedToBuffer);}
+    if(m_f_prefetchActive) {
+        byteCounter = m_prefetchFilePos; // the prefetch task reads
+    }
+    else {
+        bytesAddedToBuffer = readFileToInBuff();
+        if(bytesAddedToBuffer > 0) byteCounter += bytesAddedToBuffer;
+    }
     if(m_audioDataSize && byteCounter >= m_audioDataSize){if(!m_f_allDataReceived) m_f_allDataReceived = true;}
     // log_e("byteCounter %u >= m_audioDataSize %u, m_f_allDataReceived % i", byteCounter, m_audioDataSize, m_f_allDataReceived);
 
@@ -3323,15 +3297,26 @@ void Audio::processLocalFile() {
         if(InBuff.bufferFilled() < InBuff.getMaxBlockSize()) return;
         if(m_codec == CODEC_OPUS || m_codec == CODEC_VORBIS) {if(InBuff.bufferFilled() < 0xFFFF) return;} // ogg frame <= 64kB
         if(m_codec == CODEC_WAV)   {while((m_resumeFilePos % 4) != 0){m_resumeFilePos++; offset++; if(m_resumeFilePos >= m_fileSize) goto exit;}}  // must divisible by four
-        if(m_codec == CODEC_MP3)   {offset = mp3_correctResumeFilePos();  if(offset == -1) goto exit; MP3Decoder_ClearBuffer();}
-        if(m_codec == CODEC_FLAC)  {offset = flac_correctResumeFilePos(); if(offset == -1) goto exit; FLACDecoderReset();}
-        if(m_codec == CODEC_M4A)   {offset = m4a_correctResumeFilePos();  if(offset == -1) goto exit;}
-        if(m_codec == CODEC_VORBIS){offset = ogg_correctResumeFilePos();  if(offset == -1) goto exit; VORBISDecoder_ClearBuffers();}
-        if(m_codec == CODEC_OPUS)  {offset = ogg_correctResumeFilePos();  if(offset == -1) goto exit; OPUSDecoder_ClearBuffers();}
+        if(m_codec == CODEC_MP3)   {offset = mp3_correctResumeFilePos();  if(offset == -1) goto exit; decoderOf(m_codec)->reset();}
+        if(m_codec == CODEC_FLAC)  {offset = flac_correctResumeFilePos(); if(offset == -1) goto exit; decoderOf(m_codec)->reset();}
+        if(m_codec == CODEC_M4A)   {offset = m_f_seekExact ? 0 : m4a_correctResumeFilePos();  if(offset == -1) goto exit;} // seek index: first byte of an aac frame
+        if(m_codec == CODEC_VORBIS){offset = ogg_correctResumeFilePos();  if(offset == -1) goto exit; decoderOf(m_codec)->reset();}
+        if(m_codec == CODEC_OPUS)  {offset = ogg_correctResumeFilePos();  if(offset == -1) goto exit; decoderOf(m_codec)->reset();}
+        if(offset && m_f_seekExact) { // the seek index does not fit to the file
+            m_f_seekExact = false;
+            m_seekTrimSkip = 0;
+            m_seekTrimRemain = -1;
+        }
         m_haveNewFilePos  = newFilePos + offset - m_audioDataStart;
         m_sumBytesDecoded = newFilePos + offset - m_audioDataStart;
         newFilePos = 0;
         m_resumeFilePos = -1;
+        m_trimSkip = m_seekTrimSkip;     // seek index: preroll and frames up to the target, otherwise the encoder delay is behind us
+        m_trimRemain = m_seekTrimRemain; // and the remaining frames are unknown now
+        m_streamSample = m_f_seekExact ? (int32_t)m_seekStartSample : -1;
+        m_seekTrimSkip = 0;
+        m_seekTrimRemain = -1;
+        m_f_seekExact = false;
         InBuff.bytesWasRead(offset);
         byteCounter += offset;
     }
@@ -3363,6 +3348,11 @@ void Audio::processLocalFile() {
         else {
             m_f_stream = true;
             AUDIO_INFO("stream ready");
+            if(m_f_measureLatency) latencyMark(LAT_HEADER);
+            if(m_f_seekIndex && !m_seekIndex.isValid() && !m_f_ogg && (m_codec == CODEC_MP3 || m_codec == CODEC_FLAC)) {
+                uint8_t q = (m_codec == CODEC_MP3) ? m_mp3QualityUsed : 0; // first play, build it on the fly
+                m_seekIndex.beginBuild(m_codec, SEEK_INDEX_F_SAMPLE_EXACT, m_seekIndexInterval, m_fileSize, q);
+            }
         }
     }
 
@@ -3371,26 +3361,353 @@ void Audio::processLocalFile() {
         m_fileStartPos = -1;
     }
 
+    if(m_f_prefetch && !m_f_prefetchActive && !newFilePos && m_resumeFilePos < 0 && !m_f_allDataReceived) startFilePrefetch();
+
     // end of file reached? - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_f_eof){ // m_f_eof and m_f_ID3v1TagFound will be set in playAudioData()
+        stopFilePrefetch();
         if(m_f_ID3v1TagFound) readID3V1Tag();
-exit:
-        char* afn = NULL;
-        if(audiofile) afn = strdup(audiofile.name()); // store temporary the name
-        stopSong();
-        m_audioCurrentTime = 0;
-        m_audioFileDuration = 0;
-        m_resumeFilePos = -1;
-        m_haveNewFilePos = 0;
-        m_codec = CODEC_NONE;
+        if(m_seekIndex.isBuilding()) saveSeekIndex();
+#if AUDIO_SUPPORT_FLAC
+        if(m_codec == CODEC_FLAC && !m_f_ogg && decoderOf(CODEC_FLAC)) {
+            uint32_t corrupt = decoderOf(CODEC_FLAC)->corruptFrames();
+            if(corrupt) AUDIO_INFO("FLAC: %lu corrupt frames concealed", (long unsigned int)corrupt);
+            if(m_renderFile) {
+                m_render.md5 = decoderOf(CODEC_FLAC)->md5Result();
+                m_render.corrupt = corrupt;
+                if(m_render.md5 == FLAC_MD5_WRONG) AUDIO_INFO("FLAC: the decoded samples do not match the MD5 of the file");
+            }
+        }
+#endif
+        if(m_nextFile && spliceNextFile()) return; // gapless, the output continues with the next file
+        if(m_renderFile) m_render.done = true;
+        i2sDrain(); // localFileEnded() follows when the audio task has written the rest to the DMA
+    }
+    return;
+exit: // header timeout, seek behind the end
+    localFileEnded();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::localFileEnded() {
+    char* afn = NULL;
+    if(audiofile) afn = strdup(audiofile.name()); // store temporary the name
+    if(m_f_measureLatency && m_decodeStats[m_codec].frames) {
+        audio_decodestats_t* ds = &m_decodeStats[m_codec];
+        AUDIO_INFO("%s decode time: avg %lu us/frame, max %lu us, %lu frames", codecname[m_codec],
+                   (long unsigned int)(ds->sum_us / ds->frames), (long unsigned int)ds->max_us, (long unsigned int)ds->frames);
+    }
+    stopSong();
+    m_audioCurrentTime = 0;
+    m_audioFileDuration = 0;
+    m_resumeFilePos = -1;
+    m_haveNewFilePos = 0;
+    m_codec = CODEC_NONE;
 
-        if(afn) {
-            if(audio_eof_mp3) audio_eof_mp3(afn);
-            AUDIO_INFO("End of file \"%s\"", afn);
-            x_ps_free(&afn);
+    if(afn) {
+        if(audio_eof_mp3) audio_eof_mp3(afn);
+        AUDIO_INFO("End of file \"%s\"", afn);
+        x_ps_free(&afn);
+    }
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+uint8_t Audio::codecFromFileName(const char* path) {
+    uint8_t codec = CODEC_NONE;
+    if     (endsWith(path, ".mp3"))  codec = CODEC_MP3;
+    else if(endsWith(path, ".mp2"))  codec = CODEC_MP3; // layer II, same decoder
+    else if(endsWith(path, ".m4a"))  codec = CODEC_M4A;
+    else if(endsWith(path, ".aac"))  codec = CODEC_AAC;
+    else if(endsWith(path, ".wav"))  codec = CODEC_WAV;
+    else if(endsWith(path, ".pcm"))  codec = CODEC_WAV; // raw, see openDirectPCM()
+    else if(endsWith(path, ".raw"))  codec = CODEC_WAV;
+    else if(endsWith(path, ".flac")) codec = CODEC_FLAC;
+    else if(endsWith(path, ".opus")) codec = CODEC_OPUS;
+    else if(endsWith(path, ".ogg"))  codec = CODEC_OGG;
+    else if(endsWith(path, ".oga"))  codec = CODEC_OGG;
+    if(codec == CODEC_OGG && !decoderOf(CODEC_FLAC) && !decoderOf(CODEC_OPUS) && !decoderOf(CODEC_VORBIS)) return CODEC_NONE;
+    if(codec != CODEC_WAV && codec != CODEC_OGG && !decoderOf(codec)) return CODEC_NONE; // not compiled in, AUDIO_SUPPORT_xxx
+    return codec;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::openDirectPCM(bool raw) {
+    // 16 bit pcm with 48kHz is already the format of the output stage: the data chunk is read straight into the output
+    // blocks by the audio task, only the gain (volume, balance, mute, ramps) and audio_process_i2s() are applied.
+    // Tone and forceMono are bypassed. Raw files (.pcm, .raw) have no header and must be 48kHz 16 bit stereo.
+    uint32_t dataStart = 0;
+    uint32_t dataSize = m_fileSize;
+    uint32_t sampleRate = 48000;
+    uint16_t format = 1;
+    uint16_t channels = 2;
+    uint16_t bits = 16;
+
+    if(!raw) {
+        uint8_t sec[512]; // the first sector holds the chunks of most files, one SD command instead of one per chunk
+        uint8_t h[24];
+        bool    fmtFound = false;
+        audiofile.seek(0);
+        int32_t secLen = audiofile.read(sec, sizeof(sec));
+        if(secLen < 12 || memcmp(sec, "RIFF", 4) || memcmp(sec + 8, "WAVE", 4)) {audiofile.seek(0); return false;}
+        uint32_t pos = 12;
+        while(pos + 8 <= m_fileSize) { // chunks: "fmt ", maybe "LIST", "fact" ... and "data"
+            if(pos + 24 <= (uint32_t)secLen) memcpy(h, sec + pos, 24);
+            else {
+                audiofile.seek(pos);
+                if(audiofile.read(h, 8) != 8) break;
+                if(!memcmp(h, "fmt ", 4) && audiofile.read(h + 8, 16) != 16) break;
+            }
+            uint32_t len = h[4] | (h[5] << 8) | (h[6] << 16) | ((uint32_t)h[7] << 24);
+            if(!memcmp(h, "fmt ", 4) && len >= 16) {
+                format     = h[8]  | (h[9] << 8);
+                channels   = h[10] | (h[11] << 8);
+                sampleRate = h[12] | (h[13] << 8) | (h[14] << 16) | ((uint32_t)h[15] << 24);
+                bits       = h[22] | (h[23] << 8);
+                fmtFound = true;
+            }
+            else if(!memcmp(h, "data", 4)) {
+                dataStart = pos + 8;
+                dataSize = min(len, (uint32_t)(m_fileSize - dataStart));
+                break;
+            }
+            pos += 8 + len + (len & 1); // chunks are word aligned
         }
-        return;
+        if(!fmtFound || !dataStart || format != 1 || sampleRate != 48000 || bits != 16 || (channels != 1 && channels != 2)) {
+            audiofile.seek(0); // the wav decoder reads the header again
+            return false;
+        }
+    }
+    if(dataSize < 2u * channels) return false;
+
+    audiofile.seek(dataStart);
+    InBuff.changeMaxBlockSize(m_frameSizeWav); // as for the wav decoder, a spliced wav file continues warm
+    setSampleRate(sampleRate);
+    setBitsPerSample(bits);
+    setChannels(channels);
+    m_audioDataStart = dataStart;
+    m_audioDataSize = dataSize;
+    m_avr_bitrate = m_bitRate = sampleRate * bits * channels;
+    m_audioFileDuration = dataSize / (sampleRate * 2 * channels);
+    m_audioCurrentTime = 0;
+    m_directRemain = dataSize;
+    m_directPlayed = 0;
+    m_f_stream = true;
+    m_f_directPCM = true; // last, the audio task starts reading now
+    AUDIO_INFO("direct PCM: %s, %lu Hz, %u bit, %u ch, %lu bytes", raw ? "raw" : "wav", (long unsigned int)sampleRate, bits, channels, (long unsigned int)dataSize);
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::directPCMFill() { // audio task, file -> output blocks -> I2S
+    uint32_t frameSize = 2 * m_channels;
+    while(m_directRemain >= frameSize) {
+        uint16_t room = 0;
+        audio_sample_t* blk = m_output.acquire(&room);
+        if(!blk) break; // all blocks are queued, wait for the DMA
+        uint32_t n = min((uint32_t)room, m_directRemain / frameSize);
+        int16_t* dst = AudioDsp::pcm16Tail(blk, n, m_channels); // read into the end of the block and widened in place
+        int32_t  bytes = audiofile.read((uint8_t*)dst, n * frameSize);
+        if(bytes < (int32_t)(n * frameSize)) { // file is shorter than the data chunk
+            n = (bytes > 0) ? bytes / frameSize : 0;
+            m_directRemain = 0;
+        }
+        else m_directRemain -= n * frameSize;
+        AudioDsp::widenPcm16(blk, dst, n, m_channels);
+        m_directPlayed += n;
+        m_meter.process(blk, n);
+        m_gainRamp.process(blk, n); // volume, balance, mute and their ramps, 32 bit: -> I2S slots
+        if(audio_process_i2s) {
+            bool continueI2S = false;
+            audio_process_i2s(blk, n, &continueI2S); // 48KHz stereo, 16 or 32 bit slots
+            if(!continueI2S) n = 0;
+        }
+        if(n) m_output.produced(n);
+    }
+    if(m_directRemain < frameSize) m_f_eof = true; // processLocalFile() drains the output stage
+    m_audioCurrentTime = (float)m_directPlayed / 48000;
+    i2sFeed();
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::readGaplessInfo(File& file, uint8_t codec, uint32_t* skip, int32_t* total) {
+    // Encoders add silence at the beginning (encoder delay) and the end (padding) of the stream. The exact number of samples
+    // is found in the LAME/Xing header of mp3 files and in the OpusHead and the last granule position of opus files.
+    // skip:  decoded frames (samples per channel) to drop at the beginning
+    // total: frames to play after skip, -1 if unknown
+    *skip = 0;
+    *total = -1;
+    if(!file) return;
+    uint8_t buf[256];
+    int32_t n = 0;
+
+    if(codec == CODEC_MP3) {
+        uint32_t pos = 0;
+        file.seek(0);
+        if(file.read(buf, 10) == 10 && specialIndexOf(buf, "ID3", 4) == 0) {
+            pos = bigEndian(buf + 6, 4, 7) + 10;     // skip ID3v2 tag
+            if(buf[5] & 0x10) pos += 10;             // footer present
+        }
+        file.seek(pos);
+        n = file.read(buf, sizeof(buf));
+        file.seek(0);
+        gaplessInfo_t gi;
+        if(!Gapless_MP3Info(buf, n, m_mp3Quality == MP3_QUALITY_HALFRATE, &gi)) return; // no VBR header, nothing to trim
+        *skip = gi.skip;
+        *total = gi.total;
+        if(m_f_Log) log_i("gapless: delay %lu, padding %lu, frames %lu", (long unsigned int)gi.delay, (long unsigned int)gi.padding, (long unsigned int)gi.frames);
+    }
+
+    if(codec == CODEC_OPUS) {
+        file.seek(0);
+        n = file.read(buf, 64);
+        if(n < 64 || specialIndexOf(buf, "OggS", 4) != 0) {file.seek(0); return;}
+        int32_t head = 27 + buf[26];              // behind the segment table of the first page
+        if(head + 12 > n || memcmp(buf + head, "OpusHead", 8) != 0) {file.seek(0); return;}
+        uint32_t preSkip = buf[head + 10] + (buf[head + 11] << 8);
+        *skip = preSkip;
+        // the granule position of the last page is the number of samples (48kHz) including pre-skip
+        uint32_t tailSize = min((uint32_t)4096, (uint32_t)file.size());
+        uint8_t* tail = (uint8_t*)x_ps_malloc(tailSize);
+        if(tail) {
+            file.seek(file.size() - tailSize);
+            n = file.read(tail, tailSize);
+            for(int32_t i = n - 27; i >= 0; i--) {
+                if(tail[i] != 'O' || memcmp(tail + i, "OggS", 4) != 0) continue;
+                uint64_t granule = 0;
+                for(int j = 7; j >= 0; j--) granule = (granule << 8) | tail[i + 6 + j];
+                if(granule > preSkip && granule != UINT64_MAX) *total = granule - preSkip;
+                break;
+            }
+            x_ps_free(&tail);
+        }
+        file.seek(0);
+    }
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::queueFS(fs::FS& fs, const char* path) {
+    if(!path) {printProcessLog(AUDIOLOG_PATH_IS_NULL); return false;}  // guard
+    if(codecFromFileName(path) == CODEC_NONE) {AUDIO_INFO("The format of %s is not supported", path); return false;}   // guard
+    if(m_dataMode != AUDIO_LOCALFILE) return connecttoFS(fs, path); // nothing is playing, start immediately
+
+    if(m_queueFS != &fs) clearFSQueue();
+    m_queueFS = &fs;
+    char* audioPath = (char *)x_ps_calloc(strlen(path) + 2, sizeof(char));
+    if(!audioPath) {printProcessLog(AUDIOLOG_OUT_OF_MEMORY); return false;}
+    if(path[0] != '/') audioPath[0] = '/';
+    strcat(audioPath, path);
+    m_fsQueue.push_back(audioPath);
+    armNextFile();
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::clearFSQueue() {
+    for(int i = 0; i < m_fsQueue.size(); i++) x_ps_free(&m_fsQueue[i]);
+    vector_clear_and_shrink(m_fsQueue);
+    if(m_nextFile) m_nextFile.close();
+    m_nextCodec = CODEC_NONE;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::armNextFile() { // open and pre-parse the head of the queue while the current file is playing
+    while(!m_nextFile && m_fsQueue.size() && m_queueFS) {
+        char* path = m_fsQueue[0];
+        m_fsQueue.erase(m_fsQueue.begin());
+        if(m_queueFS->exists(path)) {
+            m_nextFile = m_queueFS->open(path);
+            m_nextCodec = codecFromFileName(path);
+            readGaplessInfo(m_nextFile, m_nextCodec, &m_nextTrimSkip, &m_nextTrimRemain);
+            AUDIO_INFO("next file: \"%s\"", path);
+        }
+        else printProcessLog(AUDIOLOG_FILE_NOT_FOUND, path);
+        x_ps_free(&path);
+    }
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::spliceNextFile() {
+    // End of file and the next file is armed. The output stage is not flushed, the first samples of the next file follow
+    // the last samples of this one. The decoder is only reset (not freed) if the codec is the same.
+    char* afn = strdup(audiofile.name()); // store temporary the name
+    uint8_t codec = m_nextCodec;
+
+    stopFilePrefetch(); // InBuff is reset below
+    m_f_lockInBuffer = true;                          // lock the buffer, the InBuffer must not be re-entered in playAudioData()
+    while(m_f_audioTaskIsDecoding) vTaskDelay(1);     // We can't reset the InBuffer while the decoding is in progress
+    if(m_f_measureLatency && m_decodeStats[m_codec].frames) {
+        audio_decodestats_t* ds = &m_decodeStats[m_codec];
+        AUDIO_INFO("%s decode time: avg %lu us/frame, max %lu us, %lu frames", codecname[m_codec],
+                   (long unsigned int)(ds->sum_us / ds->frames), (long unsigned int)ds->max_us, (long unsigned int)ds->frames);
+    }
+    audiofile.close();
+    audiofile = m_nextFile;
+    m_nextFile = File();
+    m_fileSize = audiofile.size();
+
+    bool warm = (codec == m_codec) && (codec == CODEC_MP3 || codec == CODEC_FLAC || codec == CODEC_WAV);
+    if(codec == CODEC_MP3 && m_mp3QualityUsed != m_mp3Quality) warm = false; // the output rate may change
+    if(warm) {
+        if(decoderOf(codec)) decoderOf(codec)->reset();
+    }
+    else { // free all decoders, then the arena can be reset
+        releaseDecoders();
+        m_arena.reset();
+    }
+    InBuff.resetBuffer();
+
+    m_f_firstCall = true;        // InitSequence for processLocalFile
+    m_f_firstCurTimeCall = true; // InitSequence for computeAudioTime
+    m_f_firstPlayCall = true;    // InitSequence for playAudioData
+    m_f_playing = false;         // search the first syncword
+    m_f_stream = false;
+    m_f_decode_ready = false;
+    m_f_eof = false;
+    m_f_ID3v1TagFound = false;
+    m_f_m4aID3dataAreRead = false;
+    m_f_unsync = false;
+    m_f_exthdr = false;
+    m_f_allDataReceived = false;
+    m_f_ogg = (codec == CODEC_OPUS || codec == CODEC_OGG);
+    m_controlCounter = 0;
+    m_resumeFilePos = -1;
+    m_fileStartPos = -1;
+    m_haveNewFilePos = 0;
+    m_audioCurrentTime = 0;
+    m_audioFileDuration = 0;
+    m_audioDataStart = 0;
+    m_audioDataSize = 0;
+    m_avr_bitrate = 0;
+    m_bitRate = 0;
+    m_bytesNotDecoded = 0;
+    m_sumBytesDecoded = 0;
+    m_curSample = 0;
+    m_ID3Size = 0;
+    m_trimSkip = m_nextTrimSkip;
+    m_trimRemain = m_nextTrimRemain;
+    m_gaplessSkip = m_trimSkip;
+    m_gaplessTotal = m_trimRemain;
+    m_streamSample = 0;
+    m_seekTrimSkip = 0;
+    m_seekTrimRemain = -1;
+    m_f_seekExact = false;
+    m_codec = codec;
+    m_fileFS = m_queueFS;
+    m_seekIndex.clear();
+    m_m4aIndex.clear();
+    if(m_f_seekIndex && m_fileFS) loadSeekIndex(*m_fileFS, audiofile.path());
+
+    bool raw = endsWith(audiofile.name(), ".pcm") || endsWith(audiofile.name(), ".raw");
+    m_f_directPCM = false;
+    bool res = false;
+    if(codec == CODEC_WAV && (raw || m_f_directPCMEnabled)) res = openDirectPCM(raw);
+    if(!res && !raw) res = warm || initializeDecoder(codec);
+    m_f_lockInBuffer = false;
+
+    if(afn) {
+        if(audio_eof_mp3) audio_eof_mp3(afn);
+        AUDIO_INFO("End of file \"%s\"", afn);
+        x_ps_free(&afn);
     }
+    if(!res) {stopSong(); return true;} // the decoder could not be initialized
+    AUDIO_INFO("Reading file: \"%s\"", audiofile.name());
+    armNextFile();
+    return true;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::trimDecodedFrames() { // gapless, drop the encoder delay at the beginning and the padding at the end
+    m_validSamples = Gapless_Trim(m_outBuff, m_validSamples, getChannels(), &m_trimSkip, &m_trimRemain);
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::processWebStream() {
@@ -3488,6 +3805,10 @@ void Audio::processWebStream() {
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::processWebFile() {
     if(!m_lastHost) {log_e("m_lastHost is NULL"); return;}   // guard
+    if(m_f_drain) { // end of file, the audio task empties the output stage
+        if(i2sDrain()) webFileEnded();
+        return;
+    }
     const uint32_t  maxFrameSize = InBuff.getMaxBlockSize(); // every mp3/aac frame is not bigger
     static uint32_t chunkSize;                               // chunkcount read from stream
     static size_t   audioDataCount;                          // counts the decoded audiodata only
@@ -3595,22 +3916,24 @@ void Audio::processWebFile() {
     // end of webfile reached? - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
     if(m_f_eof) { // m_f_eof and m_f_ID3v1TagFound will be set in playAudioData()
         if(m_f_ID3v1TagFound) readID3V1Tag();
-
-        stopSong();
-        if(m_f_tts) {
-            AUDIO_INFO("End of speech \"%s\"", m_speechtxt);
-            if(audio_eof_speech) audio_eof_speech(m_speechtxt);
-            x_ps_free(&m_speechtxt);
-        }
-        else {
-            AUDIO_INFO("End of webstream: \"%s\"", m_lastHost);
-            if(audio_eof_stream) audio_eof_stream(m_lastHost);
-        }
-        return;
+        i2sDrain(); // webFileEnded() follows when the audio task has written the rest to the DMA
     }
     return;
 }
 //——————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————
+void Audio::webFileEnded() {
+    stopSong();
+    if(m_f_tts) {
+        AUDIO_INFO("End of speech \"%s\"", m_speechtxt);
+        if(audio_eof_speech) audio_eof_speech(m_speechtxt);
+        x_ps_free(&m_speechtxt);
+    }
+    else {
+        AUDIO_INFO("End of webstream: \"%s\"", m_lastHost);
+        if(audio_eof_stream) audio_eof_stream(m_lastHost);
+    }
+}
+//——————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————————
 void Audio::processWebStreamTS() {
     uint32_t        availableBytes;     // available bytes in stream
     static bool     f_firstPacket;
@@ -4193,87 +4516,44 @@ lastToDo:
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::initializeDecoder(uint8_t codec) {
-    uint32_t gfH = 0;
-    uint32_t hWM = 0;
+    uint32_t    gfH = 0;
+    uint32_t    hWM = 0;
+    AudioCodec* dec = decoderOf(codec);
+
+    if(codec == CODEC_WAV) {InBuff.changeMaxBlockSize(m_frameSizeWav); return true;}
+    if(codec == CODEC_OGG) return true; // the decoder will be determined later (vorbis, flac, opus?)
+    if(!dec) {
+        AUDIO_INFO("%s is not supported in this build, see AUDIO_SUPPORT_xxx", codecname[codec]);
+        goto exit;
+    }
+    if((codec == CODEC_FLAC || codec == CODEC_VORBIS) && !psramFound()) {
+        AUDIO_INFO("%s works only with PSRAM!", codecname[codec]);
+        goto exit;
+    }
+    if(!dec->isInit()) {
+        if(!dec->init()) {
+            AUDIO_INFO("The %sDecoder could not be initialized", dec->name());
+            goto exit;
+        }
+        gfH = ESP.getFreeHeap();
+        hWM = uxTaskGetStackHighWaterMark(NULL);
+        AUDIO_INFO("%sDecoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", dec->name(), (long unsigned int)gfH, (long unsigned int)hWM);
+    }
+    if(codec == CODEC_MP3) {
+        dec->setQuality(m_mp3Quality);
+        m_mp3QualityUsed = m_mp3Quality;
+    }
+    if(codec == CODEC_FLAC) {
+        dec->setDualCore(m_f_flacDualCore ? 1 - m_audioTaskCoreId : -1, m_audioTaskPriority);
+        dec->setCrcCheck(m_f_flacCrcCheck, m_f_flacRepeat);
+    }
     switch(codec) {
-        case CODEC_MP3:
-            if(!MP3Decoder_IsInit()){
-                if(!MP3Decoder_AllocateBuffers()) {
-                    AUDIO_INFO("The MP3Decoder could not be initialized");
-                    goto exit;
-                }
-                gfH = ESP.getFreeHeap();
-                hWM = uxTaskGetStackHighWaterMark(NULL);
-                AUDIO_INFO("MP3Decoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-                InBuff.changeMaxBlockSize(m_frameSizeMP3);
-            }
-            break;
-        case CODEC_AAC:
-            if(!AACDecoder_IsInit()) {
-                if(!AACDecoder_AllocateBuffers()) {
-                    AUDIO_INFO("The AACDecoder could not be initialized");
-                    goto exit;
-                }
-                gfH = ESP.getFreeHeap();
-                hWM = uxTaskGetStackHighWaterMark(NULL);
-                AUDIO_INFO("AACDecoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-                InBuff.changeMaxBlockSize(m_frameSizeAAC);
-            }
-            break;
-        case CODEC_M4A:
-            if(!AACDecoder_IsInit()) {
-                if(!AACDecoder_AllocateBuffers()) {
-                    AUDIO_INFO("The AACDecoder could not be initialized");
-                    goto exit;
-                }
-                gfH = ESP.getFreeHeap();
-                hWM = uxTaskGetStackHighWaterMark(NULL);
-                AUDIO_INFO("AACDecoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-                InBuff.changeMaxBlockSize(m_frameSizeAAC);
-            }
-            break;
-        case CODEC_FLAC:
-            if(!psramFound()) {
-                AUDIO_INFO("FLAC works only with PSRAM!");
-                goto exit;
-            }
-            if(!FLACDecoder_AllocateBuffers()) {
-                AUDIO_INFO("The FLACDecoder could not be initialized");
-                goto exit;
-            }
-            gfH = ESP.getFreeHeap();
-            hWM = uxTaskGetStackHighWaterMark(NULL);
-            InBuff.changeMaxBlockSize(m_frameSizeFLAC);
-            AUDIO_INFO("FLACDecoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-            break;
-        case CODEC_OPUS:
-            if(!OPUSDecoder_AllocateBuffers()) {
-                AUDIO_INFO("The OPUSDecoder could not be initialized");
-                goto exit;
-            }
-            gfH = ESP.getFreeHeap();
-            hWM = uxTaskGetStackHighWaterMark(NULL);
-            AUDIO_INFO("OPUSDecoder has been initialized, free Heap: %lu bytes , free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-            InBuff.changeMaxBlockSize(m_frameSizeOPUS);
-            break;
-        case CODEC_VORBIS:
-            if(!psramFound()) {
-                AUDIO_INFO("VORBIS works only with PSRAM!");
-                goto exit;
-            }
-            if(!VORBISDecoder_AllocateBuffers()) {
-                AUDIO_INFO("The VORBISDecoder could not be initialized");
-                goto exit;
-            }
-            gfH = ESP.getFreeHeap();
-            hWM = uxTaskGetStackHighWaterMark(NULL);
-            AUDIO_INFO("VORBISDecoder has been initialized, free Heap: %lu bytes,  free stack %lu DWORDs", (long unsigned int)gfH, (long unsigned int)hWM);
-            InBuff.changeMaxBlockSize(m_frameSizeVORBIS);
-            break;
-        case CODEC_WAV: InBuff.changeMaxBlockSize(m_frameSizeWav); break;
-        case CODEC_OGG: // the decoder will be determined later (vorbis, flac, opus?)
-            break;
-        default: goto exit; break;
+        case CODEC_MP3:    InBuff.changeMaxBlockSize(m_frameSizeMP3);    break;
+        case CODEC_AAC:    InBuff.changeMaxBlockSize(m_frameSizeAAC);    break;
+        case CODEC_M4A:    InBuff.changeMaxBlockSize(m_frameSizeAAC);    break;
+        case CODEC_FLAC:   InBuff.changeMaxBlockSize(m_frameSizeFLAC);   break;
+        case CODEC_OPUS:   InBuff.changeMaxBlockSize(m_frameSizeOPUS);   break;
+        case CODEC_VORBIS: InBuff.changeMaxBlockSize(m_frameSizeVORBIS); break;
     }
     return true;
 
@@ -4282,6 +4562,28 @@ exit:
     return false;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+AudioCodec* Audio::decoderOf(uint8_t codec) { // NULL: no decoder (wav, ogg container), not compiled in or in use (opus, vorbis)
+    static AudioCodec* (*const newCodec[5])() = {AudioCodec_NewMP3, AudioCodec_NewAAC, AudioCodec_NewFLAC, AudioCodec_NewOPUS, AudioCodec_NewVORBIS};
+    int8_t i = -1;
+    switch(codec) {
+        case CODEC_MP3:    i = 0; break;
+        case CODEC_AAC:    i = 1; break;
+        case CODEC_M4A:    i = 1; break;
+        case CODEC_FLAC:   i = 2; break;
+        case CODEC_OPUS:   i = 3; break;
+        case CODEC_VORBIS: i = 4; break;
+    }
+    if(i < 0) return NULL;
+    if(!m_codecs[i]) m_codecs[i] = newCodec[i](); // the first stream of this codec, the buffers come with init()
+    return m_codecs[i];
+}
+
+void Audio::releaseDecoders() { // the buffers, the instances stay
+    for(AudioCodec* c : m_codecs) {
+        if(c) c->release();
+    }
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 // clang-format off
 bool Audio::parseContentType(char* ct) {
     enum : int { CT_NONE, CT_MP3, CT_AAC, CT_M4A, CT_WAV, CT_FLAC, CT_PLS, CT_M3U, CT_ASX, CT_M3U8, CT_TXT, CT_AACP, CT_OPUS, CT_OGG, CT_VORBIS };
@@ -4548,18 +4850,22 @@ void Audio::showCodecParams() {
     if(getBitRate()) { AUDIO_INFO("BitRate: %lu", getBitRate()); }
     else { AUDIO_INFO("BitRate: N/A"); }
 
-    if(m_codec == CODEC_AAC) {
-        uint8_t answ = AACGetFormat();
+#if AUDIO_SUPPORT_AAC
+    if(m_codec == CODEC_AAC && decoderOf(CODEC_AAC)) {
+        audioCodecInfo_t ci;
+        decoderOf(CODEC_AAC)->getInfo(&ci);
+        uint8_t answ = ci.aacFormat;
         if(answ < 3) {
             const char hf[4][8] = {"unknown", "ADIF", "ADTS"};
             AUDIO_INFO("AAC HeaderFormat: %s", hf[answ])
         }
-        answ = AACGetSBR();
+        answ = ci.aacSBR;
         if(answ > 0 && answ < 4) {
             const char sbr[4][50] = {"without SBR", "upsampled SBR", "downsampled SBR", "no SBR used, but file is upsampled by a factor 2"};
             AUDIO_INFO("Spectral band replication: %s", sbr[answ]);
         }
     }
+#endif
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 int Audio::findNextSync(uint8_t* data, size_t len) {
@@ -4572,34 +4878,30 @@ int Audio::findNextSync(uint8_t* data, size_t len) {
 
     int         nextSync = 0;
     static uint32_t swnf = 0;
+    m_decoder = decoderOf(m_codec); // used by sendBytes() until the next sync
     if(m_codec == CODEC_WAV) {
         m_f_playing = true;
         nextSync = 0;
     }
-    if(m_codec == CODEC_MP3) {
-        nextSync = MP3FindSyncWord(data, len);
-        if(nextSync == -1) return len; // syncword not found, search next block
-    }
-    if(m_codec == CODEC_AAC) { nextSync = AACFindSyncWord(data, len); }
-    if(m_codec == CODEC_M4A) {
+    else if(m_codec == CODEC_M4A) {
         if(!m_M4A_chConfig)m_M4A_chConfig = 2; // guard
         if(!m_M4A_sampleRate)m_M4A_sampleRate = 44100;
         if(!m_M4A_objectType)m_M4A_objectType = 2;
-        AACSetRawBlockParams(m_M4A_chConfig, m_M4A_sampleRate, m_M4A_objectType);
+#if AUDIO_SUPPORT_AAC
+        if(m_decoder) {
+            audioCodecRaw_t raw = {};
+            raw.sampleRate = m_M4A_sampleRate;
+            raw.channels = m_M4A_chConfig;
+            raw.objectType = m_M4A_objectType;
+            m_decoder->setRawParams(&raw);
+        }
+#endif
         m_f_playing = true;
         nextSync = 0;
     }
-    if(m_codec == CODEC_FLAC) {
-        nextSync = FLACFindSyncWord(data, len);
-        if(nextSync == -1) return len; // OggS not found, search next block
-    }
-    if(m_codec == CODEC_OPUS) {
-        nextSync = OPUSFindSyncWord(data, len);
-        if(nextSync == -1) return len; // OggS not found, search next block
-    }
-    if(m_codec == CODEC_VORBIS) {
-        nextSync = VORBISFindSyncWord(data, len);
-        if(nextSync == -1) return len; // OggS not found, search next block
+    else if(m_decoder) {
+        nextSync = m_decoder->findSync(data, len);
+        if(nextSync == -1 && m_codec != CODEC_AAC) return len; // syncword or OggS not found, search next block
     }
     if(nextSync == -1) {
         if(audio_info && swnf == 0) audio_info("syncword not found");
@@ -4623,58 +4925,33 @@ int Audio::findNextSync(uint8_t* data, size_t len) {
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::setDecoderItems() {
-    if(m_codec == CODEC_MP3) {
-        setChannels(MP3GetChannels());
-        setSampleRate(MP3GetSampRate());
-        setBitsPerSample(MP3GetBitsPerSample());
-        setBitrate(MP3GetBitrate());
-        AUDIO_INFO("MPEG-%s, Layer %s",(MP3GetVersion()==0) ? "2.5" : (MP3GetVersion()==2) ? "2" : "1", (MP3GetLayer()==1) ? "III" : (MP3GetLayer()==2) ? "II" : "I");
-    }
-    if(m_codec == CODEC_AAC || m_codec == CODEC_M4A) {
-        setChannels(AACGetChannels());
-        setSampleRate(AACGetSampRate());
-        setBitsPerSample(AACGetBitsPerSample());
-        setBitrate(AACGetBitrate());
-    }
-    if(m_codec == CODEC_FLAC) {
-        setChannels(FLACGetChannels());
-        setSampleRate(FLACGetSampRate());
-        setBitsPerSample(FLACGetBitsPerSample());
-        setBitrate(FLACGetBitRate());
-        if(FLACGetAudioDataStart() > 0){ // only flac-ogg, native flac sets audioDataStart in readFlacHeader()
-            m_audioDataStart = FLACGetAudioDataStart();
-            if(getFileSize()) m_audioDataSize = getFileSize() - m_audioDataStart;
-        }
-    }
-    if(m_codec == CODEC_OPUS) {
-        setChannels(OPUSGetChannels());
-        setSampleRate(OPUSGetSampRate());
-        setBitsPerSample(OPUSGetBitsPerSample());
-        setBitrate(OPUSGetBitRate());
-        if(OPUSGetAudioDataStart() > 0){
-            m_audioDataStart = OPUSGetAudioDataStart();
+    audioCodecInfo_t ci;
+    if(m_decoder) {
+        m_decoder->getInfo(&ci);
+        setChannels(ci.channels);
+        setSampleRate(ci.sampleRate);
+        setBitsPerSample(ci.bitsPerSample);
+        setBitrate(ci.bitRate);
+        if(ci.audioDataStart > 0){ // only ogg, native flac sets audioDataStart in readFlacHeader()
+            m_audioDataStart = ci.audioDataStart;
             if(getFileSize()) m_audioDataSize = getFileSize() - m_audioDataStart;
         }
     }
-    if(m_codec == CODEC_VORBIS) {
-        setChannels(VORBISGetChannels());
-        setSampleRate(VORBISGetSampRate());
-        setBitsPerSample(VORBISGetBitsPerSample());
-        setBitrate(VORBISGetBitRate());
-        if(VORBISGetAudioDataStart() > 0){
-            m_audioDataStart = VORBISGetAudioDataStart();
-            if(getFileSize()) m_audioDataSize = getFileSize() - m_audioDataStart;
-        }
+#if AUDIO_SUPPORT_MP3
+    if(m_codec == CODEC_MP3 && m_decoder) {
+        AUDIO_INFO("MPEG-%s, Layer %s", (ci.mpegVersion == 2) ? "2.5" : (ci.mpegVersion == 1) ? "2" : "1", (ci.layer == 3) ? "III" : (ci.layer == 2) ? "II" : "I");
     }
-    if(getBitsPerSample() != 8 && getBitsPerSample() != 16) {
-        AUDIO_INFO("Bits per sample must be 8 or 16, found %i", getBitsPerSample());
+#endif
+    bool hiRes = (m_codec == CODEC_FLAC && getBitsPerSample() > 16 && getBitsPerSample() <= 24); // flac_decoder scales to 16 or 24 bit
+    if(getBitsPerSample() != 8 && getBitsPerSample() != 16 && !hiRes) {
+        AUDIO_INFO("Bits per sample must be 8 or 16 (FLAC up to 24), found %i", getBitsPerSample());
         stopSong();
     }
     if(getChannels() != 1 && getChannels() != 2) {
         AUDIO_INFO("Num of channels must be 1 or 2, found %i", getChannels());
         stopSong();
     }
-    memset(m_filterBuff, 0, sizeof(m_filterBuff)); // Clear FilterBuffer
+    m_dsp.clearFilters();
     IIR_calculateCoefficients(m_gain0, m_gain1, m_gain2); // must be recalculated after each samplerate change
     showCodecParams();
 }
@@ -4699,18 +4976,27 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
     if(m_codec == CODEC_NONE && m_playlistFormat == FORMAT_M3U8) return 0; // can happen when the m3u8 playlist is loaded
     if(!m_f_decode_ready) return 0; // find sync first
 
-    switch(m_codec) {
-        case CODEC_WAV:  m_decodeError = 0; bytesLeft = 0; break;
-        case CODEC_MP3:  m_decodeError = MP3Decode(data, &bytesLeft, m_outBuff, 0); break;
-        case CODEC_AAC:  m_decodeError = AACDecode(data, &bytesLeft, m_outBuff); break;
-        case CODEC_M4A:  m_decodeError = AACDecode(data, &bytesLeft, m_outBuff); break;
-        case CODEC_FLAC: m_decodeError = FLACDecode(data, &bytesLeft, m_outBuff); break;
-        case CODEC_OPUS: m_decodeError = OPUSDecode(data, &bytesLeft, m_outBuff); break;
-        case CODEC_VORBIS: m_decodeError = VORBISDecode(data, &bytesLeft, m_outBuff); break;
-        default: {
-            log_e("no valid codec found codec = %d", m_codec);
-            stopSong();
+    int64_t tDecode = m_f_measureLatency ? esp_timer_get_time() : 0;
+    if(m_codec == CODEC_WAV) {m_decodeError = 0; bytesLeft = 0;}
+#if AUDIO_SAMPLE_32
+    else if(m_decoder) m_decodeError = m_decoder->decode32(data, &bytesLeft, m_outBuff);
+#else
+    else if(m_decoder) m_decodeError = m_decoder->decode(data, &bytesLeft, m_outBuff);
+#endif
+    else {
+        log_e("no valid codec found codec = %d", m_codec);
+        stopSong();
+        return 0;
+    }
+    if(m_f_measureLatency && m_decodeError >= 0 && m_codec != CODEC_NONE) {
+        uint32_t dt = esp_timer_get_time() - tDecode;
+        if(m_latencyT[LAT_DECODE]) { // steady state, the first frame is part of the latency breakdown
+            audio_decodestats_t* ds = &m_decodeStats[m_codec];
+            ds->frames++;
+            ds->sum_us += dt;
+            if(dt > ds->max_us) ds->max_us = dt;
         }
+        else if(len - bytesLeft > 0) latencyMark(LAT_DECODE);
     }
 
     // m_decodeError - possible values are:
@@ -4729,7 +5015,7 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
             }
             if(m_decodeError == ERR_MP3_INVALID_HUFFCODES) {
                 AUDIO_INFO("last mp3 frame is invalid");
-                MP3Decoder_ClearBuffer();
+                m_decoder->reset();
                 return findNextSync(data, bytesLeft); // skip last mp3 frame and search for next syncword
             }
         }
@@ -4760,84 +5046,53 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
         return 1;
     }
     // status: bytesDecoded > 0 and m_decodeError >= 0
-    char* st = NULL;
-    std::vector<uint32_t> vec;
-    switch(m_codec) {
-        case CODEC_WAV:     if(getBitsPerSample() == 16){
-                                memmove(m_outBuff, data, len); // copy len data in outbuff and set validsamples and bytesdecoded=len
-                                m_validSamples = len / (2 * getChannels());
-                            }
-                            else{
-                                for(int i = 0; i < len; i++) {
-                                    int16_t sample1 = (data[i] & 0x00FF)      - 128;
-                                    int16_t sample2 = (data[i] & 0xFF00 >> 8) - 128;
-                                    m_outBuff[i * 2 + 0] = sample1 << 8;
-                                    m_outBuff[i * 2 + 1] = sample2 << 8;
-                                }
-                                m_validSamples = len;
-                            }
-                            break;
-        case CODEC_MP3:     m_validSamples = MP3GetOutputSamps() / getChannels();
-                            break;
-        case CODEC_AAC:     m_validSamples = AACGetOutputSamps() / getChannels();
-                            static uint8_t isPS = 0;
-                            if(!isPS && AACGetParametricStereo()){ // only change 0 -> 1
-                                isPS = 1;
-                                AUDIO_INFO("Parametric Stereo");
-                            }
-                            else isPS = AACGetParametricStereo();
-                            break;
-        case CODEC_M4A:     m_validSamples = AACGetOutputSamps() / getChannels();
-                            break;
-        case CODEC_FLAC:    if(m_decodeError == FLAC_PARSE_OGG_DONE) return bytesDecoded; // nothing to play
-                            m_validSamples = FLACGetOutputSamps() / getChannels();
-                            st = FLACgetStreamTitle();
-                            if(st) {
-                                AUDIO_INFO(st);
-                                if(audio_showstreamtitle) audio_showstreamtitle(st);
-                            }
-                            vec = FLACgetMetadataBlockPicture();
-                            if(vec.size() > 0){ // get blockpic data
-                                // log_i("---------------------------------------------------------------------------");
-                                // log_i("ogg metadata blockpicture found:");
-                                // for(int i = 0; i < vec.size(); i += 2) { log_i("segment %02i, pos %07i, len %05i", i / 2, vec[i], vec[i + 1]); }
-                                // log_i("---------------------------------------------------------------------------");
-                                if(audio_oggimage) audio_oggimage(audiofile, vec);
-                            }
-                            break;
-        case CODEC_OPUS:    if(m_decodeError == OPUS_PARSE_OGG_DONE) return bytesDecoded; // nothing to play
-                            if(m_decodeError == OPUS_END)            return bytesDecoded; // nothing to play
-                            m_validSamples = OPUSGetOutputSamps();
-                            st = OPUSgetStreamTitle();
-                            if(st){
-                                AUDIO_INFO(st);
-                                if(audio_showstreamtitle) audio_showstreamtitle(st);
-                            }
-                            vec = OPUSgetMetadataBlockPicture();
-                            if(vec.size() > 0){ // get blockpic data
-                                // log_i("---------------------------------------------------------------------------");
-                                // log_i("ogg metadata blockpicture found:");
-                                // for(int i = 0; i < vec.size(); i += 2) { log_i("segment %02i, pos %07i, len %05i", i / 2, vec[i], vec[i + 1]); }
-                                // log_i("---------------------------------------------------------------------------");
-                                if(audio_oggimage) audio_oggimage(audiofile, vec);
-                            }
-                            break;
-        case CODEC_VORBIS:  if(m_decodeError == VORBIS_PARSE_OGG_DONE) return bytesDecoded; // nothing to play
-                            m_validSamples = VORBISGetOutputSamps();
-                            st = VORBISgetStreamTitle();
-                            if(st) {
-                                AUDIO_INFO(st);
-                                if(audio_showstreamtitle) audio_showstreamtitle(st);
-                            }
-                            vec = VORBISgetMetadataBlockPicture();
-                            if(vec.size() > 0){ // get blockpic data
-                                // log_i("---------------------------------------------------------------------------");
-                                // log_i("ogg metadata blockpicture found:");
-                                // for(int i = 0; i < vec.size(); i += 2) { log_i("segment %02i, pos %07i, len %05i", i / 2, vec[i], vec[i + 1]); }
-                                // log_i("---------------------------------------------------------------------------");
-                                if(audio_oggimage) audio_oggimage(audiofile, vec);
-                            }
-                            break;
+    if(m_codec == CODEC_WAV) {
+        if(getBitsPerSample() == 16){
+#if AUDIO_SAMPLE_32
+            for(int i = 0; i < len / 2; i++) m_outBuff[i] = (int16_t)(data[2 * i] | (data[2 * i + 1] << 8)) << AUDIO_SAMPLE_SHIFT;
+#else
+            memmove(m_outBuff, data, len); // copy len data in outbuff and set validsamples and bytesdecoded=len
+#endif
+            m_validSamples = len / (2 * getChannels());
+        }
+        else{
+            for(int i = 0; i < len; i++) {
+                int16_t sample1 = (data[i] & 0x00FF)      - 128;
+                int16_t sample2 = (data[i] & 0xFF00 >> 8) - 128;
+                m_outBuff[i * 2 + 0] = (audio_sample_t)(sample1 << 8) << AUDIO_SAMPLE_SHIFT;
+                m_outBuff[i * 2 + 1] = (audio_sample_t)(sample2 << 8) << AUDIO_SAMPLE_SHIFT;
+            }
+            m_validSamples = len;
+        }
+    }
+    else {
+        if(m_decoder->noOutput(m_decodeError)) return bytesDecoded; // ogg header pages, opus end: nothing to play
+        m_validSamples = m_decoder->outputFrames();
+#if AUDIO_SUPPORT_AAC
+        if(m_codec == CODEC_AAC) {
+            static uint8_t isPS = 0;
+            audioCodecInfo_t ci;
+            m_decoder->getInfo(&ci);
+            if(!isPS && ci.aacPS){ // only change 0 -> 1
+                isPS = 1;
+                AUDIO_INFO("Parametric Stereo");
+            }
+            else isPS = ci.aacPS;
+        }
+#endif
+        char* st = m_decoder->streamTitle();
+        if(st) {
+            AUDIO_INFO(st);
+            if(audio_showstreamtitle) audio_showstreamtitle(st);
+        }
+        std::vector<uint32_t> vec = m_decoder->metadataBlockPicture();
+        if(vec.size() > 0){ // get blockpic data
+            // log_i("---------------------------------------------------------------------------");
+            // log_i("ogg metadata blockpicture found:");
+            // for(int i = 0; i < vec.size(); i += 2) { log_i("segment %02i, pos %07i, len %05i", i / 2, vec[i], vec[i + 1]); }
+            // log_i("---------------------------------------------------------------------------");
+            if(audio_oggimage) audio_oggimage(audiofile, vec);
+        }
     }
     if(f_setDecodeParamsOnce && m_validSamples) {
         f_setDecodeParamsOnce = false;
@@ -4845,13 +5100,25 @@ int Audio::sendBytes(uint8_t* data, size_t len) {
         m_PlayingStartTime = millis();
     }
 
+    if(m_streamSample >= 0) m_streamSample += m_validSamples;
+    if(m_seekIndex.isBuilding() && m_validSamples) { // first play, the frame starts at the current read position
+        uint32_t framePos = m_audioDataStart + m_sumBytesDecoded;
+        int32_t mdBegin = -1, mdSize = 0;
+        if(m_decoder && m_decoder->frameStart()) {
+            m_decoder->bitReservoir(&mdBegin, &mdSize);
+            m_seekIndex.addFrame(framePos, m_validSamples, getSampleRate(), mdBegin, mdSize);
+        }
+        else m_seekIndex.addSamples(m_validSamples);
+    }
+
     uint16_t bytesDecoderOut = m_validSamples;
     if(m_channels == 2) bytesDecoderOut /= 2;
     if(m_bitsPerSample == 16) bytesDecoderOut *= 2;
     computeAudioTime(bytesDecoded, bytesDecoderOut);
 
     m_curSample = 0;
-    playChunk();
+    trimDecodedFrames();
+    if(m_validSamples) playChunk();
     return bytesDecoded;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -4877,9 +5144,11 @@ void Audio::computeAudioTime(uint16_t bytesDecoderIn, uint16_t bytesDecoderOut)
         deltaBytesIn = 0;
         nominalBitRate = 0;
 
-        if(m_codec == CODEC_FLAC && FLACGetAudioFileDuration()){
-            m_audioFileDuration = FLACGetAudioFileDuration();
-            nominalBitRate = (m_audioDataSize / FLACGetAudioFileDuration()) * 8;
+        audioCodecInfo_t ci;
+        if(m_decoder) m_decoder->getInfo(&ci);
+        if(m_decoder && ci.duration){ // flac: total samples of the STREAMINFO
+            m_audioFileDuration = ci.duration;
+            nominalBitRate = (m_audioDataSize / ci.duration) * 8;
             m_avr_bitrate = nominalBitRate;
         }
         if(m_codec == CODEC_WAV){
@@ -4969,10 +5238,12 @@ void Audio::printDecodeError(int r) {
         }
         AUDIO_INFO("MP3 decode error %d : %s", r, e);
     }
+#if AUDIO_SUPPORT_AAC
     if(m_codec == CODEC_AAC || m_codec == CODEC_M4A) {
         e = AACGetErrorMessage(abs(r));
         AUDIO_INFO("AAC decode error %d : %s", r, e);
     }
+#endif
     if(m_codec == CODEC_FLAC) {
         switch(r) {
             case ERR_FLAC_NONE: e = "NONE"; break;
@@ -4985,11 +5256,14 @@ void Audio::printDecodeError(int r) {
             case ERR_FLAC_PREORDER_TOO_BIG: e = "PREORDER TOO BIG"; break;
             case ERR_FLAC_RESERVED_RESIDUAL_CODING: e = "RESERVED RESIDUAL CODING"; break;
             case ERR_FLAC_WRONG_RICE_PARTITION_NR: e = "WRONG RICE PARTITION NR"; break;
-            case ERR_FLAC_BITS_PER_SAMPLE_TOO_BIG: e = "BITS PER SAMPLE > 16"; break;
+            case ERR_FLAC_BITS_PER_SAMPLE_TOO_BIG: e = "BITS PER SAMPLE > 24"; break;
             case ERR_FLAC_BITS_PER_SAMPLE_UNKNOWN: e = "BITS PER SAMPLE UNKNOWN"; break;
             case ERR_FLAC_DECODER_ASYNC: e = "DECODER ASYNCHRON"; break;
             case ERR_FLAC_BITREADER_UNDERFLOW: e = "BITREADER ERROR"; break;
             case ERR_FLAC_OUTBUFFER_TOO_SMALL: e = "OUTBUFFER TOO SMALL"; break;
+            case ERR_FLAC_NEGATIVE_LPC_SHIFT: e = "NEGATIVE LPC SHIFT"; break;
+            case ERR_FLAC_HEADER_CRC: e = "FRAME HEADER CRC-8"; break;
+            case ERR_FLAC_FRAME_CRC: e = "FRAME CRC-16"; break;
             default: e = "ERR_UNKNOWN";
         }
         AUDIO_INFO("FLAC decode error %d : %s", r, e);
@@ -5048,8 +5322,8 @@ bool Audio::setPinout(uint8_t BCLK, uint8_t LRC, uint8_t DOUT, int8_t MCLK) {
         x_ps_free(&m_outBuff);
         x_ps_free(&m_samplesBuff48K);
         x_ps_free(&m_lastHost);
-        m_outBuff  = (      int16_t*)x_ps_malloc(m_outbuffSize * sizeof(int16_t));
-        m_samplesBuff48K = (int16_t*)x_ps_malloc(m_samplesBuff48KSize * sizeof(int16_t));
+        m_outBuff  = (audio_sample_t*)x_ps_malloc(m_outbuffSize * sizeof(audio_sample_t));
+        m_samplesBuff48K = (audio_sample_t*)x_ps_malloc(m_samplesBuff48KSize * sizeof(audio_sample_t));
         m_chbuf    =       (char*)   x_ps_malloc(m_chbufSize);
         m_ibuff    =       (char*)   x_ps_malloc(m_ibuffSize);
         if(!m_chbuf || !m_outBuff || !m_samplesBuff48K || !m_ibuff) log_e("oom");
@@ -5120,6 +5394,11 @@ uint32_t Audio::getAudioCurrentTime() { // return current time in seconds
 bool Audio::setAudioPlayPosition(uint16_t sec) {
     if(!m_f_psramFound) {               log_w("PSRAM must be activated"); return false;} // guard
     if(m_dataMode != AUDIO_LOCALFILE /* && m_streamType == ST_WEBFILE */) return false;  // guard
+    if(seekIndexFits()) return seekIndexPosition((uint64_t)sec * m_seekIndex.sampleRate());
+    if(m_codec == CODEC_M4A && m_m4aIndex.isValid()) { // first byte of the aac frame at 'sec', from the sample tables
+        uint32_t frame = m_m4aIndex.frameAtTime((uint64_t)sec * m_m4aIndex.timescale());
+        return setFilePos(m_m4aIndex.frameOffset(frame));
+    }
     if(!m_avr_bitrate)                                                    return false;  // guard
     //if(m_codec == CODEC_OPUS) return false;   // not impl. yet
     //if(m_codec == CODEC_VORBIS) return false; // not impl. yet
@@ -5149,6 +5428,10 @@ bool Audio::setTimeOffset(int sec) { // fast forward or rewind the current posit
     if(!m_f_psramFound) {               log_w("PSRAM must be activated"); return false;} // guard
     if(m_dataMode != AUDIO_LOCALFILE /* && m_streamType == ST_WEBFILE */) return false;  // guard
     if(m_dataMode == AUDIO_LOCALFILE && !audiofile)                       return false;  // guard
+    if(seekIndexFits() && m_streamSample >= 0) {
+        int64_t target = (int64_t)m_streamSample - m_gaplessSkip + (int64_t)sec * m_seekIndex.sampleRate();
+        return seekIndexPosition(target > 0 ? target : 0);
+    }
     if(!m_avr_bitrate)                                                    return false;  // guard
     if(m_codec == CODEC_AAC) return false; // not impl. yet
     uint32_t oneSec = m_avr_bitrate / 8;                 // bytes decoded in one sec
@@ -5173,6 +5456,10 @@ bool Audio::setFilePos(uint32_t pos) {
 
 
     m_validSamples = 0;
+    m_f_seekExact = false; // set again by seekIndexPosition()
+    m_seekTrimSkip = 0;
+    m_seekTrimRemain = -1;
+    if(m_seekIndex.isBuilding()) m_seekIndex.abortBuild(); // the index needs all frames from the beginning
     if(m_dataMode == AUDIO_LOCALFILE /* || m_streamType == ST_WEBFILE */) {
         m_resumeFilePos = pos;  // used in processLocalFile()
         return true;
@@ -5180,6 +5467,112 @@ bool Audio::setFilePos(uint32_t pos) {
     return false;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::seekIndexPosition(uint32_t sample) {
+    // sample: position without the encoder delay. Jump to the entry before it, the preroll and the rest up to the target
+    // are decoded and dropped by trimDecodedFrames() if the index is sample exact (mp3, flac, opus)
+    seekEntry_t e;
+    uint32_t total = m_seekIndex.totalSamples();
+    if(total > m_gaplessSkip && sample + m_gaplessSkip >= total) sample = total - m_gaplessSkip - 1;
+    if(!m_seekIndex.lookup(sample + m_gaplessSkip, &e)) return false;
+    if(!setFilePos(e.offset)) return false;
+    m_f_seekExact = true;
+    m_seekStartSample = e.sample - e.preroll;
+    if(m_seekIndex.flags() & SEEK_INDEX_F_SAMPLE_EXACT) {
+        m_seekTrimSkip = sample + m_gaplessSkip - m_seekStartSample;
+        if(m_gaplessTotal >= 0) m_seekTrimRemain = max((int32_t)0, m_gaplessTotal - (int32_t)sample);
+    }
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::seekIndexFits() {
+    // the samples of the index must be counted as the decoder counts them now: same codec, MP3 quality (HALFRATE outputs
+    // half the samples) and, for the sample exact indexes, output rate. Otherwise the positions land elsewhere. The m4a
+    // index counts in the timescale of the file, which is not the output rate with SBR.
+    if(!m_seekIndex.isValid() || m_seekIndex.codec() != m_codec) return false;
+    if(m_seekIndex.quality() != ((m_codec == CODEC_MP3) ? m_mp3QualityUsed : 0)) return false;
+    return !(m_seekIndex.flags() & SEEK_INDEX_F_SAMPLE_EXACT) || m_seekIndex.sampleRate() == getSampleRate();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setSeekIndex(bool enable, uint16_t intervalMs) {
+    m_f_seekIndex = enable;
+    if(intervalMs) m_seekIndexInterval = intervalMs;
+    if(!enable) m_seekIndex.clear();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setDirectPCM(bool enable) { // takes effect with the next file, raw pcm files are always played directly
+    m_f_directPCMEnabled = enable;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setMP3Quality(uint8_t q) { // takes effect with the next file, MPEG2 and 2.5 streams are always decoded in full
+    // LOWPASS: the subbands above fs / 4 are not transformed, HALFRATE: in addition the synthesis filter outputs fs / 2,
+    // the resampler brings it to 48kHz. renderToFile() always decodes in full.
+    m_mp3Quality = (q <= MP3_QUALITY_HALFRATE) ? q : (uint8_t)MP3_QUALITY_FULL;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setFLACDualCore(bool enable) { // takes effect with the next file, native FLAC only (ogg FLAC has one frame per packet)
+    // While the audio task decodes a frame, a worker task on the other core decodes the next one, it needs a second set
+    // of sample buffers (PSRAM). The output is the same as with one core.
+    m_f_flacDualCore = enable;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setFLACCrcCheck(bool enable, bool repeat) { // takes effect with the next file
+    // The CRC-8 of each frame header and the CRC-16 of each frame are checked (4 KB of tables, 3...9% more decode time).
+    // A native FLAC frame that fails is replaced by silence of its block size, or by the last good frame with 'repeat'
+    // (two frame buffers in PSRAM and a copy of every frame), and decoding goes on at the next valid frame. The count is
+    // logged at the end of the file. renderToFile() also compares the decoded samples with the MD5 of the file, see
+    // audio_render_t.
+    m_f_flacCrcCheck = enable;
+    m_f_flacRepeat = repeat;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::loadSeekIndex(fs::FS& fs, const char* path) {
+    char* sidx = (char*)x_ps_calloc(strlen(path) + 6, sizeof(char));
+    if(!sidx) return;
+    strcpy(sidx, path);
+    strcat(sidx, ".sidx");
+    if(fs.exists(sidx)) {
+        File f = fs.open(sidx);
+        uint8_t hdr[SEEK_INDEX_HEADER_SIZE];
+        seekIndexHeader_t h;
+        if(f.read(hdr, SEEK_INDEX_HEADER_SIZE) == SEEK_INDEX_HEADER_SIZE && SeekIndex::parseHeader(hdr, SEEK_INDEX_HEADER_SIZE, &h)) {
+            if(h.fileSize != m_fileSize) {AUDIO_INFO("seek index \"%s\" is outdated", sidx);} // rebuilt on this play
+            else if(h.quality != ((h.codec == CODEC_MP3) ? m_mp3Quality : 0)) { // the decoder is set up after this
+                AUDIO_INFO("seek index \"%s\" was built for another MP3 quality", sidx);
+            }
+            else {
+                size_t len = h.count * SEEK_INDEX_ENTRY_SIZE;
+                uint8_t* entries = (uint8_t*)x_ps_malloc(len);
+                if(entries && f.read(entries, len) == len && m_seekIndex.load(&h, entries, len)) {
+                    if(m_f_Log) log_i("seek index: %lu entries, %lu ms", (long unsigned int)h.count, (long unsigned int)h.intervalMs);
+                }
+                x_ps_free(&entries);
+            }
+        }
+        f.close();
+    }
+    x_ps_free(&sidx);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::saveSeekIndex() {
+    // end of the first complete play, short files (sounds) are not worth a sidecar
+    if(!m_seekIndex.finishBuild() || !m_fileFS || !audiofile) return;
+    if(m_seekIndex.totalSamples() < 10 * m_seekIndex.sampleRate()) return;
+    const char* path = audiofile.path();
+    char* sidx = (char*)x_ps_calloc(strlen(path) + 6, sizeof(char));
+    size_t len = m_seekIndex.serializedSize();
+    uint8_t* buf = (uint8_t*)x_ps_malloc(len);
+    if(sidx && buf && m_seekIndex.serialize(buf, len) == len) {
+        strcpy(sidx, path);
+        strcat(sidx, ".sidx");
+        File f = m_fileFS->open(sidx, FILE_WRITE);
+        if(!f || f.write(buf, len) != len) {log_w("seek index \"%s\" could not be written", sidx);}
+        else {AUDIO_INFO("seek index written: \"%s\"", sidx);}
+        if(f) f.close();
+    }
+    x_ps_free(&buf);
+    x_ps_free(&sidx);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 bool Audio::setSampleRate(uint32_t sampRate) {
     if(!sampRate) sampRate = 48000;
     if(sampRate < 8000 ) {
@@ -5187,7 +5580,7 @@ bool Audio::setSampleRate(uint32_t sampRate) {
         m_sampleRate = 8000;
     }
     m_sampleRate = sampRate;
-    m_resampleRatio = 48000.0f / (float)m_sampleRate;
+    m_dsp.setResampleRatio(48000.0f / (float)m_sampleRate);
     return true;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -5228,85 +5621,75 @@ void Audio::setI2SCommFMT_LSB(bool commFMT) {
 
     m_f_commFMT = commFMT;
 
+    xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
     i2s_channel_disable(m_i2s_tx_handle);
     if(commFMT) {
         AUDIO_INFO("commFMT = LSBJ (Least Significant Bit Justified)");
-        m_i2s_std_cfg.slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+        m_i2s_std_cfg.slot_cfg = I2S_STD_MSB_SLOT_DEFAULT_CONFIG(I2S_SAMPLE_BITS, I2S_SLOT_MODE_STEREO);
     }
     else {
         AUDIO_INFO("commFMT = Philips");
-        m_i2s_std_cfg.slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO);
+        m_i2s_std_cfg.slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_SAMPLE_BITS, I2S_SLOT_MODE_STEREO);
     }
     i2s_channel_reconfig_std_slot(m_i2s_tx_handle, &m_i2s_std_cfg.slot_cfg);
-    i2s_channel_enable(m_i2s_tx_handle);
+    I2Sstart(); // the DMA starts empty, all credits
+    xSemaphoreGive(mutex_audioTask);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::computeVUlevel(int16_t sample[2]) {
-    static uint8_t sampleArray[2][4][8] = {0};
-    static uint8_t cnt0 = 0, cnt1 = 0, cnt2 = 0, cnt3 = 0, cnt4 = 0;
-    static bool    f_vu = false;
-
-    auto avg = [&](uint8_t* sampArr) { // lambda, inner function, compute the average of 8 samples
-        uint16_t av = 0;
-        for(int i = 0; i < 8; i++) { av += sampArr[i]; }
-        return av >> 3;
-    };
-
-    auto largest = [&](uint8_t* sampArr) { // lambda, inner function, compute the largest of 8 samples
-        uint16_t maxValue = 0;
-        for(int i = 0; i < 8; i++) {
-            if(maxValue < sampArr[i]) maxValue = sampArr[i];
-        }
-        return maxValue;
+void Audio::setLatencyMeasurement(bool enable) {
+    // the stages of the first frame are timestamped after each connecttoFS(), the breakdown is reported via audio_latency()
+    // the decode time of all other frames is accumulated per codec, see getDecodeStats()
+    m_f_measureLatency = enable;
+    memset(m_latencyT, 0, sizeof(m_latencyT));
+    memset(m_decodeStats, 0, sizeof(m_decodeStats));
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::getArenaStats(arenaStats_t* st) { m_arena.getStats(st); }
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::getDecodeStats(uint8_t codec, audio_decodestats_t* st) {
+    if(codec >= sizeof(m_decodeStats) / sizeof(m_decodeStats[0]) || !st) return false;
+    *st = m_decodeStats[codec];
+    return st->frames > 0;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::latencyMark(uint8_t stage) {
+    if(!m_latencyT[LAT_PLAY]) return; // not started by connecttoFS()
+    if(m_latencyT[stage]) return;     // first frame only
+    m_latencyT[stage] = esp_timer_get_time();
+    if(stage == LAT_I2S) latencyReport();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::latencyReport() {
+    auto since = [&](uint8_t stage) { // µs since connecttoFS(), 0 if the stage was skipped
+        return m_latencyT[stage] ? (uint32_t)(m_latencyT[stage] - m_latencyT[LAT_PLAY]) : 0;
     };
-
-    if(cnt0 == 64) {
-        cnt0 = 0;
-        cnt1++;
-    }
-    if(cnt1 == 8) {
-        cnt1 = 0;
-        cnt2++;
-    }
-    if(cnt2 == 8) {
-        cnt2 = 0;
-        cnt3++;
-    }
-    if(cnt3 == 8) {
-        cnt3 = 0;
-        cnt4++;
-        f_vu = true;
-    }
-    if(cnt4 == 8) { cnt4 = 0; }
-
-    if(!cnt0) { // store every 64th sample in the array[0]
-        sampleArray[LEFTCHANNEL][0][cnt1] = abs(sample[LEFTCHANNEL] >> 7);
-        sampleArray[RIGHTCHANNEL][0][cnt1] = abs(sample[RIGHTCHANNEL] >> 7);
-    }
-    if(!cnt1) { // store argest from 64 * 8 samples in the array[1]
-        sampleArray[LEFTCHANNEL][1][cnt2] = largest(sampleArray[LEFTCHANNEL][0]);
-        sampleArray[RIGHTCHANNEL][1][cnt2] = largest(sampleArray[RIGHTCHANNEL][0]);
-    }
-    if(!cnt2) { // store avg from 64 * 8 * 8 samples in the array[2]
-        sampleArray[LEFTCHANNEL][2][cnt3] = largest(sampleArray[LEFTCHANNEL][1]);
-        sampleArray[RIGHTCHANNEL][2][cnt3] = largest(sampleArray[RIGHTCHANNEL][1]);
-    }
-    if(!cnt3) { // store avg from 64 * 8 * 8 * 8 samples in the array[3]
-        sampleArray[LEFTCHANNEL][3][cnt4] = avg(sampleArray[LEFTCHANNEL][2]);
-        sampleArray[RIGHTCHANNEL][3][cnt4] = avg(sampleArray[RIGHTCHANNEL][2]);
-    }
-    if(f_vu) {
-        f_vu = false;
-        m_vuLeft = avg(sampleArray[LEFTCHANNEL][3]);
-        m_vuRight = avg(sampleArray[RIGHTCHANNEL][3]);
-    }
-    cnt1++;
+    audio_latency_t lat;
+    lat.codec       = codecname[m_codec];
+    lat.open_us     = since(LAT_OPEN);
+    lat.fill_us     = since(LAT_FILL);
+    lat.header_us   = since(LAT_HEADER);
+    lat.decode_us   = since(LAT_DECODE);
+    lat.resample_us = since(LAT_RESAMPLE);
+    lat.i2s_us      = since(LAT_I2S);
+    AUDIO_INFO("%s latency [us]: open %lu, fill %lu, header %lu, decode %lu, resample %lu, i2s %lu", lat.codec, (long unsigned int)lat.open_us,
+               (long unsigned int)lat.fill_us, (long unsigned int)lat.header_us, (long unsigned int)lat.decode_us,
+               (long unsigned int)lat.resample_us, (long unsigned int)lat.i2s_us);
+    if(audio_latency) audio_latency(&lat);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint16_t Audio::getVUlevel() {
-    // avg 0 ... 127
-    if(!m_f_running) return 0;
-    return (m_vuLeft << 8) + m_vuRight;
+    // peak of the last 21ms, 0 ... 127
+    audioMeter_t m;
+    if(!getMeter(&m)) return 0;
+    return ((m.peak[LEFTCHANNEL] >> 8) << 8) + (m.peak[RIGHTCHANNEL] >> 8);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+bool Audio::getMeter(audioMeter_t* m) {
+    // peak, rms and 8 bands of the 48kHz output before the volume, a new snapshot every 1024 frames (m->blocks counts them)
+    // lock free, can be called from any task
+    if(m_f_running && m_meter.read(m)) return true;
+    memset(m, 0, sizeof(audioMeter_t));
+    return false;
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass) {
@@ -5328,11 +5711,7 @@ void Audio::setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass
           Because when the EQ is adjusted, the IIR filter will be cleared and played,
           mixed in the audio data frame, and a click-like sound will be produced.
 
-          int16_t tmp[2]; tmp[0] = 0; tmp[1]= 0;
-
-          IIR_filterChain0(tmp, true ); // flush the filter
-          IIR_filterChain1(tmp, true ); // flush the filter
-          IIR_filterChain2(tmp, true ); // flush the filter
+          m_dsp.clearFilters(); // flush the filters
         */
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -5363,7 +5742,7 @@ uint8_t Audio::getVolume() { return m_vol; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint8_t Audio::getI2sPort() { return m_i2s_num; }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::computeLimit() {    // is calculated when the volume or balance changes
+void Audio::computeLimit(bool instant) {    // is calculated when the volume, balance or mute changes
     double l = 1, r = 1, v = 1; // assume 100%
 
     /* balance is left -16...+16 right */
@@ -5386,12 +5765,49 @@ void Audio::computeLimit() {    // is calculated when the volume or balance chan
     m_limit_right = r * v;
 
     // log_i("m_limit_left %f,  m_limit_right %f ",m_limit_left, m_limit_right);
+    if(m_f_fadeStop) return; // the output fades out, the new values are taken over by stopSong()
+    uint32_t rampFrames = (m_f_running && !instant) ? (uint32_t)m_volRampMs * 48 : 0; // the output is always 48kHz
+    if(m_f_mute) m_gainRamp.set(0, 0, rampFrames);
+    else         m_gainRamp.set(m_limit_left, m_limit_right, rampFrames);
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setVolumeRamp(uint16_t ms) {
+    m_volRampMs = ms;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setMute(bool mute) {
+    m_f_mute = mute;
+    computeLimit();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::fadeOutAndStop(uint16_t ms) {
+    // The ramp runs in playChunk(), loop() calls stopSong() when the faded blocks have been sent to I2S
+    x_ps_free(&m_fadeNextPath); // a stop replaces a pending fadeToFS()
+    if(!m_f_running || !ms) {stopSong(); return;}
+    m_fadeStopBlock = 0;
+    m_f_fadeStop = true;
+    m_gainRamp.set(0, 0, (uint32_t)ms * 48);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::Gain(int16_t* sample) {
-    /* important: these multiplications must all be signed ints, or the result will be invalid */
-    sample[LEFTCHANNEL]  *= m_limit_left ;
-    sample[RIGHTCHANNEL] *= m_limit_right;
+bool Audio::fadeToFS(fs::FS& fs, const char* path, uint16_t ms) {
+    // The current stream fades out while the caller returns, loop() opens 'path' when the faded blocks have been sent.
+    // Called again during the fade, only the path is replaced. connecttoFS() and fadeOutAndStop() cancel it.
+    if(!path) {printProcessLog(AUDIOLOG_PATH_IS_NULL); return false;}  // guard
+    if(!m_f_running || !ms) return connecttoFS(fs, path);
+    char* next = x_ps_strdup(path);
+    if(!next) {printProcessLog(AUDIOLOG_OUT_OF_MEMORY); return false;}
+    if(!m_f_fadeStop) fadeOutAndStop(ms);
+    x_ps_free(&m_fadeNextPath);
+    m_fadeNextPath = next;
+    m_fadeNextFS = &fs;
+    return true;
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::fadeNext() { // loop(), the stream of fadeToFS() has faded out and stopped
+    char* path = m_fadeNextPath;
+    connecttoFS(*m_fadeNextFS, path); // audio_info() reports a failure
+    if(m_fadeNextPath == path) m_fadeNextPath = nullptr;
+    x_ps_free(&path);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::inBufferFilled() {
@@ -5424,6 +5840,7 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     // https://www.earlevel.com/main/2012/11/26/biquad-c-source-code/
 
     if(getSampleRate() < 1000) return; // fuse
+    audioBiquad_t f[3];
 
     // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
@@ -5453,19 +5870,19 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
 
     if(G0 >= 0) { // boost
         norm = 1 / (1 + sqrtf(2) * K + K * K);
-        m_filter[LOWSHELF].a0 = (1 + sqrtf(2 * V) * K + V * K * K) * norm;
-        m_filter[LOWSHELF].a1 = 2 * (V * K * K - 1) * norm;
-        m_filter[LOWSHELF].a2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
-        m_filter[LOWSHELF].b1 = 2 * (K * K - 1) * norm;
-        m_filter[LOWSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
+        f[LOWSHELF].a0 = (1 + sqrtf(2 * V) * K + V * K * K) * norm;
+        f[LOWSHELF].a1 = 2 * (V * K * K - 1) * norm;
+        f[LOWSHELF].a2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
+        f[LOWSHELF].b1 = 2 * (K * K - 1) * norm;
+        f[LOWSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
     }
     else { // cut
         norm = 1 / (1 + sqrtf(2 * V) * K + V * K * K);
-        m_filter[LOWSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
-        m_filter[LOWSHELF].a1 = 2 * (K * K - 1) * norm;
-        m_filter[LOWSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
-        m_filter[LOWSHELF].b1 = 2 * (V * K * K - 1) * norm;
-        m_filter[LOWSHELF].b2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
+        f[LOWSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
+        f[LOWSHELF].a1 = 2 * (K * K - 1) * norm;
+        f[LOWSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
+        f[LOWSHELF].b1 = 2 * (V * K * K - 1) * norm;
+        f[LOWSHELF].b2 = (1 - sqrtf(2 * V) * K + V * K * K) * norm;
     }
 
     // PEAK EQ
@@ -5475,19 +5892,19 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     Q = 2.5;      // Quality factor
     if(G1 >= 0) { // boost
         norm = 1 / (1 + 1 / Q * K + K * K);
-        m_filter[PEAKEQ].a0 = (1 + V / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
-        m_filter[PEAKEQ].a2 = (1 - V / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].b1 = m_filter[PEAKEQ].a1;
-        m_filter[PEAKEQ].b2 = (1 - 1 / Q * K + K * K) * norm;
+        f[PEAKEQ].a0 = (1 + V / Q * K + K * K) * norm;
+        f[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
+        f[PEAKEQ].a2 = (1 - V / Q * K + K * K) * norm;
+        f[PEAKEQ].b1 = f[PEAKEQ].a1;
+        f[PEAKEQ].b2 = (1 - 1 / Q * K + K * K) * norm;
     }
     else { // cut
         norm = 1 / (1 + V / Q * K + K * K);
-        m_filter[PEAKEQ].a0 = (1 + 1 / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
-        m_filter[PEAKEQ].a2 = (1 - 1 / Q * K + K * K) * norm;
-        m_filter[PEAKEQ].b1 = m_filter[PEAKEQ].a1;
-        m_filter[PEAKEQ].b2 = (1 - V / Q * K + K * K) * norm;
+        f[PEAKEQ].a0 = (1 + 1 / Q * K + K * K) * norm;
+        f[PEAKEQ].a1 = 2 * (K * K - 1) * norm;
+        f[PEAKEQ].a2 = (1 - 1 / Q * K + K * K) * norm;
+        f[PEAKEQ].b1 = f[PEAKEQ].a1;
+        f[PEAKEQ].b2 = (1 - V / Q * K + K * K) * norm;
     }
 
     // HIGHSHELF
@@ -5496,171 +5913,36 @@ void Audio::IIR_calculateCoefficients(int8_t G0, int8_t G1, int8_t G2) { // Infi
     V = powf(10, fabs(G2) / 20.0);
     if(G2 >= 0) { // boost
         norm = 1 / (1 + sqrtf(2) * K + K * K);
-        m_filter[HIFGSHELF].a0 = (V + sqrtf(2 * V) * K + K * K) * norm;
-        m_filter[HIFGSHELF].a1 = 2 * (K * K - V) * norm;
-        m_filter[HIFGSHELF].a2 = (V - sqrtf(2 * V) * K + K * K) * norm;
-        m_filter[HIFGSHELF].b1 = 2 * (K * K - 1) * norm;
-        m_filter[HIFGSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
+        f[HIFGSHELF].a0 = (V + sqrtf(2 * V) * K + K * K) * norm;
+        f[HIFGSHELF].a1 = 2 * (K * K - V) * norm;
+        f[HIFGSHELF].a2 = (V - sqrtf(2 * V) * K + K * K) * norm;
+        f[HIFGSHELF].b1 = 2 * (K * K - 1) * norm;
+        f[HIFGSHELF].b2 = (1 - sqrtf(2) * K + K * K) * norm;
     }
     else {
         norm = 1 / (V + sqrtf(2 * V) * K + K * K);
-        m_filter[HIFGSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
-        m_filter[HIFGSHELF].a1 = 2 * (K * K - 1) * norm;
-        m_filter[HIFGSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
-        m_filter[HIFGSHELF].b1 = 2 * (K * K - V) * norm;
-        m_filter[HIFGSHELF].b2 = (V - sqrtf(2 * V) * K + K * K) * norm;
-    }
-
-    //    log_i("LS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[0].a0, m_filter[0].a1, m_filter[0].a2,
-    //                                                  m_filter[0].b1, m_filter[0].b2);
-    //    log_i("EQ a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[1].a0, m_filter[1].a1, m_filter[1].a2,
-    //                                                  m_filter[1].b1, m_filter[1].b2);
-    //    log_i("HS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", m_filter[2].a0, m_filter[2].a1, m_filter[2].a2,
-    //                                                  m_filter[2].b1, m_filter[2].b2);
+        f[HIFGSHELF].a0 = (1 + sqrtf(2) * K + K * K) * norm;
+        f[HIFGSHELF].a1 = 2 * (K * K - 1) * norm;
+        f[HIFGSHELF].a2 = (1 - sqrtf(2) * K + K * K) * norm;
+        f[HIFGSHELF].b1 = 2 * (K * K - V) * norm;
+        f[HIFGSHELF].b2 = (V - sqrtf(2 * V) * K + K * K) * norm;
+    }
+
+    if(m_corr > 1) { // level correction of setTone(), scaling the feed forward part equals scaling the input sample
+        f[LOWSHELF].a0 /= m_corr;
+        f[LOWSHELF].a1 /= m_corr;
+        f[LOWSHELF].a2 /= m_corr;
+    }
+    m_dsp.setFilters(f);
+
+    //    log_i("LS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", f[0].a0, f[0].a1, f[0].a2,
+    //                                                  f[0].b1, f[0].b2);
+    //    log_i("EQ a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", f[1].a0, f[1].a1, f[1].a2,
+    //                                                  f[1].b1, f[1].b2);
+    //    log_i("HS a0=%f, a1=%f, a2=%f, b1=%f, b2=%f", f[2].a0, f[2].a1, f[2].a2,
+    //                                                  f[2].b1, f[2].b2);
 }
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-// clang-format off
-void Audio::IIR_filterChain0(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[0].a0 * inSample[LEFTCHANNEL] + m_filter[0].a1 * m_filterBuff[0][z1][in][LEFTCHANNEL] +
-        m_filter[0].a2 * m_filterBuff[0][z2][in][LEFTCHANNEL] - m_filter[0].b1 * m_filterBuff[0][z1][out][LEFTCHANNEL] -
-        m_filter[0].b2 * m_filterBuff[0][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[0][z2][in][LEFTCHANNEL] = m_filterBuff[0][z1][in][LEFTCHANNEL];
-    m_filterBuff[0][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[0][z2][out][LEFTCHANNEL] = m_filterBuff[0][z1][out][LEFTCHANNEL];
-    m_filterBuff[0][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[0].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[0].a1 * m_filterBuff[0][z1][in][RIGHTCHANNEL] +
-                              m_filter[0].a2 * m_filterBuff[0][z2][in][RIGHTCHANNEL] -
-                              m_filter[0].b1 * m_filterBuff[0][z1][out][RIGHTCHANNEL] -
-                              m_filter[0].b2 * m_filterBuff[0][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[0][z2][in][RIGHTCHANNEL] = m_filterBuff[0][z1][in][RIGHTCHANNEL];
-    m_filterBuff[0][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[0][z2][out][RIGHTCHANNEL] = m_filterBuff[0][z1][out][RIGHTCHANNEL];
-    m_filterBuff[0][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    iir_in[LEFTCHANNEL] = iir_out[LEFTCHANNEL];
-    iir_in[RIGHTCHANNEL] = iir_out[RIGHTCHANNEL];
-    return;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::IIR_filterChain1(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[1].a0 * inSample[LEFTCHANNEL] + m_filter[1].a1 * m_filterBuff[1][z1][in][LEFTCHANNEL] +
-        m_filter[1].a2 * m_filterBuff[1][z2][in][LEFTCHANNEL] - m_filter[1].b1 * m_filterBuff[1][z1][out][LEFTCHANNEL] -
-        m_filter[1].b2 * m_filterBuff[1][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[1][z2][in][LEFTCHANNEL] = m_filterBuff[1][z1][in][LEFTCHANNEL];
-    m_filterBuff[1][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[1][z2][out][LEFTCHANNEL] = m_filterBuff[1][z1][out][LEFTCHANNEL];
-    m_filterBuff[1][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[1].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[1].a1 * m_filterBuff[1][z1][in][RIGHTCHANNEL] +
-                              m_filter[1].a2 * m_filterBuff[1][z2][in][RIGHTCHANNEL] -
-                              m_filter[1].b1 * m_filterBuff[1][z1][out][RIGHTCHANNEL] -
-                              m_filter[1].b2 * m_filterBuff[1][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[1][z2][in][RIGHTCHANNEL] = m_filterBuff[1][z1][in][RIGHTCHANNEL];
-    m_filterBuff[1][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[1][z2][out][RIGHTCHANNEL] = m_filterBuff[1][z1][out][RIGHTCHANNEL];
-    m_filterBuff[1][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    iir_in[LEFTCHANNEL] = iir_out[LEFTCHANNEL];
-    iir_in[RIGHTCHANNEL] = iir_out[RIGHTCHANNEL];
-    return;
-}
-//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::IIR_filterChain2(int16_t iir_in[2], bool clear) { // Infinite Impulse Response (IIR) filters
-
-    uint8_t z1 = 0, z2 = 1;
-    enum : uint8_t { in = 0, out = 1 };
-    float          inSample[2];
-    float          outSample[2];
-    static int16_t iir_out[2];
-
-    if(clear) {
-        memset(m_filterBuff, 0, sizeof(m_filterBuff)); // zero IIR filterbuffer
-        iir_out[0] = 0;
-        iir_out[1] = 0;
-        iir_in[0] = 0;
-        iir_in[1] = 0;
-    }
-
-    inSample[LEFTCHANNEL] = (float)(iir_in[LEFTCHANNEL]);
-    inSample[RIGHTCHANNEL] = (float)(iir_in[RIGHTCHANNEL]);
-
-    outSample[LEFTCHANNEL] =
-        m_filter[2].a0 * inSample[LEFTCHANNEL] + m_filter[2].a1 * m_filterBuff[2][z1][in][LEFTCHANNEL] +
-        m_filter[2].a2 * m_filterBuff[2][z2][in][LEFTCHANNEL] - m_filter[2].b1 * m_filterBuff[2][z1][out][LEFTCHANNEL] -
-        m_filter[2].b2 * m_filterBuff[2][z2][out][LEFTCHANNEL];
-
-    m_filterBuff[2][z2][in][LEFTCHANNEL] = m_filterBuff[2][z1][in][LEFTCHANNEL];
-    m_filterBuff[2][z1][in][LEFTCHANNEL] = inSample[LEFTCHANNEL];
-    m_filterBuff[2][z2][out][LEFTCHANNEL] = m_filterBuff[2][z1][out][LEFTCHANNEL];
-    m_filterBuff[2][z1][out][LEFTCHANNEL] = outSample[LEFTCHANNEL];
-    iir_out[LEFTCHANNEL] = (int16_t)outSample[LEFTCHANNEL];
-
-    outSample[RIGHTCHANNEL] = m_filter[2].a0 * inSample[RIGHTCHANNEL] +
-                              m_filter[2].a1 * m_filterBuff[2][z1][in][RIGHTCHANNEL] +
-                              m_filter[2].a2 * m_filterBuff[2][z2][in][RIGHTCHANNEL] -
-                              m_filter[2].b1 * m_filterBuff[2][z1][out][RIGHTCHANNEL] -
-                              m_filter[2].b2 * m_filterBuff[2][z2][out][RIGHTCHANNEL];
-
-    m_filterBuff[2][z2][in][RIGHTCHANNEL] = m_filterBuff[2][z1][in][RIGHTCHANNEL];
-    m_filterBuff[2][z1][in][RIGHTCHANNEL] = inSample[RIGHTCHANNEL];
-    m_filterBuff[2][z2][out][RIGHTCHANNEL] = m_filterBuff[2][z1][out][RIGHTCHANNEL];
-    m_filterBuff[2][z1][out][RIGHTCHANNEL] = outSample[RIGHTCHANNEL];
-    iir_out[RIGHTCHANNEL] = (int16_t)outSample[RIGHTCHANNEL];
-
-    iir_in[LEFTCHANNEL] = iir_out[LEFTCHANNEL];
-    iir_in[RIGHTCHANNEL] = iir_out[RIGHTCHANNEL];
-    return;
-}
-// clang-format on
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 //    AAC - T R A N S P O R T S T R E A M
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -6145,89 +6427,94 @@ boolean Audio::streamDetection(uint32_t bytesAvail) {
     return false;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-uint32_t Audio::find_m4a_atom(uint32_t fileSize, const char* atomName, uint32_t depth) {
-
-    while (audiofile.position() < fileSize) {
-        uint32_t atomStart = audiofile.position(); // Position of the current atom
-        uint32_t atomSize;
-        char atomType[5] = {0};
-        audiofile.read((uint8_t*)&atomSize, 4);    // Read the atom size (4 bytes) and the atom type (4 bytes)
-        if(!atomSize) audiofile.read((uint8_t*)&atomSize, 4); // skip 4 byte offset field
-        audiofile.read((uint8_t*)atomType, 4);
-
-        atomSize = bswap32(atomSize);              // Convert atom size from big-endian to little-endian
-        ///    log_w("%*sAtom '%s' found at position %u with size %u bytes", depth * 2, "", atomType, atomStart, atomSize);
-        if (strncmp(atomType, atomName, 4) == 0) return atomStart;
-
-        if (atomSize == 1) {                       // If the atom has a size of 1, an 'Extended Size' is used
-            uint64_t extendedSize;
-            audiofile.read((uint8_t*)&extendedSize, 8);
-            extendedSize = bswap64(extendedSize);
-        //    log_w("%*sExtended size: %llu bytes\n", depth * 2, "", extendedSize);
-            atomSize = (uint32_t)extendedSize;     // Limit to uint32_t for further processing
-        }
-
-        // If the atom is a container, read the atoms contained in it recursively
-        if (strncmp(atomType, "moov", 4) == 0 || strncmp(atomType, "trak", 4) == 0 ||
-            strncmp(atomType, "mdia", 4) == 0 || strncmp(atomType, "minf", 4) == 0 ||
-            strncmp(atomType, "stbl", 4) == 0 || strncmp(atomType, "meta", 4) == 0 ||
-            strncmp(atomType, "udta", 4) == 0 )  {
-            // Go recursively into the atom, read the contents
-            uint32_t pos = find_m4a_atom(atomStart + atomSize,  atomName, depth + 1);
-            if(pos) return pos;
-        } else {
-            audiofile.seek(atomStart + atomSize);    // No container atom, jump to the next atom
-        }
-    }
-    return 0;
-}
-//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::seek_m4a_ilst() {    // ilist - item list atom, contains the metadata
+void Audio::parse_m4a_moov() {
+    // The moov atom holds the sample tables and the metadata, it can be in front of or behind the audio block (mdat).
+    // Only the top level atoms are visited in the file, moov is read in one go and parsed in memory by M4AIndex.
+    // Therefore, this is only applicable to local files.
+
+    /* atom hierarchy (example)_________________________________________________________________________________________
+
+      ftyp -> moov -> trak -> tkhd
+              free    udta    mdia -> mdhd
+              mdat                    hdlr
+              mvhd                    minf -> smhd
+                                              dinf
+                                              stbl -> stsd
+                                                      stts
+                                                      stsc
+                                                      stsz
+                                                      stco
+      __________________________________________________________________________________________________________________*/
+
+    const uint32_t maxMoovSize = 4 * 1024 * 1024; // sample tables of a few hours
+    uint8_t  hdr[16];
+    uint32_t pos = 0;
+    uint32_t moovPos = 0, moovSize = 0;
+    uint32_t fileSize = getFileSize();
+
+    m_m4aIndex.clear();
     if(!audiofile) return; // guard
-    audiofile.seek(0);
-    uint32_t fileSize = audiofile.size();
-    const char atomName[] = "ilst";
-    uint32_t atomStart = find_m4a_atom(fileSize, atomName);
-    if(!atomStart) {
-        printProcessLog(AUDIOLOG_M4A_ATOM_NOT_FOUND, "ilst");
+
+    while(pos + 8 <= fileSize) {
+        audiofile.seek(pos);
+        if(audiofile.read(hdr, 16) < 8) break;
+        uint64_t atomSize = bigEndian(hdr, 4);
+        if(atomSize == 1) atomSize = bigEndian(hdr + 8, 8);  // extended size
+        if(atomSize == 0) atomSize = fileSize - pos; // up to the end of the file
+        if(m_f_Log) log_i("name %.4s pos %lu, size %llu", hdr + 4, (long unsigned int)pos, atomSize);
+        if(atomSize < 8) break;
+        if(memcmp(hdr + 4, "moov", 4) == 0) {moovPos = pos; moovSize = (atomSize < fileSize - pos) ? atomSize : fileSize - pos; break;}
+        if(atomSize >= fileSize - pos) break;
+        pos += atomSize;
+    }
+    if(!moovSize || moovSize > maxMoovSize) {
+        log_e("m4a atom moov not found");
         audiofile.seek(0);
         return;
     }
 
-    uint32_t   seekpos = atomStart;
-    const char info[12][6] = {"nam\0", "ART\0", "alb\0", "too\0", "cmt\0", "wrt\0", "tmpo\0", "trkn\0", "day\0", "cpil\0", "aART\0", "gen\0"};
-
-    seekpos = atomStart;
-    char buff[4];
-    uint32_t len = 0;
-    audiofile.seek(seekpos);
-    audiofile.readBytes(buff, 4);
-    len = bigEndian((uint8_t*)buff, 4);
-    if(!len) {
-        audiofile.readBytes(buff, 4); // 4bytes offset filed
-        len = bigEndian((uint8_t*)buff, 4) + 16;
-    }
-    if(len > 1024) len = 1024;
-        log_w("found at pos %i, len %i", seekpos, len);
-
-    uint8_t* data = (uint8_t*)x_ps_calloc(len, sizeof(uint8_t));
-    if(!data) {
-        log_e("out od memory");
+    uint8_t* moov = (uint8_t*)x_ps_malloc(moovSize);
+    if(!moov) {
+        log_e("out of memory");
         audiofile.seek(0);
         return;
     }
-    len -= 4;
-    audiofile.seek(seekpos);
-    audiofile.read(data, len);
-
+    audiofile.seek(moovPos);
+    if(audiofile.read(moov, moovSize) == moovSize && m_m4aIndex.parse(moov, moovSize)) {
+        if(m_f_Log) log_i("number of aac frames: %lu", (long unsigned int)m_m4aIndex.frames());
+        int channel = m_m4aIndex.channels();      // audio parameter must be set before starting
+        int bps = m_m4aIndex.bitsPerSample();     // the aac decoder. There are RAW blocks only in m4a
+        int srate = m_m4aIndex.sampleRate();
+        setBitsPerSample(bps);
+        setChannels(channel);
+        setSampleRate(srate);
+        setBitrate(bps * channel * srate);
+        AUDIO_INFO("ch; %i, bps: %i, sr: %i", channel, bps, srate);
+        if(m_m4aIndex.ilstOffset() >= 0) {
+            uint32_t len = m_m4aIndex.ilstSize();
+            if(len > 1024) len = 1024;
+            m4a_ilstMetadata(moov + m_m4aIndex.ilstOffset(), len);
+            m_f_m4aID3dataAreRead = true;
+        }
+        else printProcessLog(AUDIOLOG_M4A_ATOM_NOT_FOUND, "ilst");
+    }
+    else log_e("m4a sample tables not found");
+    x_ps_free(&moov);
+    audiofile.seek(0);
+    return;
+}
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::m4a_ilstMetadata(uint8_t* data, uint32_t len) { // ilst - item list atom, contains the metadata
+    const char info[12][6] = {"nam\0", "ART\0", "alb\0", "too\0", "cmt\0", "wrt\0", "tmpo\0", "trkn\0", "day\0", "cpil\0", "aART\0", "gen\0"};
     int offset = 0;
     for(int i = 0; i < 12; i++) {
         offset = specialIndexOf(data, info[i], len, true); // seek info[] with '\0'
         if(offset > 0) {
             offset += 19;
+            if(offset >= (int)len) continue;
             if(*(data + offset) == 0) offset++;
             char   value[256] = {0};
-            size_t temp = strlen((const char*)data + offset);
+            size_t temp = strnlen((const char*)data + offset, len - offset);
             if(temp > 254) temp = 254;
             memcpy(value, (data + offset), temp);
             value[temp] = '\0';
@@ -6249,147 +6536,18 @@ void Audio::seek_m4a_ilst() {    // ilist - item list atom, contains the metadat
             }
         }
     }
-    m_f_m4aID3dataAreRead = true;
-    x_ps_free(&data);
-    audiofile.seek(0);
-    return;
-}
-//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
-void Audio::seek_m4a_stsz() {
-    // stsz says what size each sample is in bytes. This is important for the decoder to be able to start at a chunk,
-    // and then go through each sample by its size. The stsz atom can be behind the audio block. Therefore, searching
-    // for the stsz atom is only applicable to local files.
-
-    /* atom hierarchy (example)_________________________________________________________________________________________
-
-      ftyp -> moov -> trak -> tkhd
-              free    udta    mdia -> mdhd
-              mdat                    hdlr
-              mvhd                    minf -> smhd
-                                              dinf
-                                              stbl -> stsd
-                                                      stts
-                                                      stsc
-                                                      stsz -> determine and return the position and number of entries
-                                                      stco
-      __________________________________________________________________________________________________________________*/
-
-    struct m4a_Atom {
-        int  pos;
-        int  size;
-        char name[5] = {0};
-    } atom, at, tmp;
-
-    // c99 has no inner functions, lambdas are only allowed from c11, please don't use ancient compiler
-    auto atomItems = [&](uint32_t startPos) { // lambda, inner function
-        char temp[5] = {0};
-        audiofile.seek(startPos);
-        audiofile.readBytes(temp, 4);
-        atom.size = bigEndian((uint8_t*)temp, 4);
-        if(!atom.size) atom.size = 4; // has no data, length is 0
-        audiofile.readBytes(atom.name, 4);
-        atom.name[4] = '\0';
-        atom.pos = startPos;
-        return atom;
-    };
-    // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-
-    uint32_t stsdPos = 0;
-    uint16_t stsdSize = 0;
-    boolean  found = false;
-    uint32_t seekpos = 0;
-    uint32_t filesize = getFileSize();
-    char     name[6][5] = {"moov", "trak", "mdia", "minf", "stbl", "stsz"};
-    char     noe[4] = {0};
-
-    if(!audiofile) return; // guard
-
-    at.pos = 0;
-    at.size = filesize;
-    seekpos = 0;
-
-    for(int i = 0; i < 6; i++) {
-        found = false;
-        while(seekpos < at.pos + at.size) {
-            tmp = atomItems(seekpos);
-            seekpos += tmp.size;
-        //  log_i("tmp.name %s, tmp.size %i, seekpos %i", tmp.name, tmp.size, seekpos);
-            if(strcmp(tmp.name, name[i]) == 0) {
-                memcpy((void*)&at, (void*)&tmp, sizeof(tmp));
-                found = true;
-            }
-            if(m_f_Log) log_i("name %s pos %d, size %d", tmp.name, tmp.pos, tmp.size);
-            if(strcmp(tmp.name, "stsd") == 0) { // in stsd we can found mp4a atom that contains the audioitems
-                stsdPos = tmp.pos;
-                stsdSize = tmp.size;
-            }
-        }
-        if(!found) goto noSuccess;
-        seekpos = at.pos + 8; // 4 bytes size + 4 bytes name
-    }
-    seekpos += 8; // 1 byte version + 3 bytes flags + 4  bytes sample size
-    audiofile.seek(seekpos);
-    audiofile.readBytes(noe, 4); // number of entries
-    m_stsz_numEntries = bigEndian((uint8_t*)noe, 4);
-    if(m_f_Log) log_i("number of entries in stsz: %d", m_stsz_numEntries);
-    m_stsz_position = seekpos + 4;
-    if(stsdSize) {
-        audiofile.seek(stsdPos);
-        uint8_t data[128];
-        audiofile.readBytes((char*)data, 128);
-        int offset = specialIndexOf(data, "mp4a", stsdSize);
-        if(offset > 0) {
-            int channel = bigEndian(data + offset + 20, 2); // audio parameter must be set before starting
-            int bps = bigEndian(data + offset + 22, 2);     // the aac decoder. There are RAW blocks only in m4a
-            int srate = bigEndian(data + offset + 26, 4);   //
-            setBitsPerSample(bps);
-            setChannels(channel);
-            setSampleRate(srate);
-            setBitrate(bps * channel * srate);
-            AUDIO_INFO("ch; %i, bps: %i, sr: %i", channel, bps, srate);
-        }
-    }
-    audiofile.seek(0);
-    return;
-
-noSuccess:
-    m_stsz_numEntries = 0;
-    m_stsz_position = 0;
-    log_e("m4a atom stsz not found");
-    audiofile.seek(0);
-    return;
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::m4a_correctResumeFilePos() {
     // In order to jump within an m4a file, the exact beginning of an aac block must be found. Since m4a cannot be
     // streamed, i.e. there is no syncword, an imprecise jump can lead to a crash.
+    // The frame offsets come from the sample tables in memory (stsz, stco, stsc), no file access.
 
-    if(!m_stsz_position) return m_audioDataStart; // guard
-
-    typedef union {
-        uint8_t  u8[4];
-        uint32_t u32;
-    } tu;
-    tu uu;
-
-    uint32_t i = 0, pos = m_audioDataStart;
-    uint32_t filePtr = audiofile.position();
-    bool found = false;
-    audiofile.seek(m_stsz_position);
+    if(!m_m4aIndex.isValid()) return -1; // guard
 
-    while(i < m_stsz_numEntries) {
-        i++;
-        uu.u8[3] = audiofile.read();
-        uu.u8[2] = audiofile.read();
-        uu.u8[1] = audiofile.read();
-        uu.u8[0] = audiofile.read();
-        pos += uu.u32;
-        if(pos >= m_resumeFilePos) {found = true; break;}
-    }
-    if(!found)  return -1; // not found
-
-    audiofile.seek(filePtr); // restore file pointer
-    return pos - m_resumeFilePos; // return the number of bytes to jump
+    int32_t frame = m_m4aIndex.frameAtOffset(m_resumeFilePos);
+    if(frame < 0) return -1; // not found
+    return m_m4aIndex.frameOffset(frame) - m_resumeFilePos; // return the number of bytes to jump
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 uint32_t Audio::ogg_correctResumeFilePos() {
@@ -6397,51 +6555,19 @@ uint32_t Audio::ogg_correctResumeFilePos() {
     vTaskDelay(1);
     // // log_w("in_resumeFilePos %i", resumeFilePos);
 
-    auto find_sync_word = [&](uint8_t* pos, uint32_t av) -> int {
-        int steps = 0;
-        while(av--) {
-            if(pos[steps] == 'O'){
-                if(pos[steps + 1] == 'g') {
-                    if(pos[steps + 2] == 'g') {
-                        if(pos[steps + 3] == 'S') { // Check for the second part of magic word
-                            return steps;   // Magic word found, return the number of steps
-                        }
-                    }
-                }
-            }
-            steps++;
-        }
-        return -1; // Return -1 if OggS magic word is not found
-    };
-
     uint8_t*       readPtr = InBuff.getReadPtr();
     size_t         av = InBuff.getMaxAvailableBytes();
     int32_t        steps = 0;
 
     if(av < InBuff.getMaxBlockSize()) return -1; // guard
 
-    steps = find_sync_word(readPtr, av);
+    steps = SyncScan_Pattern(readPtr, av, (const uint8_t*)"OggS", 4);
     if(steps == -1) return -1;
     return steps; // Return the number of steps to the sync word
 }
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 int32_t Audio::flac_correctResumeFilePos() {
-
-    auto find_sync_word = [&](uint8_t* pos, uint32_t av) -> int {
-        int steps = 0;
-        while(av--) {
-            char c = pos[steps];
-            steps++;
-            if(c == 0xFF) { // First byte of sync word found
-                char nextByte = pos[steps];
-                steps++;
-                if(nextByte == 0xF8) {     // Check for the second part of sync word
-                    return steps - 2;       // Sync word found, return the number of steps
-                }
-            }
-        }
-        return -1; // Return -1 if sync word is not found
-    };
+    // The starting point is the next frame header, the sync code alone can be part of the audio data
 
     uint8_t*       readPtr = InBuff.getReadPtr();
     size_t         av = InBuff.getMaxAvailableBytes();
@@ -6449,7 +6575,7 @@ int32_t Audio::flac_correctResumeFilePos() {
 
     if(av < InBuff.getMaxBlockSize()) return -1; // guard
 
-    steps = find_sync_word(readPtr, av);
+    steps = SyncScan_Header(readPtr, av, SYNC_FLAC);
     if(steps == -1) return -1;
     return steps; // Return the number of steps to the sync word
 }
@@ -6477,22 +6603,6 @@ int32_t Audio::mp3_correctResumeFilePos() {
         { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }, /* Layer 3 */
     }, };
 
-    auto find_sync_word = [&](uint8_t* pos, uint32_t av) -> int {
-        int steps = 0;
-        while(av--) {
-            char c = pos[steps];
-            steps++;
-            if(c == 0xFF) { // First byte of sync word found
-                char nextByte = pos[steps];
-                steps++;
-                if((nextByte & 0xF0) == 0xF0) { // Check for the second part of sync word
-                    return steps - 2;           // Sync word found, return the number of steps
-                }
-            }
-        }
-        return -1; // Return -1 if sync word is not found
-    };
-
     uint8_t        syncH, syncL, frame0;
     int32_t        steps = 0;
     const uint8_t* pos = InBuff.getReadPtr();
@@ -6501,16 +6611,16 @@ int32_t Audio::mp3_correctResumeFilePos() {
 
 
     if(av < InBuff.getMaxBlockSize()) return -1; // guard
+    audioCodecInfo_t ci = {};
+    if(decoderOf(CODEC_MP3)) decoderOf(CODEC_MP3)->getInfo(&ci); // bitrate of the last decoded frame
 
     while(true) {
-        steps = find_sync_word(readPtr, av);
+        steps = SyncScan_Header(readPtr, (int32_t)(av - (readPtr - pos)) - 3, SYNC_MP3); // the complete header must be in the buffer
         if(steps == -1) return -1;
         readPtr += steps;
         syncH  = *(readPtr    ); (void)syncH; // readPtr[0];
         syncL  = *(readPtr + 1);
         frame0 = *(readPtr + 2);
-        if((frame0 & 0b11110000) == 0b11110000){readPtr++; /* log_w("wrong bitrate index");                 */ continue;}
-        if((frame0 & 0b00001100) == 0b00001100){readPtr++; /* log_w("wrong sampling rate frequency index"); */ continue;}
         int32_t  verIdx = (syncL >> 3) & 0x03;
         uint8_t  mpegVers = (verIdx == 0 ? MPEG25 : ((verIdx & 0x01) ? MPEG1 : MPEG2));
         uint8_t  brIdx = (frame0 >> 4) & 0x0f;
@@ -6520,8 +6630,9 @@ int32_t Audio::mp3_correctResumeFilePos() {
         if(brIdx){
             uint32_t bitrate = ((int32_t) bitrateTab[mpegVers][layer - 1][brIdx]) * 1000;
             uint32_t samplerate = samplerateTab[mpegVers][srIdx];
+            if(m_mp3QualityUsed == MP3_QUALITY_HALFRATE && samplerate >= m_REDUCED_MINRATE) samplerate /= 2; // output rate
             // log_w("syncH 0x%02X, syncL 0x%02X bitrate %i, samplerate %i", syncH, syncL, bitrate, samplerate);
-            if(MP3GetBitrate() == bitrate && getSampleRate() == samplerate) break;
+            if(ci.bitRate == bitrate && getSampleRate() == samplerate) break;
         }
         readPtr++;
     }
@@ -6551,13 +6662,25 @@ uint8_t Audio::determineOggCodec(uint8_t* data, uint16_t len) {
 // that the I2S-DMA is always sufficiently filled, even if the Arduino 'loop' is stuck.
 //------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-void Audio::setAudioTaskCore(uint8_t coreID){  // Recommendation:If the ARDUINO RUNNING CORE is 1, the audio task should be core 0 or vice versa
+void Audio::setAudioTaskCore(uint8_t coreID, uint8_t priority){  // Recommendation:If the ARDUINO RUNNING CORE is 1, the audio task should be core 0 or vice versa
     if(coreID > 1) return;
+    if(priority < 1 || priority > configMAX_PRIORITIES - 2) return; // the prefetch task runs one above
     stopAudioTask();
+    stopPrefetchTask(); // processLocalFile() starts the file prefetch again
     xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
     m_audioTaskCoreId = coreID;
+    m_audioTaskPriority = priority;
     xSemaphoreGive(mutex_audioTask);
     startAudioTask();
+    startPrefetchTask();
+    AUDIO_INFO("audio task: core %u, priority %u", coreID, priority);
+}
+
+void Audio::setAudioTaskTarget(uint8_t blocks){ // a lower target leaves more CPU time to the loop, but less reserve for SD or WiFi stalls
+    xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+    m_schedTarget = blocks;
+    m_sched.begin(m_output.capacity(), blocks);
+    xSemaphoreGive(mutex_audioTask);
 }
 
 void Audio::startAudioTask() {
@@ -6573,7 +6696,7 @@ void Audio::startAudioTask() {
         "PeriodicTask",         /* Name of the task */
         AUDIO_STACK_SIZE,       /* Stack size in words */
         this,                   /* Task input parameter */
-        2,                      /* Priority of the task */
+        m_audioTaskPriority,    /* Priority of the task */
         xAudioStack,            /* Task stack */
         &xAudioTaskBuffer,      /* Memory for the task's control block */
         m_audioTaskCoreId       /* Core where the task should run */
@@ -6600,24 +6723,183 @@ void Audio::taskWrapper(void *param) {
 }
 
 void Audio::audioTask() {
+    uint32_t waitMs = 1;
+    m_taskWindow_us = (uint32_t)esp_timer_get_time();
+    m_taskBusy_us = 0;
     while (m_f_audioTaskIsRunning) {
-        vTaskDelay(1 / portTICK_PERIOD_MS);  // periodically every x ms
-        performAudioTask();
+        TickType_t ticks = pdMS_TO_TICKS(waitMs);
+        ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);  // a DMA event (i2sOnSent) ends the wait earlier
+        uint32_t t0 = (uint32_t)esp_timer_get_time();
+        waitMs = performAudioTask();
+        uint32_t t1 = (uint32_t)esp_timer_get_time();
+        m_taskBusy_us += t1 - t0;
+        if(t1 - t0 > m_taskMaxPass_us) m_taskMaxPass_us = t1 - t0;
+        m_taskPasses++;
+        if(t1 - m_taskWindow_us >= 1000000) { // cpu load of the last second
+            m_cpuLoad = (uint64_t)m_taskBusy_us * 100 / (t1 - m_taskWindow_us);
+            if(m_cpuLoad > m_cpuLoadMax) m_cpuLoadMax = m_cpuLoad;
+            m_taskBusy_us = 0;
+            m_taskWindow_us = t1;
+        }
     }
     vTaskDelete(nullptr);  // Delete this task
 }
 
-void Audio::performAudioTask() {
-    if(!m_f_running) return;
-    if(!m_f_stream) return;
-    if(m_codec == CODEC_NONE) return; // wait for codec is  set
-    if(m_codec == CODEC_OGG)  return; // wait for FLAC, VORBIS or OPUS
+uint32_t Audio::performAudioTask() {
+    if(!m_f_running) return 1;
+    uint32_t blockMs = m_output.blockFrames() / 48; // 48kHz output
+    if(m_f_drain) { // end of file, i2sDrain()
+        xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+        if(!m_f_drained) i2sDrainStep();
+        xSemaphoreGive(mutex_audioTask);
+        return blockMs;
+    }
+    if(m_f_directPCM) { // 48kHz 16 bit wav or raw pcm, no InBuff, no decoder, no resampler
+        xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
+        if(!m_f_eof) directPCMFill();
+        else         i2sFeed(); // processLocalFile() drains the output stage or splices the next file
+        xSemaphoreGive(mutex_audioTask);
+        return m_sched.waitMs(m_output.level(), true, blockMs);
+    }
+    bool decode = m_f_stream;
+    if(m_codec == CODEC_NONE) decode = false; // wait for codec is  set
+    if(m_codec == CODEC_OGG)  decode = false; // wait for FLAC, VORBIS or OPUS
+    if(!decode && !m_validSamples && !m_output.queued()) return 1; // nothing to output, e.g. between two gapless files
+    bool progress = true;
     xSemaphoreTake(mutex_audioTask, 0.3 * configTICK_RATE_HZ);
-    while(m_validSamples) {vTaskDelay(20 / portTICK_PERIOD_MS); playChunk();} // I2S buffer full
-    playAudioData();
+    while(m_validSamples) {ulTaskNotifyTake(pdTRUE, 20 / portTICK_PERIOD_MS); playChunk();} // output stage full, wait for the next DMA event
+    if(decode) {
+        // below the target several frames in one pass, the task catches up after the loop or the SD card held it off
+        uint8_t before = m_output.level(); // the lowest level the DMA has seen since the last pass
+        uint8_t n = 0;
+        do {
+            uint8_t* readPtr = InBuff.getReadPtr();
+            playAudioData();
+            n++;
+            progress = (InBuff.getReadPtr() != readPtr) || m_validSamples; // no input, poll
+        } while(progress && !m_validSamples && m_f_running && m_sched.more(m_output.level(), n));
+        m_sched.observe(before, m_output.level());
+    }
+    else i2sFeed();      // the header of the next file is being read, keep the DMA going
+    if(m_f_prefetchActive) xTaskNotifyGive(m_prefetchTaskHandle); // InBuff has space again
     xSemaphoreGive(mutex_audioTask);
+    return m_sched.waitMs(m_output.level(), progress, blockMs);
 }
 uint32_t Audio::getHighWatermark(){
     UBaseType_t highWaterMark = uxTaskGetStackHighWaterMark(m_audioTaskHandle);
     return highWaterMark; // dwords
 }
+
+void Audio::getAudioTaskStats(audio_taskstats_t* st) {
+    st->stackFree = m_audioTaskHandle ? uxTaskGetStackHighWaterMark(m_audioTaskHandle) : 0;
+    st->core = m_audioTaskCoreId;
+    st->priority = m_audioTaskPriority;
+    st->cpuLoad = m_cpuLoad;
+    st->cpuLoadMax = m_cpuLoadMax;
+    st->maxPass_us = m_taskMaxPass_us;
+    st->passes = m_taskPasses;
+    st->target = m_sched.target();
+    st->capacity = m_output.capacity();
+    st->minLevel = m_sched.minLevel();
+    st->raises = m_sched.raises();
+}
+
+void Audio::resetAudioTaskStats() {
+    m_cpuLoadMax = 0;
+    m_taskMaxPass_us = 0;
+    m_taskPasses = 0;
+    m_sched.resetStats();
+}
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// separate task for reading local files. 'audiofile.read()' blocks as long as the SD card is busy, in the Arduino 'loop' the display or other
+// things can delay the next read. The prefetch task keeps the InBuffer filled independently of the loop. Reads end on a sector boundary, so
+// FATFS transfers whole sectors directly into the InBuffer without copying them through its sector window.
+//------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+void Audio::setFilePrefetch(bool enable) {
+    m_f_prefetch = enable;
+    if(!enable) stopFilePrefetch(); // processLocalFile() reads again
+}
+
+void Audio::startPrefetchTask() {
+    if(m_prefetchTaskHandle) return;
+    m_prefetchTaskHandle = xTaskCreateStaticPinnedToCore(
+        &Audio::prefetchTaskWrapper, /* Function to implement the task */
+        "FilePrefetch",              /* Name of the task */
+        AUDIO_PREFETCH_STACK_SIZE,   /* Stack size */
+        this,                        /* Task input parameter */
+        m_audioTaskPriority + 1,     /* Priority, above the audio task, it is waiting for the SD card most of the time */
+        xPrefetchStack,              /* Task stack */
+        &xPrefetchTaskBuffer,        /* Memory for the task's control block */
+        m_audioTaskCoreId            /* Core where the task should run */
+    );
+}
+
+void Audio::stopPrefetchTask() {
+    stopFilePrefetch();
+    xSemaphoreTake(mutex_prefetch, portMAX_DELAY);
+    if(m_prefetchTaskHandle) {
+        vTaskDelete(m_prefetchTaskHandle);
+        m_prefetchTaskHandle = nullptr;
+    }
+    xSemaphoreGive(mutex_prefetch);
+}
+
+void Audio::prefetchTaskWrapper(void *param) {
+    Audio *runner = static_cast<Audio*>(param);
+    runner->prefetchTask();
+}
+
+void Audio::prefetchTask() {
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, 10 / portTICK_PERIOD_MS); // woken up by performAudioTask() when the decoder has consumed data
+        int32_t bytesRead = 1;
+        while(bytesRead > 0) { // until InBuff is full or the end of file is reached
+            xSemaphoreTake(mutex_prefetch, portMAX_DELAY);
+            bytesRead = 0;
+            if(m_f_prefetchActive && audiofile) {
+                bytesRead = readFileToInBuff();
+                if(bytesRead > 0) m_prefetchFilePos += bytesRead;
+            }
+            xSemaphoreGive(mutex_prefetch);
+        }
+    }
+}
+
+void Audio::startFilePrefetch() {
+    if(!m_prefetchTaskHandle || !audiofile) return;
+    xSemaphoreTake(mutex_prefetch, portMAX_DELAY);
+    m_prefetchFilePos = audiofile.position();
+    m_f_prefetchActive = true;
+    xSemaphoreGive(mutex_prefetch);
+    xTaskNotifyGive(m_prefetchTaskHandle);
+}
+
+void Audio::stopFilePrefetch() { // after return, the caller owns 'audiofile' and the write side of InBuff
+    if(!m_f_prefetchActive) return;
+    xSemaphoreTake(mutex_prefetch, portMAX_DELAY); // wait for the current read
+    m_f_prefetchActive = false;
+    xSemaphoreGive(mutex_prefetch);
+}
+
+int32_t Audio::readFileToInBuff() {
+    const uint32_t sectorSize = 512;
+    const uint32_t maxRead = 32768; // one SD multi block transfer
+    const uint32_t minRead = 4096;  // wait for more space, many small reads waste SD bandwidth
+    uint32_t space = InBuff.writeSpace();
+    if(!space) return 0;
+    uint32_t pos = audiofile.position();
+    uint32_t len = min(space, maxRead);
+    bool     toBuffEnd = (InBuff.getWritePos() + space >= (uint32_t)InBuff.getBufsize()); // the space ends at the ring end, not at the readPtr
+    bool     toFileEnd = (pos + len >= m_fileSize);
+    if(!toBuffEnd && !toFileEnd) {
+        if(len < minRead) return 0;
+        len = ((pos + len) & ~(sectorSize - 1)) - pos; // the next read starts on a sector boundary
+    }
+    else if(!toFileEnd && len > sectorSize) {
+        len = ((pos + len) & ~(sectorSize - 1)) - pos; // a small rest up to the ring end is read next time
+    }
+    int32_t bytesRead = audiofile.read(InBuff.getWritePtr(), len);
+    if(bytesRead > 0) InBuff.bytesWritten(bytesRead);
+    if(m_f_measureLatency && bytesRead > 0) latencyMark(LAT_FILL);
+    return bytesRead;
+}
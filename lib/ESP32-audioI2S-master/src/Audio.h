@@ -21,6 +21,18 @@
 #include <atomic>
 #include <codecvt>
 #include <locale>
+#include "output_stage/output_stage.h"
+#include "audio_sched/audio_sched.h"
+#include "audio_meter/audio_meter.h"
+#include "output_stage/gain_ramp.h"
+#include "audio_dsp/audio_dsp.h"
+#include "audio_arena/audio_arena.h"
+#include "audio_buffer/audio_buffer.h"
+#include "seek_index/seek_index.h"
+#include "m4a_index/m4a_index.h"
+#include "sync_scan/sync_scan.h"
+#include "gapless/gapless.h"
+#include "audio_codec/audio_codec.h"
 
 #if ESP_ARDUINO_VERSION_MAJOR >= 3
 #include <NetworkClient.h>
@@ -53,83 +65,58 @@ extern __attribute__((weak)) void audio_icydescription(const char*);
 extern __attribute__((weak)) void audio_lasthost(const char*);
 extern __attribute__((weak)) void audio_eof_speech(const char*);
 extern __attribute__((weak)) void audio_eof_stream(const char*); // The webstream comes to an end
-extern __attribute__((weak)) void audio_process_i2s(int16_t* outBuff, uint16_t validSamples, bool *continueI2S); // record audiodata or send via BT
+extern __attribute__((weak)) void audio_process_i2s(audio_sample_t* outBuff, uint16_t validSamples, bool *continueI2S); // record audiodata or send via BT, I2S slots
 extern __attribute__((weak)) void audio_log(uint8_t logLevel, const char* msg, const char* arg);
 
-//----------------------------------------------------------------------------------------------------------------------
-
-class AudioBuffer {
-// AudioBuffer will be allocated in PSRAM, If PSRAM not available or has not enough space AudioBuffer will be
-// allocated in FlashRAM with reduced size
-//
-//  m_buffer            m_readPtr                 m_writePtr                 m_endPtr
-//   |                       |<------dataLength------->|<------ writeSpace ----->|
-//   ▼                       ▼                         ▼                         ▼
-//   ---------------------------------------------------------------------------------------------------------------
-//   |                     <--m_buffSize-->                                      |      <--m_resBuffSize -->     |
-//   ---------------------------------------------------------------------------------------------------------------
-//   |<-----freeSpace------->|                         |<------freeSpace-------->|
-//
-//
-//
-//   if the space between m_readPtr and buffend < m_resBuffSize copy data from the beginning to resBuff
-//   so that the mp3/aac/flac frame is always completed
-//
-//  m_buffer                      m_writePtr                 m_readPtr        m_endPtr
-//   |                                 |<-------writeSpace------>|<--dataLength-->|
-//   ▼                                 ▼                         ▼                ▼
-//   ---------------------------------------------------------------------------------------------------------------
-//   |                        <--m_buffSize-->                                    |      <--m_resBuffSize -->     |
-//   ---------------------------------------------------------------------------------------------------------------
-//   |<---  ------dataLength--  ------>|<-------freeSpace------->|
-//
-//
+typedef struct {                // latency breakdown of the first frame, all times in µs since connecttoFS()
+    const char* codec;          // codec name
+    uint32_t    open_us;        // file opened and decoder initialized
+    uint32_t    fill_us;        // first bytes in the input buffer
+    uint32_t    header_us;      // audio header parsed, stream ready
+    uint32_t    decode_us;      // first frame decoded
+    uint32_t    resample_us;    // first frame resampled to 48kHz
+    uint32_t    i2s_us;         // first sample accepted by I2S
+} audio_latency_t;
+
+typedef struct {                // steady-state decode time, the first frame of each stream is not counted
+    uint32_t    frames;         // number of decoded frames
+    uint64_t    sum_us;         // total decode time
+    uint32_t    max_us;         // longest frame
+} audio_decodestats_t;
+
+typedef struct {                // audio task, see getAudioTaskStats()
+    uint32_t    stackFree;      // lowest free stack since the task was started, words
+    uint8_t     core;
+    uint8_t     priority;
+    uint8_t     cpuLoad;        // % of the last second spent in performAudioTask()
+    uint8_t     cpuLoadMax;     // highest cpuLoad since the last resetAudioTaskStats()
+    uint32_t    maxPass_us;     // longest pass
+    uint32_t    passes;         // passes since the last resetAudioTaskStats()
+    uint8_t     target;         // output blocks the task keeps ahead, raised after a near underrun
+    uint8_t     capacity;       // output blocks (pool + DMA)
+    uint8_t     minLevel;       // lowest output level while playing, 0xFF: not measured
+    uint32_t    raises;         // target raised
+} audio_taskstats_t;
+
+typedef struct {                // result of renderToFile()
+    uint32_t    frames;         // 48kHz frames written
+    uint32_t    crc32;          // of the written pcm data (zlib crc32)
+    uint8_t     channels;       // 1 or 2
+    bool        done;           // end of file reached, false: stopped or decoder error
+    int8_t      md5;            // FLAC: 1 decoded samples match the STREAMINFO MD5, -1 they don't, 0 not checked
+    uint16_t    corrupt;        // FLAC: concealed frames, setFLACCrcCheck()
+} audio_render_t;
+
+extern __attribute__((weak)) void audio_latency(const audio_latency_t* lat); // set setLatencyMeasurement(true)
 
-public:
-    AudioBuffer(size_t maxBlockSize = 0);       // constructor
-    ~AudioBuffer();                             // frees the buffer
-    size_t   init();                            // set default values
-    bool     isInitialized() { return m_f_init; };
-    int32_t  getBufsize();
-    void     setBufsize(size_t mbs);            // default is m_buffSizePSRAM for psram, and m_buffSizeRAM without psram
-    void     changeMaxBlockSize(uint16_t mbs);  // is default 1600 for mp3 and aac, set 16384 for FLAC
-    uint16_t getMaxBlockSize();                 // returns maxBlockSize
-    size_t   freeSpace();                       // number of free bytes to overwrite
-    size_t   writeSpace();                      // space fom writepointer to bufferend
-    size_t   bufferFilled();                    // returns the number of filled bytes
-    size_t   getMaxAvailableBytes();            // max readable bytes in one block
-    void     bytesWritten(size_t bw);           // update writepointer
-    void     bytesWasRead(size_t br);           // update readpointer
-    uint8_t* getWritePtr();                     // returns the current writepointer
-    uint8_t* getReadPtr();                      // returns the current readpointer
-    uint32_t getWritePos();                     // write position relative to the beginning
-    uint32_t getReadPos();                      // read position relative to the beginning
-    void     resetBuffer();                     // restore defaults
-    bool     havePSRAM() { return m_f_psram; };
-
-protected:
-    size_t            m_buffSizePSRAM    = UINT16_MAX * 10;   // most webstreams limit the advance to 100...300Kbytes
-    size_t            m_buffSizeRAM      = 1600 * 10;
-    size_t            m_buffSize         = 0;
-    size_t            m_freeSpace        = 0;
-    size_t            m_writeSpace       = 0;
-    size_t            m_dataLength       = 0;
-    size_t            m_resBuffSizeRAM   = 4096;     // reserved buffspace, >= one wav  frame
-    size_t            m_resBuffSizePSRAM = 4096 * 6; // reserved buffspace, >= one flac frame
-    size_t            m_maxBlockSize     = 1600;
-    uint8_t*          m_buffer           = NULL;
-    uint8_t*          m_writePtr         = NULL;
-    uint8_t*          m_readPtr          = NULL;
-    uint8_t*          m_endPtr           = NULL;
-    bool              m_f_init           = false;
-    bool              m_f_isEmpty        = true;
-    bool              m_f_psram          = false;    // PSRAM is available (and used...)
-};
 //----------------------------------------------------------------------------------------------------------------------
 
 static const size_t AUDIO_STACK_SIZE = 3300;
 static StaticTask_t __attribute__((unused)) xAudioTaskBuffer;
 static StackType_t  __attribute__((unused)) xAudioStack[AUDIO_STACK_SIZE];
+static const size_t AUDIO_PREFETCH_STACK_SIZE = 4096;
+static StaticTask_t __attribute__((unused)) xPrefetchTaskBuffer;
+static StackType_t  __attribute__((unused)) xPrefetchStack[AUDIO_PREFETCH_STACK_SIZE];
 extern char audioI2SVers[];
 
 class Audio : private AudioBuffer{
@@ -143,6 +130,12 @@ public:
     bool connecttohost(const char* host, const char* user = "", const char* pwd = "");
     bool connecttospeech(const char* speech, const char* lang);
     bool connecttoFS(fs::FS &fs, const char* path, int32_t m_fileStartPos = -1);
+    bool queueFS(fs::FS &fs, const char* path); // gapless, played after the current file, all queued files must be on the same fs
+    bool renderToFile(fs::FS &fs, const char* path, File* out); // decode to 48kHz 16 bit pcm into 'out', no I2S output
+    bool isRendering() {return m_renderFile != nullptr;}
+    void getRenderResult(audio_render_t* r) {*r = m_render;}
+    void clearFSQueue();
+    uint16_t queuedFiles() {return m_fsQueue.size() + (m_nextFile ? 1 : 0);}
     void setConnectionTimeout(uint16_t timeout_ms, uint16_t timeout_ms_ssl);
     bool setAudioPlayPosition(uint16_t sec);
     bool setFilePos(uint32_t pos);
@@ -152,12 +145,17 @@ public:
     bool isRunning() {return m_f_running;}
     void loop();
     uint32_t stopSong();
+    void fadeOutAndStop(uint16_t ms = 150); // ramps the output down to silence, then stopSong()
+    bool fadeToFS(fs::FS &fs, const char* path, uint16_t ms = 150); // fadeOutAndStop(), then loop() starts 'path', never waits
     void forceMono(bool m);
     void setBalance(int8_t bal = 0);
     void setVolumeSteps(uint8_t steps);
     void setVolume(uint8_t vol, uint8_t curve = 0);
     uint8_t getVolume();
     uint8_t maxVolume();
+    void setVolumeRamp(uint16_t ms);        // volume, balance and mute changes are ramped, 0: instantly
+    void setMute(bool mute);
+    bool getMute() {return m_f_mute;}
     uint8_t getI2sPort();
 
     uint32_t getAudioDataStartPos();
@@ -171,6 +169,15 @@ public:
     uint32_t getAudioCurrentTime();
     uint32_t getTotalPlayingTime();
     uint16_t getVUlevel();
+    bool     getMeter(audioMeter_t* m); // peak, rms and band levels, lock free
+    void     setLatencyMeasurement(bool enable);                    // timestamps the stages of the first frame
+    bool     getDecodeStats(uint8_t codec, audio_decodestats_t* st); // steady-state decode time per frame
+    void     getArenaStats(arenaStats_t* st);                         // PSRAM arena of the decoder buffers
+    void     setSeekIndex(bool enable, uint16_t intervalMs = 500);    // time -> byte table "<file>.sidx", built on the first complete play
+    void     setDirectPCM(bool enable);                               // 48kHz 16 bit wav: file -> I2S without decoder and resampler
+    void     setMP3Quality(uint8_t q);                                // MP3_QUALITY_FULL, _LOWPASS or _HALFRATE (fs / 4 bandwidth, less CPU)
+    void     setFLACDualCore(bool enable);                            // every second FLAC frame is decoded on the other core
+    void     setFLACCrcCheck(bool enable, bool repeat = false);       // FLAC frame CRCs, corrupt frames: silence or the last good frame
 
     uint32_t inBufferFilled(); // returns the number of stored bytes in the inputbuffer
     uint32_t inBufferFree();   // returns the number of free bytes in the inputbuffer
@@ -178,6 +185,9 @@ public:
     void setBufferSize(size_t mbs); // sets the size of the inputbuffer in bytes
     void setTone(int8_t gainLowPass, int8_t gainBandPass, int8_t gainHighPass);
     void setI2SCommFMT_LSB(bool commFMT);
+    bool setDmaBuffers(uint8_t dmaDescNum, uint16_t dmaFrameNum, uint8_t poolBlocks = 4); // I2S DMA depth and output block pool, frames 0: max
+    void getOutputStats(outputStats_t* st);  // buffer levels, underruns and late blocks of the output stage
+    void resetOutputStats();
     int getCodec() {return m_codec;}
     const char *getCodecname() {return codecname[m_codec];}
     const char *getVersion() {return audioI2SVers;}
@@ -201,8 +211,20 @@ private:
   bool            httpPrint(const char* host);
   bool            httpRange(const char* host, uint32_t range);
   void            processLocalFile();
+  void            localFileEnded();
+  void            fadeNext();
+  uint8_t         codecFromFileName(const char* path);
+  void            readGaplessInfo(File& file, uint8_t codec, uint32_t* skip, int32_t* total);
+  void            armNextFile();
+  bool            spliceNextFile();
+  void            trimDecodedFrames();
+  void            loadSeekIndex(fs::FS& fs, const char* path);
+  void            saveSeekIndex();
+  bool            seekIndexPosition(uint32_t sample);
+  bool            seekIndexFits();
   void            processWebStream();
   void            processWebFile();
+  void            webFileEnded();
   void            processWebStreamTS();
   void            processWebStreamHLS();
   void            playAudioData();
@@ -232,44 +254,63 @@ private:
   bool            setBitsPerSample(int bits);
   bool            setChannels(int channels);
   bool            setBitrate(int br);
-  size_t          resampleTo48kStereo(const int16_t* input, size_t inputFrames);
   void            playChunk();
-  void            computeVUlevel(int16_t sample[2]);
-  void            computeLimit();
-  void            Gain(int16_t* sample);
+  void            latencyMark(uint8_t stage);
+  void            latencyReport();
+  void            computeLimit(bool instant = false);
   void            showstreamtitle(char* ml);
   bool            parseContentType(char* ct);
   bool            parseHttpResponseHeader();
   bool            initializeDecoder(uint8_t codec);
+  AudioCodec*     decoderOf(uint8_t codec);
+  void            releaseDecoders();
   esp_err_t       I2Sstart();
   esp_err_t       I2Sstop();
+  void            i2sFeed();
+  bool            i2sDrain();
+  void            i2sDrainStep();
+  static bool     i2sOnSent(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
   void            zeroI2Sbuff();
-  void            IIR_filterChain0(int16_t iir_in[2], bool clear = false);
-  void            IIR_filterChain1(int16_t iir_in[2], bool clear = false);
-  void            IIR_filterChain2(int16_t iir_in[2], bool clear = false);
+  void            renderChunk();
   inline uint32_t streamavail() { return _client ? _client->available() : 0; }
   void            IIR_calculateCoefficients(int8_t G1, int8_t G2, int8_t G3);
   bool            ts_parsePacket(uint8_t* packet, uint8_t* packetStart, uint8_t* packetLength);
-  uint32_t        find_m4a_atom(uint32_t fileSize, const char* atomType, uint32_t depth = 0);
 
   //+++ create a T A S K  for playAudioData(), output via I2S +++
 public:
-  void            setAudioTaskCore(uint8_t coreID);
+  void            setAudioTaskCore(uint8_t coreID, uint8_t priority = 2); // restarts the audio and the prefetch task
+  void            setAudioTaskTarget(uint8_t blocks);     // output blocks decoded ahead, 0: all (default)
   uint32_t        getHighWatermark();
+  void            getAudioTaskStats(audio_taskstats_t* st);
+  void            resetAudioTaskStats();
 private:
   void            startAudioTask(); // starts a task for decode and play
   void            stopAudioTask();  // stops task for audio
   static void     taskWrapper(void *param);
   void            audioTask();
-  void            performAudioTask();
+  uint32_t        performAudioTask(); // returns the time to sleep in ms
+  bool            openDirectPCM(bool raw);
+  void            directPCMFill();
+
+  //+++ create a T A S K  for reading local files ahead of the decoder +++
+public:
+  void            setFilePrefetch(bool enable); // default: on, SD reads are done in a separate task
+private:
+  void            startPrefetchTask();
+  void            stopPrefetchTask();
+  static void     prefetchTaskWrapper(void *param);
+  void            prefetchTask();
+  void            startFilePrefetch();
+  void            stopFilePrefetch();
+  int32_t         readFileToInBuff();
 
   //+++ W E B S T R E A M  -  H E L P   F U N C T I O N S +++
   uint16_t readMetadata(uint16_t b, bool first = false);
   size_t   readChunkSize(uint8_t* bytes);
   bool     readID3V1Tag();
   boolean  streamDetection(uint32_t bytesAvail);
-  void     seek_m4a_stsz();
-  void     seek_m4a_ilst();
+  void     parse_m4a_moov();
+  void     m4a_ilstMetadata(uint8_t* data, uint32_t len);
   uint32_t m4a_correctResumeFilePos();
   uint32_t ogg_correctResumeFilePos();
   int32_t  flac_correctResumeFilePos();
@@ -364,19 +405,9 @@ void trim(char *str) {
     }
 
     int specialIndexOf (uint8_t* base, const char* str, int baselen, bool exact = false){
-        int result = 0;  // seek for str in buffer or in header up to baselen, not nullterninated
-        if (strlen(str) > baselen) return -1; // if exact == true seekstr in buffer must have "\0" at the end
-        for (int i = 0; i < baselen - strlen(str); i++){
-            result = i;
-            for (int j = 0; j < strlen(str) + exact; j++){
-                if (*(base + i + j) != *(str + j)){
-                    result = -1;
-                    break;
-                }
-            }
-            if (result >= 0) break;
-        }
-        return result;
+        // seek for str in buffer or in header up to baselen, not nullterninated
+        // if exact == true seekstr in buffer must have "\0" at the end
+        return SyncScan_IndexOf(base, str, baselen, exact);
     }
 
     int32_t min3(int32_t a, int32_t b, int32_t c){
@@ -480,6 +511,9 @@ uint64_t bigEndian(uint8_t* base, uint8_t numBytes, uint8_t shiftLeft = 8) {
     void x_ps_free(int16_t** b){
         if(*b){free(*b); *b = NULL;}
     }
+    void x_ps_free(int32_t** b){
+        if(*b){free(*b); *b = NULL;}
+    }
     void x_ps_free(uint8_t** b){
         if(*b){free(*b); *b = NULL;}
     }
@@ -586,23 +620,24 @@ private:
     enum : int { CODEC_NONE = 0, CODEC_WAV = 1, CODEC_MP3 = 2, CODEC_AAC = 3, CODEC_M4A = 4, CODEC_FLAC = 5,
                  CODEC_AACP = 6, CODEC_OPUS = 7, CODEC_OGG = 8, CODEC_VORBIS = 9};
     enum : int { ST_NONE = 0, ST_WEBFILE = 1, ST_WEBSTREAM = 2};
+    enum : int { LAT_PLAY = 0, LAT_OPEN = 1, LAT_FILL = 2, LAT_HEADER = 3, LAT_DECODE = 4, LAT_RESAMPLE = 5, LAT_I2S = 6, LAT_NUM = 7};
     typedef enum { LEFTCHANNEL=0, RIGHTCHANNEL=1 } SampleIndex;
     typedef enum { LOWSHELF = 0, PEAKEQ = 1, HIFGSHELF =2 } FilterType;
 
-    typedef struct _filter{
-        float a0;
-        float a1;
-        float a2;
-        float b1;
-        float b2;
-    } filter_t;
-
     typedef struct _pis_array{
         int number;
         int pids[4];
     } pid_array;
 
     File                  audiofile;
+    File                  m_nextFile;         // gapless, pre-opened head of m_fsQueue
+    fs::FS*               m_queueFS = nullptr;
+    std::vector<char*>    m_fsQueue;          // gapless, paths of the following files
+    fs::FS*               m_fadeNextFS = nullptr;
+    char*                 m_fadeNextPath = nullptr; // fadeToFS(), started by loop() when the current stream has faded out
+    fs::FS*               m_fileFS = nullptr; // fs of audiofile, the seek index is stored next to it
+    SeekIndex             m_seekIndex;
+    M4AIndex              m_m4aIndex;         // sample tables of a local m4a file
 #ifndef ETHERNET_IF
     WiFiClient            client;
     WiFiClientSecure      clientsecure;
@@ -615,6 +650,8 @@ private:
     SemaphoreHandle_t     mutex_playAudioData;
     SemaphoreHandle_t     mutex_audioTask;
     TaskHandle_t          m_audioTaskHandle = nullptr;
+    SemaphoreHandle_t     mutex_prefetch;
+    TaskHandle_t          m_prefetchTaskHandle = nullptr;
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
@@ -628,12 +665,20 @@ private:
 #endif
 #pragma GCC diagnostic pop
 
+    AudioArena            m_arena;            // decoder state, bound with AudioArena_Bind() while this object lives
+    OutputStage           m_output;           // DMA sized blocks between playChunk() and I2S
+    GainRamp              m_gainRamp;         // volume, balance and mute of the 48kHz output
+    File*                 m_renderFile = nullptr; // renderToFile(), playChunk() writes here instead of the output stage
+    audio_render_t        m_render = {};
+    AudioMeter            m_meter;            // levels of the 48kHz output, written by the audio task
+    AudioSched            m_sched;            // fill level of m_output, frames per pass of the audio task
+
     std::vector<char*>    m_playlistContent;  // m3u8 playlist buffer
     std::vector<char*>    m_playlistURL;      // m3u8 streamURLs buffer
     std::vector<uint32_t> m_hashQueue;
 
     const size_t    m_frameSizeWav       = 4096;
-    const size_t    m_frameSizeMP3       = 1600;
+    const size_t    m_frameSizeMP3       = 1800; // layer II: up to 1728 bytes (384kbit/s, 32kHz)
     const size_t    m_frameSizeAAC       = 1600;
     const size_t    m_frameSizeFLAC      = 4096 * 6; // 24576
     const size_t    m_frameSizeOPUS      = 1024;
@@ -653,7 +698,7 @@ private:
     char*           m_playlistBuff = NULL;          // stores playlistdata
     char*           m_speechtxt = NULL;             // stores tts text
     const uint16_t  m_plsBuffEntryLen = 256;        // length of each entry in playlistBuff
-    filter_t        m_filter[3];                    // digital filters
+    AudioDsp        m_dsp;                          // tone filters, forceMono, resampler
     int             m_LFcount = 0;                  // Detection of end of header
     uint32_t        m_sampleRate=16000;
     uint32_t        m_bitRate=0;                    // current bitrate given fom decoder
@@ -666,6 +711,12 @@ private:
     uint16_t        m_vol_steps = 21;               // default
     double          m_limit_left = 0;               // limiter 0 ... 1, left channel
     double          m_limit_right = 0;              // limiter 0 ... 1, right channel
+    uint16_t        m_volRampMs = 20;               // duration of a volume ramp
+    uint32_t        m_fadeStopBlock = 0;            // fadeOutAndStop(), output block that follows the faded audio
+    uint32_t        m_taskBusy_us = 0;              // audio task, time in performAudioTask() in the current second
+    uint32_t        m_taskWindow_us = 0;            // audio task, start of the current second
+    uint32_t        m_taskMaxPass_us = 0;
+    uint32_t        m_taskPasses = 0;
     uint8_t         m_timeoutCounter = 0;           // timeout counter
     uint8_t         m_curve = 0;                    // volume characteristic
     uint8_t         m_bitsPerSample = 16;           // bitsPerSample
@@ -673,21 +724,41 @@ private:
     uint8_t         m_i2s_num = I2S_NUM_0;          // I2S_NUM_0 or I2S_NUM_1
     uint8_t         m_playlistFormat = 0;           // M3U, PLS, ASX
     uint8_t         m_codec = CODEC_NONE;           //
+    AudioCodec*     m_decoder = NULL;               // decoder of m_codec, set in findNextSync()
+    AudioCodec*     m_codecs[5] = {};               // MP3, AAC, FLAC, OPUS, VORBIS, made by decoderOf(), owned
     uint8_t         m_m3u8Codec = CODEC_AAC;        // codec of m3u8 stream
     uint8_t         m_expectedCodec = CODEC_NONE;   // set in connecttohost (e.g. http://url.mp3 -> CODEC_MP3)
     uint8_t         m_expectedPlsFmt = FORMAT_NONE; // set in connecttohost (e.g. streaming01.m3u) -> FORMAT_M3U)
     uint8_t         m_filterType[2];                // lowpass, highpass
     uint8_t         m_streamType = ST_NONE;
     uint8_t         m_ID3Size = 0;                  // lengt of ID3frame - ID3header
-    uint8_t         m_vuLeft = 0;                   // average value of samples, left channel
-    uint8_t         m_vuRight = 0;                  // average value of samples, right channel
     uint8_t         m_audioTaskCoreId = 0;
+    uint8_t         m_audioTaskPriority = 2;        // the prefetch task runs one above
+    uint8_t         m_schedTarget = 0;              // setAudioTaskTarget(), 0: capacity of m_output
+    uint8_t         m_cpuLoad = 0;                  // audio task, % of the last second
+    uint8_t         m_cpuLoadMax = 0;
     uint8_t         m_M4A_objectType = 0;           // set in read_M4A_Header
     uint8_t         m_M4A_chConfig = 0;             // set in read_M4A_Header
     uint16_t        m_M4A_sampleRate = 0;           // set in read_M4A_Header
-    int16_t*        m_outBuff = NULL;               // Interleaved L/R
-    int16_t*        m_samplesBuff48K = NULL;        // Interleaved L/R
+    audio_sample_t* m_outBuff = NULL;               // Interleaved L/R, mono: one sample per frame
+    audio_sample_t* m_samplesBuff48K = NULL;        // Interleaved L/R
     int16_t         m_validSamples = {0};           // #144
+    int32_t         m_outPending = 0;               // frames in m_samplesBuff48K that are not yet in the output stage
+    int32_t         m_outPos = 0;                   // first pending frame in m_samplesBuff48K
+    uint32_t        m_trimSkip = 0;                 // gapless, decoded frames to drop (encoder delay, Opus pre-skip)
+    int32_t         m_trimRemain = -1;              // gapless, frames to play until the encoder padding, -1 unknown
+    uint32_t        m_nextTrimSkip = 0;             // the same for m_nextFile
+    int32_t         m_nextTrimRemain = -1;
+    uint8_t         m_nextCodec = CODEC_NONE;
+    uint32_t        m_gaplessSkip = 0;              // m_trimSkip and m_trimRemain at the beginning of the file
+    int32_t         m_gaplessTotal = -1;
+    int32_t         m_streamSample = -1;            // decoded frames since the beginning of the file, -1 unknown (after an inexact seek)
+    uint32_t        m_seekStartSample = 0;          // seek index, first decoded frame at the new file position
+    uint32_t        m_seekTrimSkip = 0;             // seek index, preroll and frames up to the target to drop
+    int32_t         m_seekTrimRemain = -1;
+    uint16_t        m_seekIndexInterval = 500;      // ms between two entries of the seek index
+    bool            m_f_seekIndex = true;           // build and use "<file>.sidx"
+    bool            m_f_seekExact = false;          // m_resumeFilePos comes from the seek index (first byte of a frame or ogg page)
     int16_t         m_curSample{0};
     uint16_t        m_dataMode{0};                  // Statemaschine
     int16_t         m_decodeError = 0;              // Stores the return value of the decoder
@@ -700,6 +771,7 @@ private:
     uint16_t        m_flacMaxFrameSize = 0;         // can be read out in the FLAC file header
     uint16_t        m_flacMaxBlockSize = 0;         // can be read out in the FLAC file header
     uint32_t        m_flacTotalSamplesInStream = 0; // can be read out in the FLAC file header
+    uint8_t         m_flacMD5[16] = {0};            // STREAMINFO, checked by renderToFile()
     uint32_t        m_metaint = 0;                  // Number of databytes between metadata
     uint32_t        m_chunkcount = 0 ;              // Counter for chunked transfer
     uint32_t        m_t0 = 0;                       // store millis(), is needed for a small delay
@@ -709,8 +781,6 @@ private:
     int32_t         m_resumeFilePos = -1;           // the return value from stopSong(), (-1) is idle
     int32_t         m_fileStartPos = -1;            // may be set in connecttoFS()
     uint16_t        m_m3u8_targetDuration = 10;     //
-    uint32_t        m_stsz_numEntries = 0;          // num of entries inside stsz atom (uint32_t)
-    uint32_t        m_stsz_position = 0;            // pos of stsz atom within file
     uint32_t        m_haveNewFilePos = 0;           // user changed the file position
     uint32_t        m_sumBytesDecoded = 0;          // used for streaming
     uint32_t        m_webFilePos = 0;               // same as audiofile.position() for SD files
@@ -730,6 +800,8 @@ private:
     bool            m_f_tts = false;                // text to speech
     bool            m_f_ogg = false;                // OGG stream
     bool            m_f_forceMono = false;          // if true stereo -> mono
+    bool            m_f_mute = false;
+    bool            m_f_fadeStop = false;           // fadeOutAndStop() in progress
     bool            m_f_rtsp = false;               // set if RTSP is used (m3u8 stream)
     bool            m_f_m3u8data = false;           // used in processM3U8entries
     bool            m_f_Log = false;                // set in platformio.ini  -DAUDIO_LOG and -DCORE_DEBUG_LEVEL=3 or 4
@@ -744,25 +816,39 @@ private:
     bool            m_f_stream = false;             // stream ready for output?
     bool            m_f_decode_ready = false;       // if true data for decode are ready
     bool            m_f_eof = false;                // end of file
+    bool            m_f_drain = false;              // end of file, i2sDrain(): the audio task writes the rest to the DMA
+    bool            m_f_drained = false;            // set by the audio task when the output stage is empty
     bool            m_f_lockInBuffer = false;       // lock inBuffer for manipulation
     bool            m_f_audioTaskIsDecoding = false;
+    bool            m_f_prefetch = true;            // read local files in the prefetch task
+    std::atomic<bool> m_f_prefetchActive{false};    // the prefetch task owns 'audiofile' reads and the write side of InBuff
+    bool            m_f_directPCMEnabled = true;    // setDirectPCM()
+    uint8_t         m_mp3Quality = 0;               // setMP3Quality(), for the next file
+    uint8_t         m_mp3QualityUsed = 0;           // quality of the mp3 decoder, set in initializeDecoder()
+    bool            m_f_flacDualCore = false;       // setFLACDualCore(), for the next file
+    bool            m_f_flacCrcCheck = false;       // setFLACCrcCheck(), for the next file
+    bool            m_f_flacRepeat = false;         // setFLACCrcCheck(), conceal with the last good frame
+    bool            m_f_directPCM = false;          // the current file is copied to the output stage as it is
+    uint32_t        m_directRemain = 0;             // bytes of the data chunk not yet read
+    uint32_t        m_directPlayed = 0;             // frames written to the output stage
+    std::atomic<uint32_t> m_prefetchFilePos{0};     // file position after the last prefetch read, read by the audio task
     bool            m_f_acceptRanges = false;
     bool            m_f_reset_m3u8Codec = true;     // reset codec for m3u8 stream
     uint8_t         m_f_channelEnabled = 3;         //
     uint32_t        m_audioFileDuration = 0;
     float           m_audioCurrentTime = 0;
-    float           m_resampleError = 0.0f;
-    float           m_resampleRatio = 1.0f;         // resample ratio for e.g. 44.1kHz to 48kHz
     uint32_t        m_audioDataStart = 0;           // in bytes
     size_t          m_audioDataSize = 0;            //
-    float           m_filterBuff[3][2][2][2];       // IIR filters memory for Audio DSP
-    float           m_corr = 1.0;					// correction factor for level adjustment
+    float           m_corr = 1.0;					// correction factor for level adjustment, folded into the first filter
     size_t          m_i2s_bytesWritten = 0;         // set in i2s_write() but not used
     size_t          m_fileSize = 0;                 // size of the file
     uint16_t        m_filterFrequency[2];
     int8_t          m_gain0 = 0;                    // cut or boost filters (EQ)
     int8_t          m_gain1 = 0;
     int8_t          m_gain2 = 0;
+    bool            m_f_measureLatency = false;     // set in setLatencyMeasurement()
+    int64_t         m_latencyT[LAT_NUM] = {0};      // esp_timer timestamps of the first frame, 0: not reached yet
+    audio_decodestats_t m_decodeStats[10] = {};     // per codec, index is m_codec
 
     pid_array       m_pidsOfPMT;
     int16_t         m_pidOfAAC;
@@ -2,7 +2,7 @@
  *  aac_decoder.h
  *  faad2 - ESP32 adaptation
  *  Created on: 12.09.2023
- *  Updated on: 13.08.2024
+ *  Updated on: 19.10.2026
 */
 
 
@@ -17,6 +17,21 @@ struct AudioSpecificConfig {
     uint8_t channelConfiguration;
 };
 
+typedef struct AACDecoder AACDecoder_t; // the libfaad handle and the stream values of one decoder, opaque
+
+AACDecoder_t* AACDecoder_New();          // an instance of its own, the heap (libfaad allocates there too)
+void        AACDecoder_Delete(AACDecoder_t *d);
+uint8_t     AACGetFormat(AACDecoder_t *d);
+uint8_t     AACGetParametricStereo(AACDecoder_t *d);
+uint8_t     AACGetSBR(AACDecoder_t *d);
+int         AACSetRawBlockParams(AACDecoder_t *d, int nChans, int sampRateCore, int profile);
+int16_t     AACGetOutputSamps(AACDecoder_t *d);
+int         AACGetBitrate(AACDecoder_t *d);
+int         AACGetChannels(AACDecoder_t *d);
+int         AACGetSampRate(AACDecoder_t *d);
+int         AACDecode(AACDecoder_t *d, uint8_t *inbuf, int32_t *bytesLeft, short *outbuf);
+
+// without instance argument: the instance of AACDecoder_AllocateBuffers()
 bool        AACDecoder_IsInit();
 bool        AACDecoder_AllocateBuffers();
 void        AACDecoder_FreeBuffers();
@@ -0,0 +1,93 @@
+/*
+ *  audio_arena.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef ARDUINO
+    #include "esp_heap_caps.h"
+    #define __malloc_heap_psram(size) \
+        heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL)
+    #define __malloc_arena(size) heap_caps_malloc(size, MALLOC_CAP_SPIRAM)
+#else
+    #define __malloc_heap_psram(size) ::malloc(size)
+    #define __malloc_arena(size)      ::malloc(size)
+#endif
+
+static std::atomic<AudioArena*> s_bound{nullptr}; // set by the task that creates Audio, read by the decoders
+
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioArena::init(size_t size) {
+    if(m_arena) return true;
+    size = AUDIO_ARENA_ALIGN(size);
+    m_arena = (uint8_t*)__malloc_arena(size);
+    if(!m_arena) return false;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.size = size;
+    m_pos = 0;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioArena::deinit() {
+    if(m_arena) free(m_arena);
+    m_arena = nullptr;
+    m_pos = 0;
+    m_stats.size = 0;
+    m_stats.used = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioArena::reset() {
+    m_pos = 0;
+    m_stats.used = 0;
+    m_stats.resets++;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void* AudioArena::malloc(size_t size) {
+    size = AUDIO_ARENA_ALIGN(size);
+    if(m_arena && size && m_pos + size <= m_stats.size) {
+        void* p = m_arena + m_pos;
+        m_pos += size;
+        m_stats.used = m_pos;
+        if(m_stats.used > m_stats.peak) m_stats.peak = m_stats.used;
+        m_stats.allocs++;
+        return p;
+    }
+    if(m_arena) m_stats.heapFallbacks++;
+    return __malloc_heap_psram(size);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioArena::owns(const void* ptr) const {
+    if(!m_arena) return false;
+    return (const uint8_t*)ptr >= m_arena && (const uint8_t*)ptr < m_arena + m_stats.size;
+}
+//----------------------------------------------------------------------------------------------------------------------
+//          D E C O D E R   S I D E
+//----------------------------------------------------------------------------------------------------------------------
+void AudioArena_Bind(AudioArena* arena) { s_bound.store(arena); }
+//----------------------------------------------------------------------------------------------------------------------
+void* AudioArena_Malloc(size_t size) {
+    AudioArena* a = s_bound.load();
+    return a ? a->malloc(size) : __malloc_heap_psram(AUDIO_ARENA_ALIGN(size));
+}
+//----------------------------------------------------------------------------------------------------------------------
+void* AudioArena_Calloc(size_t n, size_t size) {
+    void* p = AudioArena_Malloc(n * size);
+    if(p) memset(p, 0, n * size);
+    return p;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioArena_Free(void* ptr) {
+    if(!ptr) return;
+    if(AudioArena_Owns(ptr)) return; // released with the next reset()
+    free(ptr);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioArena_Owns(const void* ptr) {
+    AudioArena* a = s_bound.load();
+    return a && a->owns(ptr);
+}
@@ -0,0 +1,54 @@
+/*
+ *  audio_arena.h
+ *
+ *  PSRAM arena for the per stream state of the decoders. Audio owns an AudioArena, allocates it once in its constructor
+ *  and binds it with AudioArena_Bind(), the decoders take their buffers from the bound arena by bump allocation. Nothing
+ *  is freed during playback, reset() releases everything at once when all decoders are freed (next stream). If no arena
+ *  is bound or it is full, the heap is used as before.
+ *  Only long living decoder state belongs in here, scratch buffers that are allocated per frame must stay on the heap.
+ *  The decoders have no instance argument for the arena (Opus and Vorbis keep their state in file globals), they reach
+ *  it through AudioArena_Malloc() ... and the one bound arena.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AUDIO_ARENA_ALIGN(size) (((size_t)(size) + 7) & ~(size_t)7) // every block is 8 byte aligned
+
+typedef struct {
+    size_t   size;           // bytes of the arena
+    size_t   used;           // bytes in use since the last reset
+    size_t   peak;           // highest 'used' since init
+    uint32_t allocs;         // blocks taken from the arena since init
+    uint32_t heapFallbacks;  // blocks that did not fit and were taken from the heap
+    uint32_t resets;
+} arenaStats_t;
+
+class AudioArena {
+public:
+    AudioArena() {}
+    ~AudioArena() { deinit(); }
+    AudioArena(const AudioArena&) = delete;
+    AudioArena& operator=(const AudioArena&) = delete;
+    bool     init(size_t size);                 // allocates the arena (PSRAM), once
+    void     deinit();
+    void     reset();                           // all decoders are freed, start again at the beginning
+    void*    malloc(size_t size);               // the heap if the arena is full
+    bool     owns(const void* ptr) const;
+    void     getStats(arenaStats_t* st) const { if(st) *st = m_stats; }
+
+private:
+    uint8_t*     m_arena = nullptr;
+    size_t       m_pos = 0;
+    arenaStats_t m_stats = {};
+};
+
+void   AudioArena_Bind(AudioArena* arena);      // the arena of the decoders, nullptr: heap only
+void*  AudioArena_Malloc(size_t size);
+void*  AudioArena_Calloc(size_t n, size_t size);
+void   AudioArena_Free(void* ptr);              // heap blocks are freed, arena blocks are released by reset()
+bool   AudioArena_Owns(const void* ptr);
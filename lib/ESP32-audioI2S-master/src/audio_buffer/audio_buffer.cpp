@@ -0,0 +1,102 @@
+/*
+ *  audio_buffer.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_buffer.h"
+
+AudioBuffer::AudioBuffer(size_t maxBlockSize) {
+    if(maxBlockSize) m_resBuffSizeRAM = maxBlockSize;
+    if(maxBlockSize) m_maxBlockSize = maxBlockSize;
+}
+
+AudioBuffer::~AudioBuffer() {
+    if(m_buffer) free(m_buffer);
+    m_buffer = NULL;
+}
+
+int32_t AudioBuffer::getBufsize() { return m_buffSize; }
+
+void AudioBuffer::setBufsize(size_t mbs) {
+    m_buffSizePSRAM = m_buffSizeRAM = m_buffSize = mbs;
+    return;
+}
+
+size_t AudioBuffer::init() {
+    if(m_buffer) free(m_buffer);
+    m_buffer = NULL;
+    if(m_buffSizePSRAM > 0) { // PSRAM found, AudioBuffer will be allocated in PSRAM
+        m_f_psram = true;
+        m_buffSize = m_buffSizePSRAM;
+        m_buffer = (uint8_t*)ps_calloc(m_buffSize, sizeof(uint8_t));
+        m_buffSize = m_buffSizePSRAM - m_resBuffSizePSRAM;
+    }
+    if(!m_buffer) return 0;
+    m_f_init = true;
+    resetBuffer();
+    return m_buffSize;
+}
+
+void AudioBuffer::changeMaxBlockSize(uint16_t mbs) {
+    m_maxBlockSize = mbs;
+    return;
+}
+
+uint16_t AudioBuffer::getMaxBlockSize() { return m_maxBlockSize; }
+
+size_t AudioBuffer::freeSpace() { return m_buffSize - m_filled.load(std::memory_order_acquire); }
+
+size_t AudioBuffer::writeSpace() { // from m_writePtr up to m_readPtr or to the ring end, whichever comes first
+    size_t space = m_buffSize - m_filled.load(std::memory_order_acquire);
+    size_t toEnd = m_endPtr - m_writePtr;
+    return min(space, toEnd);
+}
+
+size_t AudioBuffer::bufferFilled() { return m_filled.load(std::memory_order_acquire); }
+
+size_t AudioBuffer::getMaxAvailableBytes() { // from m_readPtr up to m_writePtr or to the ring end
+    size_t filled = m_filled.load(std::memory_order_acquire);
+    size_t toEnd = m_endPtr - m_readPtr;
+    return min(filled, toEnd);
+}
+
+void AudioBuffer::bytesWritten(size_t bw) {
+    if(!bw) return;
+    m_writePtr += bw;
+    if(m_writePtr == m_endPtr) { m_writePtr = m_buffer; }
+    if(m_writePtr > m_endPtr) log_e("m_writePtr %p, m_endPtr %p", m_writePtr, m_endPtr);
+    m_filled.fetch_add(bw, std::memory_order_release); // the data before the count
+}
+
+void AudioBuffer::bytesWasRead(size_t br) {
+    if(!br) return;
+    m_readPtr += br;
+    if(m_readPtr >= m_endPtr) {
+        size_t tmp = m_readPtr - m_endPtr;
+        m_readPtr = m_buffer + tmp;
+    }
+    m_filled.fetch_sub(br, std::memory_order_release); // the writer overwrites the space after it has seen the count
+}
+
+uint8_t* AudioBuffer::getWritePtr() { return m_writePtr; }
+
+uint8_t* AudioBuffer::getReadPtr() {
+    size_t len = m_endPtr - m_readPtr;
+    if(len < m_maxBlockSize) { // be sure the last frame is completed, with the bytes the writer has already published
+        size_t filled = m_filled.load(std::memory_order_acquire);
+        if(filled > len) memcpy(m_endPtr, m_buffer, min(m_maxBlockSize - len, filled - len)); // cpy from m_buffer to m_endPtr
+    }
+    return m_readPtr;
+}
+
+void AudioBuffer::resetBuffer() {
+    m_writePtr = m_buffer;
+    m_readPtr = m_buffer;
+    m_endPtr = m_buffer + m_buffSize;
+    m_filled.store(0, std::memory_order_release);
+}
+
+uint32_t AudioBuffer::getWritePos() { return m_writePtr - m_buffer; }
+
+uint32_t AudioBuffer::getReadPos() { return m_readPtr - m_buffer; }
@@ -0,0 +1,82 @@
+/*
+ *  audio_buffer.h
+ *
+ *  The input ring buffer of Audio (InBuff). One writer (the prefetch task, or the audio task while no prefetch runs) and
+ *  one reader (the audio task): each side moves only its own pointer, the number of filled bytes is the only shared
+ *  state. bytesWritten() publishes written bytes with release, bytesWasRead() gives space back the same way, both sides
+ *  load the count with acquire before they touch the data. The reserve behind the ring end (getReadPtr()) is filled
+ *  with published bytes only, the writer may be writing into the beginning of the ring at the same time.
+ *  resetBuffer(), init() and changeMaxBlockSize() only while no writer runs (Audio::stopFilePrefetch()).
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+class AudioBuffer {
+// AudioBuffer will be allocated in PSRAM, If PSRAM not available or has not enough space AudioBuffer will be
+// allocated in FlashRAM with reduced size
+//
+//  m_buffer            m_readPtr                 m_writePtr                 m_endPtr
+//   |                       |<------dataLength------->|<------ writeSpace ----->|
+//   ▼                       ▼                         ▼                         ▼
+//   ---------------------------------------------------------------------------------------------------------------
+//   |                     <--m_buffSize-->                                      |      <--m_resBuffSize -->     |
+//   ---------------------------------------------------------------------------------------------------------------
+//   |<-----freeSpace------->|                         |<------freeSpace-------->|
+//
+//
+//
+//   if the space between m_readPtr and buffend < m_resBuffSize copy data from the beginning to resBuff
+//   so that the mp3/aac/flac frame is always completed
+//
+//  m_buffer                      m_writePtr                 m_readPtr        m_endPtr
+//   |                                 |<-------writeSpace------>|<--dataLength-->|
+//   ▼                                 ▼                         ▼                ▼
+//   ---------------------------------------------------------------------------------------------------------------
+//   |                        <--m_buffSize-->                                    |      <--m_resBuffSize -->     |
+//   ---------------------------------------------------------------------------------------------------------------
+//   |<---  ------dataLength--  ------>|<-------freeSpace------->|
+//
+//
+
+public:
+    AudioBuffer(size_t maxBlockSize = 0);       // constructor
+    ~AudioBuffer();                             // frees the buffer
+    size_t   init();                            // set default values
+    bool     isInitialized() { return m_f_init; };
+    int32_t  getBufsize();
+    void     setBufsize(size_t mbs);            // default is m_buffSizePSRAM for psram, and m_buffSizeRAM without psram
+    void     changeMaxBlockSize(uint16_t mbs);  // is default 1600 for mp3 and aac, set 16384 for FLAC
+    uint16_t getMaxBlockSize();                 // returns maxBlockSize
+    size_t   freeSpace();                       // number of free bytes to overwrite, any task
+    size_t   writeSpace();                      // space fom writepointer to bufferend, writer
+    size_t   bufferFilled();                    // returns the number of filled bytes, any task
+    size_t   getMaxAvailableBytes();            // max readable bytes in one block, reader
+    void     bytesWritten(size_t bw);           // update writepointer, publishes the bytes to the reader
+    void     bytesWasRead(size_t br);           // update readpointer, gives the space back to the writer
+    uint8_t* getWritePtr();                     // returns the current writepointer
+    uint8_t* getReadPtr();                      // returns the current readpointer
+    uint32_t getWritePos();                     // write position relative to the beginning
+    uint32_t getReadPos();                      // read position relative to the beginning
+    void     resetBuffer();                     // restore defaults
+    bool     havePSRAM() { return m_f_psram; };
+
+protected:
+    size_t            m_buffSizePSRAM    = UINT16_MAX * 10;   // most webstreams limit the advance to 100...300Kbytes
+    size_t            m_buffSizeRAM      = 1600 * 10;
+    size_t            m_buffSize         = 0;
+    size_t            m_resBuffSizeRAM   = 4096;     // reserved buffspace, >= one wav  frame
+    size_t            m_resBuffSizePSRAM = 4096 * 6; // reserved buffspace, >= one flac frame
+    size_t            m_maxBlockSize     = 1600;
+    uint8_t*          m_buffer           = NULL;
+    uint8_t*          m_writePtr         = NULL;
+    uint8_t*          m_readPtr          = NULL;
+    uint8_t*          m_endPtr           = NULL;
+    std::atomic<size_t> m_filled         {0};      // bytes in the ring, written by both sides, see above
+    bool              m_f_init           = false;
+    bool              m_f_psram          = false;    // PSRAM is available (and used...)
+};
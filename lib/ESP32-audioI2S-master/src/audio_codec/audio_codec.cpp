@@ -0,0 +1,266 @@
+/*
+ *  audio_codec.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_codec.h"
+
+#if AUDIO_SAMPLE_32
+int32_t AudioCodec::decode32(uint8_t* data, int32_t* bytesLeft, int32_t* out) { // 16 bit decoders
+    int32_t ret = decode(data, bytesLeft, (int16_t*)out);
+    if(ret < 0 || noOutput(ret)) return ret;
+    audioCodecInfo_t info;
+    getInfo(&info);
+    const int16_t* in = (const int16_t*)out;
+    for(int32_t i = (int32_t)(outputFrames() * info.channels) - 1; i >= 0; i--) out[i] = in[i] << AUDIO_SAMPLE_SHIFT; // backwards, in place
+    return ret;
+}
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+
+#if AUDIO_SUPPORT_MP3
+#include "../mp3_decoder/mp3_decoder.h"
+
+class MP3Codec : public AudioCodec {
+public:
+    ~MP3Codec() { release(); }
+    const char* name() override { return "MP3"; }
+    bool        init() override {
+        if(!m_d) m_d = MP3Decoder_New();
+        if(m_d) MP3Decoder_SetQuality(m_d, m_quality);
+        return m_d != nullptr;
+    }
+    bool        isInit() override { return m_d != nullptr; }
+    void        release() override {
+        MP3Decoder_Delete(m_d);
+        m_d = nullptr;
+    }
+    void        reset() override { if(m_d) MP3Decoder_ClearBuffer(m_d); }
+    size_t      stateSize() override { return MP3Decoder_StateSize(); }
+    int32_t     findSync(uint8_t* data, int32_t len) override { return MP3FindSyncWord(data, len); }
+    int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) override { return MP3Decode(m_d, data, bytesLeft, out, 0); }
+    uint32_t    outputFrames() override { return MP3GetChannels(m_d) ? MP3GetOutputSamps(m_d) / MP3GetChannels(m_d) : 0; }
+    bool        frameStart() override { return true; }
+    void        setQuality(uint8_t q) override {
+        m_quality = q;
+        if(m_d) MP3Decoder_SetQuality(m_d, q);
+    }
+    void        bitReservoir(int32_t* begin, int32_t* size) override {
+        *begin = MP3GetMainDataBegin(m_d);
+        *size = MP3GetMainDataSize(m_d);
+    }
+    void        getInfo(audioCodecInfo_t* info) override {
+        *info = audioCodecInfo_t();
+        if(!m_d) return;
+        info->sampleRate = MP3GetSampRate(m_d);
+        info->bitRate = MP3GetBitrate(m_d);
+        info->channels = MP3GetChannels(m_d);
+        info->bitsPerSample = MP3GetBitsPerSample(m_d);
+        info->layer = MP3GetLayer(m_d);
+        info->mpegVersion = MP3GetVersion(m_d);
+    }
+
+private:
+    MP3Decoder_t* m_d = nullptr;
+    uint8_t       m_quality = 0; // MP3_QUALITY_FULL, kept over release() and init()
+};
+AudioCodec* AudioCodec_NewMP3() { return new MP3Codec; }
+#else
+AudioCodec* AudioCodec_NewMP3() { return nullptr; }
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+#if AUDIO_SUPPORT_AAC
+#include "../aac_decoder/aac_decoder.h"
+
+class AACCodec : public AudioCodec {
+public:
+    ~AACCodec() { release(); }
+    const char* name() override { return "AAC"; }
+    bool        init() override {
+        if(!m_d) m_d = AACDecoder_New();
+        return m_d != nullptr;
+    }
+    bool        isInit() override { return m_d != nullptr; }
+    void        release() override {
+        AACDecoder_Delete(m_d);
+        m_d = nullptr;
+    }
+    void        reset() override {}
+    int32_t     findSync(uint8_t* data, int32_t len) override { return AACFindSyncWord(data, len); }
+    int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) override { return AACDecode(m_d, data, bytesLeft, out); }
+    uint32_t    outputFrames() override { return AACGetChannels(m_d) ? AACGetOutputSamps(m_d) / AACGetChannels(m_d) : 0; }
+    void        setRawParams(const audioCodecRaw_t* raw) override {
+        if(m_d) AACSetRawBlockParams(m_d, raw->channels, raw->sampleRate, raw->objectType);
+    }
+    void        getInfo(audioCodecInfo_t* info) override {
+        *info = audioCodecInfo_t();
+        if(!m_d) return;
+        info->sampleRate = AACGetSampRate(m_d);
+        info->bitRate = AACGetBitrate(m_d);
+        info->channels = AACGetChannels(m_d);
+        info->bitsPerSample = AACGetBitsPerSample();
+        info->aacFormat = AACGetFormat(m_d);
+        info->aacSBR = AACGetSBR(m_d);
+        info->aacPS = AACGetParametricStereo(m_d);
+    }
+
+private:
+    AACDecoder_t* m_d = nullptr;
+};
+AudioCodec* AudioCodec_NewAAC() { return new AACCodec; }
+#else
+AudioCodec* AudioCodec_NewAAC() { return nullptr; }
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+#if AUDIO_SUPPORT_FLAC
+#include "../flac_decoder/flac_decoder.h"
+
+class FLACCodec : public AudioCodec {
+public:
+    ~FLACCodec() { release(); }
+    const char* name() override { return "FLAC"; }
+    bool        init() override { // a new stream: the metadata and ogg page state of the last one are cleared
+        if(!m_d) return (m_d = FLACDecoder_New()) != nullptr;
+        FLACDecoder_ClearBuffer(m_d);
+        FLACDecoder_setDefaults(m_d);
+        m_d->pageNr = 0;
+        return true;
+    }
+    void        release() override {
+        FLACDecoder_Delete(m_d);
+        m_d = nullptr;
+    }
+    void        reset() override { if(m_d) FLACDecoderReset(m_d); }
+    void        setDualCore(int8_t core, uint8_t priority) override { if(m_d) FLACDecoder_SetDualCore(m_d, core, priority); }
+    void        setCrcCheck(bool enable, bool repeat) override {
+        if(!m_d) return;
+        FLACDecoder_SetCrcCheck(m_d, enable);
+        FLACDecoder_SetConcealment(m_d, repeat ? FLAC_CONCEAL_REPEAT : FLAC_CONCEAL_SILENCE);
+    }
+    uint32_t    corruptFrames() override { return m_d ? FLACDecoder_CorruptFrames(m_d) : 0; }
+    void        startMD5(const uint8_t* md5) override { if(m_d) FLACDecoder_StartMD5(m_d, md5); }
+    int8_t      md5Result() override { return m_d ? FLACDecoder_MD5Result(m_d) : (int8_t)FLAC_MD5_NONE; }
+    size_t      stateSize() override { return FLACDecoder_StateSize(); }
+    int32_t     findSync(uint8_t* data, int32_t len) override { return m_d ? FLACFindSyncWord(m_d, data, len) : -1; }
+    int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) override { return FLACDecode(m_d, data, bytesLeft, out); }
+#if AUDIO_SAMPLE_32
+    int32_t     decode32(uint8_t* data, int32_t* bytesLeft, int32_t* out) override { return FLACDecode32(m_d, data, bytesLeft, out); }
+#endif
+    bool        noOutput(int32_t ret) override { return ret == FLAC_PARSE_OGG_DONE; }
+    uint32_t    outputFrames() override { return FLACGetChannels(m_d) ? FLACGetOutputSamps(m_d) / FLACGetChannels(m_d) : 0; }
+    bool        frameStart() override { return FLACGetFrameStart(m_d); }
+    char*       streamTitle() override { return FLACgetStreamTitle(m_d); }
+    std::vector<uint32_t> metadataBlockPicture() override { return FLACgetMetadataBlockPicture(m_d); }
+    void        setRawParams(const audioCodecRaw_t* raw) override {
+        if(m_d) FLACSetRawBlockParams(m_d, raw->channels, raw->sampleRate, raw->bitsPerSample, raw->totalSamples, raw->audioDataSize);
+    }
+    void        getInfo(audioCodecInfo_t* info) override {
+        *info = audioCodecInfo_t();
+        if(!m_d) return;
+        info->sampleRate = FLACGetSampRate(m_d);
+        info->bitRate = FLACGetBitRate(m_d);
+        info->audioDataStart = FLACGetAudioDataStart(m_d);
+        info->duration = FLACGetAudioFileDuration(m_d);
+        info->channels = FLACGetChannels(m_d);
+        info->bitsPerSample = FLACGetBitsPerSample(m_d);
+    }
+
+private:
+    FLACDecoder_t* m_d = nullptr;
+};
+AudioCodec* AudioCodec_NewFLAC() { return new FLACCodec; }
+#else
+AudioCodec* AudioCodec_NewFLAC() { return nullptr; }
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+#if AUDIO_SUPPORT_OPUS
+#include "../opus_decoder/opus_decoder.h"
+
+class OPUSCodec : public AudioCodec { // the decoder state is file global: one instance at a time
+public:
+    static bool s_f_exists;
+    OPUSCodec() { s_f_exists = true; }
+    ~OPUSCodec() {
+        release();
+        s_f_exists = false;
+    }
+    const char* name() override { return "OPUS"; }
+    bool        init() override { return OPUSDecoder_AllocateBuffers(); }
+    void        release() override { OPUSDecoder_FreeBuffers(); }
+    void        reset() override { OPUSDecoder_ClearBuffers(); }
+    size_t      stateSize() override { return OPUSDecoder_StateSize(); }
+    int32_t     findSync(uint8_t* data, int32_t len) override { return OPUSFindSyncWord(data, len); }
+    int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) override { return OPUSDecode(data, bytesLeft, out); }
+    bool        noOutput(int32_t ret) override { return ret == OPUS_PARSE_OGG_DONE || ret == OPUS_END; }
+    uint32_t    outputFrames() override { return OPUSGetOutputSamps(); }
+    char*       streamTitle() override { return OPUSgetStreamTitle(); }
+    std::vector<uint32_t> metadataBlockPicture() override { return OPUSgetMetadataBlockPicture(); }
+    void        getInfo(audioCodecInfo_t* info) override {
+        *info = audioCodecInfo_t();
+        info->sampleRate = OPUSGetSampRate();
+        info->bitRate = OPUSGetBitRate();
+        info->audioDataStart = OPUSGetAudioDataStart();
+        info->channels = OPUSGetChannels();
+        info->bitsPerSample = OPUSGetBitsPerSample();
+    }
+};
+bool        OPUSCodec::s_f_exists = false;
+AudioCodec* AudioCodec_NewOPUS() { return OPUSCodec::s_f_exists ? nullptr : new OPUSCodec; }
+#else
+AudioCodec* AudioCodec_NewOPUS() { return nullptr; }
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+#if AUDIO_SUPPORT_VORBIS
+#include "../vorbis_decoder/vorbis_decoder.h"
+
+class VORBISCodec : public AudioCodec { // the decoder state is file global: one instance at a time
+public:
+    static bool s_f_exists;
+    VORBISCodec() { s_f_exists = true; }
+    ~VORBISCodec() {
+        release();
+        s_f_exists = false;
+    }
+    const char* name() override { return "VORBIS"; }
+    bool        init() override { return VORBISDecoder_AllocateBuffers(); }
+    void        release() override { VORBISDecoder_FreeBuffers(); }
+    void        reset() override { VORBISDecoder_ClearBuffers(); }
+    size_t      stateSize() override { return VORBISDecoder_StateSize(); }
+    int32_t     findSync(uint8_t* data, int32_t len) override { return VORBISFindSyncWord(data, len); }
+    int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) override { return VORBISDecode(data, bytesLeft, out); }
+    bool        noOutput(int32_t ret) override { return ret == VORBIS_PARSE_OGG_DONE; }
+    uint32_t    outputFrames() override { return VORBISGetOutputSamps(); }
+    char*       streamTitle() override { return VORBISgetStreamTitle(); }
+    std::vector<uint32_t> metadataBlockPicture() override { return VORBISgetMetadataBlockPicture(); }
+    void        getInfo(audioCodecInfo_t* info) override {
+        *info = audioCodecInfo_t();
+        info->sampleRate = VORBISGetSampRate();
+        info->bitRate = VORBISGetBitRate();
+        info->audioDataStart = VORBISGetAudioDataStart();
+        info->channels = VORBISGetChannels();
+        info->bitsPerSample = VORBISGetBitsPerSample();
+    }
+};
+bool        VORBISCodec::s_f_exists = false;
+AudioCodec* AudioCodec_NewVORBIS() { return VORBISCodec::s_f_exists ? nullptr : new VORBISCodec; }
+#else
+AudioCodec* AudioCodec_NewVORBIS() { return nullptr; }
+#endif
+//----------------------------------------------------------------------------------------------------------------------
+size_t AudioCodec_MaxStateSize() { // without instances, the Audio constructor sizes the arena before any decoder exists
+    size_t size = 0;
+#if AUDIO_SUPPORT_MP3
+    if(MP3Decoder_StateSize() > size) size = MP3Decoder_StateSize();
+#endif
+#if AUDIO_SUPPORT_FLAC
+    if(FLACDecoder_StateSize() > size) size = FLACDecoder_StateSize();
+#endif
+#if AUDIO_SUPPORT_OPUS
+    if(OPUSDecoder_StateSize() > size) size = OPUSDecoder_StateSize();
+#endif
+#if AUDIO_SUPPORT_VORBIS
+    if(VORBISDecoder_StateSize() > size) size = VORBISDecoder_StateSize();
+#endif
+    return size; // AAC: libfaad allocates from the heap
+}
@@ -0,0 +1,99 @@
+/*
+ *  audio_codec.h
+ *
+ *  Common interface of the decoders. Audio looks the decoder up once per stream (Audio::decoderOf()), per frame there
+ *  is one virtual call instead of a switch over the codec. An AudioCodec owns the state of its decoder: each Audio
+ *  object creates its own with AudioCodec_NewMP3() ... and deletes them, two objects (or a test on the host) decode
+ *  side by side. Opus and Vorbis still keep their state in file globals, their factory hands out one instance at a
+ *  time and returns nullptr while it exists.
+ *  The decoders are chosen at compile time with -DAUDIO_SUPPORT_MP3=0/1 (AAC, FLAC, OPUS, VORBIS) in platformio.ini:
+ *  the factory of a disabled decoder returns nullptr, nothing references its code and the linker (--gc-sections) drops
+ *  it together with its tables, the arena is sized for the enabled decoders only.
+ *  With -DAUDIO_SAMPLE_32=1 Audio calls decode32(), the default widens the 16 bit output of decode() in place.
+ *  This header has no Arduino or FS dependency.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "../output_stage/audio_sample.h"
+
+#ifndef AUDIO_SUPPORT_MP3
+#define AUDIO_SUPPORT_MP3    1
+#endif
+#ifndef AUDIO_SUPPORT_AAC
+#define AUDIO_SUPPORT_AAC    1 // aac, m4a and aac in ts (m3u8)
+#endif
+#ifndef AUDIO_SUPPORT_FLAC
+#define AUDIO_SUPPORT_FLAC   1 // native and ogg
+#endif
+#ifndef AUDIO_SUPPORT_OPUS
+#define AUDIO_SUPPORT_OPUS   1
+#endif
+#ifndef AUDIO_SUPPORT_VORBIS
+#define AUDIO_SUPPORT_VORBIS 1
+#endif
+
+typedef struct {
+    uint32_t sampleRate;
+    uint32_t bitRate;
+    uint32_t audioDataStart; // ogg: first audio page, 0 if the container parser knows it
+    uint32_t duration;       // s, 0 if unknown
+    uint8_t  channels;
+    uint8_t  bitsPerSample;
+    uint8_t  layer;          // mp3: 1...3
+    uint8_t  mpegVersion;    // mp3: 0 MPEG-1, 1 MPEG-2, 2 MPEG-2.5
+    uint8_t  aacFormat;      // aac: 0 raw, 1 ADIF, 2 ADTS
+    uint8_t  aacSBR;         // aac: 0 no SBR, 1 upsampled, 2 downsampled, 3 no SBR but upsampled
+    uint8_t  aacPS;          // aac: parametric stereo
+} audioCodecInfo_t;
+
+typedef struct {             // from the container, the frames have no stream header of their own (m4a, native flac)
+    uint32_t sampleRate;
+    uint32_t totalSamples;   // flac: STREAMINFO, per channel
+    uint32_t audioDataSize;  // flac: bytes of the frames
+    uint8_t  channels;
+    uint8_t  bitsPerSample;  // flac
+    uint8_t  objectType;     // aac: 1 main, 2 LC, 3 SSR, 4 LTP
+} audioCodecRaw_t;
+
+class AudioCodec {
+public:
+    virtual ~AudioCodec() {}
+    virtual const char* name() = 0;
+    virtual bool        init() = 0;                   // allocates the buffers of this instance
+    virtual bool        isInit() { return false; }    // buffers are kept between streams of the same codec
+    virtual void        release() = 0;                // frees the buffers
+    virtual void        reset() = 0;                  // new file position, the stream parameters are kept
+    virtual size_t      stateSize() { return 0; }     // bytes taken from the arena by init()
+    virtual int32_t     findSync(uint8_t* data, int32_t len) = 0;                       // offset of the next frame, -1: not found
+    virtual int32_t     decode(uint8_t* data, int32_t* bytesLeft, int16_t* out) = 0;    // 0 or > 0: ok, < 0: error
+#if AUDIO_SAMPLE_32
+    virtual int32_t     decode32(uint8_t* data, int32_t* bytesLeft, int32_t* out);      // the same, 24 bit samples in 32 bit
+#endif
+    virtual bool        noOutput(int32_t ret) { (void)ret; return false; }              // decode() read a header page, nothing to play
+    virtual uint32_t    outputFrames() = 0;           // frames (samples per channel) of the last decode()
+    virtual void        getInfo(audioCodecInfo_t* info) = 0;
+    virtual void        setRawParams(const audioCodecRaw_t* raw) { (void)raw; } // m4a, native flac, after init()
+    virtual bool        frameStart() { return false; } // the last decode() started at a frame header (seek index)
+    virtual void        setQuality(uint8_t q) { (void)q; } // MP3_QUALITY_xxx, reduced decode modes of the mp3 decoder
+    virtual void        setDualCore(int8_t core, uint8_t priority) { (void)core; (void)priority; } // FLAC: worker task, -1: off
+    virtual void        setCrcCheck(bool enable, bool repeat) { (void)enable; (void)repeat; } // FLAC: frame CRCs, concealment
+    virtual uint32_t    corruptFrames() { return 0; }                                  // FLAC: concealed since setRawParams()
+    virtual void        startMD5(const uint8_t* md5) { (void)md5; }                    // FLAC: STREAMINFO MD5, nullptr: off
+    virtual int8_t      md5Result() { return 0; }                                      // FLAC: FLAC_MD5_xxx at the end
+    virtual void        bitReservoir(int32_t* begin, int32_t* size) { *begin = -1; *size = 0; } // mp3 main data
+    virtual char*       streamTitle() { return nullptr; }                               // ogg comment, once
+    virtual std::vector<uint32_t> metadataBlockPicture() { return std::vector<uint32_t>(); } // ogg pictures, once
+};
+
+AudioCodec* AudioCodec_NewMP3();    // a new instance (delete it), nullptr if the decoder is not compiled in
+AudioCodec* AudioCodec_NewAAC();
+AudioCodec* AudioCodec_NewFLAC();
+AudioCodec* AudioCodec_NewOPUS();   // one at a time, nullptr while the other one exists
+AudioCodec* AudioCodec_NewVORBIS(); // one at a time
+size_t      AudioCodec_MaxStateSize(); // largest stateSize() of the compiled decoders, arena size
@@ -0,0 +1,103 @@
+/*
+ *  audio_dsp.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_dsp.h"
+#include <math.h>
+#include <string.h>
+
+#if AUDIO_SAMPLE_32
+typedef int64_t dsp_sum_t; // two samples in the headroom overflow 32 bit
+#else
+typedef int32_t dsp_sum_t;
+#endif
+
+AudioDsp::AudioDsp() {
+    for(int n = 0; n < 3; n++) m_filter[n] = {1, 0, 0, 0, 0}; // flat
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioDsp::setFilters(const audioBiquad_t f[3]) { memcpy(m_filter, f, sizeof(m_filter)); }
+
+void AudioDsp::clearFilters() { memset(m_mem, 0, sizeof(m_mem)); }
+//----------------------------------------------------------------------------------------------------------------------
+void AudioDsp::filter(audio_sample_t* buff, uint32_t frames, uint8_t channels, bool forceMono) {
+    enum : uint8_t { z1 = 0, z2 = 1, in = 0, out = 1 };
+    for(uint32_t i = 0; i < frames; i++) {
+        for(uint8_t ch = 0; ch < channels; ch++) { // the channels are independent, one after the other
+            audio_sample_t s = buff[ch];
+            for(int n = 0; n < 3; n++) {
+                float (*m)[2][2] = m_mem[n];
+                float inSample = (float)s;
+                float outSample = m_filter[n].a0 * inSample + m_filter[n].a1 * m[z1][in][ch] + m_filter[n].a2 * m[z2][in][ch] -
+                                  m_filter[n].b1 * m[z1][out][ch] - m_filter[n].b2 * m[z2][out][ch];
+                m[z2][in][ch] = m[z1][in][ch];
+                m[z1][in][ch] = inSample;
+                m[z2][out][ch] = m[z1][out][ch];
+                m[z1][out][ch] = outSample;
+                s = (audio_sample_t)outSample;
+            }
+            buff[ch] = s;
+        }
+        if(forceMono && channels == 2) {
+            audio_sample_t xy = (audio_sample_t)(((dsp_sum_t)buff[0] + buff[1]) / 2);
+            buff[0] = xy;
+            buff[1] = xy;
+        }
+        buff += channels;
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+size_t AudioDsp::resample(const audio_sample_t* in, size_t frames, uint8_t channels, audio_sample_t* out) {
+    float  exactOutputFrames = frames * m_ratio;
+    size_t outputFrames = static_cast<size_t>(floorf(exactOutputFrames + m_error));
+    m_error += exactOutputFrames - outputFrames;
+
+    for(size_t i = 0; i < outputFrames; ++i) {
+        float  inFramePos = i / m_ratio;
+        size_t idx = static_cast<size_t>(inFramePos);
+        float  frac = inFramePos - idx;
+
+        size_t i1 = idx * channels;
+        size_t i2 = (idx + 1 < frames) ? (idx + 1) * channels : i1;
+
+        audio_sample_t left1 = in[i1];
+        audio_sample_t left2 = in[i2];
+        out[i * 2] = static_cast<audio_sample_t>(left1 * (1.0f - frac) + left2 * frac);
+        if(channels == 1) {out[i * 2 + 1] = out[i * 2]; continue;}
+
+        audio_sample_t right1 = in[i1 + 1];
+        audio_sample_t right2 = in[i2 + 1];
+        out[i * 2 + 1] = static_cast<audio_sample_t>(right1 * (1.0f - frac) + right2 * frac);
+    }
+    return outputFrames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int16_t* AudioDsp::toPcm16(audio_sample_t* buff, uint32_t frames, uint8_t channels) {
+#if AUDIO_SAMPLE_32
+    int16_t* pcm = (int16_t*)buff; // rounded and saturated, sample i is written behind the ones it is read from
+    uint32_t step = (channels == 1) ? 2 : 1;
+    for(uint32_t i = 0; i < frames * channels; i++) {
+        int32_t s = (buff[i * step] + (1 << (AUDIO_SAMPLE_SHIFT - 1))) >> AUDIO_SAMPLE_SHIFT;
+        pcm[i] = (s > 32767) ? 32767 : (s < -32768) ? -32768 : s;
+    }
+    return pcm;
+#else
+    if(channels == 1) for(uint32_t i = 0; i < frames; i++) buff[i] = buff[2 * i];
+    return buff;
+#endif
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioDsp::widenPcm16(audio_sample_t* blk, const int16_t* src, uint32_t frames, uint8_t channels) {
+#if AUDIO_SAMPLE_32
+    for(uint32_t i = 0; i < frames; i++) { // forwards, the 32 bit frame i ends before the 16 bit frame i + 1
+        audio_sample_t l = src[i * channels] << AUDIO_SAMPLE_SHIFT;
+        audio_sample_t r = src[i * channels + channels - 1] << AUDIO_SAMPLE_SHIFT;
+        blk[2 * i] = l;
+        blk[2 * i + 1] = r;
+    }
+#else
+    if(channels == 1) for(uint32_t i = 0; i < frames; i++) {int16_t s = src[i]; blk[2 * i] = s; blk[2 * i + 1] = s;}
+#endif
+}
@@ -0,0 +1,51 @@
+/*
+ *  audio_dsp.h
+ *
+ *  The sample processing of Audio between the decoder and the output stage, on audio_sample_t (16 bit, or 24 bit with 8
+ *  bits of headroom with AUDIO_SAMPLE_32):
+ *  - the three tone filters of setTone() (low shelf, peak EQ, high shelf), biquads in float, the level correction is
+ *    folded into the first one. Mono is filtered once per frame with the memory of the left channel.
+ *  - forceMono of stereo sources
+ *  - the linear resampler to 48 kHz, mono is interleaved to stereo here and not before
+ *  - the 16 bit conversions of the paths behind the resampler: the PCM cache of renderToFile() and the direct PCM blocks
+ *  The arithmetic is the one of the former IIR_filterChain0..2() and resampleTo48kStereo() of Audio.
+ *  No Arduino dependency.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../output_stage/audio_sample.h"
+
+typedef struct {
+    float a0, a1, a2; // feed forward
+    float b1, b2;     // feedback
+} audioBiquad_t;
+
+class AudioDsp {
+public:
+    AudioDsp();
+    void     setFilters(const audioBiquad_t f[3]);                            // low shelf, peak EQ, high shelf
+    void     clearFilters();                                                  // the filter memory, not the coefficients
+    void     filter(audio_sample_t* buff, uint32_t frames, uint8_t channels, bool forceMono); // in place
+    void     setResampleRatio(float ratio) { m_ratio = ratio; }               // 48000 / source rate
+    size_t   resample(const audio_sample_t* in, size_t frames, uint8_t channels, audio_sample_t* out); // -> 48kHz stereo
+
+    // the 48kHz stereo frames of resample() as 16 bit in place, mono: the left channel only. Returns 'buff'
+    static int16_t* toPcm16(audio_sample_t* buff, uint32_t frames, uint8_t channels);
+    // direct PCM: the 16 bit frames are read to pcm16Tail() of a block of 'frames' stereo frames and widened in place,
+    // 'src' may lie further back (fewer frames than asked for were read)
+    static int16_t* pcm16Tail(audio_sample_t* blk, uint32_t frames, uint8_t channels) {
+        return (int16_t*)(blk + 2 * frames) - frames * channels;
+    }
+    static void     widenPcm16(audio_sample_t* blk, const int16_t* src, uint32_t frames, uint8_t channels);
+
+private:
+    audioBiquad_t m_filter[3];
+    float         m_mem[3][2][2][2] = {}; // [filter][z1, z2][in, out][left, right]
+    float         m_ratio = 1.0f;
+    float         m_error = 0.0f;         // fraction of an output frame carried to the next call
+};
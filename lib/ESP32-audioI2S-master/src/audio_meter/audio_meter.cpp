@@ -0,0 +1,180 @@
+/*
+ *  audio_meter.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_meter.h"
+#include <math.h>
+#include <string.h>
+
+static const uint8_t s_bandEdge[AUDIO_METER_BANDS + 1] = {1, 2, 4, 8, 16, 32, 64, 96, 128}; // FFT bins
+
+AudioMeter::AudioMeter() {
+    const float pi = 3.14159265f;
+    for(int i = 0; i < AUDIO_METER_FFT; i++) m_window[i] = 0.5f - 0.5f * cosf(2 * pi * i / AUDIO_METER_FFT);
+    for(int i = 0; i < AUDIO_METER_FFT / 2; i++) {
+        m_cos[i] = cosf(2 * pi * i / AUDIO_METER_FFT);
+        m_sin[i] = sinf(2 * pi * i / AUDIO_METER_FFT);
+    }
+    reset();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMeter::reset() {
+    m_frames = 0;
+    m_peak[0] = m_peak[1] = 0;
+    m_sumSq[0] = m_sumSq[1] = 0;
+    m_decimSum = 0;
+    m_fftPos = 0;
+    memset(m_re, 0, sizeof(m_re));
+    publish(); // silence
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline int32_t level(int16_t s) { return s; }
+static inline int32_t level(int32_t s) { return s >> 8; } // 24 bit -> 16 bit scale
+
+// the 32 bit samples are taken before the gain stage, with 8 bits of headroom |level()| reaches 2^23
+template <typename T> static inline uint64_t square(int32_t v) { return (uint64_t)((int64_t)v * v); }
+template <> inline uint64_t square<int16_t>(int32_t v) { return (uint32_t)(v * v); } // |v| <= 2^15, 32 bit multiply
+
+template <typename T>
+void AudioMeter::accumulate(const T* buff, uint32_t frames) {
+    while(frames) {
+        uint32_t n = AUDIO_METER_FRAMES - m_frames;
+        if(n > frames) n = frames;
+        // local accumulators, the loop body has no stores to members and no branches except the peaks
+        uint32_t pl = m_peak[0], pr = m_peak[1];
+        uint64_t sl = 0, sr = 0;
+        int32_t  decim = m_decimSum;
+        uint32_t pos = m_frames;
+        for(uint32_t i = 0; i < n; i++) {
+            int32_t l = level(buff[2 * i]);
+            int32_t r = level(buff[2 * i + 1]);
+            uint32_t al = l < 0 ? -l : l;
+            uint32_t ar = r < 0 ? -r : r;
+            if(al > pl) pl = al;
+            if(ar > pr) pr = ar;
+            sl += square<T>(l);
+            sr += square<T>(r);
+            decim += l + r;
+            if(((pos + i) & (AUDIO_METER_DECIM - 1)) == AUDIO_METER_DECIM - 1) {
+                m_re[m_fftPos++] = (float)decim * (1.0f / (2 * AUDIO_METER_DECIM));
+                decim = 0;
+            }
+        }
+        m_peak[0] = pl > 0xFFFF ? 0xFFFF : pl;
+        m_peak[1] = pr > 0xFFFF ? 0xFFFF : pr;
+        m_sumSq[0] += sl;
+        m_sumSq[1] += sr;
+        m_decimSum = decim;
+        m_frames += n;
+        buff += 2 * n;
+        frames -= n;
+        if(m_frames == AUDIO_METER_FRAMES) {
+            fft();
+            publish();
+            m_frames = 0;
+            m_peak[0] = m_peak[1] = 0;
+            m_sumSq[0] = m_sumSq[1] = 0;
+            m_decimSum = 0;
+            m_fftPos = 0;
+        }
+    }
+}
+
+void AudioMeter::process(const int16_t* buff, uint32_t frames) { accumulate(buff, frames); }
+
+void AudioMeter::process(const int32_t* buff, uint32_t frames) { accumulate(buff, frames); }
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMeter::fft() { // the real input as a complex FFT of half the size, m_re: windowed input -> bins 0 ... N/2 - 1
+    const int n = AUDIO_METER_FFT / 2;
+    for(int i = 0; i < n; i++) { // even samples -> real part, odd samples -> imaginary part
+        float e = m_re[2 * i] * m_window[2 * i];
+        m_im[i] = m_re[2 * i + 1] * m_window[2 * i + 1];
+        m_re[i] = e;
+    }
+    for(int i = 1, j = 0; i < n; i++) { // bit reversal
+        int bit = n >> 1;
+        for(; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if(i < j) {
+            float t = m_re[i];
+            m_re[i] = m_re[j];
+            m_re[j] = t;
+            t = m_im[i];
+            m_im[i] = m_im[j];
+            m_im[j] = t;
+        }
+    }
+    for(int len = 2; len <= n; len <<= 1) {
+        int step = AUDIO_METER_FFT / len; // the tables are made for AUDIO_METER_FFT points
+        for(int i = 0; i < n; i += len) {
+            for(int k = 0; k < len / 2; k++) {
+                float wr = m_cos[k * step], wi = -m_sin[k * step];
+                int   a = i + k, b = i + k + len / 2;
+                float tr = m_re[b] * wr - m_im[b] * wi;
+                float ti = m_re[b] * wi + m_im[b] * wr;
+                m_re[b] = m_re[a] - tr;
+                m_im[b] = m_im[a] - ti;
+                m_re[a] += tr;
+                m_im[a] += ti;
+            }
+        }
+    }
+    // Z = FFT(even + i odd): X[k] = E[k] + W^k O[k], E = (Z[k] + conj Z[n-k]) / 2, O = (Z[k] - conj Z[n-k]) / 2i,
+    // X[n - k] = conj(E[k] - W^k O[k])
+    m_re[0] += m_im[0];
+    m_im[0] = 0;
+    for(int k = 1; k <= n / 2; k++) {
+        int   m = n - k;
+        float er = (m_re[k] + m_re[m]) * 0.5f, ei = (m_im[k] - m_im[m]) * 0.5f;
+        float or_ = (m_im[k] + m_im[m]) * 0.5f, oi = (m_re[m] - m_re[k]) * 0.5f;
+        float wr = m_cos[k], wi = -m_sin[k];
+        float tr = or_ * wr - oi * wi, ti = or_ * wi + oi * wr;
+        m_re[k] = er + tr;
+        m_im[k] = ei + ti;
+        m_re[m] = er - tr;
+        m_im[m] = -(ei - ti);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioMeter::publish() {
+    // full scale sine through the hann window: |X| = 32767 * N / 4 in the peak bin, 1.5 times that energy over 3 bins
+    const float ref = 1.5f * (32767.0f * AUDIO_METER_FFT / 4) * (32767.0f * AUDIO_METER_FFT / 4);
+    uint8_t bands[AUDIO_METER_BANDS];
+    for(int b = 0; b < AUDIO_METER_BANDS; b++) {
+        float e = 0;
+        if(m_frames) for(int k = s_bandEdge[b]; k < s_bandEdge[b + 1]; k++) e += m_re[k] * m_re[k] + m_im[k] * m_im[k];
+        float db = e > 0 ? 10 * log10f(e / ref) : -AUDIO_METER_RANGE;
+        if(db < -AUDIO_METER_RANGE) db = -AUDIO_METER_RANGE;
+        if(db > 0) db = 0;
+        bands[b] = (uint8_t)((db + AUDIO_METER_RANGE) * 255 / AUDIO_METER_RANGE);
+    }
+    uint16_t rms[2];
+    for(int c = 0; c < 2; c++) {
+        float v = m_frames ? sqrtf((float)m_sumSq[c] / m_frames) : 0;
+        rms[c] = v > 0xFFFF ? 0xFFFF : (uint16_t)v; // above full scale in the headroom of AUDIO_SAMPLE_32
+    }
+
+    uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed); // odd: being written
+    std::atomic_thread_fence(std::memory_order_release);
+    m_snap.peak[0] = m_frames ? m_peak[0] : 0;
+    m_snap.peak[1] = m_frames ? m_peak[1] : 0;
+    m_snap.rms[0] = rms[0];
+    m_snap.rms[1] = rms[1];
+    memcpy(m_snap.bands, bands, sizeof(bands));
+    m_snap.blocks++;
+    m_seq.store(seq + 2, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioMeter::read(audioMeter_t* m) {
+    for(int tries = 0; tries < 8; tries++) {
+        uint32_t seq = m_seq.load(std::memory_order_acquire);
+        if(seq & 1) continue; // the audio task is writing
+        memcpy(m, (const void*)&m_snap, sizeof(audioMeter_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_seq.load(std::memory_order_relaxed) == seq) return true;
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+/*
+ *  audio_meter.h
+ *
+ *  Level meter of the 48kHz output, fed once per resampled chunk instead of once per frame. Every AUDIO_METER_FRAMES
+ *  frames (21ms) it publishes peak and RMS per channel and the energy of 8 octave bands. The bands come from a 256 point
+ *  FFT of the mid signal, decimated by 4 (12kHz, 47Hz per bin, 47Hz ... 6kHz), a real FFT run as a complex one of 128
+ *  points.
+ *  The writer is the audio task, readers (loop, LEDs) get a consistent copy through a sequence counter without a mutex:
+ *  the counter is odd while a snapshot is written, a reader retries when it changed during the copy.
+ *  No Arduino dependency.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define AUDIO_METER_FRAMES 1024 // 48kHz stereo frames per snapshot
+#define AUDIO_METER_DECIM  4    // frames per FFT sample
+#define AUDIO_METER_FFT    (AUDIO_METER_FRAMES / AUDIO_METER_DECIM)
+#define AUDIO_METER_BANDS  8
+#define AUDIO_METER_RANGE  72   // dB, band value 0: -72dBFS or less, 255: full scale sine
+
+typedef struct {
+    uint16_t peak[2];                  // largest absolute sample, left / right
+    uint16_t rms[2];
+    uint8_t  bands[AUDIO_METER_BANDS]; // 47 ... 94Hz, ... 4.5 ... 6kHz, logarithmic
+    uint32_t blocks;                   // number of published snapshots, changes with every snapshot
+} audioMeter_t;
+
+class AudioMeter {
+public:
+    AudioMeter();
+    void process(const int16_t* buff, uint32_t frames); // interleaved stereo
+    void process(const int32_t* buff, uint32_t frames); // interleaved stereo, 24 bit samples (AUDIO_SAMPLE_32)
+    void reset();                                       // publishes silence
+    bool read(audioMeter_t* m);                         // false if no consistent copy could be taken
+
+private:
+    friend struct AudioMeterTest; // test/test_audio_meter.cpp, drives the sequence counter
+    template <typename T> void accumulate(const T* buff, uint32_t frames);
+    void publish();
+    void fft();
+
+    uint32_t m_frames = 0;                      // frames in the current block
+    uint16_t m_peak[2] = {0};
+    uint64_t m_sumSq[2] = {0};
+    int32_t  m_decimSum = 0;                    // mid samples of the current FFT sample
+    uint16_t m_fftPos = 0;
+    float    m_re[AUDIO_METER_FFT];
+    float    m_im[AUDIO_METER_FFT];
+    float    m_window[AUDIO_METER_FFT];         // hann
+    float    m_cos[AUDIO_METER_FFT / 2];
+    float    m_sin[AUDIO_METER_FFT / 2];
+
+    audioMeter_t          m_snap = {};
+    std::atomic<uint32_t> m_seq{0};
+};
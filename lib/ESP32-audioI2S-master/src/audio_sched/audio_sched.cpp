@@ -0,0 +1,44 @@
+/*
+ *  audio_sched.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_sched.h"
+
+void AudioSched::begin(uint8_t capacity, uint8_t target) {
+    m_capacity = capacity ? capacity : 1;
+    if(!target || target > m_capacity) target = m_capacity;
+    m_base = target;
+    m_target = target;
+    m_f_filled = false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool AudioSched::more(uint8_t level, uint8_t done) {
+    if(level >= m_target) return false;
+    uint32_t batch = 1 + (m_target - level) / 2; // one frame fills one or more blocks
+    if(batch > AUDIO_SCHED_MAX_BATCH) batch = AUDIO_SCHED_MAX_BATCH;
+    return done < batch;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t AudioSched::waitMs(uint8_t level, bool progress, uint32_t blockMs) {
+    if(progress && level >= m_target) return blockMs ? blockMs : 1; // woken up by the DMA when a block has been sent
+    return 1; // behind or no input, one tick: the idle task of the core must run (task watchdog)
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSched::observe(uint8_t before, uint8_t after) {
+    if(m_f_filled) { // not at the start of the stream or while refilling to a raised target
+        if(before < m_minLevel) m_minLevel = before;
+        if(before <= 1 && m_target < m_capacity) { // close to an underrun, keep more audio ahead
+            m_target++;
+            m_raises++;
+            m_f_filled = false;
+        }
+    }
+    if(after >= m_target) m_f_filled = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void AudioSched::resetStats() {
+    m_minLevel = 0xFF;
+    m_raises = 0;
+}
@@ -0,0 +1,43 @@
+/*
+ *  audio_sched.h
+ *
+ *  Fill level controller of the audio task. The level is the number of output blocks with audio (pool + DMA), the task
+ *  decodes until the level reaches the target and then sleeps until the DMA has sent a block, instead of waking up
+ *  every millisecond. Below the target the number of frames per pass grows with the deficit: a task that was held off
+ *  by the loop (display flush, LEDs, SD card) catches up in one pass instead of one frame per tick.
+ *  Once the target was reached, a level of one block or less before a pass (the lowest level the DMA has seen since the
+ *  previous pass) raises the target by one block (up to the capacity),
+ *  begin() restores the configured target, restart() at the end of a stream (the next one starts empty).
+ *  Without input (InBuff empty) the task polls once per tick.
+ *  No Arduino dependency, the controller can be driven by a simulation on the host.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AUDIO_SCHED_MAX_BATCH 8 // frames per pass, the mutex is held that long
+
+class AudioSched {
+public:
+    void     begin(uint8_t capacity, uint8_t target);                 // blocks, target 0: capacity
+    bool     more(uint8_t level, uint8_t done);                       // decode another frame in this pass?
+    uint32_t waitMs(uint8_t level, bool progress, uint32_t blockMs);  // sleep after the pass, a DMA event ends it earlier
+    void     observe(uint8_t before, uint8_t after);                  // once per pass while playing, level before / after the batch
+    void     restart() { m_f_filled = false; }                        // new stream, the output is empty
+    uint8_t  target() { return m_target; }
+    uint8_t  minLevel() { return m_minLevel; }
+    uint32_t raises() { return m_raises; }
+    void     resetStats();
+
+private:
+    uint8_t  m_capacity = 1;
+    uint8_t  m_base = 1;     // configured target
+    uint8_t  m_target = 1;   // current target, >= m_base
+    uint8_t  m_minLevel = 0xFF;
+    uint32_t m_raises = 0;   // target raised after a near underrun
+    bool     m_f_filled = false; // the target has been reached in this stream
+};
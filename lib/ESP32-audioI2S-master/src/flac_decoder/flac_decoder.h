@@ -18,6 +18,9 @@
 
 #include "Arduino.h"
 #include <vector>
+#include "../audio_arena/audio_arena.h"
+#include "../sync_scan/sync_scan.h"
+#include "esp_rom_md5.h"
 using namespace std;
 
 #define MAX_CHANNELS 2
@@ -45,7 +48,12 @@ enum : int8_t  {FLAC_PARSE_OGG_DONE = 100,
                 ERR_FLAC_DECODER_ASYNC = -12,
                 ERR_FLAC_UNIMPLEMENTED = -13,
                 ERR_FLAC_BITREADER_UNDERFLOW = -14,
-                ERR_FLAC_OUTBUFFER_TOO_SMALL = -15};
+                ERR_FLAC_OUTBUFFER_TOO_SMALL = -15,
+                ERR_FLAC_NEGATIVE_LPC_SHIFT = -16,
+                ERR_FLAC_HEADER_CRC = -17,
+                ERR_FLAC_FRAME_CRC = -18};
+enum : int8_t  {FLAC_MD5_WRONG = -1, FLAC_MD5_NONE = 0, FLAC_MD5_OK = 1, FLAC_MD5_RUNNING = 2};
+enum : uint8_t {FLAC_CONCEAL_SILENCE = 0, FLAC_CONCEAL_REPEAT = 1}; // FLACDecoder_SetConcealment()
 
 typedef struct FLACMetadataBlock_t{
                               // METADATA_BLOCK_STREAMINFO
@@ -148,23 +156,145 @@ typedef struct FLACFrameHeader_t {
 
 }FLACFrameHeader_t;
 
+typedef struct FLACFrameDecoder_t { // state of one frame decode, the worker of the dual core mode has its own instance
+    FLACFrameHeader_t header;
+    int32_t*       samples[MAX_CHANNELS];
+    const uint8_t* inptr;           // the frame, byte aligned
+    uint64_t       bitBuffer;       // the next bitBufferLen bits, MSB first, the unused low bits are zero
+    uint32_t       rIndex;          // bytes of inptr moved into bitBuffer
+    uint32_t       crcPos;          // bytes of inptr in crc16
+    uint16_t       crc16;           // CRC-16 of the frame so far, FLACDecoder_SetCrcCheck()
+    uint16_t       numOfOutSamples; // block size of the frame
+    uint8_t        bitBufferLen;
+    bool           bitReaderError;
+    bool           quiet;           // no bit reader messages, the worker's frame can end behind its input
+}FLACFrameDecoder_t;
+
+// dual core mode: while the audio task decodes a frame, the worker task looks for the next frame header behind it and
+// decodes that frame too. It is used if it starts where the frame of the audio task ends, otherwise it is decoded again.
+typedef struct {
+    FLACFrameDecoder_t* fd;
+    FLACFrameHeader_t   ref;   // header of the frame of the audio task, the next one must have the same stream parameters
+    const uint8_t*      from;  // search start
+    int32_t             avail; // bytes from 'from'
+    const uint8_t*      start; // result: the decoded frame, NULL: none
+    int32_t             len;   // result: its bytes including the CRC-16 footer
+} flacAhead_t;
+
+#define FLAC_WORKER_STACK        4096 // bytes, stack of the worker task (dual core mode)
+#define FLAC_WORKER_STACK_MARGIN  512 // bytes, less unused stack is logged, FLACDecoder_WorkerStackFree()
+
+typedef struct FLACDecoder_t { // complete state of one decoder instance, see FLACDecoder_New()
+    FLACMetadataBlock_t meta;
+    FLACFrameDecoder_t  fd[2];             // [cur]: the frame being decoded or output, the other one: the worker's frame
+    uint8_t             cur;
+    bool                f_heap;            // FLACDecoder_New(false): the buffers are not in the audio arena
+    // stream and ogg container
+    vector<uint32_t>    segmTableVec;
+    vector<uint32_t>    blockPicItem;
+    uint32_t            bitrate;
+    uint32_t            blockPicLenUntilFrameEnd;
+    uint32_t            currentFilePos;
+    uint32_t            blockPicPos;
+    uint32_t            blockPicLen;
+    uint32_t            audioDataStart;
+    int32_t             remainBlockPicLen;
+    uint32_t            segmLenTmp;        // rest of an ogg segment that is skipped
+    int32_t             nBytes;            // rest of the ogg audio segment
+    int32_t             bytesIn;           // input bytes of the frame for the compression ratio
+    uint16_t            validSamples;
+    uint16_t            offset;            // output position in the frame
+    uint8_t             status;            // DECODE_FRAME, DECODE_SUBFRAMES, OUT_SAMPLES
+    uint8_t             pageSegments;
+    uint8_t             pageNr;
+    float               compressionRatio;
+    char                streamTitle[256];
+    char*               vendorString;
+    bool                f_parseOgg;
+    bool                f_frameStart;
+    bool                f_newStreamTitle;
+    bool                f_firstCall;
+    bool                f_oggWrapper;
+    bool                f_lastMetaDataBlock;
+    bool                f_newMetadataBlockPicture;
+    // dual core mode, FLACDecoder_SetDualCore()
+    TaskHandle_t        worker;
+    SemaphoreHandle_t   workerDone;
+    int8_t              workerCore;        // -1: off
+    uint8_t             workerPrio;
+    flacAhead_t         ahead;
+    bool                f_aheadReady;      // fd[cur ^ 1] holds the next frame, ahead.len bytes
+    // frame checks: FLACDecoder_SetCrcCheck(), STREAMINFO MD5: FLACDecoder_StartMD5()
+    bool                f_crcCheck;
+    bool                f_ref;
+    FLACFrameHeader_t   refHeader;         // the last good frame, the next one must match it
+    uint16_t            refBlockSize;
+    uint32_t            corruptFrames;     // concealed since FLACSetRawBlockParams()
+    uint8_t             conceal;           // FLAC_CONCEAL_SILENCE, FLAC_CONCEAL_REPEAT
+    int32_t*            last[MAX_CHANNELS];// FLAC_CONCEAL_REPEAT: the samples of the last good frame, not decorrelated
+    uint16_t            lastBlockSize;     // 0: none yet
+    uint8_t             lastChanAsgn;
+    md5_context_t       md5;
+    uint8_t             streamMD5[16];
+    uint64_t            md5Samples;
+    int8_t              md5State;
+}FLACDecoder_t;
+
+// instances, each one has its own state and worker task, two tasks may decode with their own instance at the same time
+FLACDecoder_t*   FLACDecoder_New(bool arena = true);
+void             FLACDecoder_Delete(FLACDecoder_t* d);
+int32_t          FLACFindSyncWord(FLACDecoder_t* d, unsigned char* buf, int32_t nBytes);
+char*            FLACgetStreamTitle(FLACDecoder_t* d);
+int32_t          FLACparseOGG(FLACDecoder_t* d, uint8_t* inbuf, int32_t* bytesLeft);
+vector<uint32_t> FLACgetMetadataBlockPicture(FLACDecoder_t* d);
+int32_t          parseMetaDataBlockHeader(FLACDecoder_t* d, uint8_t* inbuf, int16_t nBytes);
+void             FLACDecoder_setDefaults(FLACDecoder_t* d);
+void             FLACDecoder_ClearBuffer(FLACDecoder_t* d);
+void             FLACDecoder_SetDualCore(FLACDecoder_t* d, int8_t core, uint8_t priority);
+uint32_t         FLACDecoder_WorkerStackFree(FLACDecoder_t* d);
+void             FLACDecoder_SetCrcCheck(FLACDecoder_t* d, bool enable);
+void             FLACDecoder_SetConcealment(FLACDecoder_t* d, uint8_t mode);
+uint32_t         FLACDecoder_CorruptFrames(FLACDecoder_t* d);
+void             FLACDecoder_StartMD5(FLACDecoder_t* d, const uint8_t* md5);
+int8_t           FLACDecoder_MD5Result(FLACDecoder_t* d);
+void             FLACSetRawBlockParams(FLACDecoder_t* d, uint8_t Chans, uint32_t SampRate, uint8_t BPS, uint32_t tsis, uint32_t AuDaLength);
+void             FLACDecoderReset(FLACDecoder_t* d);
+int8_t           FLACDecode(FLACDecoder_t* d, uint8_t* inbuf, int32_t* bytesLeft, int16_t* outbuf);
+int8_t           FLACDecode32(FLACDecoder_t* d, uint8_t* inbuf, int32_t* bytesLeft, int32_t* outbuf);
+int8_t           FLACDecodeNative(FLACDecoder_t* d, uint8_t* inbuf, int32_t* bytesLeft, void* outbuf, bool out32 = false);
+int8_t           flacDecodeFrame(FLACDecoder_t* d, uint8_t* inbuf, int32_t* bytesLeft);
+uint32_t         FLACGetOutputSamps(FLACDecoder_t* d);
+bool             FLACGetFrameStart(FLACDecoder_t* d);
+uint64_t         FLACGetTotoalSamplesInStream(FLACDecoder_t* d);
+uint8_t          FLACGetBitsPerSample(FLACDecoder_t* d);
+uint8_t          FLACGetChannels(FLACDecoder_t* d);
+uint32_t         FLACGetSampRate(FLACDecoder_t* d);
+uint32_t         FLACGetBitRate(FLACDecoder_t* d);
+uint32_t         FLACGetAudioDataStart(FLACDecoder_t* d);
+uint32_t         FLACGetAudioFileDuration(FLACDecoder_t* d);
+
+// the same without instance argument, they use the instance of FLACDecoder_AllocateBuffers()
 int32_t          FLACFindSyncWord(unsigned char* buf, int32_t nBytes);
-boolean          FLACFindMagicWord(unsigned char* buf, int32_t nBytes);
 char*            FLACgetStreamTitle();
-int32_t          FLACparseOGG(uint8_t* inbuf, int32_t* bytesLeft);
 vector<uint32_t> FLACgetMetadataBlockPicture();
-int32_t          parseFlacFirstPacket(uint8_t* inbuf, int16_t nBytes);
-int32_t          parseMetaDataBlockHeader(uint8_t* inbuf, int16_t nBytes);
 bool             FLACDecoder_AllocateBuffers(void);
+size_t           FLACDecoder_StateSize(void);
 void             FLACDecoder_setDefaults();
 void             FLACDecoder_ClearBuffer();
 void             FLACDecoder_FreeBuffers();
+void             FLACDecoder_SetDualCore(int8_t core, uint8_t priority);
+void             FLACDecoder_SetCrcCheck(bool enable);
+void             FLACDecoder_SetConcealment(uint8_t mode);
+uint32_t         FLACDecoder_WorkerStackFree();
+uint32_t         FLACDecoder_CorruptFrames();
+void             FLACDecoder_StartMD5(const uint8_t* md5);
+int8_t           FLACDecoder_MD5Result();
 void             FLACSetRawBlockParams(uint8_t Chans, uint32_t SampRate, uint8_t BPS, uint32_t tsis, uint32_t AuDaLength);
 void             FLACDecoderReset();
 int8_t           FLACDecode(uint8_t* inbuf, int32_t* bytesLeft, int16_t* outbuf);
-int8_t           FLACDecodeNative(uint8_t* inbuf, int32_t* bytesLeft, int16_t* outbuf);
-int8_t           flacDecodeFrame(uint8_t* inbuf, int32_t* bytesLeft);
+int8_t           FLACDecode32(uint8_t* inbuf, int32_t* bytesLeft, int32_t* outbuf);
 uint32_t         FLACGetOutputSamps();
+bool             FLACGetFrameStart();
 uint64_t         FLACGetTotoalSamplesInStream();
 uint8_t          FLACGetBitsPerSample();
 uint8_t          FLACGetChannels();
@@ -172,17 +302,27 @@ uint32_t         FLACGetSampRate();
 uint32_t         FLACGetBitRate();
 uint32_t         FLACGetAudioDataStart();
 uint32_t         FLACGetAudioFileDuration();
-uint32_t         readUint(uint8_t nBits, int32_t* bytesLeft);
-int32_t          readSignedInt(int32_t nBits, int32_t* bytesLeft);
-int64_t          readRiceSignedInt(uint8_t param, int32_t* bytesLeft);
-void             alignToByte();
-int8_t           decodeSubframes(int32_t* bytesLeft);
-int8_t           decodeSubframe(uint8_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
-int8_t           decodeFixedPredictionSubframe(uint8_t predOrder, uint8_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
-int8_t           decodeLinearPredictiveCodingSubframe(int32_t lpcOrder, int32_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
-int8_t           decodeResiduals(uint8_t warmup, uint8_t ch, int32_t* bytesLeft);
-void             restoreLinearPrediction(uint8_t ch, uint8_t shift);
+
+// stateless
+boolean          FLACFindMagicWord(unsigned char* buf, int32_t nBytes);
+int32_t          parseFlacFirstPacket(uint8_t* inbuf, int16_t nBytes);
 int32_t          FLAC_specialIndexOf(uint8_t* base, const char* str, int32_t baselen, bool exact = false);
+
+// frame decoding, the audio task and the worker task (dual core mode) each work on their own FLACFrameDecoder_t
+int8_t           parseFrameHeader(FLACDecoder_t* d, FLACFrameDecoder_t* fd, int32_t* bytesLeft);
+uint32_t         readUint(FLACFrameDecoder_t* fd, uint8_t nBits, int32_t* bytesLeft);
+int32_t          readSignedInt(FLACFrameDecoder_t* fd, int32_t nBits, int32_t* bytesLeft);
+int8_t           readRicePartition(FLACFrameDecoder_t* fd, int32_t* dst, int32_t n, uint8_t param, int32_t* bytesLeft);
+void             releaseBitBuffer(FLACFrameDecoder_t* fd, int32_t* bytesLeft);
+void             alignToByte(FLACFrameDecoder_t* fd);
+int8_t           decodeSubframes(FLACDecoder_t* d, FLACFrameDecoder_t* fd, int32_t* bytesLeft);
+int8_t           decodeSubframe(FLACFrameDecoder_t* fd, uint8_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
+int8_t           decodeFixedPredictionSubframe(FLACFrameDecoder_t* fd, uint8_t predOrder, uint8_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
+int8_t           decodeLinearPredictiveCodingSubframe(FLACFrameDecoder_t* fd, int32_t lpcOrder, int32_t sampleDepth, uint8_t ch, int32_t* bytesLeft);
+int8_t           decodeResiduals(FLACFrameDecoder_t* fd, uint8_t warmup, uint8_t ch, int32_t* bytesLeft);
+void             interleaveSamples(FLACDecoder_t* d, FLACFrameDecoder_t* fd, void* outbuf, bool out32, uint32_t offset, uint32_t n);
+void             restoreFixedPrediction(int32_t* x, int32_t n, uint8_t order);
+void             restoreLinearPrediction(int32_t* x, int32_t n, const int32_t* coefs, uint8_t order, int32_t shift, bool acc64);
 char*            flac_x_ps_malloc(uint16_t len);
 char*            flac_x_ps_calloc(uint16_t len, uint8_t size);
 char*            flac_x_ps_strdup(const char* str);
@@ -0,0 +1,150 @@
+/*
+ *  flac_verify.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "flac_verify.h"
+
+static uint32_t getBE24(const uint8_t* p) { return (p[0] << 16) | (p[1] << 8) | p[2]; }
+static uint32_t getBE32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+bool FlacVerify::begin() {
+    end();
+    m_result = FLAC_VERIFY_RUNNING;
+    m_pos = m_fill = 0;
+    m_skip = 0;
+    m_f_header = m_f_frames = m_f_last = m_f_eof = false;
+    m_corrupt = 0;
+    m_samples = 0;
+    m_dec = FLACDecoder_New(false);
+    m_buf = (uint8_t*)ps_malloc(FLAC_VERIFY_BUF_SIZE + 64);
+    m_out = (int32_t*)ps_malloc(2048 * MAX_CHANNELS * sizeof(int32_t)); // the decoder outputs up to 2048 frames per call
+    if(!m_dec || !m_buf || !m_out) {
+        log_e("not enough memory to verify a flac file");
+        end();
+        m_result = FLAC_VERIFY_ERROR;
+        return false;
+    }
+    FLACDecoder_SetCrcCheck(m_dec, true); // at idle time the cost does not matter
+    return true;
+}
+
+void FlacVerify::end() {
+    if(m_dec) FLACDecoder_Delete(m_dec);
+    if(m_buf) free(m_buf);
+    if(m_out) free(m_out);
+    m_dec = nullptr;
+    m_buf = nullptr;
+    m_out = nullptr;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t* FlacVerify::space(size_t* len) {
+    if(!m_buf) {
+        *len = 0;
+        return nullptr;
+    }
+    if(m_pos) {
+        memmove(m_buf, m_buf + m_pos, m_fill - m_pos);
+        m_fill -= m_pos;
+        m_pos = 0;
+    }
+    *len = FLAC_VERIFY_BUF_SIZE - m_fill;
+    return m_buf + m_fill;
+}
+
+int8_t FlacVerify::step(size_t len, bool eof) {
+    if(!isRunning()) return m_result;
+    m_fill += len;
+    memset(m_buf + m_fill, 0, 64);
+    m_f_eof = eof;
+    if(!m_f_frames && !parseMetadata()) {
+        if(m_result == FLAC_VERIFY_RUNNING && m_f_eof) m_result = FLAC_VERIFY_ERROR; // no audio frames
+        if(m_result != FLAC_VERIFY_RUNNING) end();
+        return m_result;
+    }
+    decodeFrames();
+    if(m_f_eof) finish();
+    return m_result;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool FlacVerify::parseMetadata() { // an ID3v2 tag, "fLaC", the metadata blocks
+    while(true) {
+        int32_t avail = m_fill - m_pos;
+        if(m_skip) {
+            uint32_t n = (m_skip < (uint32_t)avail) ? m_skip : avail;
+            m_pos += n;
+            m_skip -= n;
+            if(m_skip) return false;
+            continue;
+        }
+        const uint8_t* p = m_buf + m_pos;
+        if(!m_f_header) {
+            if(avail < 10) return false;
+            if(!memcmp(p, "ID3", 3)) {
+                m_skip = 10 + ((p[6] & 0x7F) << 21 | (p[7] & 0x7F) << 14 | (p[8] & 0x7F) << 7 | (p[9] & 0x7F));
+                continue;
+            }
+            if(memcmp(p, "fLaC", 4)) {
+                m_result = FLAC_VERIFY_ERROR;
+                return false;
+            }
+            m_f_header = true;
+            m_pos += 4;
+            continue;
+        }
+        if(m_f_last) break;
+        if(avail < 4 + 34) return false;                 // block header and STREAMINFO
+        uint8_t  type = p[0] & 0x7F;
+        uint32_t blockLen = getBE24(p + 1);
+        m_f_last = p[0] & 0x80;
+        m_pos += 4;
+        m_skip = blockLen;
+        if(type == 0 && blockLen >= 34) {                // STREAMINFO
+            const uint8_t* s = p + 4;
+            m_sampleRate = (s[10] << 12) | (s[11] << 4) | (s[12] >> 4);
+            m_channels = ((s[12] >> 1) & 7) + 1;
+            m_bps = (((s[12] & 1) << 4) | (s[13] >> 4)) + 1;
+            m_totalSamples = getBE32(s + 14);            // the low 32 bits, as Audio
+            memcpy(m_md5, s + 18, 16);
+        }
+    }
+    if(!m_sampleRate || m_channels > MAX_CHANNELS || m_bps > 24) {
+        m_result = FLAC_VERIFY_ERROR;
+        return false;
+    }
+    FLACDecoderReset(m_dec);
+    FLACSetRawBlockParams(m_dec, m_channels, m_sampleRate, m_bps, m_totalSamples, 0);
+    FLACDecoder_StartMD5(m_dec, m_md5);
+    m_f_frames = true;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void FlacVerify::decodeFrames() {
+    while(m_pos < m_fill) {
+        int32_t avail = m_fill - m_pos;
+        if(avail < MAX_BLOCKSIZE && !m_f_eof) return;   // the decoder needs a whole frame
+        int32_t left = avail;
+        int8_t  ret = FLACDecode32(m_dec, m_buf + m_pos, &left, m_out);
+        if(ret < 0) { // a damaged frame without a valid header behind it in the buffer, as Audio: the next sync word
+            m_corrupt += FLACDecoder_CorruptFrames(m_dec) + 1;
+            int32_t o = FLACFindSyncWord(m_dec, m_buf + m_pos + 1, avail - 1);
+            m_pos = (o < 0) ? m_fill - (m_f_eof ? 0 : 1) : m_pos + o + 1;
+            FLACSetRawBlockParams(m_dec, m_channels, m_sampleRate, m_bps, m_totalSamples, 0);
+            continue;
+        }
+        uint32_t n = FLACGetOutputSamps(m_dec);
+        m_samples += n / m_channels;
+        m_pos += avail - left;
+        if(left == avail && !n) return;                 // no progress, wait for more input
+    }
+}
+
+void FlacVerify::finish() {
+    if(m_result != FLAC_VERIFY_RUNNING) return;
+    m_corrupt += FLACDecoder_CorruptFrames(m_dec);
+    int8_t md5 = FLACDecoder_MD5Result(m_dec);          // missing samples count as wrong
+    if(m_corrupt || md5 == FLAC_MD5_WRONG) m_result = FLAC_VERIFY_WRONG;
+    else m_result = (md5 == FLAC_MD5_OK) ? FLAC_VERIFY_OK : FLAC_VERIFY_NO_MD5;
+    end();
+}
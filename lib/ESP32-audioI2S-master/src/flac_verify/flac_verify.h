@@ -0,0 +1,61 @@
+/*
+ *  flac_verify.h
+ *
+ *  Whole file check of a native FLAC file: all frames are decoded with CRC checks and the samples are compared with the
+ *  MD5 of the STREAMINFO block. It runs in small steps while nothing plays (AudioCache), with a decoder instance of its
+ *  own on the heap, the one of the playback and the audio arena are not touched. No FS calls in here, the caller reads
+ *  the file into space() and hands the bytes to step().
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include "../flac_decoder/flac_decoder.h"
+
+#define FLAC_VERIFY_BUF_SIZE (2 * MAX_BLOCKSIZE) // input: a whole frame and the header of the next one
+
+enum : int8_t {
+    FLAC_VERIFY_ERROR = -2,   // not a native FLAC file, or not enough memory
+    FLAC_VERIFY_WRONG = -1,   // MD5 wrong or corrupt frames: the file is damaged
+    FLAC_VERIFY_RUNNING = 0,
+    FLAC_VERIFY_OK = 1,
+    FLAC_VERIFY_NO_MD5 = 2,   // the encoder did not store an MD5, the frames were checked only
+};
+
+class FlacVerify {
+public:
+    ~FlacVerify() { end(); }
+    bool     begin();                             // a new file, allocates the decoder and the buffers
+    void     end();                               // frees everything, also to abort a check
+    bool     isRunning() { return m_dec != nullptr && m_result == FLAC_VERIFY_RUNNING; }
+    uint8_t* space(size_t* len);                  // where the next bytes of the file go, *len: free bytes
+    int8_t   step(size_t len, bool eof);          // 'len' bytes were read into space(), eof: that was the end of the file
+    int8_t   result() { return m_result; }
+    uint32_t corruptFrames() { return m_corrupt; }
+    uint64_t samples() { return m_samples; }      // decoded samples per channel
+
+private:
+    bool     parseMetadata();                     // false: more bytes needed
+    void     decodeFrames();
+    void     finish();
+
+    FLACDecoder_t* m_dec = nullptr;
+    uint8_t*       m_buf = nullptr;               // FLAC_VERIFY_BUF_SIZE + 64 zero bytes that the bit reader may read ahead
+    int32_t*       m_out = nullptr;
+    int32_t        m_pos = 0;                     // first unused byte in m_buf
+    int32_t        m_fill = 0;                    // bytes in m_buf
+    uint32_t       m_skip = 0;                    // bytes of a metadata block still to skip (pictures)
+    bool           m_f_header = false;            // "fLaC" seen
+    bool           m_f_frames = false;            // all metadata blocks passed
+    bool           m_f_last = false;              // the last metadata block has begun
+    bool           m_f_eof = false;
+    uint8_t        m_channels = 0;
+    uint8_t        m_bps = 0;
+    uint32_t       m_sampleRate = 0;
+    uint32_t       m_totalSamples = 0;
+    uint8_t        m_md5[16];
+    uint32_t       m_corrupt = 0;
+    uint64_t       m_samples = 0;
+    int8_t         m_result = FLAC_VERIFY_RUNNING;
+};
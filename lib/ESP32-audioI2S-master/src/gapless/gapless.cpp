@@ -0,0 +1,58 @@
+/*
+ *  gapless.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "gapless.h"
+#include <string.h>
+#include "../sync_scan/sync_scan.h"
+
+static uint32_t be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]; }
+//----------------------------------------------------------------------------------------------------------------------
+bool Gapless_MP3Info(const uint8_t* buf, int32_t len, bool halfRate, gaplessInfo_t* gi) {
+    // false: no Xing/Info frame, nothing to trim. halfRate: MP3_QUALITY_HALFRATE, the counts are those of the decoder output
+    memset(gi, 0, sizeof(gaplessInfo_t));
+    gi->total = -1;
+    int32_t sync = SyncScan_Header(buf, len, SYNC_MP3);
+    if(sync < 0 || sync + 4 > len) return false;
+    const uint8_t* h = buf + sync;
+    if(((h[1] >> 1) & 0x03) != 1) return false;  // Xing/LAME headers are layer III frames
+    bool    mpeg1 = ((h[1] >> 3) & 0x03) == 3;
+    bool    mono  = (h[3] >> 6) == 3;
+    int32_t x = sync + 4 + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17)); // behind the side info
+    if(!(h[1] & 0x01)) x += 2;                   // protection bit clear: CRC-16 between the header and the side info
+    if(x + 8 > len) return false;
+    if(memcmp(buf + x, "Xing", 4) != 0 && memcmp(buf + x, "Info", 4) != 0) return false;
+    uint32_t spf = mpeg1 ? 1152 : 576;
+    uint8_t  half = (mpeg1 && halfRate) ? 1 : 0;
+    uint32_t flags = be32(buf + x + 4);
+    int32_t  idx = x + 8;
+    if(flags & 0x01) {if(idx + 4 > len) return false; gi->frames = be32(buf + idx); idx += 4;}
+    if(flags & 0x02) idx += 4;   // bytes
+    if(flags & 0x04) idx += 100; // TOC
+    if(flags & 0x08) idx += 4;   // quality
+    gi->skip = spf >> half;      // the Xing/Info frame itself is decoded to silence
+    if(idx + 24 > len) return true;
+    if(memcmp(buf + idx, "LAME", 4) != 0 && memcmp(buf + idx, "Lavc", 4) != 0 && memcmp(buf + idx, "Lavf", 4) != 0) return true;
+    gi->delay   = (buf[idx + 21] << 4) | (buf[idx + 22] >> 4);
+    gi->padding = ((buf[idx + 22] & 0x0F) << 8) | buf[idx + 23];
+    gi->skip += (gi->delay + GAPLESS_DECODER_DELAY) >> half;
+    if(gi->frames && gi->frames * spf > gi->delay + gi->padding) gi->total = (gi->frames * spf - gi->delay - gi->padding) >> half;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t Gapless_Trim(audio_sample_t* buf, uint32_t frames, uint8_t channels, uint32_t* skip, int32_t* remain) {
+    // drops the first *skip frames and everything behind *remain frames, returns the frames left in buf
+    if(*skip) {
+        uint32_t n = frames < *skip ? frames : *skip;
+        *skip -= n;
+        frames -= n;
+        if(frames) memmove(buf, buf + n * channels, frames * channels * sizeof(audio_sample_t));
+    }
+    if(*remain >= 0) {
+        if(frames > (uint32_t)*remain) frames = *remain;
+        *remain -= frames;
+    }
+    return frames;
+}
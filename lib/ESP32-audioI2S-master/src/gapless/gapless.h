@@ -0,0 +1,28 @@
+/*
+ *  gapless.h
+ *
+ *  Encoder delay and padding of mp3 files (Xing/Info + LAME tag in the first frame) and the trim of the decoded frames.
+ *  Audio::readGaplessInfo() reads the first frame, Audio::trimDecodedFrames() drops the delay and the padding, so two
+ *  files played back to back join without a gap. No FS calls in here.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../output_stage/audio_sample.h"
+
+typedef struct {
+    uint32_t skip;    // decoded frames to drop at the beginning (Xing frame, encoder delay, decoder delay)
+    int32_t  total;   // frames to play after skip, -1 unknown
+    uint32_t delay;   // LAME tag, 0 without
+    uint32_t padding;
+    uint32_t frames;  // mp3 frames in the stream (Xing), 0 unknown
+} gaplessInfo_t;
+
+#define GAPLESS_DECODER_DELAY 529 // MDCT overlap + synthesis filterbank of the mp3 decoder
+
+bool     Gapless_MP3Info(const uint8_t* buf, int32_t len, bool halfRate, gaplessInfo_t* gi); // buf: first bytes behind the ID3 tag
+uint32_t Gapless_Trim(audio_sample_t* buf, uint32_t frames, uint8_t channels, uint32_t* skip, int32_t* remain);
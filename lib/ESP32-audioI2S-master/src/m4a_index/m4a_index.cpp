@@ -0,0 +1,248 @@
+/*
+ *  m4a_index.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "m4a_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t getBE16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+static uint32_t getBE32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+static uint64_t getBE64(const uint8_t* p) { return ((uint64_t)getBE32(p) << 32) | getBE32(p + 4); }
+
+M4AIndex::M4AIndex() {}
+
+M4AIndex::~M4AIndex() { clear(); }
+
+void M4AIndex::clear() {
+    if(m_sizes) free(m_sizes);
+    if(m_chunkOffset) free(m_chunkOffset);
+    if(m_chunkFirst) free(m_chunkFirst);
+    if(m_stts) free(m_stts);
+    m_sizes = nullptr;
+    m_chunkOffset = nullptr;
+    m_chunkFirst = nullptr;
+    m_stts = nullptr;
+    m_numFrames = 0;
+    m_numChunks = 0;
+    m_numStts = 0;
+    m_timescale = 0;
+    m_duration = 0;
+    m_sampleRate = 0;
+    m_channels = 0;
+    m_bitsPerSample = 0;
+    m_ilstOffset = -1;
+    m_ilstSize = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool M4AIndex::find(const uint8_t* buf, uint32_t len, const char* name, uint32_t* start, uint32_t* size) {
+    uint32_t pos = 0;
+    while(pos + 8 <= len) {
+        uint64_t atomSize = getBE32(buf + pos);
+        uint32_t hdr = 8;
+        if(atomSize == 1) { // extended size
+            if(pos + 16 > len) return false;
+            atomSize = getBE64(buf + pos + 8);
+            hdr = 16;
+        }
+        else if(atomSize == 0) atomSize = len - pos; // up to the end
+        if(atomSize < hdr || atomSize > len - pos) return false;
+        if(memcmp(buf + pos + 4, name, 4) == 0) {
+            *start = pos + hdr;
+            *size = atomSize - hdr;
+            return true;
+        }
+        pos += atomSize;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool M4AIndex::parse(const uint8_t* moov, uint32_t len) {
+    clear();
+    if(len < 8 || memcmp(moov + 4, "moov", 4) != 0) return false;
+    uint32_t hdr = (getBE32(moov) == 1) ? 16 : 8;
+    const uint8_t* body = moov + hdr;
+    uint32_t bodyLen = len - hdr;
+
+    // the first track with a sound handler
+    uint32_t pos = 0, s, n;
+    while(pos < bodyLen && find(body + pos, bodyLen - pos, "trak", &s, &n)) {
+        const uint8_t* trak = body + pos + s;
+        uint32_t mdia, mdiaLen, hdlr, hdlrLen;
+        if(find(trak, n, "mdia", &mdia, &mdiaLen) && find(trak + mdia, mdiaLen, "hdlr", &hdlr, &hdlrLen) && hdlrLen >= 12 &&
+           memcmp(trak + mdia + hdlr + 8, "soun", 4) == 0) {
+            if(!parseTrak(trak, n)) {clear(); return false;}
+            break;
+        }
+        pos += s + n;
+    }
+    if(!m_numFrames) return false;
+
+    // metadata: moov -> udta -> meta -> ilst, meta is a full atom (version, flags) except in some QuickTime files
+    uint32_t udta, udtaLen, meta, metaLen, ilst, ilstLen;
+    if(find(body, bodyLen, "udta", &udta, &udtaLen) && find(body + udta, udtaLen, "meta", &meta, &metaLen) && metaLen >= 8) {
+        uint32_t skip = (memcmp(body + udta + meta + 4, "hdlr", 4) == 0) ? 0 : 4;
+        if(find(body + udta + meta + skip, metaLen - skip, "ilst", &ilst, &ilstLen)) {
+            m_ilstOffset = hdr + udta + meta + skip + ilst - 8; // with the atom header
+            m_ilstSize = ilstLen + 8;
+        }
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool M4AIndex::parseTrak(const uint8_t* trak, uint32_t len) {
+    uint32_t mdia, mdiaLen, mdhd, mdhdLen, minf, minfLen, stbl, stblLen;
+    if(!find(trak, len, "mdia", &mdia, &mdiaLen)) return false;
+    const uint8_t* p = trak + mdia;
+    if(!find(p, mdiaLen, "mdhd", &mdhd, &mdhdLen) || mdhdLen < 24) return false;
+    if(p[mdhd] == 1) { // version 1, 64 bit times
+        if(mdhdLen < 32) return false;
+        m_timescale = getBE32(p + mdhd + 20);
+        m_duration = getBE64(p + mdhd + 24);
+    }
+    else {
+        m_timescale = getBE32(p + mdhd + 12);
+        m_duration = getBE32(p + mdhd + 16);
+    }
+    if(!find(p, mdiaLen, "minf", &minf, &minfLen)) return false;
+    if(!find(p + minf, minfLen, "stbl", &stbl, &stblLen)) return false;
+    const uint8_t* t = p + minf + stbl;
+
+    uint32_t stsd, stsdLen, stts, sttsLen, stsz, stszLen, stsc, stscLen, stco, stcoLen;
+    bool co64 = false;
+    if(!find(t, stblLen, "stsd", &stsd, &stsdLen) || stsdLen < 8 + 34) return false;
+    if(memcmp(t + stsd + 12, "mp4a", 4) != 0) return false; // aac only
+    m_channels = getBE16(t + stsd + 8 + 24);
+    m_bitsPerSample = getBE16(t + stsd + 8 + 26);
+    m_sampleRate = getBE16(t + stsd + 8 + 32);                // 16.16 fixed point
+
+    if(!find(t, stblLen, "stts", &stts, &sttsLen) || sttsLen < 8) return false;
+    if(!find(t, stblLen, "stsz", &stsz, &stszLen) || stszLen < 12) return false;
+    if(!find(t, stblLen, "stsc", &stsc, &stscLen) || stscLen < 8) return false;
+    if(!find(t, stblLen, "stco", &stco, &stcoLen)) {
+        if(!find(t, stblLen, "co64", &stco, &stcoLen)) return false;
+        co64 = true;
+    }
+    if(stcoLen < 8) return false;
+
+    // stts, frame durations as runs
+    m_numStts = getBE32(t + stts + 4);
+    if(m_numStts > (sttsLen - 8) / 8) return false;
+    m_stts = (run_t*)calloc(m_numStts + 1, sizeof(run_t));
+    if(!m_stts) return false;
+    uint64_t sttsFrames = 0;
+    for(uint32_t i = 0; i < m_numStts; i++) {
+        m_stts[i].count = getBE32(t + stts + 8 + i * 8);
+        m_stts[i].delta = getBE32(t + stts + 12 + i * 8);
+        sttsFrames += m_stts[i].count;
+    }
+
+    // stco/co64, chunk offsets
+    m_numChunks = getBE32(t + stco + 4);
+    if(m_numChunks > (stcoLen - 8) / (co64 ? 8 : 4)) return false;
+    m_chunkOffset = (uint32_t*)calloc(m_numChunks + 1, sizeof(uint32_t));
+    m_chunkFirst = (uint32_t*)calloc(m_numChunks + 1, sizeof(uint32_t));
+    if(!m_chunkOffset || !m_chunkFirst) return false;
+    for(uint32_t i = 0; i < m_numChunks; i++) {
+        uint64_t off = co64 ? getBE64(t + stco + 8 + i * 8) : getBE32(t + stco + 8 + i * 4);
+        if(off > 0xFFFFFFFF) return false; // the file positions are 32 bit
+        m_chunkOffset[i] = off;
+    }
+
+    // stsc, frames per chunk as runs -> first frame of every chunk. The runs must cover all chunks from chunk 1 on,
+    // otherwise chunks without a first frame would be left
+    uint32_t numRuns = getBE32(t + stsc + 4);
+    if(!numRuns || numRuns > (stscLen - 8) / 12) return false;
+    if(getBE32(t + stsc + 8) != 1) return false;
+    uint64_t frame = 0;
+    for(uint32_t r = 0; r < numRuns; r++) {
+        uint32_t first = getBE32(t + stsc + 8 + r * 12);
+        uint32_t perChunk = getBE32(t + stsc + 12 + r * 12);
+        uint32_t next = (r + 1 < numRuns) ? getBE32(t + stsc + 8 + (r + 1) * 12) : m_numChunks + 1;
+        if(next <= first || next > m_numChunks + 1) return false; // ascending, within stco
+        for(uint32_t c = first - 1; c < next - 1; c++) {
+            m_chunkFirst[c] = frame;
+            frame += perChunk;
+            if(frame > M4A_MAX_FRAMES) return false;
+        }
+    }
+
+    // stsz, frame sizes, an aac frame is always smaller than 64kB. With a fixed size the count is not backed by a table,
+    // it is limited by the frames of stts and stsc
+    uint32_t fixedSize = getBE32(t + stsz + 4);
+    uint32_t numFrames = getBE32(t + stsz + 8);
+    if(!fixedSize && numFrames > (stszLen - 12) / 4) return false;
+    if(fixedSize > 0xFFFF) return false;
+    if(numFrames > frame) numFrames = frame;
+    if(numFrames > sttsFrames) numFrames = sttsFrames;
+    if(numFrames > M4A_MAX_FRAMES || numFrames > (SIZE_MAX - sizeof(uint16_t)) / sizeof(uint16_t)) return false;
+    m_sizes = (uint16_t*)calloc(numFrames + 1, sizeof(uint16_t));
+    if(!m_sizes) return false;
+    for(uint32_t i = 0; i < numFrames; i++) {
+        uint32_t size = fixedSize ? fixedSize : getBE32(t + stsz + 12 + i * 4);
+        if(size > 0xFFFF) return false;
+        m_sizes[i] = size;
+    }
+    m_numFrames = numFrames;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t M4AIndex::chunkOfFrame(uint32_t frame) { // last chunk with a first frame <= frame
+    uint32_t lo = 0, hi = m_numChunks - 1;
+    while(lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if(m_chunkFirst[mid] <= frame) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t M4AIndex::frameOffset(uint32_t frame) {
+    if(frame >= m_numFrames) return 0;
+    uint32_t c = chunkOfFrame(frame);
+    uint32_t pos = m_chunkOffset[c];
+    for(uint32_t f = m_chunkFirst[c]; f < frame; f++) pos += m_sizes[f];
+    return pos;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t M4AIndex::frameAtOffset(uint32_t pos) {
+    if(!m_numFrames) return -1;
+    uint32_t lo = 0, hi = m_numChunks - 1; // last chunk that starts at or before pos
+    while(lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if(m_chunkOffset[mid] <= pos) lo = mid;
+        else hi = mid - 1;
+    }
+    uint32_t f = m_chunkFirst[lo];
+    uint32_t end = (lo + 1 < m_numChunks) ? m_chunkFirst[lo + 1] : m_numFrames;
+    uint32_t off = m_chunkOffset[lo];
+    while(f < end && f < m_numFrames && off < pos) off += m_sizes[f++];
+    if(f >= m_numFrames) return -1;
+    return f; // f == end: the first frame of the next chunk
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t M4AIndex::frameAtTime(uint64_t t) {
+    uint32_t frame = 0;
+    for(uint32_t i = 0; i < m_numStts; i++) {
+        uint64_t runTime = (uint64_t)m_stts[i].count * m_stts[i].delta;
+        if(t < runTime) {
+            frame += m_stts[i].delta ? t / m_stts[i].delta : 0;
+            break;
+        }
+        t -= runTime;
+        frame += m_stts[i].count;
+    }
+    return (frame < m_numFrames) ? frame : m_numFrames - 1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint64_t M4AIndex::frameTime(uint32_t frame) {
+    uint64_t t = 0;
+    for(uint32_t i = 0; i < m_numStts && frame; i++) {
+        uint32_t n = (frame < m_stts[i].count) ? frame : m_stts[i].count;
+        t += (uint64_t)n * m_stts[i].delta;
+        frame -= n;
+    }
+    return t;
+}
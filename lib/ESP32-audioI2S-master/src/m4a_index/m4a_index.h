@@ -0,0 +1,71 @@
+/*
+ *  m4a_index.h
+ *
+ *  Sample tables of the audio track of an m4a file, parsed from the moov atom that the caller has read into memory in one go.
+ *  stsz, stco/co64, stsc and stts are kept as compact arrays (frame sizes as uint16, one offset per chunk), frame offsets and
+ *  times are served from memory, no file access after parse(). The moov buffer can be freed after parse().
+ *
+ *  moov -> trak -> mdia -> mdhd (timescale)
+ *                          hdlr (soun)
+ *                          minf -> stbl -> stsd (mp4a: channels, bits per sample, sample rate)
+ *                                          stts (frame durations)  stsz (frame sizes)
+ *                                          stsc (frames per chunk) stco/co64 (chunk offsets)
+ *       -> udta -> meta -> ilst (metadata)
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define M4A_MAX_FRAMES  (1u << 22) // 4M aac frames (26 hours at 44.1kHz), larger tables are rejected as corrupt
+
+class M4AIndex {
+public:
+    M4AIndex();
+    ~M4AIndex();
+    bool     parse(const uint8_t* moov, uint32_t len); // complete moov atom (header included)
+    void     clear();
+    bool     isValid() { return m_numFrames > 0; }
+    uint32_t frames() { return m_numFrames; }
+    uint32_t timescale() { return m_timescale; }
+    uint16_t channels() { return m_channels; }
+    uint16_t bitsPerSample() { return m_bitsPerSample; }
+    uint32_t sampleRate() { return m_sampleRate; }
+    uint64_t duration() { return m_duration; }              // in timescale units
+    int32_t  ilstOffset() { return m_ilstOffset; }          // ilst atom within the moov buffer, -1 not found
+    uint32_t ilstSize() { return m_ilstSize; }
+
+    uint32_t frameSize(uint32_t frame) { return frame < m_numFrames ? m_sizes[frame] : 0; }
+    uint32_t frameOffset(uint32_t frame);                   // file position of an aac frame
+    int32_t  frameAtOffset(uint32_t pos);                   // first frame that starts at or behind pos, -1 none
+    uint32_t frameAtTime(uint64_t t);                       // frame that contains t (timescale units)
+    uint64_t frameTime(uint32_t frame);
+
+private:
+    typedef struct {
+        uint32_t count;
+        uint32_t delta;
+    } run_t;
+
+    bool     find(const uint8_t* buf, uint32_t len, const char* name, uint32_t* start, uint32_t* size); // child atom payload
+    bool     parseTrak(const uint8_t* trak, uint32_t len);
+    uint32_t chunkOfFrame(uint32_t frame);
+
+    uint16_t* m_sizes = nullptr;        // stsz
+    uint32_t* m_chunkOffset = nullptr;  // stco/co64
+    uint32_t* m_chunkFirst = nullptr;   // first frame of each chunk, from stsc
+    run_t*    m_stts = nullptr;
+    uint32_t  m_numFrames = 0;
+    uint32_t  m_numChunks = 0;
+    uint32_t  m_numStts = 0;
+    uint32_t  m_timescale = 0;
+    uint64_t  m_duration = 0;
+    uint32_t  m_sampleRate = 0;
+    uint16_t  m_channels = 0;
+    uint16_t  m_bitsPerSample = 0;
+    int32_t   m_ilstOffset = -1;
+    uint32_t  m_ilstSize = 0;
+};
@@ -3,9 +3,10 @@
  * libhelix_HMP3DECODER
  *
  *  Created on: 26.10.2018
- *  Updated on: 27.05.2025
+ *  Updated on: 19.10.2026
  */
 #include "mp3_decoder.h"
+#include <mutex>
 /* clip to range [-2^n, 2^n - 1] */
 #if 0 //Fast on ARM:
 #define CLIP_2N(y, n) { \
@@ -37,21 +38,7 @@ const uint8_t  m_NGRANS_MPEG2           =1;
 const uint32_t m_SQRTHALF               =0x5a82799a;  // sqrt(0.5) in Q31 format
 
 
-MP3FrameInfo_t *m_MP3FrameInfo;
-SFBandTable_t m_SFBandTable;
-StereoMode_t m_sMode;  /* mono/stereo mode */
-MPEGVersion_t m_MPEGVersion;  /* version ID */
-FrameHeader_t *m_FrameHeader;
-SideInfoSub_t m_SideInfoSub[m_MAX_NGRAN][m_MAX_NCHAN];
-SideInfo_t *m_SideInfo;
-CriticalBandInfo_t m_CriticalBandInfo[m_MAX_NCHAN];  /* filled in dequantizer, used in joint stereo reconstruction */
-DequantInfo_t *m_DequantInfo;
-HuffmanInfo_t *m_HuffmanInfo;
-IMDCTInfo_t *m_IMDCTInfo;
-ScaleFactorInfoSub_t m_ScaleFactorInfoSub[m_MAX_NGRAN][m_MAX_NCHAN];
-ScaleFactorJS_t *m_ScaleFactorJS;
-SubbandInfo_t *m_SubbandInfo;
-MP3DecInfo_t *m_MP3DecInfo;
+MP3Decoder_t *m_MP3Decoder = NULL; // instance of MP3Decoder_AllocateBuffers()
 
 const uint16_t huffTable[4242] PROGMEM = {
     /* huffTable01[9] */
@@ -748,92 +735,92 @@ int32_t CalcBitsUsed(BitStreamInfo_t *bsi, uint8_t *startBuf, int32_t startOffse
     return bitsUsed;
 }
 //----------------------------------------------------------------------------------------------------------------------
-int32_t CheckPadBit(){
-    return (m_FrameHeader->paddingBit ? 1 : 0);
+int32_t CheckPadBit(MP3Decoder_t *d){
+    return (d->frameHeader.paddingBit ? 1 : 0);
 }
 //----------------------------------------------------------------------------------------------------------------------
-int32_t UnpackFrameHeader(uint8_t *buf){
+int32_t UnpackFrameHeader(MP3Decoder_t *d, uint8_t *buf){
    int32_t verIdx;
     /* validate pointers and sync word */
     if ((buf[0] & m_SYNCWORDH) != m_SYNCWORDH || (buf[1] & m_SYNCWORDL) != m_SYNCWORDL){return -1;}
     /* read header fields - use bitmasks instead of GetBits() for speed, since format never varies */
     verIdx = (buf[1] >> 3) & 0x03;
-    m_MPEGVersion = (MPEGVersion_t) (verIdx == 0 ? MPEG25 : ((verIdx & 0x01) ? MPEG1 : MPEG2));
-    m_FrameHeader->layer = 4 - ((buf[1] >> 1) & 0x03); /* easy mapping of index to layer number, 4 = error */
-    m_FrameHeader->crc = 1 - ((buf[1] >> 0) & 0x01);
-    m_FrameHeader->brIdx = (buf[2] >> 4) & 0x0f;
-    m_FrameHeader->srIdx = (buf[2] >> 2) & 0x03;
-    m_FrameHeader->paddingBit = (buf[2] >> 1) & 0x01;
-    m_FrameHeader->privateBit = (buf[2] >> 0) & 0x01;
-    m_sMode = (StereoMode_t) ((buf[3] >> 6) & 0x03); /* maps to correct enum (see definition) */
-    m_FrameHeader->modeExt = (buf[3] >> 4) & 0x03;
-    m_FrameHeader->copyFlag = (buf[3] >> 3) & 0x01;
-    m_FrameHeader->origFlag = (buf[3] >> 2) & 0x01;
-    m_FrameHeader->emphasis = (buf[3] >> 0) & 0x03;
+    d->mpegVersion = (MPEGVersion_t) (verIdx == 0 ? MPEG25 : ((verIdx & 0x01) ? MPEG1 : MPEG2));
+    d->frameHeader.layer = 4 - ((buf[1] >> 1) & 0x03); /* easy mapping of index to layer number, 4 = error */
+    d->frameHeader.crc = 1 - ((buf[1] >> 0) & 0x01);
+    d->frameHeader.brIdx = (buf[2] >> 4) & 0x0f;
+    d->frameHeader.srIdx = (buf[2] >> 2) & 0x03;
+    d->frameHeader.paddingBit = (buf[2] >> 1) & 0x01;
+    d->frameHeader.privateBit = (buf[2] >> 0) & 0x01;
+    d->sMode = (StereoMode_t) ((buf[3] >> 6) & 0x03); /* maps to correct enum (see definition) */
+    d->frameHeader.modeExt = (buf[3] >> 4) & 0x03;
+    d->frameHeader.copyFlag = (buf[3] >> 3) & 0x01;
+    d->frameHeader.origFlag = (buf[3] >> 2) & 0x01;
+    d->frameHeader.emphasis = (buf[3] >> 0) & 0x03;
     /* check parameters to avoid indexing tables with bad values */
-    if (m_FrameHeader->srIdx == 3 || m_FrameHeader->layer == 4 || m_FrameHeader->brIdx == 15) {return -1;}
+    if (d->frameHeader.srIdx == 3 || d->frameHeader.layer == 4 || d->frameHeader.brIdx == 15) {return -1;}
     /* for readability (we reference sfBandTable many times in decoder) */
-    m_SFBandTable = sfBandTable[m_MPEGVersion][m_FrameHeader->srIdx];
-    if (m_sMode != Joint) /* just to be safe (dequant, stproc check fh->modeExt) */
-        m_FrameHeader->modeExt = 0;
+    d->sfBand = sfBandTable[d->mpegVersion][d->frameHeader.srIdx];
+    if (d->sMode != Joint) /* just to be safe (dequant, stproc check fh->modeExt) */
+        d->frameHeader.modeExt = 0;
     /* init user-accessible data */
-    m_MP3DecInfo->nChans = (m_sMode == Mono ? 1 : 2);
-    m_MP3DecInfo->samprate = samplerateTab[m_MPEGVersion][m_FrameHeader->srIdx];
-    m_MP3DecInfo->nGrans = (m_MPEGVersion == MPEG1 ? m_NGRANS_MPEG1 : m_NGRANS_MPEG2);
-    m_MP3DecInfo->nGranSamps = ((int32_t) samplesPerFrameTab[m_MPEGVersion][m_FrameHeader->layer - 1])/m_MP3DecInfo->nGrans;
-    m_MP3DecInfo->layer = m_FrameHeader->layer;
+    d->decInfo.nChans = (d->sMode == Mono ? 1 : 2);
+    d->decInfo.samprate = samplerateTab[d->mpegVersion][d->frameHeader.srIdx];
+    d->decInfo.nGrans = (d->mpegVersion == MPEG1 ? m_NGRANS_MPEG1 : m_NGRANS_MPEG2);
+    d->decInfo.nGranSamps = ((int32_t) samplesPerFrameTab[d->mpegVersion][d->frameHeader.layer - 1])/d->decInfo.nGrans;
+    d->decInfo.layer = d->frameHeader.layer;
 
     /* get bitrate and nSlots from table, unless brIdx == 0 (free mode) in which case caller must figure it out himself
      * question - do we want to overwrite mp3DecInfo->bitrate with 0 each time if it's free mode, and
      *  copy the pre-calculated actual free bitrate into it in mp3dec.c (according to the spec,
      *  this shouldn't be necessary, since it should be either all frames free or none free)
      */
-    if (m_FrameHeader->brIdx) {
-        m_MP3DecInfo->bitrate=((int32_t) bitrateTab[m_MPEGVersion][m_FrameHeader->layer - 1][m_FrameHeader->brIdx]) * 1000;
+    if (d->frameHeader.brIdx) {
+        d->decInfo.bitrate=((int32_t) bitrateTab[d->mpegVersion][d->frameHeader.layer - 1][d->frameHeader.brIdx]) * 1000;
         /* nSlots = total frame bytes (from table) - sideInfo bytes - header - CRC (if present) + pad (if present) */
-        m_MP3DecInfo->nSlots= (int32_t) slotTab[m_MPEGVersion][m_FrameHeader->srIdx][m_FrameHeader->brIdx]
-                - (int32_t) sideBytesTab[m_MPEGVersion][(m_sMode == Mono ? 0 : 1)] - 4
-                - (m_FrameHeader->crc ? 2 : 0) + (m_FrameHeader->paddingBit ? 1 : 0);
+        d->decInfo.nSlots= (int32_t) slotTab[d->mpegVersion][d->frameHeader.srIdx][d->frameHeader.brIdx]
+                - (int32_t) sideBytesTab[d->mpegVersion][(d->sMode == Mono ? 0 : 1)] - 4
+                - (d->frameHeader.crc ? 2 : 0) + (d->frameHeader.paddingBit ? 1 : 0);
     }
     /* load crc word, if enabled, and return length of frame header (in bytes) */
-    if (m_FrameHeader->crc) {
-        m_FrameHeader->CRCWord = ((int32_t) buf[4] << 8 | (int32_t) buf[5] << 0);
+    if (d->frameHeader.crc) {
+        d->frameHeader.CRCWord = ((int32_t) buf[4] << 8 | (int32_t) buf[5] << 0);
         return 6;
     } else {
-        m_FrameHeader->CRCWord = 0;
+        d->frameHeader.CRCWord = 0;
         return 4;
     }
 }
 //----------------------------------------------------------------------------------------------------------------------
-int32_t UnpackSideInfo( uint8_t *buf) {
+int32_t UnpackSideInfo(MP3Decoder_t *d, uint8_t *buf) {
    int32_t gr, ch, bd, nBytes;
     BitStreamInfo_t bitStreamInfo, *bsi;
 
     SideInfoSub_t *sis;
     /* validate pointers and sync word */
     bsi = &bitStreamInfo;
-    if (m_MPEGVersion == MPEG1) {
+    if (d->mpegVersion == MPEG1) {
         /* MPEG 1 */
-        nBytes=(m_sMode == Mono ? m_SIBYTES_MPEG1_MONO : m_SIBYTES_MPEG1_STEREO);
+        nBytes=(d->sMode == Mono ? m_SIBYTES_MPEG1_MONO : m_SIBYTES_MPEG1_STEREO);
         SetBitstreamPointer(bsi, nBytes, buf);
-        m_SideInfo->mainDataBegin = GetBits(bsi, 9);
-        m_SideInfo->privateBits= GetBits(bsi, (m_sMode == Mono ? 5 : 3));
-        for (ch = 0; ch < m_MP3DecInfo->nChans; ch++)
-            for (bd = 0; bd < m_MAX_SCFBD; bd++) m_SideInfo->scfsi[ch][bd] = GetBits(bsi, 1);
+        d->sideInfo.mainDataBegin = GetBits(bsi, 9);
+        d->sideInfo.privateBits= GetBits(bsi, (d->sMode == Mono ? 5 : 3));
+        for (ch = 0; ch < d->decInfo.nChans; ch++)
+            for (bd = 0; bd < m_MAX_SCFBD; bd++) d->sideInfo.scfsi[ch][bd] = GetBits(bsi, 1);
     } else {
         /* MPEG 2, MPEG 2.5 */
-        nBytes=(m_sMode == Mono ? m_SIBYTES_MPEG2_MONO : m_SIBYTES_MPEG2_STEREO);
+        nBytes=(d->sMode == Mono ? m_SIBYTES_MPEG2_MONO : m_SIBYTES_MPEG2_STEREO);
         SetBitstreamPointer(bsi, nBytes, buf);
-        m_SideInfo->mainDataBegin = GetBits(bsi, 8);
-        m_SideInfo->privateBits = GetBits(bsi, (m_sMode == Mono ? 1 : 2));
+        d->sideInfo.mainDataBegin = GetBits(bsi, 8);
+        d->sideInfo.privateBits = GetBits(bsi, (d->sMode == Mono ? 1 : 2));
     }
-    for (gr = 0; gr < m_MP3DecInfo->nGrans; gr++) {
-        for (ch = 0; ch < m_MP3DecInfo->nChans; ch++) {
-            sis = &m_SideInfoSub[gr][ch]; /* side info subblock for this granule, channel */
+    for (gr = 0; gr < d->decInfo.nGrans; gr++) {
+        for (ch = 0; ch < d->decInfo.nChans; ch++) {
+            sis = &d->sideInfoSub[gr][ch]; /* side info subblock for this granule, channel */
             sis->part23Length = GetBits(bsi, 12);
             sis->nBigvals = GetBits(bsi, 9);
             sis->globalGain = GetBits(bsi, 8);
-            sis->sfCompress = GetBits(bsi, (m_MPEGVersion == MPEG1 ? 4 : 9));
+            sis->sfCompress = GetBits(bsi, (d->mpegVersion == MPEG1 ? 4 : 9));
             sis->winSwitchFlag = GetBits(bsi, 1);
             if (sis->winSwitchFlag) {
                 /* this is a start, stop, short, or mixed block */
@@ -868,12 +855,12 @@ int32_t UnpackSideInfo( uint8_t *buf) {
                 sis->region0Count = GetBits(bsi, 4);
                 sis->region1Count = GetBits(bsi, 3);
             }
-            sis->preFlag = (m_MPEGVersion == MPEG1 ? GetBits(bsi, 1) : 0);
+            sis->preFlag = (d->mpegVersion == MPEG1 ? GetBits(bsi, 1) : 0);
             sis->sfactScale = GetBits(bsi, 1);
             sis->count1TableSelect = GetBits(bsi, 1);
         }
     }
-    m_MP3DecInfo->mainDataBegin = m_SideInfo->mainDataBegin; /* needed by main decode loop */
+    d->decInfo.mainDataBegin = d->sideInfo.mainDataBegin; /* needed by main decode loop */
     assert(nBytes == CalcBitsUsed(bsi, buf, 0) >> 3);
     return nBytes;
 }
@@ -1135,7 +1122,7 @@ void UnpackSFMPEG2(BitStreamInfo_t *bsi, SideInfoSub_t *sis,
  *
  * Return:      length (in bytes) of scale factor data, -1 if null input pointers
  **********************************************************************************************************************/
-int32_t UnpackScaleFactors( uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail, int32_t gr, int32_t ch){
+int32_t UnpackScaleFactors(MP3Decoder_t *d, uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail, int32_t gr, int32_t ch){
    int32_t bitsUsed;
     uint8_t *startBuf;
     BitStreamInfo_t bitStreamInfo, *bsi;
@@ -1147,14 +1134,14 @@ int32_t UnpackScaleFactors( uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail,
     if (*bitOffset)
         GetBits(bsi, *bitOffset);
 
-    if (m_MPEGVersion == MPEG1)
-        UnpackSFMPEG1(bsi, &m_SideInfoSub[gr][ch], &m_ScaleFactorInfoSub[gr][ch],
-                      m_SideInfo->scfsi[ch], gr, &m_ScaleFactorInfoSub[0][ch]);
+    if (d->mpegVersion == MPEG1)
+        UnpackSFMPEG1(bsi, &d->sideInfoSub[gr][ch], &d->scaleFactorInfoSub[gr][ch],
+                      d->sideInfo.scfsi[ch], gr, &d->scaleFactorInfoSub[0][ch]);
     else
-        UnpackSFMPEG2(bsi, &m_SideInfoSub[gr][ch], &m_ScaleFactorInfoSub[gr][ch],
-                      gr, ch, m_FrameHeader->modeExt, m_ScaleFactorJS);
+        UnpackSFMPEG2(bsi, &d->sideInfoSub[gr][ch], &d->scaleFactorInfoSub[gr][ch],
+                      gr, ch, d->frameHeader.modeExt, &d->scaleFactorJS);
 
-    m_MP3DecInfo->part23Length[gr][ch] = m_SideInfoSub[gr][ch].part23Length;
+    d->decInfo.part23Length[gr][ch] = d->sideInfoSub[gr][ch].part23Length;
 
     bitsUsed = CalcBitsUsed(bsi, buf, *bitOffset);
     buf += (bitsUsed + *bitOffset) >> 3;
@@ -1180,54 +1167,9 @@ int32_t UnpackScaleFactors( uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail,
  *              -1 if sync not found after searching nBytes
  ****************************************************************************************************************************************************/
 int32_t MP3FindSyncWord(uint8_t *buf, int32_t nBytes) {
-
-    const uint8_t mp3FHsize = 4; // frame header size
-    uint8_t firstFH[4];
-
-    //————————————————————————————————————————————————————————————————————————————————————————————————————————
-    auto findSync = [&](uint8_t* buf, uint16_t offset, uint16_t len) { // lambda, inner function
-        for (int32_t i = 0; i < nBytes - 1; i++) {
-            if ((buf[i + offset] & m_SYNCWORDH) == m_SYNCWORDH && (buf[i + offset + 1] & m_SYNCWORDL) == m_SYNCWORDL){
-                return i;
-            }
-        }
-        return (int32_t)-1;
-    };
-    //————————————————————————————————————————————————————————————————————————————————————————————————————————
-    /* find byte-aligned syncword - need 12 (MPEG 1,2) or 11 (MPEG 2.5) matching bits */
-   int32_t pos = findSync(buf, 0, nBytes);
-    if(pos == -1) return pos; // syncword not found
-    nBytes -= pos;
-
-    while(nBytes > 0){
-        firstFH[0] = buf[pos + 0];
-        firstFH[1] = buf[pos + 1];
-        firstFH[2] = buf[pos + 2];
-        firstFH[3] = buf[pos + 2];
-
-        if((firstFH[2] & 0b11110000) == 0b11110000){ // wrong bitrate index
-            log_d("wrong bitrate index");
-            pos += mp3FHsize;
-            nBytes -= mp3FHsize;
-            int32_t i = findSync(buf, pos, nBytes);
-            pos += i;
-            nBytes -= i;
-            continue;
-        }
-
-        if((firstFH[2] & 0b00001100) == 0b00001100){ // wrong sampling rate frequency index
-            log_d("wrong sampling rate");
-            pos += mp3FHsize;
-            nBytes -= mp3FHsize;
-           int32_t i = findSync(buf, pos, nBytes);
-            pos += i;
-            nBytes -= i;
-            continue;
-        }
-        break;
-    }
-
-    return pos;
+    /* find byte-aligned syncword - need 12 (MPEG 1,2) or 11 (MPEG 2.5) matching bits,
+       frames with a wrong bitrate index or sampling rate frequency index are skipped */
+    return SyncScan_Header(buf, nBytes, SYNC_MP3);
 }
 /*****************************************************************************************************************************************************
  * Function:    MP3FindFreeSync
@@ -1281,6 +1223,13 @@ int32_t MP3FindFreeSync(uint8_t *buf, uint8_t firstFH[4], int32_t nBytes){
 
     return -1;
 }
+/* reduced decode modes, see MP3Decoder_SetQuality() */
+static inline bool ReducedBands(MP3Decoder_t *d) {
+    return d->quality != MP3_QUALITY_FULL && d->decInfo.samprate >= m_REDUCED_MINRATE;
+}
+static inline int32_t ReducedRateShift(MP3Decoder_t *d) { // 1: the output has half the stream rate
+    return (d->quality == MP3_QUALITY_HALFRATE && d->decInfo.samprate >= m_REDUCED_MINRATE) ? 1 : 0;
+}
 /***********************************************************************************************************************
  * Function:    MP3GetLastFrameInfo
  *
@@ -1294,35 +1243,38 @@ int32_t MP3FindFreeSync(uint8_t *buf, uint8_t firstFH[4], int32_t nBytes){
  * Return:      none
  *
  * Notes:       call this right after calling MP3Decode
+ *              samprate and outputSamps are those of the PCM output, half the stream values in MP3_QUALITY_HALFRATE
  **********************************************************************************************************************/
-void MP3GetLastFrameInfo() {
-    if (m_MP3DecInfo->layer != 3){
-        m_MP3FrameInfo->bitrate=0;
-        m_MP3FrameInfo->nChans=0;
-        m_MP3FrameInfo->samprate=0;
-        m_MP3FrameInfo->bitsPerSample=0;
-        m_MP3FrameInfo->outputSamps=0;
-        m_MP3FrameInfo->layer=0;
-        m_MP3FrameInfo->version=0;
+void MP3GetLastFrameInfo(MP3Decoder_t *d) {
+    if (d->decInfo.layer != 3 && !MP3_LAYER12){
+        d->frameInfo.bitrate=0;
+        d->frameInfo.nChans=0;
+        d->frameInfo.samprate=0;
+        d->frameInfo.bitsPerSample=0;
+        d->frameInfo.outputSamps=0;
+        d->frameInfo.layer=0;
+        d->frameInfo.version=0;
     }
     else{
-        m_MP3FrameInfo->bitrate=m_MP3DecInfo->bitrate;
-        m_MP3FrameInfo->nChans=m_MP3DecInfo->nChans;
-        m_MP3FrameInfo->samprate=m_MP3DecInfo->samprate;
-        m_MP3FrameInfo->bitsPerSample=16;
-        m_MP3FrameInfo->outputSamps=m_MP3DecInfo->nChans
-                * (int32_t) samplesPerFrameTab[m_MPEGVersion][m_MP3DecInfo->layer-1];
-        m_MP3FrameInfo->layer=m_MP3DecInfo->layer;
-        m_MP3FrameInfo->version=m_MPEGVersion;
-    }
-}
-int32_t MP3GetSampRate(){return m_MP3FrameInfo->samprate;}
-int32_t MP3GetChannels(){return m_MP3FrameInfo->nChans;}
-int32_t MP3GetBitsPerSample(){return m_MP3FrameInfo->bitsPerSample;}
-int32_t MP3GetBitrate(){return m_MP3FrameInfo->bitrate;}
-int32_t MP3GetOutputSamps(){return m_MP3FrameInfo->outputSamps;}
-int32_t MP3GetLayer(){return m_MP3FrameInfo->layer;}     // 0: Reserviert, 1: Layer III, 2: Layer II, 3: Layer I
-int32_t MP3GetVersion(){return m_MP3FrameInfo->version;} // 0: MPEG-2.5, 1: Reserviert, 2: MPEG-2 (ISO/IEC 13818-3), 3: MPEG-1 (ISO/IEC 11172-3)
+        d->frameInfo.bitrate=d->decInfo.bitrate;
+        d->frameInfo.nChans=d->decInfo.nChans;
+        d->frameInfo.samprate=d->decInfo.samprate >> ReducedRateShift(d);
+        d->frameInfo.bitsPerSample=16;
+        d->frameInfo.outputSamps=d->decInfo.nChans
+                * ((int32_t) samplesPerFrameTab[d->mpegVersion][d->decInfo.layer-1] >> ReducedRateShift(d));
+        d->frameInfo.layer=d->decInfo.layer;
+        d->frameInfo.version=d->mpegVersion;
+    }
+}
+int32_t MP3GetSampRate(MP3Decoder_t *d){return d->frameInfo.samprate;}
+int32_t MP3GetChannels(MP3Decoder_t *d){return d->frameInfo.nChans;}
+int32_t MP3GetBitsPerSample(MP3Decoder_t *d){return d->frameInfo.bitsPerSample;}
+int32_t MP3GetBitrate(MP3Decoder_t *d){return d->frameInfo.bitrate;}
+int32_t MP3GetOutputSamps(MP3Decoder_t *d){return d->frameInfo.outputSamps;}
+int32_t MP3GetLayer(MP3Decoder_t *d){return d->frameInfo.layer;}     // 1: Layer I, 2: Layer II, 3: Layer III
+int32_t MP3GetVersion(MP3Decoder_t *d){return d->frameInfo.version;} // MPEGVersion_t, 0: MPEG-1 (ISO/IEC 11172-3), 1: MPEG-2 (ISO/IEC 13818-3), 2: MPEG-2.5
+int32_t MP3GetMainDataBegin(MP3Decoder_t *d){return d->decInfo.mainDataBegin;} // bytes of the bit reservoir used by the last frame
+int32_t MP3GetMainDataSize(MP3Decoder_t *d){return d->decInfo.nSlots;}          // main data bytes in the last frame
 /***********************************************************************************************************************
  * Function:    MP3GetNextFrameInfo
  *
@@ -1335,12 +1287,12 @@ int32_t MP3GetVersion(){return m_MP3FrameInfo->version;} // 0: MPEG-2.5, 1: Rese
  *
  * Return:      error code, defined in mp3dec.h (0 means no error, < 0 means error)
  **********************************************************************************************************************/
-int32_t MP3GetNextFrameInfo(uint8_t *buf) {
+int32_t MP3GetNextFrameInfo(MP3Decoder_t *d, uint8_t *buf) {
 
-    if (UnpackFrameHeader( buf) == -1 || m_MP3DecInfo->layer != 3)
+    if (UnpackFrameHeader(d, buf) == -1 || (d->decInfo.layer != 3 && !MP3_LAYER12))
         return ERR_MP3_INVALID_FRAMEHEADER;
 
-    MP3GetLastFrameInfo();
+    MP3GetLastFrameInfo(d);
 
     return ERR_MP3_NONE;
 }
@@ -1356,9 +1308,9 @@ int32_t MP3GetNextFrameInfo(uint8_t *buf) {
  *
  * Return:      none
  **********************************************************************************************************************/
-void MP3ClearBadFrame(int16_t *outbuf) {
+void MP3ClearBadFrame(MP3Decoder_t *d, int16_t *outbuf) {
    int32_t i;
-    for (i = 0; i < m_MP3DecInfo->nGrans * m_MP3DecInfo->nGranSamps * m_MP3DecInfo->nChans; i++)
+    for (i = 0; i < d->decInfo.nGrans * d->decInfo.nGranSamps * d->decInfo.nChans; i++)
         outbuf[i] = 0;
 }
 /***********************************************************************************************************************
@@ -1372,7 +1324,7 @@ void MP3ClearBadFrame(int16_t *outbuf) {
  *              or reformatted as "self-contained" frames (useSize = 1)
  *
  * Outputs:     PCM data in outbuf, interleaved LRLRLR... if stereo
- *              number of output samples = nGrans * nGranSamps * nChans
+ *              number of output samples = nGrans * nGranSamps * nChans, half of it in MP3_QUALITY_HALFRATE
  *              updated inbuf pointer, updated bytesLeft
  *
  * Return:      error code, defined in mp3dec.h (0 means no error, < 0 means error)
@@ -1380,7 +1332,7 @@ void MP3ClearBadFrame(int16_t *outbuf) {
  * Notes:       switching useSize on and off between frames in the same stream
  *                is not supported (bit reservoir is not maintained if useSize on)
  **********************************************************************************************************************/
-int32_t MP3Decode( uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t useSize){
+int32_t MP3Decode(MP3Decoder_t *d, uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t useSize){
 
     // int main_data_begin_val = MP3_AnalyzeFrame(inbuf, *bytesLeft);
     // log_w("Main_Data_Begin %d", main_data_begin_val);
@@ -1388,39 +1340,46 @@ int32_t MP3Decode( uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t
     int32_t offset, bitOffset, mainBits, gr, ch, fhBytes, siBytes, freeFrameBytes;
     int32_t prevBitOffset, sfBlockBits, huffBlockBits;
     uint8_t *mainPtr;
-    static uint8_t underflowCounter = 0; // http://macslons-irish-pub-radio.stream.laut.fm/macslons-irish-pub-radio
 
     /* unpack frame header */
-    fhBytes = UnpackFrameHeader(inbuf);
+    fhBytes = UnpackFrameHeader(d, inbuf);
     if (fhBytes < 0){
         return ERR_MP3_INVALID_FRAMEHEADER; /* don't clear outbuf since we don't know size (failed to parse header) */
     }
+    if (d->decInfo.layer != 3) {
+#if MP3_LAYER12
+        return DecodeLayer12(d, inbuf, fhBytes, bytesLeft, outbuf);
+#else
+        MP3ClearBadFrame(d, outbuf);
+        return ERR_MP3_INVALID_FRAMEHEADER;
+#endif
+    }
     inbuf += fhBytes;
     /* unpack side info */
-    siBytes = UnpackSideInfo( inbuf);
+    siBytes = UnpackSideInfo(d, inbuf);
     if (siBytes < 0) {
-        MP3ClearBadFrame(outbuf);
+        MP3ClearBadFrame(d, outbuf);
         return ERR_MP3_INVALID_SIDEINFO;
     }
     inbuf += siBytes;
     *bytesLeft -= (fhBytes + siBytes);
 
     /* if free mode, need to calculate bitrate and nSlots manually, based on frame size */
-    if (m_MP3DecInfo->bitrate == 0 || m_MP3DecInfo->freeBitrateFlag) {
-        if(!m_MP3DecInfo->freeBitrateFlag){
+    if (d->decInfo.bitrate == 0 || d->decInfo.freeBitrateFlag) {
+        if(!d->decInfo.freeBitrateFlag){
             /* first time through, need to scan for next sync word and figure out frame size */
-            m_MP3DecInfo->freeBitrateFlag=1;
-            m_MP3DecInfo->freeBitrateSlots=MP3FindFreeSync(inbuf, inbuf - fhBytes - siBytes, *bytesLeft);
-            if(m_MP3DecInfo->freeBitrateSlots < 0){
-                MP3ClearBadFrame(outbuf);
-                m_MP3DecInfo->freeBitrateFlag = 0;
+            d->decInfo.freeBitrateFlag=1;
+            d->decInfo.freeBitrateSlots=MP3FindFreeSync(inbuf, inbuf - fhBytes - siBytes, *bytesLeft);
+            if(d->decInfo.freeBitrateSlots < 0){
+                MP3ClearBadFrame(d, outbuf);
+                d->decInfo.freeBitrateFlag = 0;
                 return ERR_MP3_FREE_BITRATE_SYNC;
             }
-            freeFrameBytes=m_MP3DecInfo->freeBitrateSlots + fhBytes + siBytes;
-            m_MP3DecInfo->bitrate=(freeFrameBytes * m_MP3DecInfo->samprate * 8)
-                    / (m_MP3DecInfo->nGrans * m_MP3DecInfo->nGranSamps);
+            freeFrameBytes=d->decInfo.freeBitrateSlots + fhBytes + siBytes;
+            d->decInfo.bitrate=(freeFrameBytes * d->decInfo.samprate * 8)
+                    / (d->decInfo.nGrans * d->decInfo.nGranSamps);
         }
-        m_MP3DecInfo->nSlots = m_MP3DecInfo->freeBitrateSlots + CheckPadBit(); /* add pad byte, if required */
+        d->decInfo.nSlots = d->decInfo.freeBitrateSlots + CheckPadBit(d); /* add pad byte, if required */
     }
 
     /* useSize != 0 means we're getting reformatted (RTP) packets (see RFC 3119)
@@ -1430,159 +1389,195 @@ int32_t MP3Decode( uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t
      *      frame is (in bytesLeft)
      */
     if (useSize) {
-        m_MP3DecInfo->nSlots = *bytesLeft;
-        if (m_MP3DecInfo->mainDataBegin != 0 || m_MP3DecInfo->nSlots <= 0) {
+        d->decInfo.nSlots = *bytesLeft;
+        if (d->decInfo.mainDataBegin != 0 || d->decInfo.nSlots <= 0) {
             /* error - non self-contained frame, or missing frame (size <= 0), could do loss concealment here */
-            MP3ClearBadFrame(outbuf);
+            MP3ClearBadFrame(d, outbuf);
             return ERR_MP3_INVALID_FRAMEHEADER;
         }
 
         /* can operate in-place on reformatted frames */
-        m_MP3DecInfo->mainDataBytes = m_MP3DecInfo->nSlots;
+        d->decInfo.mainDataBytes = d->decInfo.nSlots;
         mainPtr = inbuf;
-        inbuf += m_MP3DecInfo->nSlots;
-        *bytesLeft -= (m_MP3DecInfo->nSlots);
+        inbuf += d->decInfo.nSlots;
+        *bytesLeft -= (d->decInfo.nSlots);
     } else {
         /* out of data - assume last or truncated frame */
-        if (m_MP3DecInfo->nSlots > *bytesLeft) {
-            MP3ClearBadFrame(outbuf);
+        if (d->decInfo.nSlots > *bytesLeft) {
+            MP3ClearBadFrame(d, outbuf);
             return ERR_MP3_INDATA_UNDERFLOW;
         }
         /* fill main data buffer with enough new data for this frame */
-        if (m_MP3DecInfo->mainDataBytes >= m_MP3DecInfo->mainDataBegin) {
+        if (d->decInfo.mainDataBytes >= d->decInfo.mainDataBegin) {
             /* adequate "old" main data available (i.e. bit reservoir) */
-            underflowCounter = 0;
-            memmove(m_MP3DecInfo->mainBuf,
-                    m_MP3DecInfo->mainBuf + m_MP3DecInfo->mainDataBytes - m_MP3DecInfo->mainDataBegin,
-                    m_MP3DecInfo->mainDataBegin);
-            memcpy (m_MP3DecInfo->mainBuf + m_MP3DecInfo->mainDataBegin, inbuf,
-                    m_MP3DecInfo->nSlots);
-
-            m_MP3DecInfo->mainDataBytes = m_MP3DecInfo->mainDataBegin + m_MP3DecInfo->nSlots;
-            inbuf += m_MP3DecInfo->nSlots;
-            *bytesLeft -= (m_MP3DecInfo->nSlots);
-            mainPtr = m_MP3DecInfo->mainBuf;
+            d->underflowCounter = 0;
+            memmove(d->decInfo.mainBuf,
+                    d->decInfo.mainBuf + d->decInfo.mainDataBytes - d->decInfo.mainDataBegin,
+                    d->decInfo.mainDataBegin);
+            memcpy (d->decInfo.mainBuf + d->decInfo.mainDataBegin, inbuf,
+                    d->decInfo.nSlots);
+
+            d->decInfo.mainDataBytes = d->decInfo.mainDataBegin + d->decInfo.nSlots;
+            inbuf += d->decInfo.nSlots;
+            *bytesLeft -= (d->decInfo.nSlots);
+            mainPtr = d->decInfo.mainBuf;
         } else {
             /* not enough data in bit reservoir from previous frames (perhaps starting in middle of file) */
-            underflowCounter ++;
-            memcpy(m_MP3DecInfo->mainBuf + m_MP3DecInfo->mainDataBytes, inbuf, m_MP3DecInfo->nSlots);
-            m_MP3DecInfo->mainDataBytes += m_MP3DecInfo->nSlots;
-            inbuf += m_MP3DecInfo->nSlots;
-            *bytesLeft -= (m_MP3DecInfo->nSlots);
-            if(underflowCounter < 4){
+            d->underflowCounter ++;
+            memcpy(d->decInfo.mainBuf + d->decInfo.mainDataBytes, inbuf, d->decInfo.nSlots);
+            d->decInfo.mainDataBytes += d->decInfo.nSlots;
+            inbuf += d->decInfo.nSlots;
+            *bytesLeft -= (d->decInfo.nSlots);
+            if(d->underflowCounter < 4){
+                MP3ClearBadFrame(d, outbuf); // the frame is played as silence, the sample count stays in step with the stream
+                MP3GetLastFrameInfo(d);
                 return ERR_MP3_NONE;
             }
-            MP3ClearBadFrame( outbuf);
+            MP3ClearBadFrame(d, outbuf);
             return ERR_MP3_MAINDATA_UNDERFLOW;
         }
     }
     bitOffset = 0;
-    mainBits = m_MP3DecInfo->mainDataBytes * 8;
+    mainBits = d->decInfo.mainDataBytes * 8;
 
     /* decode one complete frame */
-    for (gr = 0; gr < m_MP3DecInfo->nGrans; gr++) {
-        for (ch = 0; ch < m_MP3DecInfo->nChans; ch++) {
+    for (gr = 0; gr < d->decInfo.nGrans; gr++) {
+        for (ch = 0; ch < d->decInfo.nChans; ch++) {
             /* unpack scale factors and compute size of scale factor block */
             prevBitOffset = bitOffset;
-            offset = UnpackScaleFactors( mainPtr, &bitOffset,
+            offset = UnpackScaleFactors(d, mainPtr, &bitOffset,
                     mainBits, gr, ch);
             sfBlockBits = 8 * offset - prevBitOffset + bitOffset;
-            huffBlockBits = m_MP3DecInfo->part23Length[gr][ch] - sfBlockBits;
+            huffBlockBits = d->decInfo.part23Length[gr][ch] - sfBlockBits;
             mainPtr += offset;
             mainBits -= sfBlockBits;
 
             if (offset < 0 || mainBits < huffBlockBits) {
-                MP3ClearBadFrame(outbuf);
+                MP3ClearBadFrame(d, outbuf);
                 return ERR_MP3_INVALID_SCALEFACT;
             }
             /* decode Huffman code words */
             prevBitOffset = bitOffset;
-            offset = DecodeHuffman( mainPtr, &bitOffset, huffBlockBits, gr, ch);
+            offset = DecodeHuffman(d, mainPtr, &bitOffset, huffBlockBits, gr, ch);
             if (offset < 0) {
-                MP3ClearBadFrame( outbuf);
+                MP3ClearBadFrame(d, outbuf);
                 return ERR_MP3_INVALID_HUFFCODES;
             }
             mainPtr += offset;
             mainBits -= (8 * offset - prevBitOffset + bitOffset);
         }
         /* dequantize coefficients, decode stereo, reorder int16_t blocks */
-        if (MP3Dequantize( gr) < 0) {
-            MP3ClearBadFrame(outbuf);
+        if (MP3Dequantize(d, gr) < 0) {
+            MP3ClearBadFrame(d, outbuf);
             return ERR_MP3_INVALID_DEQUANTIZE;
         }
 
         /* alias reduction, inverse MDCT, overlap-add, frequency inversion */
-        for (ch = 0; ch < m_MP3DecInfo->nChans; ch++) {
-            if (IMDCT( gr, ch) < 0) {
-                MP3ClearBadFrame(outbuf);
+        for (ch = 0; ch < d->decInfo.nChans; ch++) {
+            if (IMDCT(d, gr, ch) < 0) {
+                MP3ClearBadFrame(d, outbuf);
                 return ERR_MP3_INVALID_IMDCT;
             }
         }
         /* subband transform - if stereo, interleaves pcm LRLRLR */
-        if (Subband(
-                outbuf + gr * m_MP3DecInfo->nGranSamps * m_MP3DecInfo->nChans)
+        if (Subband(d,
+                outbuf + gr * (d->decInfo.nGranSamps >> ReducedRateShift(d)) * d->decInfo.nChans, m_BLOCK_SIZE)
                 < 0) {
-            MP3ClearBadFrame(outbuf);
+            MP3ClearBadFrame(d, outbuf);
             return ERR_MP3_INVALID_SUBBAND;
         }
     }
-    MP3GetLastFrameInfo();
+    MP3GetLastFrameInfo(d);
     return ERR_MP3_NONE;
 }
 
+/***********************************************************************************************************************
+ * Function:    MP3Decoder_Init
+ *
+ * Description: places a decoder instance in a buffer supplied by the caller
+ *
+ * Inputs:      buffer of at least MP3Decoder_StateSize() bytes, 4 byte aligned
+ *              size of the buffer
+ *
+ * Outputs:     cleared instance
+ *
+ * Return:      pointer to the instance, NULL if the buffer is missing or too small
+ *
+ * Notes:       the instance holds the complete state of one stream, no other memory is used between frames.
+ *              Instances are independent, two tasks may each decode with their own instance at the same time.
+ *              The caller owns the buffer, there is nothing to free.
+ **********************************************************************************************************************/
+MP3Decoder_t *MP3Decoder_Init(void *buf, size_t size) {
+    if(!buf || size < sizeof(MP3Decoder_t)) return NULL;
+    MP3Decoder_t *d = (MP3Decoder_t*)buf;
+    MP3Decoder_ClearBuffer(d);
+#if MP3_HUFF_FAST_BITS
+    InitHuffmanFastTables();
+#endif
+    return d;
+}
 /***********************************************************************************************************************
  * Function:    MP3Decoder_ClearBuffer
  *
  * Description: clear all the memory needed for the MP3 decoder
  *
- * Inputs:      none
+ * Inputs:      instance
  *
  * Outputs:     none
  *
  * Return:      none
  *
  **********************************************************************************************************************/
-void MP3Decoder_ClearBuffer(void) {
+void MP3Decoder_ClearBuffer(MP3Decoder_t *d) {
 
+    uint8_t quality = d->quality;
     /* important to do this - DSP primitives assume a bunch of state variables are 0 on first use */
-    memset( m_MP3DecInfo,         0, sizeof(MP3DecInfo_t));                                    //Clear MP3DecInfo
-    memset(&m_ScaleFactorInfoSub, 0, sizeof(ScaleFactorInfoSub_t)*(m_MAX_NGRAN *m_MAX_NCHAN)); //Clear ScaleFactorInfo
-    memset( m_SideInfo,           0, sizeof(SideInfo_t));                                      //Clear SideInfo
-    memset( m_FrameHeader,        0, sizeof(FrameHeader_t));                                   //Clear FrameHeader
-    memset( m_HuffmanInfo,        0, sizeof(HuffmanInfo_t));                                   //Clear HuffmanInfo
-    memset( m_DequantInfo,        0, sizeof(DequantInfo_t));                                   //Clear DequantInfo
-    memset( m_IMDCTInfo,          0, sizeof(IMDCTInfo_t));                                     //Clear IMDCTInfo
-    memset( m_SubbandInfo,        0, sizeof(SubbandInfo_t));                                   //Clear SubbandInfo
-    memset(&m_CriticalBandInfo,   0, sizeof(CriticalBandInfo_t)*m_MAX_NCHAN);                  //Clear CriticalBandInfo
-    memset( m_ScaleFactorJS,      0, sizeof(ScaleFactorJS_t));                                 //Clear ScaleFactorJS
-    memset(&m_SideInfoSub,        0, sizeof(SideInfoSub_t)*(m_MAX_NGRAN *m_MAX_NCHAN));        //Clear SideInfoSub
-    memset(&m_SFBandTable,        0, sizeof(SFBandTable_t));                                   //Clear SFBandTable
-    memset( m_MP3FrameInfo,       0, sizeof(MP3FrameInfo_t));                                  //Clear MP3FrameInfo
-
+    memset(d, 0, sizeof(MP3Decoder_t));
+    d->quality = quality;
     return;
 
 }
+void MP3Decoder_ClearBuffer(void) {
+    if(m_MP3Decoder) MP3Decoder_ClearBuffer(m_MP3Decoder);
+}
+/***********************************************************************************************************************
+ * Function:    MP3Decoder_SetQuality
+ *
+ * Description: choose the decode quality / complexity
+ *
+ * Inputs:      instance
+ *              MP3_QUALITY_FULL, MP3_QUALITY_LOWPASS or MP3_QUALITY_HALFRATE
+ *
+ * Outputs:     none
+ *
+ * Return:      none
+ *
+ * Notes:       LOWPASS drops subbands 16...31 before the alias reduction, the IMDCT skips them (half of the hybrid
+ *                filterbank), bandwidth 11kHz at 44.1kHz
+ *              HALFRATE also computes every second output sample of the synthesis filter only, the output rate
+ *                (MP3GetSampRate()) and the number of samples (MP3GetOutputSamps()) are halved
+ *              MPEG2 and 2.5 streams (<= 24kHz) are always decoded in full, their bandwidth is already small
+ *              set it between streams, a change within a stream changes the output rate without notice
+ **********************************************************************************************************************/
+void MP3Decoder_SetQuality(MP3Decoder_t *d, uint8_t quality) {
+    d->quality = (quality <= MP3_QUALITY_HALFRATE) ? quality : (uint8_t)MP3_QUALITY_FULL;
+}
 /***********************************************************************************************************************
  * Function:    MP3Decoder_AllocateBuffers
  *
- * Description: allocate all the memory needed for the MP3 decoder
+ * Description: allocate the instance used by the functions without instance argument
  *
  * Inputs:      none
  *
  * Outputs:     none
  *
- * Return:      pointer to MP3DecInfo structure (initialized with pointers to all
- *                the internal buffers needed for decoding)
- *
- * Notes:       if one or more mallocs fail, function frees any buffers already
- *                allocated before returning
+ * Return:      true if the instance could be allocated
  *
  **********************************************************************************************************************/
 
 #ifdef CONFIG_IDF_TARGET_ESP32S3
-    // ESP32-S3: If there is PSRAM, prefer it
-    #define __malloc_heap_psram(size) \
-        heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT|MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT|MALLOC_CAP_INTERNAL)
+    // ESP32-S3: If there is PSRAM, prefer it, take the buffers from the audio arena
+    #define __malloc_heap_psram(size) AudioArena_Malloc(size)
 #else
     // ESP32, PSRAM is too slow, prefer SRAM
     #define __malloc_heap_psram(size) \
@@ -1590,25 +1585,28 @@ void MP3Decoder_ClearBuffer(void) {
 #endif
 
 bool MP3Decoder_AllocateBuffers(void) {
-    if(!m_MP3DecInfo)       {m_MP3DecInfo    = (MP3DecInfo_t*)    __malloc_heap_psram(sizeof(MP3DecInfo_t)   );}
-    if(!m_FrameHeader)      {m_FrameHeader   = (FrameHeader_t*)   __malloc_heap_psram(sizeof(FrameHeader_t)  );}
-    if(!m_SideInfo)         {m_SideInfo      = (SideInfo_t*)      __malloc_heap_psram(sizeof(SideInfo_t)     );}
-    if(!m_ScaleFactorJS)    {m_ScaleFactorJS = (ScaleFactorJS_t*) __malloc_heap_psram(sizeof(ScaleFactorJS_t));}
-    if(!m_HuffmanInfo)      {m_HuffmanInfo   = (HuffmanInfo_t*)   __malloc_heap_psram(sizeof(HuffmanInfo_t)  );}
-    if(!m_DequantInfo)      {m_DequantInfo   = (DequantInfo_t*)   __malloc_heap_psram(sizeof(DequantInfo_t)  );}
-    if(!m_IMDCTInfo)        {m_IMDCTInfo     = (IMDCTInfo_t*)     __malloc_heap_psram(sizeof(IMDCTInfo_t)    );}
-    if(!m_SubbandInfo)      {m_SubbandInfo   = (SubbandInfo_t*)   __malloc_heap_psram(sizeof(SubbandInfo_t)  );}
-    if(!m_MP3FrameInfo)     {m_MP3FrameInfo  = (MP3FrameInfo_t*)  __malloc_heap_psram(sizeof(MP3FrameInfo_t) );}
-
-    if(!m_MP3DecInfo || !m_FrameHeader || !m_SideInfo || !m_ScaleFactorJS || !m_HuffmanInfo ||
-       !m_DequantInfo || !m_IMDCTInfo || !m_SubbandInfo || !m_MP3FrameInfo) {
-        MP3Decoder_FreeBuffers();
+    if(!m_MP3Decoder) {m_MP3Decoder = MP3Decoder_New();}
+    if(!m_MP3Decoder) {
         log_e("not enough memory to allocate mp3decoder buffers");
         return false;
     }
-    MP3Decoder_ClearBuffer();
     return true;
 }
+/***********************************************************************************************************************
+ * Function:    MP3Decoder_StateSize
+ *
+ * Description: bytes of one instance, the size of the buffer for MP3Decoder_Init()
+ *
+ * Inputs:      none
+ *
+ * Outputs:     none
+ *
+ * Return:      size rounded up to the block alignment of the audio arena, sizes the arena
+ *
+ **********************************************************************************************************************/
+size_t MP3Decoder_StateSize(void) {
+    return AUDIO_ARENA_ALIGN(sizeof(MP3Decoder_t));
+}
 /***********************************************************************************************************************
  * Function:    MP3Decoder_IsInit
  *
@@ -1619,48 +1617,365 @@ bool MP3Decoder_AllocateBuffers(void) {
  * Outputs:     none
  *
  * Return:      true if buffers allocated, otherwise false
-
+ *
  **********************************************************************************************************************/
 bool MP3Decoder_IsInit(void) {
-    if(!m_MP3DecInfo || !m_FrameHeader || !m_SideInfo || !m_ScaleFactorJS || !m_HuffmanInfo ||
-       !m_DequantInfo || !m_IMDCTInfo || !m_SubbandInfo || !m_MP3FrameInfo) {
-        return false;
-    }
-    return true;
+    return m_MP3Decoder != NULL;
 }
 /***********************************************************************************************************************
  * Function:    MP3Decoder_FreeBuffers
  *
- * Description: frees all the memory used by the MP3 decoder
+ * Description: frees the instance allocated by MP3Decoder_AllocateBuffers()
  *
- * Inputs:      pointer to initialized MP3DecInfo structure
+ * Inputs:      none
  *
  * Outputs:     none
  *
  * Return:      none
  *
- * Notes:       safe to call even if some buffers were not allocated
+ * Notes:       safe to call even if the instance was not allocated
  **********************************************************************************************************************/
 void MP3Decoder_FreeBuffers()
 {
-//    uint32_t i = ESP.getFreeHeap();
+    if(m_MP3Decoder) {MP3Decoder_Delete(m_MP3Decoder); m_MP3Decoder = NULL;}
+}
+/***********************************************************************************************************************
+ * Function:    MP3Decoder_New, MP3Decoder_Delete
+ *
+ * Description: an instance of its own in the audio arena (the heap if the arena is full), as AudioCodec owns one
+ *
+ * Inputs:      none / the instance
+ *
+ * Outputs:     none
+ *
+ * Return:      cleared instance, NULL if there is not enough memory
+ *
+ * Notes:       arena blocks are released by AudioArena::reset(), heap blocks by MP3Decoder_Delete()
+ **********************************************************************************************************************/
+MP3Decoder_t *MP3Decoder_New(void) {
+    void *buf = __malloc_heap_psram(sizeof(MP3Decoder_t));
+    MP3Decoder_t *d = MP3Decoder_Init(buf, sizeof(MP3Decoder_t));
+    if(!d) AudioArena_Free(buf);
+    return d;
+}
+void MP3Decoder_Delete(MP3Decoder_t *d) {
+    AudioArena_Free(d);
+}
+/* functions without instance argument, they use the instance of MP3Decoder_AllocateBuffers() */
+int32_t MP3Decode(uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t useSize) {
+    return MP3Decode(m_MP3Decoder, inbuf, bytesLeft, outbuf, useSize);
+}
+void    MP3Decoder_SetQuality(uint8_t q)  {if(m_MP3Decoder) MP3Decoder_SetQuality(m_MP3Decoder, q);}
+void    MP3GetLastFrameInfo()             {MP3GetLastFrameInfo(m_MP3Decoder);}
+int32_t MP3GetNextFrameInfo(uint8_t *buf) {return MP3GetNextFrameInfo(m_MP3Decoder, buf);}
+int32_t MP3GetSampRate()                  {return MP3GetSampRate(m_MP3Decoder);}
+int32_t MP3GetChannels()                  {return MP3GetChannels(m_MP3Decoder);}
+int32_t MP3GetBitsPerSample()             {return MP3GetBitsPerSample(m_MP3Decoder);}
+int32_t MP3GetBitrate()                   {return MP3GetBitrate(m_MP3Decoder);}
+int32_t MP3GetOutputSamps()               {return MP3GetOutputSamps(m_MP3Decoder);}
+int32_t MP3GetLayer()                     {return MP3GetLayer(m_MP3Decoder);}
+int32_t MP3GetVersion()                   {return MP3GetVersion(m_MP3Decoder);}
+int32_t MP3GetMainDataBegin()             {return MP3GetMainDataBegin(m_MP3Decoder);}
+int32_t MP3GetMainDataSize()              {return MP3GetMainDataSize(m_MP3Decoder);}
 
-    if(m_MP3DecInfo)        {free(m_MP3DecInfo);      m_MP3DecInfo=NULL;}
-    if(m_FrameHeader)       {free(m_FrameHeader);     m_FrameHeader=NULL;}
-    if(m_SideInfo)          {free(m_SideInfo);        m_SideInfo=NULL;}
-    if(m_ScaleFactorJS )    {free(m_ScaleFactorJS);   m_ScaleFactorJS=NULL;}
-    if(m_HuffmanInfo)       {free(m_HuffmanInfo);     m_HuffmanInfo=NULL;}
-    if(m_DequantInfo)       {free(m_DequantInfo);     m_DequantInfo=NULL;}
-    if(m_IMDCTInfo)         {free(m_IMDCTInfo);       m_IMDCTInfo=NULL;}
-    if(m_SubbandInfo)       {free(m_SubbandInfo);     m_SubbandInfo=NULL;}
-    if(m_MP3FrameInfo)      {free(m_MP3FrameInfo);    m_MP3FrameInfo=NULL;}
+/***********************************************************************************************************************
+ * H U F F M A N N
+ **********************************************************************************************************************/
 
-//    log_i("MP3Decoder: %lu bytes memory was freed", ESP.getFreeHeap() - i);
+#if MP3_HUFF_FAST_BITS
+/***********************************************************************************************************************
+ * First level lookup tables, built once from huffTable and quadTable by InitHuffmanFastTables().
+ * Indexed with the next MP3_HUFF_FAST_BITS bits of the stream, an entry holds up to two complete codewords (pairs or
+ * quads) including their sign bits. 0: the first codeword is longer than the index or has an escape (linbits), it is
+ * decoded through huffTable as before.
+ *   pair entry: bits 0-3 length, 4-7 |x|, 8 sign x, 9-12 |y|, 13 sign y, bits 14-27 the same for the second pair
+ *   quad entry: bits 0-3 length, 4-11 v, w, x, y (bit 0: 1, bit 1: sign), bits 12-23 the same for the second quad
+ * The tables are constant after init and shared by all decoder instances. They are built once, under a std::call_once
+ * flag: two tasks that create their first decoder at the same time (render and playback, dual core) find them complete.
+ **********************************************************************************************************************/
+#if MP3_HUFF_FAST_BITS < 4 || MP3_HUFF_FAST_BITS > 10
+#error "MP3_HUFF_FAST_BITS: 4...10 or 0"
+#endif
+#define HUFF_FAST_PAIRTABS 15  // distinct pair code tables, 16...23 and 24...31 share theirs, the escape (15) needs linbits
+#define HUFF_FAST_SIZE     (1 << MP3_HUFF_FAST_BITS)
+
+static uint32_t s_huffFastPairs[HUFF_FAST_PAIRTABS][HUFF_FAST_SIZE];
+static uint32_t s_huffFastQuads[2][HUFF_FAST_SIZE];
+static int8_t   s_huffFastSlot[m_HUFF_PAIRTABS];
+static std::once_flag s_huffFastOnce;
+
+/* one pair from the left justified bits, 'avail' of them are known, returns the bits used or 0 */
+static int32_t FastPairOf(const uint16_t *tBase, int32_t tabType, uint64_t bits, int32_t avail, uint32_t *xy) {
+    const uint16_t *tCurr = tBase;
+    int32_t pos = 0, maxBits, len, x, y;
+    uint16_t cw;
+    if (tabType == oneShot) {
+        maxBits = pgm_read_word(&tBase[0]) & 0x000f;
+        cw = pgm_read_word(&tBase[1 + (bits >> (64 - maxBits))]);
+    } else {
+        while (1) {
+            maxBits = pgm_read_word(&tCurr[0]) & 0x000f;
+            cw = pgm_read_word(&tCurr[((bits << pos) >> (64 - maxBits)) + 1]);
+            if ((cw >> 12) & 0x000f) break;
+            pos += maxBits;
+            if (pos >= avail) return 0;
+            tCurr += cw;
+        }
+    }
+    len = pos + ((cw >> 12) & 0x000f);
+    x = (cw >> 4) & 0x000f;
+    y = (cw >> 8) & 0x000f;
+    if (tabType == loopLinbits && (x == 15 || y == 15)) return 0;
+    if (len + (x ? 1 : 0) + (y ? 1 : 0) > avail) return 0;
+    if (x) {x |= ((bits << len) >> 63) << 4; len++;}
+    if (y) {y |= ((bits << len) >> 63) << 4; len++;}
+    *xy = x | (y << 5);
+    return len;
+}
+//----------------------------------------------------------------------------------------------------------------------
+/* one quad, same as FastPairOf() */
+static int32_t FastQuadOf(const uint8_t *tBase, int32_t maxBits, uint64_t bits, int32_t avail, uint32_t *vwxy) {
+    uint8_t cw = pgm_read_byte(&tBase[bits >> (64 - maxBits)]);
+    int32_t len = (cw >> 4) & 0x0f;
+    uint32_t q = 0;
+    for (int32_t k = 0; k < 4; k++) {
+        if (!((cw >> (3 - k)) & 0x01)) continue;
+        if (len >= avail) return 0;
+        q |= (1 | ((bits << len) >> 63) << 1) << (2 * k);
+        len++;
+    }
+    if (len > avail) return 0;
+    *vwxy = q;
+    return len;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void BuildHuffmanFastTables(void) {
+    int32_t slots = 0, offs[HUFF_FAST_PAIRTABS], lin[HUFF_FAST_PAIRTABS];
+    for (int32_t t = 0; t < m_HUFF_PAIRTABS; t++) {
+        int32_t tabType = huffTabLookup[t].tabType;
+        s_huffFastSlot[t] = -1;
+        if (tabType != oneShot && tabType != loopNoLinbits && tabType != loopLinbits) continue;
+        for (int32_t s = 0; s < slots; s++) {
+            if (offs[s] == huffTabOffset[t] && lin[s] == (tabType == loopLinbits)) {s_huffFastSlot[t] = s; break;}
+        }
+        if (s_huffFastSlot[t] >= 0 || slots == HUFF_FAST_PAIRTABS) continue;
+        offs[slots] = huffTabOffset[t];
+        lin[slots] = (tabType == loopLinbits);
+        s_huffFastSlot[t] = slots;
+        const uint16_t *tBase = huffTable + huffTabOffset[t];
+        for (uint32_t i = 0; i < HUFF_FAST_SIZE; i++) {
+            uint64_t bits = (uint64_t)i << (64 - MP3_HUFF_FAST_BITS);
+            uint32_t xy1, xy2;
+            int32_t  n1 = FastPairOf(tBase, tabType, bits, MP3_HUFF_FAST_BITS, &xy1), n2 = 0;
+            if (n1) n2 = FastPairOf(tBase, tabType, bits << n1, MP3_HUFF_FAST_BITS - n1, &xy2);
+            s_huffFastPairs[slots][i] = n1 ? (n1 | xy1 << 4 | (n2 ? (n2 | xy2 << 4) << 14 : 0)) : 0;
+        }
+        slots++;
+    }
+    for (int32_t t = 0; t < 2; t++) {
+        const uint8_t *tBase = quadTable + quadTabOffset[t];
+        for (uint32_t i = 0; i < HUFF_FAST_SIZE; i++) {
+            uint64_t bits = (uint64_t)i << (64 - MP3_HUFF_FAST_BITS);
+            uint32_t q1, q2;
+            int32_t  n1 = FastQuadOf(tBase, quadTabMaxBits[t], bits, MP3_HUFF_FAST_BITS, &q1), n2 = 0;
+            if (n1) n2 = FastQuadOf(tBase, quadTabMaxBits[t], bits << n1, MP3_HUFF_FAST_BITS - n1, &q2);
+            s_huffFastQuads[t][i] = n1 ? (n1 | q1 << 4 | (n2 ? (n2 | q2 << 4) << 12 : 0)) : 0;
+        }
+    }
 }
 
+void InitHuffmanFastTables(void) { // the other callers wait until the first one has built the tables
+    std::call_once(s_huffFastOnce, BuildHuffmanFastTables);
+}
+//----------------------------------------------------------------------------------------------------------------------
+/* 4 bytes into the 64 bit cache, cachedBits < 32 */
+#define HUFF_REFILL64(cache, cachedBits, buf) { \
+    (cache) |= (uint64_t)((uint32_t)(buf)[0] << 24 | (uint32_t)(buf)[1] << 16 | (uint32_t)(buf)[2] << 8 | (buf)[3]) << (32 - (cachedBits)); \
+    (buf) += 4; (cachedBits) += 32; \
+}
+/* sign-magnitude value of the fast tables, 4 bit magnitude, sign at bit 4 */
+#define HUFF_FAST_VAL(e, shift)  ((int32_t)((((e) >> (shift)) & 0x0f) | ((((e) >> ((shift) + 4)) & 0x01) << 31)))
+/* one bit value of a quad entry, sign at the next bit */
+#define HUFF_QUAD_VAL(e, shift)  ((int32_t)((((e) >> (shift)) & 0x01) | ((((e) >> ((shift) + 1)) & 0x01) << 31)))
+/* back to the 32 bit cache of the callers: whole bytes are given back until at most 16 bits are cached */
+#define HUFF_RETURN32(cache, cachedBits, buf, bitsLeft, pCache, pCachedBits, pBuf, pBitsLeft) { \
+    while ((cachedBits) > 16) {(buf)--; (cachedBits) -= 8; (bitsLeft) += 8;} \
+    (cache) = (cachedBits) ? (cache) & (~0ULL << (64 - (cachedBits))) : 0; \
+    *(pCache) = (uint32_t)((cache) >> 32); *(pCachedBits) = (cachedBits); *(pBuf) = (buf); *(pBitsLeft) = (bitsLeft); \
+}
 /***********************************************************************************************************************
- * H U F F M A N N
+ * Function:    DecodeHuffmanPairsFast
+ *
+ * Description: decodes the pairs of DecodeHuffmanPairs() while there are enough bits left in the granule, the codewords
+ *              at the end are left to DecodeHuffmanPairs(), so that the handling of the last bits does not change
+ *
+ * Inputs:      state of DecodeHuffmanPairs() after the partial first byte was loaded
+ *
+ * Outputs:     decoded pairs, updated state (32 bit cache with at most 16 bits)
+ *
+ * Return:      number of values still to decode
+ *
+ * Notes:       64 bit cache refilled with 4 bytes at a time, at least 32 bits are cached at the start of a pair
  **********************************************************************************************************************/
+int32_t DecodeHuffmanPairsFast(int32_t **pxy, int32_t nVals, int32_t tabIdx, int32_t *pBitsLeft, uint8_t **pBuf,
+                               uint32_t *pCache, int32_t *pCachedBits){
+    const uint32_t *fTab = s_huffFastPairs[s_huffFastSlot[tabIdx]];
+    const uint16_t *tBase = huffTable + huffTabOffset[tabIdx], *tCurr;
+    int32_t tabType = huffTabLookup[tabIdx].tabType, linBits = huffTabLookup[tabIdx].linBits;
+    int32_t *xy = *pxy, bitsLeft = *pBitsLeft, cachedBits = *pCachedBits, maxBits, len, x, y;
+    uint8_t *buf = *pBuf;
+    uint64_t cache = (uint64_t)*pCache << 32;
+    uint32_t e;
+    uint16_t cw;
+
+    while (nVals > 0) {
+        /* a pair with escapes takes up to 19 + 2 * 14 bits, 32 cached and 32 more in the buffer are enough */
+        if (cachedBits < 32) {
+            if (bitsLeft < 64) break;
+            HUFF_REFILL64(cache, cachedBits, buf);
+            bitsLeft -= 32;
+        } else if (bitsLeft < 32) break;
+
+        e = fTab[cache >> (64 - MP3_HUFF_FAST_BITS)];
+        if (e) {
+            len = e & 0x0f;
+            xy[0] = HUFF_FAST_VAL(e, 4);
+            xy[1] = HUFF_FAST_VAL(e, 9);
+            cache <<= len; cachedBits -= len;
+            xy += 2; nVals -= 2;
+            len = (e >> 14) & 0x0f;
+            if (len && nVals > 0) {
+                xy[0] = HUFF_FAST_VAL(e, 18);
+                xy[1] = HUFF_FAST_VAL(e, 23);
+                cache <<= len; cachedBits -= len;
+                xy += 2; nVals -= 2;
+            }
+            continue;
+        }
+
+        /* long codeword or escape, walk huffTable as DecodeHuffmanPairs() */
+        if (tabType == oneShot) {
+            maxBits = pgm_read_word(&tBase[0]) & 0x000f;
+            cw = pgm_read_word(&tBase[1 + (cache >> (64 - maxBits))]);
+        } else {
+            tCurr = tBase;
+            while (1) {
+                maxBits = pgm_read_word(&tCurr[0]) & 0x000f;
+                cw = pgm_read_word(&tCurr[(cache >> (64 - maxBits)) + 1]);
+                if ((cw >> 12) & 0x000f) break;
+                cachedBits -= maxBits;
+                cache <<= maxBits;
+                tCurr += cw;
+            }
+        }
+        len = (cw >> 12) & 0x000f;
+        cachedBits -= len;
+        cache <<= len;
+        x = (cw >> 4) & 0x000f;
+        y = (cw >> 8) & 0x000f;
+
+        if (x == 15 && tabType == loopLinbits) {
+            if (cachedBits < linBits + 1) {HUFF_REFILL64(cache, cachedBits, buf); bitsLeft -= 32;}
+            x += (int32_t)(cache >> (64 - linBits));
+            cachedBits -= linBits;
+            cache <<= linBits;
+        }
+        if (x) {
+            x |= (uint32_t)(cache >> 32) & 0x80000000;
+            cache <<= 1;
+            cachedBits--;
+        }
+        if (y == 15 && tabType == loopLinbits) {
+            if (cachedBits < linBits + 1) {HUFF_REFILL64(cache, cachedBits, buf); bitsLeft -= 32;}
+            y += (int32_t)(cache >> (64 - linBits));
+            cachedBits -= linBits;
+            cache <<= linBits;
+        }
+        if (y) {
+            y |= (uint32_t)(cache >> 32) & 0x80000000;
+            cache <<= 1;
+            cachedBits--;
+        }
+        xy[0] = x;
+        xy[1] = y;
+        xy += 2; nVals -= 2;
+    }
+    HUFF_RETURN32(cache, cachedBits, buf, bitsLeft, pCache, pCachedBits, pBuf, pBitsLeft);
+    *pxy = xy;
+    return nVals;
+}
+/***********************************************************************************************************************
+ * Function:    DecodeHuffmanQuadsFast
+ *
+ * Description: decodes the quads of DecodeHuffmanQuads() while there are enough bits left, same as
+ *              DecodeHuffmanPairsFast()
+ *
+ * Inputs:      state of DecodeHuffmanQuads() after the partial first byte was loaded
+ *
+ * Outputs:     decoded quads, updated state (32 bit cache with at most 16 bits)
+ *
+ * Return:      number of values decoded
+ **********************************************************************************************************************/
+int32_t DecodeHuffmanQuadsFast(int32_t **pvwxy, int32_t nVals, int32_t tabIdx, int32_t *pBitsLeft, uint8_t **pBuf,
+                               uint32_t *pCache, int32_t *pCachedBits){
+    const uint32_t *fTab = s_huffFastQuads[tabIdx];
+    const uint8_t *tBase = quadTable + quadTabOffset[tabIdx];
+    int32_t maxBits = quadTabMaxBits[tabIdx];
+    int32_t *vwxy = *pvwxy, bitsLeft = *pBitsLeft, cachedBits = *pCachedBits, i = 0, len;
+    uint8_t *buf = *pBuf, cw;
+    uint64_t cache = (uint64_t)*pCache << 32;
+    uint32_t e;
+
+    while (i < (nVals - 3)) {
+        /* a quad takes up to 6 + 4 bits */
+        if (cachedBits < 32) {
+            if (bitsLeft < 32) break;
+            HUFF_REFILL64(cache, cachedBits, buf);
+            bitsLeft -= 32;
+        }
+
+        e = fTab[cache >> (64 - MP3_HUFF_FAST_BITS)];
+        if (e) {
+            len = e & 0x0f;
+            vwxy[0] = HUFF_QUAD_VAL(e, 4);
+            vwxy[1] = HUFF_QUAD_VAL(e, 6);
+            vwxy[2] = HUFF_QUAD_VAL(e, 8);
+            vwxy[3] = HUFF_QUAD_VAL(e, 10);
+            cache <<= len; cachedBits -= len;
+            vwxy += 4; i += 4;
+            len = (e >> 12) & 0x0f;
+            if (len && i < (nVals - 3)) {
+                vwxy[0] = HUFF_QUAD_VAL(e, 16);
+                vwxy[1] = HUFF_QUAD_VAL(e, 18);
+                vwxy[2] = HUFF_QUAD_VAL(e, 20);
+                vwxy[3] = HUFF_QUAD_VAL(e, 22);
+                cache <<= len; cachedBits -= len;
+                vwxy += 4; i += 4;
+            }
+            continue;
+        }
+
+        /* codeword and signs longer than the index */
+        cw = pgm_read_byte(&tBase[cache >> (64 - maxBits)]);
+        len = (cw >> 4) & 0x0f;
+        cachedBits -= len;
+        cache <<= len;
+        for (int32_t k = 0; k < 4; k++) {
+            int32_t v = (cw >> (3 - k)) & 0x01;
+            if (v) {
+                v |= (uint32_t)(cache >> 32) & 0x80000000;
+                cache <<= 1;
+                cachedBits--;
+            }
+            vwxy[k] = v;
+        }
+        vwxy += 4; i += 4;
+    }
+    HUFF_RETURN32(cache, cachedBits, buf, bitsLeft, pCache, pCachedBits, pBuf, pBitsLeft);
+    *pvwxy = vwxy;
+    return i;
+}
+#endif // MP3_HUFF_FAST_BITS
 
 /***********************************************************************************************************************
  * Function:    DecodeHuffmanPairs
@@ -1719,6 +2034,11 @@ int32_t DecodeHuffmanPairs(int32_t *xy, int32_t nVals, int32_t tabIdx, int32_t b
         cache = (uint32_t) (*buf++) << (32 - cachedBits);
     bitsLeft -= cachedBits;
 
+#if MP3_HUFF_FAST_BITS
+    if (tabType != noBits) /* all but the last codewords */
+        nVals = DecodeHuffmanPairsFast(&xy, nVals, tabIdx, &bitsLeft, &buf, &cache, &cachedBits);
+#endif
+
     if (tabType == noBits) {
         /* table 0, no data, x = y = 0 */
         for (i = 0; i < nVals; i += 2) {
@@ -1939,6 +2259,9 @@ int32_t DecodeHuffmanQuads(int32_t *vwxy, int32_t nVals, int32_t tabIdx, int32_t
     bitsLeft -= cachedBits;
 
     i = padBits = 0;
+#if MP3_HUFF_FAST_BITS
+    i = DecodeHuffmanQuadsFast(&vwxy, nVals, tabIdx, &bitsLeft, &buf, &cache, &cachedBits); /* all but the last codewords */
+#endif
     while (i < (nVals - 3)) {
         /* refill cache - assumes cachedBits <= 16 */
         if (bitsLeft >= 16) {
@@ -2033,14 +2356,14 @@ int32_t DecodeHuffmanQuads(int32_t *vwxy, int32_t nVals, int32_t tabIdx, int32_t
  *                out of bits prematurely (invalid bitstream)
  **********************************************************************************************************************/
 // .data about 1ms faster per frame
-int32_t DecodeHuffman(uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, int32_t gr, int32_t ch){
+int32_t DecodeHuffman(MP3Decoder_t *d, uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, int32_t gr, int32_t ch){
 
    int32_t r1Start, r2Start, rEnd[4]; /* region boundaries */
    int32_t i, w, bitsUsed, bitsLeft;
     uint8_t *startBuf = buf;
 
     SideInfoSub_t *sis;
-    sis = &m_SideInfoSub[gr][ch];
+    sis = &d->sideInfoSub[gr][ch];
     //hi = (HuffmanInfo_t*) (m_MP3DecInfo->HuffmanInfoPS);
 
     if (huffBlockBits < 0)
@@ -2049,20 +2372,20 @@ int32_t DecodeHuffman(uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, i
     /* figure out region boundaries (the first 2*bigVals coefficients divided into 3 regions) */
     if (sis->winSwitchFlag && sis->blockType == 2) {
         if (sis->mixedBlock == 0) {
-            r1Start = m_SFBandTable.s[(sis->region0Count + 1) / 3] * 3;
+            r1Start = d->sfBand.s[(sis->region0Count + 1) / 3] * 3;
         } else {
-            if (m_MPEGVersion == MPEG1) {
-                r1Start = m_SFBandTable.l[sis->region0Count + 1];
+            if (d->mpegVersion == MPEG1) {
+                r1Start = d->sfBand.l[sis->region0Count + 1];
             } else {
                 /* see MPEG2 spec for explanation */
-                w = m_SFBandTable.s[4] - m_SFBandTable.s[3];
-                r1Start = m_SFBandTable.l[6] + 2 * w;
+                w = d->sfBand.s[4] - d->sfBand.s[3];
+                r1Start = d->sfBand.l[6] + 2 * w;
             }
         }
         r2Start = m_MAX_NSAMP; /* short blocks don't have region 2 */
     } else {
-        r1Start = m_SFBandTable.l[sis->region0Count + 1];
-        r2Start = m_SFBandTable.l[sis->region0Count + 1 + sis->region1Count + 1];
+        r1Start = d->sfBand.l[sis->region0Count + 1];
+        r2Start = d->sfBand.l[sis->region0Count + 1 + sis->region1Count + 1];
     }
 
     /* offset rEnd index by 1 so first region = rEnd[1] - rEnd[0], etc. */
@@ -2072,12 +2395,12 @@ int32_t DecodeHuffman(uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, i
     rEnd[0] = 0;
 
     /* rounds up to first all-zero pair (we don't check last pair for (x,y) == (non-zero, zero)) */
-    m_HuffmanInfo->nonZeroBound[ch] = rEnd[3];
+    d->huffmanInfo.nonZeroBound[ch] = rEnd[3];
 
     /* decode Huffman pairs (rEnd[i] are always even numbers) */
     bitsLeft = huffBlockBits;
     for (i = 0; i < 3; i++) {
-        bitsUsed = DecodeHuffmanPairs(m_HuffmanInfo->huffDecBuf[ch] + rEnd[i],
+        bitsUsed = DecodeHuffmanPairs(d->huffmanInfo.huffDecBuf[ch] + rEnd[i],
                 rEnd[i + 1] - rEnd[i], sis->tableSelect[i], bitsLeft, buf,
                 *bitOffset);
         if (bitsUsed < 0 || bitsUsed > bitsLeft) /* error - overran end of bitstream */
@@ -2090,13 +2413,13 @@ int32_t DecodeHuffman(uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, i
     }
 
     /* decode Huffman quads (if any) */
-    m_HuffmanInfo->nonZeroBound[ch] += DecodeHuffmanQuads(m_HuffmanInfo->huffDecBuf[ch] + rEnd[3],
+    d->huffmanInfo.nonZeroBound[ch] += DecodeHuffmanQuads(d->huffmanInfo.huffDecBuf[ch] + rEnd[3],
             m_MAX_NSAMP - rEnd[3], sis->count1TableSelect, bitsLeft, buf,
             *bitOffset);
 
-    assert(m_HuffmanInfo->nonZeroBound[ch] <= m_MAX_NSAMP);
-    for (i = m_HuffmanInfo->nonZeroBound[ch]; i < m_MAX_NSAMP; i++)
-        m_HuffmanInfo->huffDecBuf[ch][i] = 0;
+    assert(d->huffmanInfo.nonZeroBound[ch] <= m_MAX_NSAMP);
+    for (i = d->huffmanInfo.nonZeroBound[ch]; i < m_MAX_NSAMP; i++)
+        d->huffmanInfo.huffDecBuf[ch][i] = 0;
 
     /* If bits used for 576 samples < huffBlockBits, then the extras are considered
      *  to be stuffing bits (throw away, but need to return correct bitstream position)
@@ -2134,16 +2457,16 @@ int32_t DecodeHuffman(uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, i
  *              Equivalently, we can think of the dequantized coefficients as
  *                Q(DQ_FRACBITS_OUT - 15) with no implicit bias.
  **********************************************************************************************************************/
-int32_t MP3Dequantize(int32_t gr){
+int32_t MP3Dequantize(MP3Decoder_t *d, int32_t gr){
    int32_t i, ch, nSamps, mOut[2];
     CriticalBandInfo_t *cbi;
-    cbi = &m_CriticalBandInfo[0];
+    cbi = &d->criticalBandInfo[0];
     mOut[0] = mOut[1] = 0;
 
     /* dequantize all the samples in each channel */
-    for (ch = 0; ch < m_MP3DecInfo->nChans; ch++) {
-        m_HuffmanInfo->gb[ch] = DequantChannel(m_HuffmanInfo->huffDecBuf[ch], m_DequantInfo->workBuf,
-                &m_HuffmanInfo->nonZeroBound[ch], &m_SideInfoSub[gr][ch], &m_ScaleFactorInfoSub[gr][ch], &cbi[ch]);
+    for (ch = 0; ch < d->decInfo.nChans; ch++) {
+        d->huffmanInfo.gb[ch] = DequantChannel(d, d->huffmanInfo.huffDecBuf[ch], d->dequantInfo.workBuf,
+                &d->huffmanInfo.nonZeroBound[ch], &d->sideInfoSub[gr][ch], &d->scaleFactorInfoSub[gr][ch], &cbi[ch]);
     }
 
     /* joint stereo processing assumes one guard bit in input samples
@@ -2151,53 +2474,53 @@ int32_t MP3Dequantize(int32_t gr){
      *   just make a pass over the data and clip to [-2^30+1, 2^30-1]
      * in practice this may never happen
      */
-    if (m_FrameHeader->modeExt && (m_HuffmanInfo->gb[0] < 1 || m_HuffmanInfo->gb[1] < 1)) {
-        for (i = 0; i < m_HuffmanInfo->nonZeroBound[0]; i++) {
-            if (m_HuffmanInfo->huffDecBuf[0][i] < -0x3fffffff)  m_HuffmanInfo->huffDecBuf[0][i] = -0x3fffffff;
-            if (m_HuffmanInfo->huffDecBuf[0][i] >  0x3fffffff)  m_HuffmanInfo->huffDecBuf[0][i] =  0x3fffffff;
+    if (d->frameHeader.modeExt && (d->huffmanInfo.gb[0] < 1 || d->huffmanInfo.gb[1] < 1)) {
+        for (i = 0; i < d->huffmanInfo.nonZeroBound[0]; i++) {
+            if (d->huffmanInfo.huffDecBuf[0][i] < -0x3fffffff)  d->huffmanInfo.huffDecBuf[0][i] = -0x3fffffff;
+            if (d->huffmanInfo.huffDecBuf[0][i] >  0x3fffffff)  d->huffmanInfo.huffDecBuf[0][i] =  0x3fffffff;
         }
-        for (i = 0; i < m_HuffmanInfo->nonZeroBound[1]; i++) {
-            if (m_HuffmanInfo->huffDecBuf[1][i] < -0x3fffffff)  m_HuffmanInfo->huffDecBuf[1][i] = -0x3fffffff;
-            if (m_HuffmanInfo->huffDecBuf[1][i] >  0x3fffffff)  m_HuffmanInfo->huffDecBuf[1][i] =  0x3fffffff;
+        for (i = 0; i < d->huffmanInfo.nonZeroBound[1]; i++) {
+            if (d->huffmanInfo.huffDecBuf[1][i] < -0x3fffffff)  d->huffmanInfo.huffDecBuf[1][i] = -0x3fffffff;
+            if (d->huffmanInfo.huffDecBuf[1][i] >  0x3fffffff)  d->huffmanInfo.huffDecBuf[1][i] =  0x3fffffff;
         }
     }
 
     /* do mid-side stereo processing, if enabled */
-    if (m_FrameHeader->modeExt >> 1) {
-        if (m_FrameHeader->modeExt & 0x01) {
+    if (d->frameHeader.modeExt >> 1) {
+        if (d->frameHeader.modeExt & 0x01) {
             /* intensity stereo enabled - run mid-side up to start of right zero region */
             if (cbi[1].cbType == 0)
-                nSamps = m_SFBandTable.l[cbi[1].cbEndL + 1];
+                nSamps = d->sfBand.l[cbi[1].cbEndL + 1];
             else
-                nSamps = 3 * m_SFBandTable.s[cbi[1].cbEndSMax + 1];
+                nSamps = 3 * d->sfBand.s[cbi[1].cbEndSMax + 1];
         } else {
             /* intensity stereo disabled - run mid-side on whole spectrum */
-            nSamps = (m_HuffmanInfo->nonZeroBound[0] > m_HuffmanInfo->nonZeroBound[1] ?
-                                                       m_HuffmanInfo->nonZeroBound[0] : m_HuffmanInfo->nonZeroBound[1]);
+            nSamps = (d->huffmanInfo.nonZeroBound[0] > d->huffmanInfo.nonZeroBound[1] ?
+                                                       d->huffmanInfo.nonZeroBound[0] : d->huffmanInfo.nonZeroBound[1]);
         }
-        MidSideProc(m_HuffmanInfo->huffDecBuf, nSamps, mOut);
+        MidSideProc(d->huffmanInfo.huffDecBuf, nSamps, mOut);
     }
 
     /* do intensity stereo processing, if enabled */
-    if (m_FrameHeader->modeExt & 0x01) {
-        nSamps = m_HuffmanInfo->nonZeroBound[0];
-        if (m_MPEGVersion == MPEG1) {
-            IntensityProcMPEG1(m_HuffmanInfo->huffDecBuf, nSamps, &m_ScaleFactorInfoSub[gr][1], &m_CriticalBandInfo[0],
-                    m_FrameHeader->modeExt >> 1, m_SideInfoSub[gr][1].mixedBlock, mOut);
+    if (d->frameHeader.modeExt & 0x01) {
+        nSamps = d->huffmanInfo.nonZeroBound[0];
+        if (d->mpegVersion == MPEG1) {
+            IntensityProcMPEG1(d, d->huffmanInfo.huffDecBuf, nSamps, &d->scaleFactorInfoSub[gr][1], &d->criticalBandInfo[0],
+                    d->frameHeader.modeExt >> 1, d->sideInfoSub[gr][1].mixedBlock, mOut);
         } else {
-            IntensityProcMPEG2(m_HuffmanInfo->huffDecBuf, nSamps, &m_ScaleFactorInfoSub[gr][1], &m_CriticalBandInfo[0],
-                    m_ScaleFactorJS, m_FrameHeader->modeExt >> 1, m_SideInfoSub[gr][1].mixedBlock, mOut);
+            IntensityProcMPEG2(d, d->huffmanInfo.huffDecBuf, nSamps, &d->scaleFactorInfoSub[gr][1], &d->criticalBandInfo[0],
+                    &d->scaleFactorJS, d->frameHeader.modeExt >> 1, d->sideInfoSub[gr][1].mixedBlock, mOut);
         }
     }
 
     /* adjust guard bit count and nonZeroBound if we did any stereo processing */
-    if (m_FrameHeader->modeExt) {
-        m_HuffmanInfo->gb[0] = CLZ(mOut[0]) - 1;
-        m_HuffmanInfo->gb[1] = CLZ(mOut[1]) - 1;
-        nSamps = (m_HuffmanInfo->nonZeroBound[0] > m_HuffmanInfo->nonZeroBound[1] ?
-                                                       m_HuffmanInfo->nonZeroBound[0] : m_HuffmanInfo->nonZeroBound[1]);
-        m_HuffmanInfo->nonZeroBound[0] = nSamps;
-        m_HuffmanInfo->nonZeroBound[1] = nSamps;
+    if (d->frameHeader.modeExt) {
+        d->huffmanInfo.gb[0] = CLZ(mOut[0]) - 1;
+        d->huffmanInfo.gb[1] = CLZ(mOut[1]) - 1;
+        nSamps = (d->huffmanInfo.nonZeroBound[0] > d->huffmanInfo.nonZeroBound[1] ?
+                                                       d->huffmanInfo.nonZeroBound[0] : d->huffmanInfo.nonZeroBound[1]);
+        d->huffmanInfo.nonZeroBound[0] = nSamps;
+        d->huffmanInfo.nonZeroBound[1] = nSamps;
     }
 
     /* output format Q(DQ_FRACBITS_OUT) */
@@ -2325,7 +2648,7 @@ int32_t DequantBlock(int32_t *inbuf, int32_t *outbuf, int32_t num, int32_t scale
  *
  * Notes:       dequantized samples in Q(DQ_FRACBITS_OUT) format
  **********************************************************************************************************************/
-int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBound,  SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis,
+int32_t DequantChannel(MP3Decoder_t *d, int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBound,  SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis,
                                                                                               CriticalBandInfo_t *cbi)
 {
    int32_t i, j, w, cb;
@@ -2340,7 +2663,7 @@ int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBou
     if (sis->blockType == 2) {
         // cbStartL = 0;
         if (sis->mixedBlock) {
-            cbEndL = (m_MPEGVersion == MPEG1 ? 8 : 6);
+            cbEndL = (d->mpegVersion == MPEG1 ? 8 : 6);
             cbStartS = 3;
         } else {
             cbEndL = 0;
@@ -2369,7 +2692,7 @@ int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBou
      *   dividing every sample by sqrt(2) = multiplying by 2^-.5)
      */
     globalGain = sis->globalGain;
-    if (m_FrameHeader->modeExt >> 1)
+    if (d->frameHeader.modeExt >> 1)
          globalGain -= 2;
     globalGain += m_IMDCT_SCALE;      /* scale everything by sqrt(2), for fast IMDCT36 */
 
@@ -2377,7 +2700,7 @@ int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBou
     for (cb = 0; cb < cbEndL; cb++) {
 
         nonZero = 0;
-        nSamps = m_SFBandTable.l[cb + 1] - m_SFBandTable.l[cb];
+        nSamps = d->sfBand.l[cb + 1] - d->sfBand.l[cb];
         gainI = 210 - globalGain + sfactMultiplier * (sfis->l[cb] + (sis->preFlag ? (int32_t)preTab[cb] : 0));
 
         nonZero |= DequantBlock(sampleBuf + i, sampleBuf + i, nSamps, gainI);
@@ -2406,7 +2729,7 @@ int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBou
     cbMax[2] = cbMax[1] = cbMax[0] = cbStartS;
     for (cb = cbStartS; cb < cbEndS; cb++) {
 
-        nSamps = m_SFBandTable.s[cb + 1] - m_SFBandTable.s[cb];
+        nSamps = d->sfBand.s[cb + 1] - d->sfBand.s[cb];
         for (w = 0; w < 3; w++) {
             nonZero =  0;
             gainI = 210 - globalGain + 8*sis->subBlockGain[w] + sfactMultiplier*(sfis->s[cb][w]);
@@ -2518,7 +2841,7 @@ void MidSideProc(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, int32_t mO
  * Notes:       assume at least 1 GB in input
  *
  **********************************************************************************************************************/
-void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  ScaleFactorInfoSub_t *sfis,
+void IntensityProcMPEG1(MP3Decoder_t *d, int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  ScaleFactorInfoSub_t *sfis,
                                                     CriticalBandInfo_t *cbi, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2])
 {
    int32_t i = 0, j = 0, n = 0, cb = 0, w = 0;
@@ -2537,13 +2860,13 @@ void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  Sc
         cbStartL = cbi[1].cbEndL + 1;
         cbEndL = cbi[0].cbEndL + 1;
         cbStartS = cbEndS = 0;
-        i = m_SFBandTable.l[cbStartL];
+        i = d->sfBand.l[cbStartL];
     } else if (cbi[1].cbType == 1 || cbi[1].cbType == 2) {
         /* short or mixed block */
         cbStartS = cbi[1].cbEndSMax + 1;
         cbEndS = cbi[0].cbEndSMax + 1;
         cbStartL = cbEndL = 0;
-        i = 3 * m_SFBandTable.s[cbStartS];
+        i = 3 * d->sfBand.s[cbStartS];
     }
     sampsLeft = nSamps - i; /* process to length of left */
     isfTab = (int32_t *) ISFMpeg1[midSideFlag];
@@ -2560,7 +2883,7 @@ void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  Sc
             fr = isfTab[6] - isfTab[isf];
         }
 
-        n = m_SFBandTable.l[cb + 1] - m_SFBandTable.l[cb];
+        n = d->sfBand.l[cb + 1] - d->sfBand.l[cb];
         for (j = 0; j < n && sampsLeft > 0; j++, i++) {
             xr = MULSHIFT32(fr, x[0][i]) << 2;
             x[1][i] = xr;
@@ -2583,7 +2906,7 @@ void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  Sc
                 frs[w] = isfTab[6] - isfTab[isf];
             }
         }
-        n = m_SFBandTable.s[cb + 1] - m_SFBandTable.s[cb];
+        n = d->sfBand.s[cb + 1] - d->sfBand.s[cb];
         for (j = 0; j < n && sampsLeft >= 3; j++, i += 3) {
             xr = MULSHIFT32(frs[0], x[0][i + 0]) << 2;
             x[1][i + 0] = xr;
@@ -2632,7 +2955,7 @@ void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,  Sc
  * Notes:       assume at least 1 GB in input
  *
  **********************************************************************************************************************/
-void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
+void IntensityProcMPEG2(MP3Decoder_t *d, int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
          ScaleFactorInfoSub_t *sfis, CriticalBandInfo_t *cbi,
         ScaleFactorJS_t *sfjs, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2]) {
    int32_t i, j, k, n, r, cb, w;
@@ -2659,7 +2982,7 @@ void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
         il[21] = il[22] = 1;
         cbStartL = cbi[1].cbEndL + 1; /* start at end of right */
         cbEndL = cbi[0].cbEndL + 1; /* process to end of left */
-        i = m_SFBandTable.l[cbStartL];
+        i = d->sfBand.l[cbStartL];
         sampsLeft = nSamps - i;
 
         for (cb = cbStartL; cb < cbEndL; cb++) {
@@ -2672,7 +2995,7 @@ void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
                 fl = isfTab[(sfIdx & 0x01 ? isf : 0)];
                 fr = isfTab[(sfIdx & 0x01 ? 0 : isf)];
             }
-           int32_t r=m_SFBandTable.l[cb + 1] - m_SFBandTable.l[cb];
+           int32_t r=d->sfBand.l[cb + 1] - d->sfBand.l[cb];
             n=(r < sampsLeft ? r : sampsLeft);
             //n = MIN(fh->sfBand->l[cb + 1] - fh->sfBand->l[cb], sampsLeft);
             for (j = 0; j < n; j++, i++) {
@@ -2695,7 +3018,7 @@ void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
         for (w = 0; w < 3; w++) {
             cbStartS = cbi[1].cbEndS[w] + 1; /* start at end of right */
             cbEndS = cbi[0].cbEndS[w] + 1; /* process to end of left */
-            i = 3 * m_SFBandTable.s[cbStartS] + w;
+            i = 3 * d->sfBand.s[cbStartS] + w;
 
             /* skip through sample array by 3, so early-exit logic would be more tricky */
             for (cb = cbStartS; cb < cbEndS; cb++) {
@@ -2708,7 +3031,7 @@ void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps,
                     fl = isfTab[(sfIdx & 0x01 ? isf : 0)];
                     fr = isfTab[(sfIdx & 0x01 ? 0 : isf)];
                 }
-                n = m_SFBandTable.s[cb + 1] - m_SFBandTable.s[cb];
+                n = d->sfBand.s[cb + 1] - d->sfBand.s[cb];
 
                 for (j = 0; j < n; j++, i += 3) {
                     xr = MULSHIFT32(fr, x[0][i]) << 2;
@@ -3431,27 +3754,30 @@ int32_t HybridTransform(int32_t *xCurr, int32_t *xPrev, int32_t y[m_BLOCK_SIZE][
  *              updated hi->nonZeroBound index for this channel
  *
  * Return:      0 on success,  -1 if null input pointers
+ *
+ * Notes:       MP3_QUALITY_LOWPASS and _HALFRATE: the subbands from m_REDUCED_NBANDS on are treated as zero, the
+ *                last butterfly sees zeros, nonZeroBound is capped, the IMDCT of the upper subbands is skipped
  **********************************************************************************************************************/
 // a bit faster in RAM
 /*__attribute__ ((section (".data")))*/
-int32_t IMDCT(int32_t gr, int32_t ch) {
+int32_t IMDCT(MP3Decoder_t *d, int32_t gr, int32_t ch) {
    int32_t nBfly, blockCutoff;
     BlockCount_t bc;
 
-    /* m_SideInfo is an array of up to 4 structs, stored as gr0ch0, gr0ch1, gr1ch0, gr1ch1 */
+    /* d->sideInfoSub is an array of up to 4 structs, stored as gr0ch0, gr0ch1, gr1ch0, gr1ch1 */
     /* anti-aliasing done on whole long blocks only
      * for mixed blocks, nBfly always 1, except 3 for 8 kHz MPEG 2.5 (see sfBandTab)
      *   nLongBlocks = number of blocks with (possibly) non-zero power
      *   nBfly = number of butterflies to do (nLongBlocks - 1, unless no long blocks)
      */
-    blockCutoff = m_SFBandTable.l[(m_MPEGVersion == MPEG1 ? 8 : 6)] / 18; /* same as 3* num short sfb's in spec */
-    if (m_SideInfoSub[gr][ch].blockType != 2) {
+    blockCutoff = d->sfBand.l[(d->mpegVersion == MPEG1 ? 8 : 6)] / 18; /* same as 3* num short sfb's in spec */
+    if (d->sideInfoSub[gr][ch].blockType != 2) {
         /* all long transforms */
-       int32_t x=(m_HuffmanInfo->nonZeroBound[ch] + 7) / 18 + 1;
+       int32_t x=(d->huffmanInfo.nonZeroBound[ch] + 7) / 18 + 1;
         bc.nBlocksLong=(x<32 ? x : 32);
         //bc.nBlocksLong = min((hi->nonZeroBound[ch] + 7) / 18 + 1, 32);
         nBfly = bc.nBlocksLong - 1;
-    } else if (m_SideInfoSub[gr][ch].blockType == 2 && m_SideInfoSub[gr][ch].mixedBlock) {
+    } else if (d->sideInfoSub[gr][ch].blockType == 2 && d->sideInfoSub[gr][ch].mixedBlock) {
         /* mixed block - long transforms until cutoff, then short transforms */
         bc.nBlocksLong = blockCutoff;
         nBfly = bc.nBlocksLong - 1;
@@ -3461,34 +3787,261 @@ int32_t IMDCT(int32_t gr, int32_t ch) {
         nBfly = 0;
     }
 
-    AntiAlias(m_HuffmanInfo->huffDecBuf[ch], nBfly);
-   int32_t x=m_HuffmanInfo->nonZeroBound[ch];
+    if (ReducedBands(d)) {
+        const int32_t nSamps = m_REDUCED_NBANDS * 18;
+        if (d->huffmanInfo.nonZeroBound[ch] > nSamps) { /* the last butterfly mixes subband 15 with zeros */
+            memset(d->huffmanInfo.huffDecBuf[ch] + nSamps, 0, 8 * sizeof(int32_t));
+            d->huffmanInfo.nonZeroBound[ch] = nSamps;
+        }
+        if (bc.nBlocksLong > m_REDUCED_NBANDS) bc.nBlocksLong = m_REDUCED_NBANDS;
+        if (nBfly > m_REDUCED_NBANDS) nBfly = m_REDUCED_NBANDS;
+    }
+
+    AntiAlias(d->huffmanInfo.huffDecBuf[ch], nBfly);
+   int32_t x=d->huffmanInfo.nonZeroBound[ch];
    int32_t y=nBfly * 18 + 8;
-    m_HuffmanInfo->nonZeroBound[ch]=(x>y ? x: y);
+    d->huffmanInfo.nonZeroBound[ch]=(x>y ? x: y);
+    if (ReducedBands(d) && d->huffmanInfo.nonZeroBound[ch] > m_REDUCED_NBANDS * 18) /* the aliases of subband 15 */
+        d->huffmanInfo.nonZeroBound[ch] = m_REDUCED_NBANDS * 18;
 
-    assert(m_HuffmanInfo->nonZeroBound[ch] <= m_MAX_NSAMP);
+    assert(d->huffmanInfo.nonZeroBound[ch] <= m_MAX_NSAMP);
 
     /* for readability, use a struct instead of passing a million parameters to HybridTransform() */
-    bc.nBlocksTotal = (m_HuffmanInfo->nonZeroBound[ch] + 17) / 18;
-    bc.nBlocksPrev = m_IMDCTInfo->numPrevIMDCT[ch];
-    bc.prevType = m_IMDCTInfo->prevType[ch];
-    bc.prevWinSwitch = m_IMDCTInfo->prevWinSwitch[ch];
+    bc.nBlocksTotal = (d->huffmanInfo.nonZeroBound[ch] + 17) / 18;
+    bc.nBlocksPrev = d->imdctInfo.numPrevIMDCT[ch];
+    bc.prevType = d->imdctInfo.prevType[ch];
+    bc.prevWinSwitch = d->imdctInfo.prevWinSwitch[ch];
     /* where WINDOW switches (not nec. transform) */
-    bc.currWinSwitch = (m_SideInfoSub[gr][ch].mixedBlock ? blockCutoff : 0);
-    bc.gbIn = m_HuffmanInfo->gb[ch];
+    bc.currWinSwitch = (d->sideInfoSub[gr][ch].mixedBlock ? blockCutoff : 0);
+    bc.gbIn = d->huffmanInfo.gb[ch];
 
-    m_IMDCTInfo->numPrevIMDCT[ch] = HybridTransform(m_HuffmanInfo->huffDecBuf[ch], m_IMDCTInfo->overBuf[ch],
-            m_IMDCTInfo->outBuf[ch], &m_SideInfoSub[gr][ch], &bc);
-    m_IMDCTInfo->prevType[ch] = m_SideInfoSub[gr][ch].blockType;
-    m_IMDCTInfo->prevWinSwitch[ch] = bc.currWinSwitch; /* 0 means not a mixed block (either all short or all long) */
-    m_IMDCTInfo->gb[ch] = bc.gbOut;
+    d->imdctInfo.numPrevIMDCT[ch] = HybridTransform(d->huffmanInfo.huffDecBuf[ch], d->imdctInfo.overBuf[ch],
+            d->imdctInfo.outBuf[ch], &d->sideInfoSub[gr][ch], &bc);
+    d->imdctInfo.prevType[ch] = d->sideInfoSub[gr][ch].blockType;
+    d->imdctInfo.prevWinSwitch[ch] = bc.currWinSwitch; /* 0 means not a mixed block (either all short or all long) */
+    d->imdctInfo.gb[ch] = bc.gbOut;
 
-    assert(m_IMDCTInfo->numPrevIMDCT[ch] <= m_NBANDS);
+    assert(d->imdctInfo.numPrevIMDCT[ch] <= m_NBANDS);
 
     /* output has gained 2int32_t bits */
     return 0;
 }
 
+/***********************************************************************************************************************
+ * L A Y E R   I / I I
+ **********************************************************************************************************************/
+#if MP3_LAYER12
+/* quantization classes (ISO 11172-3 table B.4), index = class
+ *   1...15: one sample per code of bits = class + 1, 2^bits - 1 levels (layer I: class = allocation)
+ *   16...18: three samples grouped in one code of 5, 7, 10 bits, 3, 5, 9 levels
+ *   recip = 2^(31 + shift) / levels, rounded, shift = ceil(log2(levels))
+ *   sample = (2 * code - (levels - 1)) / levels = ((2 * code - (levels - 1)) * recip) >> shift, Q31, |sample| < 1
+ */
+typedef struct {
+    uint8_t  bits;
+    uint8_t  grouped;
+    uint8_t  shift;
+    uint16_t levels;
+    uint32_t recip;
+} L12Class_t;
+
+static const L12Class_t m_L12Class[19] PROGMEM = {
+    { 0, 0,  0,     0, 0x00000000},
+    { 2, 0,  2,     3, 0xaaaaaaab}, { 3, 0,  3,     7, 0x92492492}, { 4, 0,  4,    15, 0x88888889},
+    { 5, 0,  5,    31, 0x84210842}, { 6, 0,  6,    63, 0x82082082}, { 7, 0,  7,   127, 0x81020408},
+    { 8, 0,  8,   255, 0x80808081}, { 9, 0,  9,   511, 0x80402010}, {10, 0, 10,  1023, 0x80200802},
+    {11, 0, 11,  2047, 0x80100200}, {12, 0, 12,  4095, 0x80080080}, {13, 0, 13,  8191, 0x80040020},
+    {14, 0, 14, 16383, 0x80020008}, {15, 0, 15, 32767, 0x80010002}, {16, 0, 16, 65535, 0x80008001},
+    { 5, 1,  2,     3, 0xaaaaaaab}, { 7, 1,  3,     5, 0xcccccccd}, {10, 1,  4,     9, 0xe38e38e4}
+};
+
+/* layer II allocation: nbal bit index -> quantization class, per group of subbands (ISO 11172-3 B.2, 13818-3 B.1) */
+static const uint8_t m_L2ClassA[16] PROGMEM = {0, 16,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15};
+static const uint8_t m_L2ClassB[16] PROGMEM = {0, 16, 17,  2, 18,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 15};
+static const uint8_t m_L2ClassC[8]  PROGMEM = {0, 16, 17,  2, 18,  3,  4, 15};
+static const uint8_t m_L2ClassD[4]  PROGMEM = {0, 16, 17, 15};
+static const uint8_t m_L2ClassE[16] PROGMEM = {0, 16, 17, 18,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14};
+static const uint8_t m_L2ClassF[16] PROGMEM = {0, 16, 17,  2, 18,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13};
+
+typedef struct {
+    uint8_t        nSubbands;
+    uint8_t        nbal;         /* bits of the allocation */
+    const uint8_t *cls;
+} L2AllocGroup_t;
+
+static const L2AllocGroup_t m_L2AllocHigh[4] = {{3, 4, m_L2ClassA}, {8, 4, m_L2ClassB}, {12, 3, m_L2ClassC}, {7, 2, m_L2ClassD}};
+static const L2AllocGroup_t m_L2AllocLow[2]  = {{2, 4, m_L2ClassE}, {10, 3, m_L2ClassE}};             /* B.2c, B.2d */
+static const L2AllocGroup_t m_L2AllocLSF[3]  = {{4, 4, m_L2ClassF}, {7, 3, m_L2ClassE}, {19, 2, m_L2ClassE}}; /* MPEG2 */
+
+/* scale factor index i: 2^(1 - i / 3) = m_L12ScaleFrac[i % 3] * 2^(1 - i / 3), Q31 */
+static const int32_t m_L12ScaleFrac[3] PROGMEM = {0x7fffffff, 0x6597fa95, 0x50a28be6};
+
+/* one requantized subband sample, Q(DQ_FRACBITS_OUT - 2) like the output of IMDCT() */
+static inline int32_t L12Sample(uint32_t code, const L12Class_t *qc, int32_t sf) {
+    if (code >= qc->levels) code = qc->levels - 1; /* not allowed, 'all ones' */
+    int32_t f = (int32_t)(((int64_t)(2 * (int32_t)code - (qc->levels - 1)) * qc->recip) >> qc->shift); /* Q31 */
+    /* f * frac: Q30, * 2 for the scale factor, Q30 -> Q23: >> 6 */
+    return MULSHIFT32(f, m_L12ScaleFrac[sf % 3]) >> (6 + sf / 3);
+}
+/***********************************************************************************************************************
+ * Function:    DecodeLayer12
+ *
+ * Description: decode one frame of layer I or layer II data
+ *
+ * Inputs:      instance with the unpacked frame header (UnpackFrameHeader())
+ *              pointer to the frame header, its length in bytes (4 or 6 with CRC)
+ *              number of valid bytes from the frame header on
+ *              pointer to outbuf, big enough to hold one frame of decoded PCM samples
+ *
+ * Outputs:     PCM data in outbuf, interleaved LRLRLR... if stereo, 384 (layer I) or 1152 (layer II) samples per channel,
+ *                half of it in MP3_QUALITY_HALFRATE
+ *              updated bytesLeft
+ *
+ * Return:      error code, defined in mp3dec.h (0 means no error, < 0 means error)
+ *
+ * Notes:       no Huffman decoding and no hybrid filterbank, the requantized subband samples go to the synthesis
+ *                filter of layer III (Subband()) through imdctInfo.outBuf, 18 (layer II) or 12 (layer I) at a time
+ *              free format is not supported, the CRC is not checked
+ **********************************************************************************************************************/
+int32_t DecodeLayer12(MP3Decoder_t *d, uint8_t *inbuf, int32_t fhBytes, int32_t *bytesLeft, int16_t *outbuf) {
+    BitStreamInfo_t bitStreamInfo, *bsi = &bitStreamInfo;
+    uint8_t cls[m_MAX_NCHAN][m_NBANDS];        /* quantization class, 0: not transmitted */
+    uint8_t sf[m_MAX_NCHAN][3][m_NBANDS];      /* scale factor index per part of 4 granules (layer II) */
+    uint8_t scfsi[m_MAX_NCHAN][m_NBANDS];
+    int32_t sb, ch, gr, i, frameBytes, sbLimit, bound, sbOut, mOut[m_MAX_NCHAN];
+    int32_t nChans = d->decInfo.nChans;
+    int32_t layer = d->decInfo.layer;
+
+    if (d->frameHeader.brIdx == 0) {
+        MP3ClearBadFrame(d, outbuf);
+        return ERR_MP3_FREE_BITRATE_SYNC;
+    }
+    if (layer == 1)
+        frameBytes = (12 * d->decInfo.bitrate / d->decInfo.samprate + d->frameHeader.paddingBit) * 4;
+    else
+        frameBytes = 144 * d->decInfo.bitrate / d->decInfo.samprate + d->frameHeader.paddingBit;
+    if (frameBytes > *bytesLeft) {
+        MP3ClearBadFrame(d, outbuf);
+        return ERR_MP3_INDATA_UNDERFLOW;
+    }
+    d->decInfo.nSlots = frameBytes - fhBytes; /* no bit reservoir */
+    d->decInfo.mainDataBegin = 0;
+    d->decInfo.mainDataBytes = 0;
+    SetBitstreamPointer(bsi, frameBytes - fhBytes, inbuf + fhBytes);
+
+    /* bit allocation */
+    const L2AllocGroup_t *grp = NULL;
+    if (layer == 1) {
+        sbLimit = m_NBANDS;
+    } else if (d->mpegVersion != MPEG1) {
+        grp = m_L2AllocLSF;
+        sbLimit = 30;
+    } else {
+        int32_t kbps = d->decInfo.bitrate / 1000 / nChans; /* per channel */
+        if (kbps < 56) {
+            grp = m_L2AllocLow;
+            sbLimit = (d->frameHeader.srIdx == 2 ? 12 : 8);
+        } else {
+            grp = m_L2AllocHigh;
+            sbLimit = ((kbps >= 96 && d->frameHeader.srIdx != 1) ? 30 : 27);
+        }
+    }
+    bound = (d->sMode == Joint ? (d->frameHeader.modeExt + 1) * 4 : sbLimit); /* intensity stereo from bound on */
+    if (bound > sbLimit) bound = sbLimit;
+    memset(cls, 0, sizeof(cls));
+    for (sb = 0, i = 0; sb < sbLimit; sb++) {
+        int32_t nbal = 4;
+        const uint8_t *clsTab = NULL;
+        if (grp) {
+            if (i == grp->nSubbands) {grp++; i = 0;}
+            nbal = grp->nbal;
+            clsTab = grp->cls;
+            i++;
+        }
+        for (ch = 0; ch < nChans; ch++) {
+            if (ch && sb >= bound) {
+                cls[1][sb] = cls[0][sb];
+                break;
+            }
+            uint32_t a = GetBits(bsi, nbal);
+            if (layer == 1 && a == 15) {
+                MP3ClearBadFrame(d, outbuf);
+                return ERR_MP3_INVALID_SIDEINFO;
+            }
+            cls[ch][sb] = (clsTab ? clsTab[a] : a);
+        }
+    }
+    /* scale factors */
+    for (sb = 0; sb < sbLimit; sb++)
+        for (ch = 0; ch < nChans; ch++)
+            scfsi[ch][sb] = (layer == 2 && cls[ch][sb] ? GetBits(bsi, 2) : 2); /* 2: one scale factor for all parts */
+    for (sb = 0; sb < sbLimit; sb++) {
+        for (ch = 0; ch < nChans; ch++) {
+            if (!cls[ch][sb]) continue;
+            uint8_t s0 = GetBits(bsi, 6), s1 = s0, s2 = s0;
+            switch (scfsi[ch][sb]) {
+                case 0: s1 = GetBits(bsi, 6); s2 = GetBits(bsi, 6); break;
+                case 1: s2 = GetBits(bsi, 6); break;
+                case 3: s1 = s2 = GetBits(bsi, 6); break;
+            }
+            sf[ch][0][sb] = (s0 < 63 ? s0 : 62); /* 63 is not allowed */
+            sf[ch][1][sb] = (s1 < 63 ? s1 : 62);
+            sf[ch][2][sb] = (s2 < 63 ? s2 : 62);
+        }
+    }
+
+    /* samples: layer I 12 of each subband, layer II 12 granules of 3, the synthesis runs every 18 (II) or 12 (I) */
+    sbOut = (ReducedBands(d) ? m_REDUCED_NBANDS : m_NBANDS);
+    int32_t nBlocks = (layer == 1 ? 12 : m_BLOCK_SIZE);
+    int32_t nPerGr = (layer == 1 ? 1 : 3);
+    int32_t blk = 0;
+    for (gr = 0; gr < 12; gr++) {
+        if (blk == 0) {
+            for (ch = 0; ch < nChans; ch++) {
+                memset(d->imdctInfo.outBuf[ch], 0, nBlocks * m_NBANDS * sizeof(int32_t));
+                mOut[ch] = 0;
+            }
+        }
+        int32_t part = gr >> 2;
+        for (sb = 0; sb < sbLimit; sb++) {
+            for (ch = 0; ch < nChans; ch++) {
+                uint32_t code[3];
+                const L12Class_t *qc = &m_L12Class[cls[ch][sb]];
+                if (!cls[ch][sb]) continue;
+                if (ch == 0 || sb < bound) {
+                    if (qc->grouped) {
+                        uint32_t c = GetBits(bsi, qc->bits);
+                        code[0] = c % qc->levels; c /= qc->levels;
+                        code[1] = c % qc->levels; c /= qc->levels;
+                        code[2] = c;
+                    } else {
+                        for (i = 0; i < nPerGr; i++) code[i] = GetBits(bsi, qc->bits);
+                    }
+                }
+                /* else intensity stereo, the codes of the left channel with the right scale factor */
+                if (sb >= sbOut) continue;
+                for (i = 0; i < nPerGr; i++) {
+                    int32_t x = L12Sample(code[i], qc, sf[ch][part][sb]);
+                    d->imdctInfo.outBuf[ch][blk + i][sb] = x;
+                    mOut[ch] |= FASTABS(x);
+                }
+            }
+        }
+        blk += nPerGr;
+        if (blk == nBlocks) {
+            for (ch = 0; ch < nChans; ch++)
+                d->imdctInfo.gb[ch] = (mOut[ch] ? CLZ(mOut[ch]) - 1 : 31);
+            Subband(d, outbuf, nBlocks);
+            outbuf += (nBlocks * m_NBANDS * nChans) >> ReducedRateShift(d);
+            blk = 0;
+        }
+    }
+    *bytesLeft -= frameBytes;
+    MP3GetLastFrameInfo(d);
+    return ERR_MP3_NONE;
+}
+#endif /* MP3_LAYER12 */
+
 /***********************************************************************************************************************
  * S U B B A N D
  **********************************************************************************************************************/
@@ -3499,34 +4052,53 @@ int32_t IMDCT(int32_t gr, int32_t ch) {
  * Description: do subband transform on all the blocks in one granule, all channels
  *
  * Inputs:      filled MP3DecInfo structure, after calling IMDCT for all channels
+ *              number of blocks in imdctInfo.outBuf, even: m_BLOCK_SIZE, 12 for layer I
  *              vbuf[ch] and vindex[ch] must be preserved between calls
  *
  * Outputs:     decoded PCM data, interleaved LRLRLR... if stereo
+ *              16 instead of 32 samples per block and channel in MP3_QUALITY_HALFRATE
  *
  * Return:      0 on success,  -1 if null input pointers
  **********************************************************************************************************************/
-int32_t Subband(int16_t *pcmBuf) {
+int32_t Subband(MP3Decoder_t *d, int16_t *pcmBuf, int32_t nBlocks) {
    int32_t b;
-    if (m_MP3DecInfo->nChans == 2) {
+    if (ReducedRateShift(d)) {
+        /* half rate, the vbuf FIFO is filled as usual, the synthesis filter skips the odd samples */
+        for (b = 0; b < nBlocks; b++) {
+            for (int32_t ch = 0; ch < d->decInfo.nChans; ch++)
+                FDCT32(d->imdctInfo.outBuf[ch][b], d->subbandInfo.vbuf + ch * 32, d->subbandInfo.vindex,
+                        (b & 0x01), d->imdctInfo.gb[ch]);
+            if (d->decInfo.nChans == 2)
+                PolyphaseStereoHalf(pcmBuf, d->subbandInfo.vbuf + d->subbandInfo.vindex + m_VBUF_LENGTH * (b & 0x01),
+                        polyCoef);
+            else
+                PolyphaseMonoHalf(pcmBuf, d->subbandInfo.vbuf + d->subbandInfo.vindex + m_VBUF_LENGTH * (b & 0x01),
+                        polyCoef);
+            d->subbandInfo.vindex = (d->subbandInfo.vindex - (b & 0x01)) & 7;
+            pcmBuf += d->decInfo.nChans * (m_NBANDS / 2);
+        }
+        return 0;
+    }
+    if (d->decInfo.nChans == 2) {
         /* stereo */
-        for (b = 0; b < m_BLOCK_SIZE; b++) {
-            FDCT32(m_IMDCTInfo->outBuf[0][b], m_SubbandInfo->vbuf + 0 * 32, m_SubbandInfo->vindex,
-                    (b & 0x01), m_IMDCTInfo->gb[0]);
-            FDCT32(m_IMDCTInfo->outBuf[1][b], m_SubbandInfo->vbuf + 1 * 32, m_SubbandInfo->vindex,
-                    (b & 0x01), m_IMDCTInfo->gb[1]);
+        for (b = 0; b < nBlocks; b++) {
+            FDCT32(d->imdctInfo.outBuf[0][b], d->subbandInfo.vbuf + 0 * 32, d->subbandInfo.vindex,
+                    (b & 0x01), d->imdctInfo.gb[0]);
+            FDCT32(d->imdctInfo.outBuf[1][b], d->subbandInfo.vbuf + 1 * 32, d->subbandInfo.vindex,
+                    (b & 0x01), d->imdctInfo.gb[1]);
             PolyphaseStereo(pcmBuf,
-                    m_SubbandInfo->vbuf + m_SubbandInfo->vindex + m_VBUF_LENGTH * (b & 0x01),
+                    d->subbandInfo.vbuf + d->subbandInfo.vindex + m_VBUF_LENGTH * (b & 0x01),
                     polyCoef);
-            m_SubbandInfo->vindex = (m_SubbandInfo->vindex - (b & 0x01)) & 7;
+            d->subbandInfo.vindex = (d->subbandInfo.vindex - (b & 0x01)) & 7;
             pcmBuf += (2 * m_NBANDS);
         }
     } else {
         /* mono */
-        for (b = 0; b < m_BLOCK_SIZE; b++) {
-            FDCT32(m_IMDCTInfo->outBuf[0][b], m_SubbandInfo->vbuf + 0 * 32, m_SubbandInfo->vindex,
-                    (b & 0x01), m_IMDCTInfo->gb[0]);
-            PolyphaseMono(pcmBuf, m_SubbandInfo->vbuf + m_SubbandInfo->vindex + m_VBUF_LENGTH * (b & 0x01), polyCoef);
-            m_SubbandInfo->vindex = (m_SubbandInfo->vindex - (b & 0x01)) & 7;
+        for (b = 0; b < nBlocks; b++) {
+            FDCT32(d->imdctInfo.outBuf[0][b], d->subbandInfo.vbuf + 0 * 32, d->subbandInfo.vindex,
+                    (b & 0x01), d->imdctInfo.gb[0]);
+            PolyphaseMono(pcmBuf, d->subbandInfo.vbuf + d->subbandInfo.vindex + m_VBUF_LENGTH * (b & 0x01), polyCoef);
+            d->subbandInfo.vindex = (d->subbandInfo.vindex - (b & 0x01)) & 7;
             pcmBuf += m_NBANDS;
         }
     }
@@ -3728,6 +4300,28 @@ short ClipToShort(int32_t x, int32_t fracBits){
     return x;
 #endif
 }
+/* Accumulation of the synthesis filter, chosen with MP3_POLYPHASE_ACC32.
+ * 64 bit: sum of the full products vbuf * coef (coef = Q30 >> 12), shifted right by 32 - 12 at the end.
+ * 32 bit: every product is shifted right by 32 - 12 on its own, one mulsh per tap instead of mull, mulsh, add and addc.
+ *   The truncation costs less than 1 unit of 2^20 per product, at most 16 units per sample, the output LSB is 64 units:
+ *   a sample differs from the 64 bit result by 1 LSB at most. A full scale sample is 2^21 units, no overflow.
+ * No ESP32-S3 PIE kernel: its vector MACs multiply 8 or 16 bit lanes (EE.VMULAS.S16...), here 32 bit samples meet 20 bit
+ *   coefficients. Split into 16 bit halves that is four signed products per tap, the low halves are unsigned, plus the
+ *   reversed vbuf[23 - j] taps that need a lane shuffle: more instructions than one mulsh. test/test_mp3_synth.cpp
+ *   checks the 1 LSB bound and measures the cycles per frame of both variants on the host.
+ */
+#if MP3_POLYPHASE_ACC32
+typedef int32_t polyAcc_t;
+inline int32_t PolyMul(int32_t v, int32_t c) {return (int32_t)(((int64_t)v * (int32_t)((uint32_t)c << m_CSHIFT)) >> 32);}
+#define POLY_MAC(sum, v, c)  ((sum) += PolyMul((v), (c)))
+#define POLY_RND             ((polyAcc_t)1 << ((m_DQ_FRACBITS_OUT - 2 - 2 - 15) - 1))
+#define POLY_OUT(sum)        ClipToShort((sum), m_DQ_FRACBITS_OUT - 2 - 2 - 15)
+#else
+typedef uint64_t polyAcc_t;
+#define POLY_MAC(sum, v, c)  ((sum) = MADD64((sum), (v), (c)))
+#define POLY_RND             ((polyAcc_t)1 << ((m_DQ_FRACBITS_OUT - 2 - 2 - 15) - 1 + (32 - m_CSHIFT)))
+#define POLY_OUT(sum)        ClipToShort((int32_t)SAR64((sum), (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15)
+#endif
 /***********************************************************************************************************************
  * Function:    PolyphaseMono
  *
@@ -3749,9 +4343,9 @@ void PolyphaseMono(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
     const uint32_t *coef;
    int32_t *vb1;
    int32_t vLo, vHi, c1, c2;
-    uint64_t sum1L, sum2L, rndVal;
+    polyAcc_t sum1L, sum2L, rndVal;
 
-    rndVal = (uint64_t)( 1ULL << ((m_DQ_FRACBITS_OUT - 2 - 2 - 15) - 1 + (32 - m_CSHIFT)) );
+    rndVal = POLY_RND;
 
     /* special case, output sample 0 */
     coef = coefBase;
@@ -3759,35 +4353,34 @@ void PolyphaseMono(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
     sum1L = rndVal;
     for(int32_t j=0; j<8; j++){
         c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi=*(vb1+(23-(j))); // 0...7
-        sum1L=MADD64(sum1L, vLo, c1); sum1L=MADD64(sum1L, vHi, -c2);
+        POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum1L, vHi, -c2);
     }
-    *(pcm + 0) = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+    *(pcm + 0) = POLY_OUT(sum1L);
 
     /* special case, output sample 16 */
     coef = coefBase + 256;
     vb1 = vbuf + 64*16;
     sum1L = rndVal;
     for(int32_t j=0; j<8; j++){
-        c1=*coef; coef++; vLo=*(vb1+(j)); sum1L = MADD64(sum1L, vLo,  c1); // 0...7
+        c1=*coef; coef++; vLo=*(vb1+(j)); POLY_MAC(sum1L, vLo, c1); // 0...7
     }
-    *(pcm + 16) = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+    *(pcm + 16) = POLY_OUT(sum1L);
 
     /* main convolution loop: sum1L = samples 1, 2, 3, ... 15   sum2L = samples 31, 30, ... 17 */
     coef = coefBase + 16;
     vb1 = vbuf + 64;
     pcm++;
 
-    /* right now, the compiler creates bad asm from this... */
     for (i = 15; i > 0; i--) {
         sum1L = sum2L = rndVal;
         for(int32_t j=0; j<8; j++){
             c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
-            sum1L=MADD64(sum1L, vLo,  c1); sum2L = MADD64(sum2L, vLo,  c2);
-            sum1L=MADD64(sum1L, vHi, -c2); sum2L = MADD64(sum2L, vHi,  c1);
+            POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum2L, vLo, c2);
+            POLY_MAC(sum1L, vHi, -c2); POLY_MAC(sum2L, vHi, c1);
         }
         vb1 += 64;
-        *(pcm)       = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-        *(pcm + 2*i) = ClipToShort((int32_t)SAR64(sum2L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+        *(pcm)       = POLY_OUT(sum1L);
+        *(pcm + 2*i) = POLY_OUT(sum2L);
         pcm++;
     }
 }
@@ -3814,9 +4407,9 @@ void PolyphaseStereo(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
     const uint32_t *coef;
    int32_t *vb1;
    int32_t vLo, vHi, c1, c2;
-    uint64_t sum1L, sum2L, sum1R, sum2R, rndVal;
+    polyAcc_t sum1L, sum2L, sum1R, sum2R, rndVal;
 
-    rndVal = (uint64_t)( 1 << ((m_DQ_FRACBITS_OUT - 2 - 2 - 15) - 1 + (32 - m_CSHIFT)) );
+    rndVal = POLY_RND;
 
     /* special case, output sample 0 */
     coef = coefBase;
@@ -3825,12 +4418,12 @@ void PolyphaseStereo(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
 
     for(int32_t j=0; j<8; j++){
         c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
-        sum1L=MADD64(sum1L, vLo,  c1); sum1L=MADD64(sum1L, vHi, -c2);
+        POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum1L, vHi, -c2);
         vLo=*(vb1+32+(j)); vHi=*(vb1+32+(23-(j)));
-        sum1R=MADD64(sum1R, vLo,  c1); sum1R=MADD64(sum1R, vHi, -c2); \
+        POLY_MAC(sum1R, vLo, c1); POLY_MAC(sum1R, vHi, -c2); \
     }
-    *(pcm + 0) = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-    *(pcm + 1) = ClipToShort((int32_t)SAR64(sum1R, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+    *(pcm + 0) = POLY_OUT(sum1L);
+    *(pcm + 1) = POLY_OUT(sum1R);
 
     /* special case, output sample 16 */
     coef = coefBase + 256;
@@ -3838,38 +4431,163 @@ void PolyphaseStereo(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
     sum1L = sum1R = rndVal;
 
     for(int32_t j=0; j<8; j++){
-        c1=*coef; coef++; vLo = *(vb1+(j)); sum1L = MADD64(sum1L, vLo,  c1);
-        vLo = *(vb1+32+(j)); sum1R = MADD64(sum1R, vLo,  c1);
+        c1=*coef; coef++; vLo = *(vb1+(j)); POLY_MAC(sum1L, vLo, c1);
+        vLo = *(vb1+32+(j)); POLY_MAC(sum1R, vLo, c1);
     }
-    *(pcm + 2*16 + 0) = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-    *(pcm + 2*16 + 1) = ClipToShort((int32_t)SAR64(sum1R, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+    *(pcm + 2*16 + 0) = POLY_OUT(sum1L);
+    *(pcm + 2*16 + 1) = POLY_OUT(sum1R);
 
     /* main convolution loop: sum1L = samples 1, 2, 3, ... 15   sum2L = samples 31, 30, ... 17 */
     coef = coefBase + 16;
     vb1 = vbuf + 64;
     pcm += 2;
 
-    /* right now, the compiler creates bad asm from this... */
     for (i = 15; i > 0; i--) {
         sum1L = sum2L = rndVal;
         sum1R = sum2R = rndVal;
 
         for(int32_t j=0; j<8; j++){
             c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
-            sum1L=MADD64(sum1L, vLo,  c1); sum2L=MADD64(sum2L, vLo,  c2);
-            sum1L=MADD64(sum1L, vHi, -c2); sum2L=MADD64(sum2L, vHi,  c1);
+            POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum2L, vLo, c2);
+            POLY_MAC(sum1L, vHi, -c2); POLY_MAC(sum2L, vHi, c1);
             vLo=*(vb1+32+(j));  vHi=*(vb1+32+(23-(j)));
-            sum1R=MADD64(sum1R, vLo,  c1); sum2R=MADD64(sum2R, vLo,  c2);
-            sum1R=MADD64(sum1R, vHi, -c2); sum2R=MADD64(sum2R, vHi,  c1);
+            POLY_MAC(sum1R, vLo, c1); POLY_MAC(sum2R, vLo, c2);
+            POLY_MAC(sum1R, vHi, -c2); POLY_MAC(sum2R, vHi, c1);
         }
         vb1 += 64;
-        *(pcm + 0)         = ClipToShort((int32_t)SAR64(sum1L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-        *(pcm + 1)         = ClipToShort((int32_t)SAR64(sum1R, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-        *(pcm + 2*2*i + 0) = ClipToShort((int32_t)SAR64(sum2L, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
-        *(pcm + 2*2*i + 1) = ClipToShort((int32_t)SAR64(sum2R, (32-m_CSHIFT)), m_DQ_FRACBITS_OUT - 2 - 2 - 15);
+        *(pcm + 0)         = POLY_OUT(sum1L);
+        *(pcm + 1)         = POLY_OUT(sum1R);
+        *(pcm + 2*2*i + 0) = POLY_OUT(sum2L);
+        *(pcm + 2*2*i + 1) = POLY_OUT(sum2R);
         pcm += 2;
     }
 }
+/***********************************************************************************************************************
+ * Function:    PolyphaseMonoHalf
+ *
+ * Description: filter one subband and produce the 16 even output PCM samples (0, 2, ... 30) for one channel
+ *
+ * Inputs:      see PolyphaseMono()
+ *
+ * Outputs:     16 samples of one channel of decoded PCM data at half the sample rate
+ *
+ * Return:      none
+ *
+ * Notes:       the same sums as PolyphaseMono() for the even samples, decimation without a filter: the subbands
+ *                above fs / 4 must be zero (MP3_QUALITY_HALFRATE drops them in IMDCT())
+ **********************************************************************************************************************/
+void PolyphaseMonoHalf(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
+   int32_t i;
+    const uint32_t *coef;
+   int32_t *vb1;
+   int32_t vLo, vHi, c1, c2;
+    polyAcc_t sum1L, sum2L, rndVal;
+
+    rndVal = POLY_RND;
+
+    /* output sample 0 */
+    coef = coefBase;
+    vb1 = vbuf;
+    sum1L = rndVal;
+    for(int32_t j=0; j<8; j++){
+        c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi=*(vb1+(23-(j)));
+        POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum1L, vHi, -c2);
+    }
+    *(pcm + 0) = POLY_OUT(sum1L);
+
+    /* output sample 16 */
+    coef = coefBase + 256;
+    vb1 = vbuf + 64*16;
+    sum1L = rndVal;
+    for(int32_t j=0; j<8; j++){
+        c1=*coef; coef++; vLo=*(vb1+(j)); POLY_MAC(sum1L, vLo, c1);
+    }
+    *(pcm + 8) = POLY_OUT(sum1L);
+
+    /* sum1L = samples 2, 4, ... 14   sum2L = samples 30, 28, ... 18 */
+    coef = coefBase + 16 * 2;
+    vb1 = vbuf + 64 * 2;
+    for (i = 14; i > 0; i -= 2) {
+        sum1L = sum2L = rndVal;
+        for(int32_t j=0; j<8; j++){
+            c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
+            POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum2L, vLo, c2);
+            POLY_MAC(sum1L, vHi, -c2); POLY_MAC(sum2L, vHi, c1);
+        }
+        coef += 16;
+        vb1 += 64 * 2;
+        *(pcm + (16 - i) / 2) = POLY_OUT(sum1L);
+        *(pcm + (16 + i) / 2) = POLY_OUT(sum2L);
+    }
+}
+/***********************************************************************************************************************
+ * Function:    PolyphaseStereoHalf
+ *
+ * Description: filter one subband and produce the 16 even output PCM samples (0, 2, ... 30) for each channel
+ *
+ * Inputs:      see PolyphaseStereo()
+ *
+ * Outputs:     16 samples of two channels of decoded PCM data at half the sample rate, interleaved LRLRLR...
+ *
+ * Return:      none
+ *
+ * Notes:       see PolyphaseMonoHalf()
+ **********************************************************************************************************************/
+void PolyphaseStereoHalf(int16_t *pcm, int32_t *vbuf, const uint32_t *coefBase){
+   int32_t i;
+    const uint32_t *coef;
+   int32_t *vb1;
+   int32_t vLo, vHi, c1, c2;
+    polyAcc_t sum1L, sum2L, sum1R, sum2R, rndVal;
+
+    rndVal = POLY_RND;
+
+    /* output sample 0 */
+    coef = coefBase;
+    vb1 = vbuf;
+    sum1L = sum1R = rndVal;
+    for(int32_t j=0; j<8; j++){
+        c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
+        POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum1L, vHi, -c2);
+        vLo=*(vb1+32+(j)); vHi=*(vb1+32+(23-(j)));
+        POLY_MAC(sum1R, vLo, c1); POLY_MAC(sum1R, vHi, -c2);
+    }
+    *(pcm + 0) = POLY_OUT(sum1L);
+    *(pcm + 1) = POLY_OUT(sum1R);
+
+    /* output sample 16 */
+    coef = coefBase + 256;
+    vb1 = vbuf + 64*16;
+    sum1L = sum1R = rndVal;
+    for(int32_t j=0; j<8; j++){
+        c1=*coef; coef++; vLo = *(vb1+(j)); POLY_MAC(sum1L, vLo, c1);
+        vLo = *(vb1+32+(j)); POLY_MAC(sum1R, vLo, c1);
+    }
+    *(pcm + 2*8 + 0) = POLY_OUT(sum1L);
+    *(pcm + 2*8 + 1) = POLY_OUT(sum1R);
+
+    /* sum1L = samples 2, 4, ... 14   sum2L = samples 30, 28, ... 18 */
+    coef = coefBase + 16 * 2;
+    vb1 = vbuf + 64 * 2;
+    for (i = 14; i > 0; i -= 2) {
+        sum1L = sum2L = rndVal;
+        sum1R = sum2R = rndVal;
+        for(int32_t j=0; j<8; j++){
+            c1=*coef; coef++; c2=*coef; coef++; vLo=*(vb1+(j)); vHi = *(vb1+(23-(j)));
+            POLY_MAC(sum1L, vLo, c1); POLY_MAC(sum2L, vLo, c2);
+            POLY_MAC(sum1L, vHi, -c2); POLY_MAC(sum2L, vHi, c1);
+            vLo=*(vb1+32+(j));  vHi=*(vb1+32+(23-(j)));
+            POLY_MAC(sum1R, vLo, c1); POLY_MAC(sum2R, vLo, c2);
+            POLY_MAC(sum1R, vHi, -c2); POLY_MAC(sum2R, vHi, c1);
+        }
+        coef += 16;
+        vb1 += 64 * 2;
+        *(pcm + (16 - i) + 0) = POLY_OUT(sum1L);
+        *(pcm + (16 - i) + 1) = POLY_OUT(sum1R);
+        *(pcm + (16 + i) + 0) = POLY_OUT(sum2L);
+        *(pcm + (16 + i) + 1) = POLY_OUT(sum2R);
+    }
+}
 
 /***********************************************************************************************************************
  * Function:    AnalyzeFrame
@@ -3,6 +3,18 @@
 
 #include "Arduino.h"
 #include "assert.h"
+#include "../audio_arena/audio_arena.h"
+#include "../sync_scan/sync_scan.h"
+
+#ifndef MP3_POLYPHASE_ACC32
+#define MP3_POLYPHASE_ACC32 1 // synthesis filter with 32 bit accumulators (mulsh), 0: 64 bit reference, bit exact with helix
+#endif
+#ifndef MP3_LAYER12
+#define MP3_LAYER12         1 // also decode MPEG audio layer I and II (.mp2), 0: layer III only
+#endif
+#ifndef MP3_HUFF_FAST_BITS
+#define MP3_HUFF_FAST_BITS  7 // first level Huffman lookup, 17 tables of 4 << n bytes RAM (7: 8.5KB, 6: 4.3KB), 4...10, 0: off
+#endif
 
 static const uint8_t  m_HUFF_PAIRTABS          =32;
 static const uint8_t  m_BLOCK_SIZE             =18;
@@ -14,6 +26,14 @@ static const uint16_t m_MAINBUF_SIZE           =1940;
 static const uint8_t  m_MAX_NGRAN              =2;     // max granules
 static const uint8_t  m_MAX_NCHAN              =2;     // max channels
 static const uint16_t m_MAX_NSAMP              =576;   // max samples per channel, per granule
+static const uint8_t  m_REDUCED_NBANDS         =16;    // subbands decoded by MP3_QUALITY_LOWPASS and _HALFRATE (fs / 4)
+static const int32_t  m_REDUCED_MINRATE        =32000; // the reduced modes apply to MPEG1 streams (32, 44.1, 48kHz) only
+
+enum {                          /* MP3Decoder_SetQuality() */
+    MP3_QUALITY_FULL =     0,   /* all 32 subbands at the stream rate */
+    MP3_QUALITY_LOWPASS =  1,   /* subbands 16...31 are dropped before the IMDCT, bandwidth fs / 4, stream rate */
+    MP3_QUALITY_HALFRATE = 2    /* as LOWPASS, the synthesis filter computes every second sample only, output fs / 2 */
+};
 
 enum {
     ERR_MP3_NONE =                  0,
@@ -197,6 +217,26 @@ typedef struct MP3DecInfo {
     int32_t part23Length[m_MAX_NGRAN][m_MAX_NCHAN];
 } MP3DecInfo_t;
 
+typedef struct MP3Decoder {     /* complete state of one decoder instance, see MP3Decoder_Init() */
+    MP3DecInfo_t         decInfo;
+    MP3FrameInfo_t       frameInfo;
+    FrameHeader_t        frameHeader;
+    SideInfo_t           sideInfo;
+    SideInfoSub_t        sideInfoSub[m_MAX_NGRAN][m_MAX_NCHAN];
+    ScaleFactorInfoSub_t scaleFactorInfoSub[m_MAX_NGRAN][m_MAX_NCHAN];
+    ScaleFactorJS_t      scaleFactorJS;
+    CriticalBandInfo_t   criticalBandInfo[m_MAX_NCHAN];  /* filled in dequantizer, used in joint stereo reconstruction */
+    SFBandTable_t        sfBand;
+    HuffmanInfo_t        huffmanInfo;
+    DequantInfo_t        dequantInfo;
+    IMDCTInfo_t          imdctInfo;
+    SubbandInfo_t        subbandInfo;
+    StereoMode_t         sMode;                          /* mono/stereo mode */
+    MPEGVersion_t        mpegVersion;                    /* version ID */
+    uint8_t              underflowCounter;               /* frames in a row without enough bit reservoir */
+    uint8_t              quality;                        /* MP3_QUALITY_xxx, kept by MP3Decoder_ClearBuffer() */
+} MP3Decoder_t;
+
 
 
 
@@ -455,9 +495,30 @@ const uint32_t csa[8][2] PROGMEM = {
  */
 
 // prototypes
+// instance API, the caller supplies the memory (MP3Decoder_StateSize() bytes), instances are independent
+MP3Decoder_t *MP3Decoder_Init(void *buf, size_t size);
+MP3Decoder_t *MP3Decoder_New(void);             // MP3Decoder_Init() on a buffer of the audio arena (heap if full)
+void     MP3Decoder_Delete(MP3Decoder_t *d);
+void     MP3Decoder_ClearBuffer(MP3Decoder_t *d);
+void     MP3Decoder_SetQuality(MP3Decoder_t *d, uint8_t quality);
+int32_t  MP3Decode(MP3Decoder_t *d, uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t useSize);
+void     MP3GetLastFrameInfo(MP3Decoder_t *d);
+int32_t  MP3GetNextFrameInfo(MP3Decoder_t *d, uint8_t *buf);
+int32_t  MP3GetSampRate(MP3Decoder_t *d);
+int32_t  MP3GetChannels(MP3Decoder_t *d);
+int32_t  MP3GetBitsPerSample(MP3Decoder_t *d);
+int32_t  MP3GetBitrate(MP3Decoder_t *d);
+int32_t  MP3GetOutputSamps(MP3Decoder_t *d);
+int32_t  MP3GetLayer(MP3Decoder_t *d);
+int32_t  MP3GetVersion(MP3Decoder_t *d);
+int32_t  MP3GetMainDataBegin(MP3Decoder_t *d);
+int32_t  MP3GetMainDataSize(MP3Decoder_t *d);
+// the same without instance argument, on the instance of MP3Decoder_AllocateBuffers()
 bool     MP3Decoder_AllocateBuffers(void);
+size_t   MP3Decoder_StateSize(void);
 bool     MP3Decoder_IsInit();
 void     MP3Decoder_FreeBuffers();
+void     MP3Decoder_SetQuality(uint8_t quality);
 int32_t  MP3Decode( uint8_t *inbuf, int32_t *bytesLeft, int16_t *outbuf, int32_t useSize);
 void     MP3GetLastFrameInfo();
 int32_t  MP3GetNextFrameInfo(uint8_t *buf);
@@ -469,36 +530,48 @@ int32_t  MP3GetBitrate();
 int32_t  MP3GetOutputSamps();
 int32_t  MP3GetLayer();
 int32_t  MP3GetVersion();
+int32_t  MP3GetMainDataBegin();
+int32_t  MP3GetMainDataSize();
 
 //internally used
 int  MP3_AnalyzeFrame(const uint8_t *frame_data, size_t frame_len);
 void MP3Decoder_ClearBuffer(void);
 void PolyphaseMono(int16_t *pcm, int32_t *vbuf, const uint32_t* coefBase);
 void PolyphaseStereo(int16_t *pcm, int32_t *vbuf, const uint32_t* coefBase);
+void PolyphaseMonoHalf(int16_t *pcm, int32_t *vbuf, const uint32_t* coefBase);
+void PolyphaseStereoHalf(int16_t *pcm, int32_t *vbuf, const uint32_t* coefBase);
 void SetBitstreamPointer(BitStreamInfo_t *bsi, int32_t nBytes, uint8_t *buf);
 uint32_t GetBits(BitStreamInfo_t *bsi, int32_t nBits);
 int32_t CalcBitsUsed(BitStreamInfo_t *bsi, uint8_t *startBuf, int32_t startOffset);
-int32_t DequantChannel(int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBound, SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis, CriticalBandInfo_t *cbi);
+int32_t DequantChannel(MP3Decoder_t *d, int32_t *sampleBuf, int32_t *workBuf, int32_t *nonZeroBound, SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis, CriticalBandInfo_t *cbi);
 void MidSideProc(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, int32_t mOut[2]);
-void IntensityProcMPEG1(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, ScaleFactorInfoSub_t *sfis,	CriticalBandInfo_t *cbi, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2]);
-void IntensityProcMPEG2(int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, ScaleFactorInfoSub_t *sfis, CriticalBandInfo_t *cbi, ScaleFactorJS_t *sfjs, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2]);
+void IntensityProcMPEG1(MP3Decoder_t *d, int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, ScaleFactorInfoSub_t *sfis,	CriticalBandInfo_t *cbi, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2]);
+void IntensityProcMPEG2(MP3Decoder_t *d, int32_t x[m_MAX_NCHAN][m_MAX_NSAMP], int32_t nSamps, ScaleFactorInfoSub_t *sfis, CriticalBandInfo_t *cbi, ScaleFactorJS_t *sfjs, int32_t midSideFlag, int32_t mixFlag, int32_t mOut[2]);
 void FDCT32(int32_t *x, int32_t *d, int32_t offset, int32_t oddBlock, int32_t gb);// __attribute__ ((section (".data")));
-int32_t CheckPadBit();
-int32_t UnpackFrameHeader(uint8_t *buf);
-int32_t UnpackSideInfo(uint8_t *buf);
-int32_t DecodeHuffman( uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, int32_t gr, int32_t ch);
-int32_t MP3Dequantize( int32_t gr);
-int32_t IMDCT( int32_t gr, int32_t ch);
-int32_t UnpackScaleFactors( uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail, int32_t gr, int32_t ch);
-int32_t Subband(int16_t *pcmBuf);
+int32_t CheckPadBit(MP3Decoder_t *d);
+int32_t UnpackFrameHeader(MP3Decoder_t *d, uint8_t *buf);
+int32_t UnpackSideInfo(MP3Decoder_t *d, uint8_t *buf);
+int32_t DecodeHuffman(MP3Decoder_t *d, uint8_t *buf, int32_t *bitOffset, int32_t huffBlockBits, int32_t gr, int32_t ch);
+int32_t MP3Dequantize(MP3Decoder_t *d, int32_t gr);
+int32_t IMDCT(MP3Decoder_t *d, int32_t gr, int32_t ch);
+int32_t UnpackScaleFactors(MP3Decoder_t *d, uint8_t *buf, int32_t *bitOffset, int32_t bitsAvail, int32_t gr, int32_t ch);
+int32_t Subband(MP3Decoder_t *d, int16_t *pcmBuf, int32_t nBlocks);
+#if MP3_LAYER12
+int32_t DecodeLayer12(MP3Decoder_t *d, uint8_t *inbuf, int32_t fhBytes, int32_t *bytesLeft, int16_t *outbuf);
+#endif
 int16_t ClipToShort(int32_t x, int32_t fracBits);
 void RefillBitstreamCache(BitStreamInfo_t *bsi);
 void UnpackSFMPEG1(BitStreamInfo_t *bsi, SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis, int32_t *scfsi, int32_t gr, ScaleFactorInfoSub_t *sfisGr0);
 void UnpackSFMPEG2(BitStreamInfo_t *bsi, SideInfoSub_t *sis, ScaleFactorInfoSub_t *sfis, int32_t gr, int32_t ch, int32_t modeExt, ScaleFactorJS_t *sfjs);
 int32_t MP3FindFreeSync(uint8_t *buf, uint8_t firstFH[4], int32_t nBytes);
-void MP3ClearBadFrame( int16_t *outbuf);
+void MP3ClearBadFrame(MP3Decoder_t *d, int16_t *outbuf);
 int32_t DecodeHuffmanPairs(int32_t *xy, int32_t nVals, int32_t tabIdx, int32_t bitsLeft, uint8_t *buf, int32_t bitOffset);
 int32_t DecodeHuffmanQuads(int32_t *vwxy, int32_t nVals, int32_t tabIdx, int32_t bitsLeft, uint8_t *buf, int32_t bitOffset);
+#if MP3_HUFF_FAST_BITS
+void    InitHuffmanFastTables(void);
+int32_t DecodeHuffmanPairsFast(int32_t **pxy, int32_t nVals, int32_t tabIdx, int32_t *pBitsLeft, uint8_t **pBuf, uint32_t *pCache, int32_t *pCachedBits);
+int32_t DecodeHuffmanQuadsFast(int32_t **pvwxy, int32_t nVals, int32_t tabIdx, int32_t *pBitsLeft, uint8_t **pBuf, uint32_t *pCache, int32_t *pCachedBits);
+#endif
 int32_t DequantBlock(int32_t *inbuf, int32_t *outbuf, int32_t num, int32_t scale);
 void AntiAlias(int32_t *x, int32_t nBfly);
 void WinPrevious(int32_t *xPrev, int32_t *xPrevWin, int32_t btPrev);
@@ -513,4 +586,4 @@ inline int32_t MULSHIFT32(int32_t x, int32_t y) { int32_t z; z = (uint64_t) x *
 inline uint64_t MADD64(uint64_t sum64, int32_t x, int32_t y) {sum64 += (uint64_t) x * (uint64_t) y; return sum64;}/* returns 64-bit value in [edx:eax] */
 inline uint64_t xSAR64(uint64_t x, int32_t n){return x >> n;}
 inline int32_t FASTABS(int32_t x){ return __builtin_abs(x);} //xtensa has a fast abs instruction //fb
-#define CLZ(x) __builtin_clz(x) //fb
+#define CLZ(x) ((x) ? __builtin_clz(x) : 32) //fb, 32 for 0 as NSAU on xtensa, __builtin_clz(0) is undefined (x86)
@@ -2012,12 +2012,8 @@ int32_t celt_decoder_init(int32_t channels){
 }
 //----------------------------------------------------------------------------------------------------------------------
 
-// save stack arrays in heap, prefer PSRAM
-#ifdef BOARD_HAS_PSRAM
-    #define __heap_caps_malloc(size) heap_caps_malloc(size, MALLOC_CAP_SPIRAM)
-#else
-    #define __heap_caps_malloc(size) heap_caps_malloc(size, MALLOC_CAP_DEFAULT)
-#endif
+// save stack arrays in the audio arena (PSRAM), heap if the arena is not available
+#define __heap_caps_malloc(size) AudioArena_Malloc(size)
 
 bool CELTDecoder_AllocateBuffers(void) {
     size_t omd = celt_decoder_get_size(2);
@@ -2041,18 +2037,24 @@ bool CELTDecoder_AllocateBuffers(void) {
     return true;
 }
 //----------------------------------------------------------------------------------------------------------------------
+size_t CELTDecoder_StateSize(void) { // bytes of CELTDecoder_AllocateBuffers(), sizes the audio arena
+    return AUDIO_ARENA_ALIGN(celt_decoder_get_size(2)) + AUDIO_ARENA_ALIGN(960 * sizeof(int32_t)) + AUDIO_ARENA_ALIGN(176 * sizeof(int32_t)) +
+           AUDIO_ARENA_ALIGN(1248 * sizeof(int16_t)) + AUDIO_ARENA_ALIGN(1920 * sizeof(int16_t)) + 4 * AUDIO_ARENA_ALIGN(21 * sizeof(int32_t)) +
+           AUDIO_ARENA_ALIGN(42) + AUDIO_ARENA_ALIGN(176 * sizeof(int16_t));
+}
+//----------------------------------------------------------------------------------------------------------------------
 void CELTDecoder_FreeBuffers(){
-    if(s_celtDec)            { free(s_celtDec);            s_celtDec =            NULL; }
-    if(s_freqBuff)           { free(s_freqBuff),           s_freqBuff =           NULL; }
-    if(s_iyBuff)             { free(s_iyBuff),             s_iyBuff =             NULL; }
-    if(s_normBuff)           { free(s_normBuff),           s_normBuff =           NULL; }
-    if(s_XBuff)              { free(s_XBuff),              s_XBuff =              NULL; }
-    if(s_bits1Buff)          { free(s_bits1Buff),          s_bits1Buff =          NULL; }
-    if(s_bits2Buff)          { free(s_bits2Buff),          s_bits2Buff =          NULL; }
-    if(s_threshBuff)         { free(s_threshBuff),         s_threshBuff =         NULL; }
-    if(s_trim_offsetBuff)    { free(s_trim_offsetBuff),    s_trim_offsetBuff =    NULL; }
-    if(s_collapse_masksBuff) { free(s_collapse_masksBuff), s_collapse_masksBuff = NULL; }
-    if(s_tmpBuff)            { free(s_tmpBuff),            s_tmpBuff =            NULL; }
+    if(s_celtDec)            { AudioArena_Free(s_celtDec);            s_celtDec =            NULL; }
+    if(s_freqBuff)           { AudioArena_Free(s_freqBuff),           s_freqBuff =           NULL; }
+    if(s_iyBuff)             { AudioArena_Free(s_iyBuff),             s_iyBuff =             NULL; }
+    if(s_normBuff)           { AudioArena_Free(s_normBuff),           s_normBuff =           NULL; }
+    if(s_XBuff)              { AudioArena_Free(s_XBuff),              s_XBuff =              NULL; }
+    if(s_bits1Buff)          { AudioArena_Free(s_bits1Buff),          s_bits1Buff =          NULL; }
+    if(s_bits2Buff)          { AudioArena_Free(s_bits2Buff),          s_bits2Buff =          NULL; }
+    if(s_threshBuff)         { AudioArena_Free(s_threshBuff),         s_threshBuff =         NULL; }
+    if(s_trim_offsetBuff)    { AudioArena_Free(s_trim_offsetBuff),    s_trim_offsetBuff =    NULL; }
+    if(s_collapse_masksBuff) { AudioArena_Free(s_collapse_masksBuff), s_collapse_masksBuff = NULL; }
+    if(s_tmpBuff)            { AudioArena_Free(s_tmpBuff),            s_tmpBuff =            NULL; }
 }
 //----------------------------------------------------------------------------------------------------------------------
 void CELTDecoder_ClearBuffer(void){
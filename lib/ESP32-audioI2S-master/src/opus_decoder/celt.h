@@ -609,6 +609,7 @@ void     unquant_energy_finalise(int16_t *oldEBands, int32_t *fine_quant, int32_
 uint32_t celt_pvq_u_row(uint32_t row, uint32_t data);
 
 bool     CELTDecoder_AllocateBuffers(void);
+size_t   CELTDecoder_StateSize(void);
 void     CELTDecoder_FreeBuffers();
 void     CELTDecoder_ClearBuffer(void);
 
@@ -70,9 +70,9 @@ float     s_opusCompressionRatio = 0;
 std::vector <uint32_t>s_opusBlockPicItem;
 
 bool OPUSDecoder_AllocateBuffers(){
-    s_opusChbuf = (char*)__malloc_heap_psram(512);
+    s_opusChbuf = (char*)AudioArena_Malloc(512);
     if(!CELTDecoder_AllocateBuffers()) {log_e("CELT not init"); return false;}
-    s_opusSegmentTable = (uint16_t*)__malloc_heap_psram(256 * sizeof(uint16_t));
+    s_opusSegmentTable = (uint16_t*)AudioArena_Malloc(256 * sizeof(uint16_t));
     if(!s_opusSegmentTable) {log_e("CELT not init"); return false;}
     CELTDecoder_ClearBuffer();
     OPUSDecoder_ClearBuffers();
@@ -95,9 +95,12 @@ bool OPUSDecoder_AllocateBuffers(){
     // }
     return true;
 }
+size_t OPUSDecoder_StateSize(){ // bytes of OPUSDecoder_AllocateBuffers(), sizes the audio arena
+    return AUDIO_ARENA_ALIGN(512) + AUDIO_ARENA_ALIGN(256 * sizeof(uint16_t)) + CELTDecoder_StateSize();
+}
 void OPUSDecoder_FreeBuffers(){
-    if(s_opusChbuf)        {free(s_opusChbuf);        s_opusChbuf = NULL;}
-    if(s_opusSegmentTable) {free(s_opusSegmentTable); s_opusSegmentTable = NULL;}
+    if(s_opusChbuf)        {AudioArena_Free(s_opusChbuf);        s_opusChbuf = NULL;}
+    if(s_opusSegmentTable) {AudioArena_Free(s_opusSegmentTable); s_opusSegmentTable = NULL;}
     s_frameCount = 0;
     s_opusSegmentLength = 0;
     s_opusValidSamples = 0;
@@ -1066,17 +1069,5 @@ int32_t OPUSFindSyncWord(unsigned char *buf, int32_t nBytes){
 }
 //----------------------------------------------------------------------------------------------------------------------
 int32_t OPUS_specialIndexOf(uint8_t* base, const char* str, int32_t baselen, bool exact){
-    int32_t result = -1;  // seek for str in buffer or in header up to baselen, not nullterninated
-    if (strlen(str) > baselen) return -1; // if exact == true seekstr in buffer must have "\0" at the end
-    for (int32_t i = 0; i < baselen - strlen(str); i++){
-        result = i;
-        for (int32_t j = 0; j < strlen(str) + exact; j++){
-            if (*(base + i + j) != *(str + j)){
-                result = -1;
-                break;
-            }
-        }
-        if (result >= 0) break;
-    }
-    return result;
+    return SyncScan_IndexOf(base, str, baselen, exact); // seek for str in buffer up to baselen, not nullterminated
 }
@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <vector>
+#include "../audio_arena/audio_arena.h"
+#include "../sync_scan/sync_scan.h"
 using namespace std;
 
 enum : int8_t  {OPUS_END = 120,
@@ -36,6 +38,7 @@ enum : int8_t  {OPUS_END = 120,
                 ERR_CELT_OPUS_INTERNAL_ERROR = -28};
 
 bool             OPUSDecoder_AllocateBuffers();
+size_t           OPUSDecoder_StateSize();
 void             OPUSDecoder_FreeBuffers();
 void             OPUSDecoder_ClearBuffers();
 void             OPUSsetDefaults();
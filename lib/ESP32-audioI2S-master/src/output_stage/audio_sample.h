@@ -0,0 +1,29 @@
+/*
+ *  audio_sample.h
+ *
+ *  Sample format between the decoders and the I2S slots, chosen at compile time with -DAUDIO_SAMPLE_32=0/1 in
+ *  platformio.ini.
+ *  0 (default): 16 bit samples from the decoder to I2S, 16 bit slots.
+ *  1: 32 bit samples with 24 significant bits (full scale +-2^23) from the decoder up to the gain stage, the tone
+ *     filters and the resampler have 8 bits of headroom. GainRamp saturates them and left aligns them in 32 bit I2S
+ *     slots, the codec runs at 24 bit. The 16 bit decoders are widened by AUDIO_SAMPLE_SHIFT, FLAC delivers up to 24 bit.
+ *  No Arduino dependency.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef AUDIO_SAMPLE_32
+#define AUDIO_SAMPLE_32 0
+#endif
+
+#if AUDIO_SAMPLE_32
+typedef int32_t audio_sample_t;
+#define AUDIO_SAMPLE_SHIFT 8 // 16 bit sample -> audio_sample_t
+#else
+typedef int16_t audio_sample_t;
+#define AUDIO_SAMPLE_SHIFT 0
+#endif
@@ -0,0 +1,112 @@
+/*
+ *  gain_ramp.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "gain_ramp.h"
+#include <math.h>
+
+GainRamp::GainRamp() {
+    for(int ch = 0; ch < 2; ch++) {
+        m_cur[ch] = 1.0f;
+        m_target[ch] = 1.0f;
+        m_factor[ch] = 1.0f;
+        m_next[ch] = 1.0f;
+    }
+    steady();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GainRamp::set(float left, float right, uint32_t rampFrames) {
+    float t[2] = {left, right};
+    for(int ch = 0; ch < 2; ch++) {
+        if(t[ch] < 0) t[ch] = 0;
+        if(t[ch] > 1) t[ch] = 1;
+    }
+    uint32_t seq;
+    do seq = m_seq.load(std::memory_order_relaxed) & ~1u; // odd: another task is in set()
+    while(!m_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire));
+    std::atomic_thread_fence(std::memory_order_release);
+    m_next[0] = t[0];
+    m_next[1] = t[1];
+    m_nextFrames = rampFrames;
+    m_seq.store(seq + 2, std::memory_order_release);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GainRamp::take() { // audio task, the target of the last complete set()
+    uint32_t seq = m_seq.load(std::memory_order_acquire);
+    if(seq == m_taken || (seq & 1)) return;
+    float    next[2] = {m_next[0], m_next[1]};
+    uint32_t rampFrames = m_nextFrames;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(m_seq.load(std::memory_order_relaxed) != seq) return; // set() again during the copy, next block
+    m_taken = seq;
+    start(next, rampFrames);
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GainRamp::start(const float target[2], uint32_t rampFrames) {
+    m_target[0] = target[0];
+    m_target[1] = target[1];
+    if(!rampFrames || (m_cur[0] == m_target[0] && m_cur[1] == m_target[1])) {
+        m_cur[0] = m_target[0];
+        m_cur[1] = m_target[1];
+        m_remain = 0;
+        steady();
+        return;
+    }
+    for(int ch = 0; ch < 2; ch++) { // constant factor per frame, from 'cur' to 'target' in rampFrames steps
+        float from = (m_cur[ch] < GAIN_RAMP_FLOOR) ? GAIN_RAMP_FLOOR : m_cur[ch];
+        float to = (m_target[ch] < GAIN_RAMP_FLOOR) ? GAIN_RAMP_FLOOR : m_target[ch];
+        m_cur[ch] = from;
+        m_factor[ch] = powf(to / from, 1.0f / rampFrames);
+    }
+    m_remain = rampFrames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GainRamp::steady() {
+    for(int ch = 0; ch < 2; ch++) m_q15[ch] = (int32_t)(m_cur[ch] * 32768.0f + 0.5f);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static inline int32_t toSlot(int32_t s) { // 24 bit -> left aligned in the 32 bit slot, saturated
+    if(s > 0x7FFFFF) s = 0x7FFFFF;
+    if(s < -0x800000) s = -0x800000;
+    return (int32_t)((uint32_t)s << 8);
+}
+static inline int16_t scale(int16_t s, float g) { return (int16_t)(s * g); }
+static inline int32_t scale(int32_t s, float g) { return toSlot((int32_t)(s * g)); }
+static inline int16_t scaleQ15(int16_t s, int32_t q) { return (int16_t)((s * q) >> 15); }
+static inline int32_t scaleQ15(int32_t s, int32_t q) { return toSlot((int32_t)(((int64_t)s * q) >> 15)); }
+
+template <typename T>
+void GainRamp::apply(T* frames, uint32_t n) {
+    uint32_t i = 0;
+    take();
+    if(m_remain) {
+        uint32_t r = (n < m_remain) ? n : m_remain;
+        float l = m_cur[0], rg = m_cur[1];
+        for(; i < r; i++) {
+            l *= m_factor[0];
+            rg *= m_factor[1];
+            frames[2 * i]     = scale(frames[2 * i], l);
+            frames[2 * i + 1] = scale(frames[2 * i + 1], rg);
+        }
+        m_cur[0] = l;
+        m_cur[1] = rg;
+        m_remain -= r;
+        if(!m_remain) { // end of the ramp, the floor becomes the real target
+            m_cur[0] = m_target[0];
+            m_cur[1] = m_target[1];
+            steady();
+        }
+    }
+    if(i == n) return;
+    if(sizeof(T) == 2 && m_q15[0] == 32768 && m_q15[1] == 32768) return; // unity gain, 32 bit slots need the conversion
+    for(; i < n; i++) {
+        frames[2 * i]     = scaleQ15(frames[2 * i], m_q15[0]);
+        frames[2 * i + 1] = scaleQ15(frames[2 * i + 1], m_q15[1]);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void GainRamp::process(int16_t* frames, uint32_t n) { apply(frames, n); }
+
+void GainRamp::process(int32_t* frames, uint32_t n) { apply(frames, n); }
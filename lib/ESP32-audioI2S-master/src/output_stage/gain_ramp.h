@@ -0,0 +1,50 @@
+/*
+ *  gain_ramp.h
+ *
+ *  Per sample gain of the stereo output, applied to a whole block at once. A new volume, balance or mute is not set
+ *  instantly but reached with a ramp that is linear in dB (a constant factor per frame), clicks are avoided.
+ *  Gains below GAIN_RAMP_FLOOR (-60dB) are ramped to the floor, then set to the target (0 = silence).
+ *  Without a ramp in progress the block is scaled with a Q15 factor, with unity gain it is not touched at all.
+ *  set() can be called from any task, the new target is taken over by process() at the beginning of the next block. It
+ *  is published with a sequence counter (odd while set() writes it, one writer at a time): process() takes a copy only
+ *  when the counter is even and unchanged after the copy, else it keeps the old target for one more block.
+ *  With 32 bit samples (AUDIO_SAMPLE_32) this is the final conversion: the 24 bit samples are scaled, saturated and left
+ *  aligned in the 32 bit I2S slots in the same pass.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define GAIN_RAMP_FLOOR 0.001f // -60dB
+
+class GainRamp {
+public:
+    GainRamp();
+    void     set(float left, float right, uint32_t rampFrames); // linear gain 0...1, 0 frames: instantly
+    void     process(int16_t* frames, uint32_t n);              // interleaved L/R
+    void     process(int32_t* frames, uint32_t n);              // interleaved L/R, 24 bit in, 32 bit I2S slots out
+    bool     isRamping() { return m_remain > 0 || m_seq.load(std::memory_order_acquire) != m_taken; } // audio task
+    bool     isSilent() { return !isRamping() && m_cur[0] == 0 && m_cur[1] == 0; }
+    float    gain(uint8_t ch) { return m_cur[ch & 1]; }
+
+private:
+    void     take();
+    void     start(const float target[2], uint32_t rampFrames);
+    void     steady();
+    template <typename T> void apply(T* frames, uint32_t n);
+
+    float    m_cur[2];
+    float    m_target[2];
+    float    m_factor[2];  // per frame while ramping
+    uint32_t m_remain = 0; // frames up to the target
+    int32_t  m_q15[2];     // m_cur as Q15, used when not ramping
+    float    m_next[2];    // set(), not yet taken over
+    uint32_t m_nextFrames = 0;
+    uint32_t m_taken = 0;  // m_seq of the last target taken over
+    std::atomic<uint32_t> m_seq{0};
+};
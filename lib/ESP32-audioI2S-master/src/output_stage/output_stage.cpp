@@ -0,0 +1,151 @@
+/*
+ *  output_stage.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "output_stage.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+    #include "esp_heap_caps.h"
+    // prefer internal RAM, the I2S driver copies the blocks into the DMA buffers
+    #define __malloc_heap_internal(size) \
+        heap_caps_malloc_prefer(size, 2, MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL, MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM)
+#else
+    #define __malloc_heap_internal(size) malloc(size)
+#endif
+
+OutputStage::OutputStage() {}
+
+OutputStage::~OutputStage() { freePool(); }
+
+void OutputStage::freePool() {
+    if(m_pool) free(m_pool);
+    m_pool = nullptr;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool OutputStage::init(uint8_t numBlocks, uint16_t blockFrames, uint8_t dmaDepth) {
+    if(numBlocks < 2 || !blockFrames || !dmaDepth) return false;
+    freePool();
+    m_pool = (audio_sample_t*)__malloc_heap_internal((size_t)numBlocks * blockFrames * 2 * sizeof(audio_sample_t));
+    if(!m_pool) return false;
+    m_numBlocks = numBlocks;
+    m_blockFrames = blockFrames;
+    m_dmaDepth = dmaDepth;
+    reset();
+    resetStats();
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OutputStage::reset() {
+    drop();
+    m_dmaFree = m_dmaDepth;
+}
+
+void OutputStage::drop() {
+    // the DMA buffers that were already written keep their credit, onDmaSent() gives it back when they have been sent.
+    // Restoring all credits here would show an empty DMA and count the audio still in it as underruns
+    m_f_active = 0;
+    m_f_starved = 0;
+    m_head = 0;
+    m_tail = 0;
+    m_fill = 0;
+    m_frontOffset = 0;
+    m_queued = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint16_t OutputStage::dmaFrames(uint16_t frames) {
+    if(!frames || frames > OUTPUT_MAX_BLOCK_FRAMES) return OUTPUT_MAX_BLOCK_FRAMES;
+    return frames;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t OutputStage::level() {
+    uint32_t dmaFree = m_dmaFree.load();
+    if(dmaFree > m_dmaDepth) dmaFree = m_dmaDepth;
+    return (uint8_t)(m_queued.load() + m_dmaDepth - dmaFree);
+}
+//----------------------------------------------------------------------------------------------------------------------
+audio_sample_t* OutputStage::acquire(uint16_t* room) {
+    *room = 0;
+    if(!m_pool) return nullptr;
+    if(m_queued.load() >= m_numBlocks) return nullptr; // the head block is still waiting for I2S
+    *room = m_blockFrames - m_fill;
+    return m_pool + ((size_t)m_head * m_blockFrames + m_fill) * 2;
+}
+
+void OutputStage::produced(uint16_t frames) {
+    if(!frames) return;
+    m_f_active = 1;
+    m_fill += frames;
+    if(m_fill >= m_blockFrames) commit();
+}
+
+void OutputStage::flush() {
+    if(m_fill && m_queued.load() < m_numBlocks) {
+        memset(m_pool + ((size_t)m_head * m_blockFrames + m_fill) * 2, 0, (size_t)(m_blockFrames - m_fill) * 2 * sizeof(audio_sample_t));
+        commit();
+    }
+    m_f_active = 0; // the DMA may run dry now, that is not an underrun
+}
+
+void OutputStage::commit() {
+    m_fill = 0;
+    m_head++;
+    if(m_head == m_numBlocks) m_head = 0;
+    m_queued++;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t* OutputStage::front(size_t* bytes) {
+    *bytes = 0;
+    if(!m_queued.load() || !m_dmaFree.load()) return nullptr;
+    *bytes = (size_t)m_blockFrames * 2 * sizeof(audio_sample_t) - m_frontOffset;
+    return (uint8_t*)(m_pool + (size_t)m_tail * m_blockFrames * 2) + m_frontOffset;
+}
+
+void OutputStage::consumed(size_t bytes) {
+    if(!bytes) return;
+    m_frontOffset += bytes;
+    if(m_frontOffset < (size_t)m_blockFrames * 2 * sizeof(audio_sample_t)) return; // partially written
+    m_frontOffset = 0;
+    m_tail++;
+    if(m_tail == m_numBlocks) m_tail = 0;
+    uint32_t q = --m_queued;
+    m_dmaFree--;
+    m_blocksSent++;
+    if(m_f_starved.exchange(0)) m_lateBlocks++;
+    if(m_f_active.load() && q < m_minQueued.load()) m_minQueued = q;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OutputStage::onDmaSent() {
+    // with auto_clear the DMA runs continuously, every sent buffer that was not filled by consumed() has been silence
+    uint32_t f = m_dmaFree.load();
+    while(f < m_dmaDepth && !m_dmaFree.compare_exchange_weak(f, f + 1)) {} // consumed() may decrement concurrently
+    if(f >= m_dmaDepth) {
+        if(m_f_active.load()) { m_underruns++; m_f_starved = 1; }
+        return;
+    }
+    if(m_f_active.load() && f + 1 > m_maxDmaFree.load()) m_maxDmaFree = f + 1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void OutputStage::getStats(outputStats_t* st) {
+    st->numBlocks   = m_numBlocks;
+    st->blockFrames = m_blockFrames;
+    st->dmaDepth    = m_dmaDepth;
+    st->queued      = m_queued.load();
+    st->minQueued   = m_minQueued.load();
+    st->dmaFree     = m_dmaFree.load();
+    st->maxDmaFree  = m_maxDmaFree.load();
+    st->blocksSent  = m_blocksSent.load();
+    st->underruns   = m_underruns.load();
+    st->lateBlocks  = m_lateBlocks.load();
+}
+
+void OutputStage::resetStats() {
+    m_minQueued = m_numBlocks;
+    m_maxDmaFree = 0;
+    m_blocksSent = 0;
+    m_underruns = 0;
+    m_lateBlocks = 0;
+}
@@ -0,0 +1,89 @@
+/*
+ *  output_stage.h
+ *
+ *  Pool of preallocated, DMA sized blocks between the DSP chain and I2S.
+ *  One block holds exactly one DMA buffer (dma_frame_num stereo frames of audio_sample_t), the I2S 'on_sent' event is the
+ *  consumer clock.
+ *  No I2S or FreeRTOS calls in here, the pool and the accounting can be driven by a simulated clock on the host.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "audio_sample.h"
+
+// The IDF I2S driver clamps one DMA buffer to 4092 bytes without an error. A block must be exactly one DMA buffer, so
+// the frame count is derived from this limit in one place, see OutputStage::dmaFrames().
+#define OUTPUT_DMA_BUFFER_MAX   4092
+#define OUTPUT_MAX_BLOCK_FRAMES (OUTPUT_DMA_BUFFER_MAX / (2 * sizeof(audio_sample_t))) // 1023 (16 bit), 511 (32 bit slots)
+
+typedef struct {
+    uint8_t  numBlocks;   // blocks in the pool
+    uint16_t blockFrames; // stereo frames per block (== I2S dma_frame_num)
+    uint8_t  dmaDepth;    // number of DMA buffers (== I2S dma_desc_num)
+    uint8_t  queued;      // blocks waiting for a free DMA buffer
+    uint8_t  minQueued;   // lowest queue level while playing, since the last resetStats()
+    uint8_t  dmaFree;     // DMA buffers that are not filled with audio data
+    uint8_t  maxDmaFree;  // highest number of unfilled DMA buffers while playing, since the last resetStats()
+    uint32_t blocksSent;  // blocks handed over to the DMA
+    uint32_t underruns;   // DMA buffers sent without audio data (auto_clear -> silence)
+    uint32_t lateBlocks;  // blocks that arrived after an underrun
+} outputStats_t;
+
+class OutputStage {
+public:
+    OutputStage();
+    ~OutputStage();
+    bool     init(uint8_t numBlocks, uint16_t blockFrames, uint8_t dmaDepth); // (re)allocates the pool
+    void     reset();                                  // drops all blocks, the I2S channel is disabled and the DMA is empty
+    void     drop();                                   // drops the queued blocks, the DMA buffers play out and onDmaSent() returns their credits
+    static uint16_t dmaFrames(uint16_t frames);        // frames per DMA buffer and block, 0 or too large: OUTPUT_MAX_BLOCK_FRAMES
+    bool     isInitialized() { return m_pool != nullptr; }
+    uint16_t blockFrames() { return m_blockFrames; }
+    uint8_t  queued() { return (uint8_t)m_queued.load(); }
+    uint8_t  numBlocks() { return m_numBlocks; }
+    uint8_t  capacity() { return m_numBlocks + m_dmaDepth; }
+    uint8_t  level();                                  // blocks with audio in the pool and in the DMA buffers
+
+    // producer side (DSP chain)
+    audio_sample_t* acquire(uint16_t* room);           // write pointer into the current block, room in frames, nullptr if the pool is full
+    void     produced(uint16_t frames);                // frames written at acquire(), a full block is queued automatically
+    void     flush();                                  // pad the current block with silence and queue it, end of stream
+
+    // consumer side (I2S writer)
+    uint8_t* front(size_t* bytes);                     // unwritten part of the oldest block, nullptr if nothing queued or no DMA buffer free
+    void     consumed(size_t bytes);                   // bytes accepted by I2S, releases the block when it is complete
+
+    // DMA events, ISR safe
+    void     onDmaSent();                              // one DMA buffer has been transmitted
+
+    void     getStats(outputStats_t* st);
+    void     resetStats();
+
+private:
+    void     commit();
+    void     freePool();
+
+    audio_sample_t*      m_pool = nullptr;
+    uint8_t              m_numBlocks = 0;
+    uint16_t             m_blockFrames = 0;
+    uint8_t              m_dmaDepth = 0;
+    uint8_t              m_head = 0;             // block that is filled by the producer
+    uint8_t              m_tail = 0;             // oldest queued block
+    uint16_t             m_fill = 0;             // frames in the head block
+    size_t               m_frontOffset = 0;      // bytes of the tail block already written to I2S
+    // 32 bit atomics, they are lock free on Xtensa and can be used in the I2S ISR
+    std::atomic<uint32_t> m_queued{0};
+    std::atomic<uint32_t> m_dmaFree{0};
+    std::atomic<uint32_t> m_f_active{0};         // 1 between the first produced block and flush() / reset()
+    std::atomic<uint32_t> m_f_starved{0};        // an underrun occured, the next block is late
+    std::atomic<uint32_t> m_minQueued{0};
+    std::atomic<uint32_t> m_maxDmaFree{0};
+    std::atomic<uint32_t> m_blocksSent{0};
+    std::atomic<uint32_t> m_underruns{0};
+    std::atomic<uint32_t> m_lateBlocks{0};
+};
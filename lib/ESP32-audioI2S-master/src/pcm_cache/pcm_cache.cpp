@@ -0,0 +1,215 @@
+/*
+ *  pcm_cache.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "pcm_cache.h"
+#include "../gapless/gapless.h"
+#include "../sync_scan/sync_scan.h"
+#include "../flac_decoder/flac_decoder.h"
+#include <string.h>
+#include <vector>
+
+#define PCM_CACHE_CHUNK 1024 // 48 kHz frames per write() call
+
+static void     put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void     put32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static uint32_t get32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint32_t be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+//----------------------------------------------------------------------------------------------------------------------
+void PcmCache::makeHeader(uint8_t* h, const pcmCacheHeader_t* c) {
+    memcpy(h, "RIFF", 4);
+    put32(h + 4, PCM_CACHE_HEADER_SIZE - 8 + c->dataSize);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    put32(h + 16, 16);
+    put16(h + 20, 1);                                    // PCM
+    put16(h + 22, c->channels);
+    put32(h + 24, PCM_CACHE_RATE);
+    put32(h + 28, PCM_CACHE_RATE * 2 * c->channels);     // bytes per second
+    put16(h + 32, 2 * c->channels);
+    put16(h + 34, 16);
+    memcpy(h + 36, "bzsc", 4);
+    put32(h + 40, 16);
+    put32(h + 44, PCM_CACHE_VERSION);
+    put32(h + 48, c->srcSize);
+    put32(h + 52, c->srcTime);
+    put32(h + 56, c->crc);
+    memcpy(h + 60, "data", 4);
+    put32(h + 64, c->dataSize);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool PcmCache::parseHeader(const uint8_t* h, size_t fileSize, pcmCacheHeader_t* c) {
+    if(memcmp(h, "RIFF", 4) || memcmp(h + 8, "WAVEfmt ", 8) || memcmp(h + 36, "bzsc", 4) || memcmp(h + 60, "data", 4)) return false;
+    if(get32(h + 44) != PCM_CACHE_VERSION || get32(h + 24) != PCM_CACHE_RATE || h[34] != 16) return false;
+    c->channels = h[22];
+    c->srcSize = get32(h + 48);
+    c->srcTime = get32(h + 52);
+    c->crc = get32(h + 56);
+    c->dataSize = get32(h + 64);
+    return (c->channels == 1 || c->channels == 2) && fileSize == PCM_CACHE_HEADER_SIZE + (size_t)c->dataSize;
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint32_t PcmCache::crc32(uint32_t crc, const uint8_t* p, size_t n) {
+    static uint32_t table[256];
+    if(!table[1]) {
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+            table[i] = c;
+        }
+    }
+    crc = ~crc;
+    while(n--) crc = table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool PcmCache::transcode(uint8_t* data, size_t len, pcmCacheWrite_t write, void* user, pcmTranscodeResult_t* r) {
+    memset(r, 0, sizeof(pcmTranscodeResult_t));
+    size_t pos = 0;
+    if(len >= 10 && !memcmp(data, "ID3", 3)) { // ID3v2, the size syncsafe
+        pos = 10 + ((data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F));
+        if(data[5] & 0x10) pos += 10;          // footer
+    }
+    if(pos + 4 > len) return false;
+    PcmCache    t;
+    AudioCodec* c = nullptr;
+    bool        flac = !memcmp(data + pos, "fLaC", 4);
+    t.m_r = r;
+    if(flac) { // the metadata blocks, the frames follow the last one
+        audioCodecRaw_t raw = {};
+        uint8_t         md5[16];
+        bool            last = false, info = false;
+        pos += 4;
+        while(!last) {
+            if(pos + 4 > len) return false;
+            last = data[pos] & 0x80;
+            uint32_t blockLen = (data[pos + 1] << 16) | (data[pos + 2] << 8) | data[pos + 3];
+            const uint8_t* s = data + pos + 4;
+            if((data[pos] & 0x7F) == 0 && blockLen >= 34 && pos + 4 + 34 <= len) { // STREAMINFO
+                raw.sampleRate = (s[10] << 12) | (s[11] << 4) | (s[12] >> 4);
+                raw.channels = ((s[12] >> 1) & 0x07) + 1;
+                raw.bitsPerSample = (((s[12] & 0x01) << 4) | (s[13] >> 4)) + 1;
+                raw.totalSamples = be32(s + 14);
+                memcpy(md5, s + 18, 16);
+                info = true;
+            }
+            pos += 4 + blockLen;
+        }
+        if(!info || pos >= len) return false;
+        c = AudioCodec_NewFLAC();
+        if(!c || !c->init()) {delete c; return false;}
+        raw.audioDataSize = len - pos;
+        c->setRawParams(&raw);
+        c->setCrcCheck(true, false);            // a bad frame is counted and comes out as silence
+        c->startMD5(md5);
+    } else {
+        if(!SyncScan_ValidHeader(data + pos, SYNC_MP3)) return false; // the first frame right behind the tag
+        c = AudioCodec_NewMP3();                // a new instance decodes in MP3_QUALITY_FULL
+        if(!c || !c->init()) {delete c; return false;}
+        gaplessInfo_t gi;
+        if(Gapless_MP3Info(data + pos, len - pos, false, &gi)) {
+            t.m_skip = gi.skip;
+            t.m_remain = gi.total;
+        }
+    }
+    r->done = t.run(c, data + pos, len - pos, write, user);
+    if(flac) {
+        int8_t md5 = c->md5Result();
+        r->md5 = (md5 == FLAC_MD5_RUNNING) ? (int8_t)FLAC_MD5_WRONG : md5; // samples missing
+        r->corrupt = c->corruptFrames();
+    }
+    delete c;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// the loop of Audio for one stream: find the frame, decode it, one byte on after an error
+bool PcmCache::run(AudioCodec* c, uint8_t* data, int32_t len, pcmCacheWrite_t write, void* user) {
+    std::vector<int16_t> out(MAX_BLOCKSIZE * 2);
+    int32_t              pos = 0;
+    bool                 synced = false;
+    while(pos < len) {
+        if(!synced) {
+            int32_t o = c->findSync(data + pos, len - pos);
+            if(o < 0) break;
+            pos += o;
+            synced = true;
+        }
+        int32_t left = len - pos;
+        int32_t ret = c->decode(data + pos, &left, out.data());
+        if(ret < 0) {
+            m_r->errors++;
+            pos++;
+            synced = false;
+            continue;
+        }
+        pos = len - left;
+        if(c->noOutput(ret)) continue;
+        audioCodecInfo_t info;
+        c->getInfo(&info);
+        if(!m_r->channels) {
+            m_r->channels = info.channels;
+            m_r->sampleRate = info.sampleRate;
+        }
+        if(info.channels != m_r->channels || info.sampleRate != m_r->sampleRate) return false; // one format per cache file
+        if(!m_r->sampleRate || m_r->channels < 1 || m_r->channels > 2) return false;
+        if(!put(out.data(), c->outputFrames(), write, user)) return false;
+    }
+    return m_r->channels && flush(write, user);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// gapless trim, then linear interpolation to 48 kHz: output frame k lies at k * rate / 48000 in the source
+bool PcmCache::put(const int16_t* pcm, uint32_t frames, pcmCacheWrite_t write, void* user) {
+    uint8_t  ch = m_r->channels;
+    uint32_t drop = frames < m_skip ? frames : m_skip;
+    m_skip -= drop;
+    pcm += drop * ch;
+    frames -= drop;
+    if(m_remain >= 0) {
+        if(frames > (uint32_t)m_remain) frames = m_remain;
+        m_remain -= frames;
+    }
+    if(!frames) return true;
+    int16_t  buf[PCM_CACHE_CHUNK * 2];
+    uint32_t n = 0;
+    uint64_t end = m_in + frames;                        // source frames m_in ... end - 1 are here, m_in - 1 in m_prev
+    for(;;) {
+        uint64_t p = m_out * m_r->sampleRate;
+        uint64_t i = p / PCM_CACHE_RATE;
+        uint32_t f = p % PCM_CACHE_RATE;
+        if(i >= end || (f && i + 1 >= end)) break;       // the next call brings the frame behind
+        for(uint8_t k = 0; k < ch; k++) {
+            int32_t a = (i < m_in) ? m_prev[k] : pcm[(i - m_in) * ch + k];
+            int32_t b = f ? pcm[(i + 1 - m_in) * ch + k] : a;
+            int64_t v = (int64_t)a * (PCM_CACHE_RATE - f) + (int64_t)b * f;
+            buf[n * ch + k] = (int16_t)((v + (v < 0 ? -PCM_CACHE_RATE / 2 : PCM_CACHE_RATE / 2)) / PCM_CACHE_RATE);
+        }
+        m_out++;
+        if(++n == PCM_CACHE_CHUNK && !emit(buf, &n, write, user)) return false;
+    }
+    for(uint8_t k = 0; k < ch; k++) m_prev[k] = pcm[(frames - 1) * ch + k];
+    m_in = end;
+    return emit(buf, &n, write, user);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool PcmCache::flush(pcmCacheWrite_t write, void* user) { // the output frames behind the last source frame hold it
+    int16_t  buf[PCM_CACHE_CHUNK * 2];
+    uint32_t n = 0;
+    uint8_t  ch = m_r->channels;
+    while(m_out * m_r->sampleRate < m_in * PCM_CACHE_RATE) {
+        for(uint8_t k = 0; k < ch; k++) buf[n * ch + k] = m_prev[k];
+        m_out++;
+        if(++n == PCM_CACHE_CHUNK && !emit(buf, &n, write, user)) return false;
+    }
+    return emit(buf, &n, write, user);
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool PcmCache::emit(int16_t* out, uint32_t* n, pcmCacheWrite_t write, void* user) {
+    if(!*n) return true;
+    uint32_t bytes = *n * m_r->channels * sizeof(int16_t);
+    if(!write(out, *n, m_r->channels, user)) return false;
+    m_r->crc32 = crc32(m_r->crc32, (const uint8_t*)out, bytes);
+    m_r->frames += *n;
+    *n = 0;
+    return true;
+}
@@ -0,0 +1,76 @@
+/*
+ *  pcm_cache.h
+ *
+ *  The 48 kHz PCM cache of the SD sounds (AudioCache) outside of Audio: the file format and a transcode core that drives
+ *  a decoder through the AudioCodec interface. On the device Audio::renderToFile() makes the cache with the playback
+ *  pipeline, on the host tools/pcm_cache_cli.cpp makes the same files with PcmCache::transcode(). No FS calls in here.
+ *
+ *  File layout, a WAV of 48 kHz 16 bit (mono stays mono), little endian:
+ *    0  "RIFF" size      8  "WAVEfmt " 16, PCM, channels, 48000, bytes/s, block align, 16
+ *    36 "bzsc" 16        44 version    48 source size    52 source date (0: ignored)    56 CRC32 of the PCM data
+ *    60 "data" size      68 samples
+ *
+ *  transcode() takes MP3/MP2 (a frame right at the start or behind an ID3v2 tag, encoder delay and padding of the LAME
+ *  tag trimmed) and native FLAC (STREAMINFO, frame CRCs and MD5 checked). The resampler is linear as
+ *  Audio::resampleTo48kStereo(), but continues over the frame boundaries: the PCM is not bit exact with the device, the
+ *  CRC in the header covers what was written.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../audio_codec/audio_codec.h"
+
+#define PCM_CACHE_HEADER_SIZE 68
+#define PCM_CACHE_VERSION     1
+#define PCM_CACHE_RATE        48000
+
+typedef struct {
+    uint8_t  channels;
+    uint32_t dataSize;     // bytes of PCM behind the header
+    uint32_t srcSize;
+    uint32_t srcTime;      // 0: not compared
+    uint32_t crc;
+} pcmCacheHeader_t;
+
+typedef struct {           // as audio_render_t of Audio::renderToFile()
+    bool     done;         // the end of the source was reached and every write succeeded
+    uint32_t frames;       // 48 kHz frames written
+    uint8_t  channels;
+    uint32_t sampleRate;   // of the source
+    uint32_t crc32;
+    int8_t   md5;          // FLAC: 1 decoded samples match the STREAMINFO MD5, -1 they don't, 0 not checked
+    uint16_t corrupt;      // FLAC: frames with a wrong CRC
+    uint32_t errors;       // decode() errors, the decoder resynced behind them
+} pcmTranscodeResult_t;
+
+typedef bool (*pcmCacheWrite_t)(const int16_t* pcm, uint32_t frames, uint8_t channels, void* user); // false: stop
+
+class PcmCache {
+public:
+    static void     makeHeader(uint8_t* h, const pcmCacheHeader_t* c);
+    static bool     parseHeader(const uint8_t* h, size_t fileSize, pcmCacheHeader_t* c); // false if it is no cache file
+    static uint32_t crc32(uint32_t crc, const uint8_t* p, size_t n);                      // zlib, as esp_rom_crc32_le()
+    static bool     damaged(const pcmTranscodeResult_t* r) { return r->md5 < 0 || r->corrupt > 0; } // no cache of it
+
+    // 'data': the whole source and 64 zero bytes behind 'len' that the bit readers may read ahead. The codec is made
+    // here (AudioCodec_NewMP3() or AudioCodec_NewFLAC()), false if the source is none of both or not compiled in
+    static bool     transcode(uint8_t* data, size_t len, pcmCacheWrite_t write, void* user, pcmTranscodeResult_t* r);
+
+private:
+    PcmCache() {}
+    bool            run(AudioCodec* c, uint8_t* data, int32_t len, pcmCacheWrite_t write, void* user);
+    bool            put(const int16_t* pcm, uint32_t frames, pcmCacheWrite_t write, void* user);
+    bool            flush(pcmCacheWrite_t write, void* user);
+    bool            emit(int16_t* out, uint32_t* n, pcmCacheWrite_t write, void* user);
+
+    pcmTranscodeResult_t* m_r = nullptr;
+    uint32_t              m_skip = 0;      // frames still to drop (encoder delay)
+    int32_t               m_remain = -1;   // frames still to keep, -1 unknown
+    uint64_t              m_in = 0;        // source frames received
+    uint64_t              m_out = 0;       // 48 kHz frames made
+    int16_t               m_prev[2] = {};  // last source frame of the previous call
+};
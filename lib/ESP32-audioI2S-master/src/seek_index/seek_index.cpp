@@ -0,0 +1,180 @@
+/*
+ *  seek_index.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "seek_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void     putLE16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void     putLE32(uint8_t* p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static uint16_t getLE16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t getLE32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+SeekIndex::SeekIndex() { memset(&m_hdr, 0, sizeof(m_hdr)); }
+
+SeekIndex::~SeekIndex() { clear(); }
+
+void SeekIndex::clear() {
+    if(m_entries) free(m_entries);
+    m_entries = nullptr;
+    m_capacity = 0;
+    memset(&m_hdr, 0, sizeof(m_hdr));
+    m_f_valid = false;
+    m_f_building = false;
+    m_samples = 0;
+    m_nextMark = 0;
+    m_ringCount = 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SeekIndex::lookup(uint32_t sample, seekEntry_t* e) {
+    if(!m_f_valid || !m_hdr.count) return false;
+    if(sample < m_entries[0].sample) return false;
+    uint32_t lo = 0, hi = m_hdr.count - 1;
+    while(lo < hi) { // last entry with sample <= 'sample'
+        uint32_t mid = (lo + hi + 1) / 2;
+        if(m_entries[mid].sample <= sample) lo = mid;
+        else hi = mid - 1;
+    }
+    *e = m_entries[lo];
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SeekIndex::parseHeader(const uint8_t* buf, size_t len, seekIndexHeader_t* h) {
+    if(len < SEEK_INDEX_HEADER_SIZE) return false;
+    if(memcmp(buf, "SIDX", 4) != 0) return false;
+    if(buf[4] != SEEK_INDEX_VERSION) return false;
+    if(getLE16(buf + 10) != SEEK_INDEX_ENTRY_SIZE) return false;
+    h->codec = buf[5];
+    h->flags = buf[6];
+    h->quality = buf[7];
+    h->intervalMs = getLE16(buf + 8);
+    h->sampleRate = getLE32(buf + 12);
+    h->fileSize = getLE32(buf + 16);
+    h->totalSamples = getLE32(buf + 20);
+    h->count = getLE32(buf + 24);
+    return h->sampleRate && h->count;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SeekIndex::load(const seekIndexHeader_t* h, const uint8_t* entries, size_t len) {
+    clear();
+    if(len < (size_t)h->count * SEEK_INDEX_ENTRY_SIZE) return false;
+    m_entries = (seekEntry_t*)malloc(h->count * sizeof(seekEntry_t));
+    if(!m_entries) return false;
+    m_capacity = h->count;
+    for(uint32_t i = 0; i < h->count; i++) {
+        const uint8_t* p = entries + i * SEEK_INDEX_ENTRY_SIZE;
+        m_entries[i].sample = getLE32(p);
+        m_entries[i].offset = getLE32(p + 4);
+        m_entries[i].preroll = getLE32(p + 8);
+        if(m_entries[i].preroll > m_entries[i].sample) {clear(); return false;}
+        if(i && m_entries[i].sample < m_entries[i - 1].sample) {clear(); return false;} // binary search needs ascending samples
+    }
+    m_hdr = *h;
+    m_f_valid = true;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+size_t SeekIndex::serialize(uint8_t* buf, size_t len) {
+    if(!m_f_valid || len < serializedSize()) return 0;
+    memset(buf, 0, SEEK_INDEX_HEADER_SIZE);
+    memcpy(buf, "SIDX", 4);
+    buf[4] = SEEK_INDEX_VERSION;
+    buf[5] = m_hdr.codec;
+    buf[6] = m_hdr.flags;
+    buf[7] = m_hdr.quality;
+    putLE16(buf + 8, m_hdr.intervalMs);
+    putLE16(buf + 10, SEEK_INDEX_ENTRY_SIZE);
+    putLE32(buf + 12, m_hdr.sampleRate);
+    putLE32(buf + 16, m_hdr.fileSize);
+    putLE32(buf + 20, m_hdr.totalSamples);
+    putLE32(buf + 24, m_hdr.count);
+    for(uint32_t i = 0; i < m_hdr.count; i++) {
+        uint8_t* p = buf + SEEK_INDEX_HEADER_SIZE + i * SEEK_INDEX_ENTRY_SIZE;
+        putLE32(p, m_entries[i].sample);
+        putLE32(p + 4, m_entries[i].offset);
+        putLE32(p + 8, m_entries[i].preroll);
+    }
+    return serializedSize();
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SeekIndex::beginBuild(uint8_t codec, uint8_t flags, uint16_t intervalMs, uint32_t fileSize, uint8_t quality) {
+    clear();
+    m_hdr.codec = codec;
+    m_hdr.flags = flags;
+    m_hdr.quality = quality;
+    m_hdr.intervalMs = intervalMs ? intervalMs : 1;
+    m_hdr.fileSize = fileSize;
+    m_f_building = true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SeekIndex::addFrame(uint32_t pos, uint32_t samples, uint32_t sampleRate, int32_t mainDataBegin, int32_t mainDataSize) {
+    if(!m_f_building || !samples) return;
+    if(!m_hdr.sampleRate) m_hdr.sampleRate = sampleRate;
+    if(sampleRate != m_hdr.sampleRate) {abortBuild(); return;} // the samples can't be converted into time any more
+    uint32_t interval = (uint64_t)m_hdr.sampleRate * m_hdr.intervalMs / 1000;
+    if(!interval) interval = 1;
+
+    seekEntry_t e = {m_samples, pos, 0};
+    bool found = (m_samples >= m_nextMark);
+    if(mainDataBegin >= 0) { // mp3, remember the frame, the decoder must start where the bit reservoir of this frame begins
+        if(m_ringCount == SEEK_INDEX_MP3_RING) {memmove(m_ring, m_ring + 1, (SEEK_INDEX_MP3_RING - 1) * sizeof(frame_t)); m_ringCount--;}
+        m_ring[m_ringCount++] = {pos, m_samples, mainDataBegin, mainDataSize};
+        if(found) {
+            int32_t t = m_ringCount - 1;
+            int32_t p = reservoirStart(t);
+            if(t > 0) { // the previous frame must be decoded correctly too, its output overlaps the first granule
+                int32_t q = reservoirStart(t - 1);
+                if(q < 0) p = -1;
+                if(p >= 0) {if(q < p) p = q; if(t - 1 < p) p = t - 1;}
+                if(p >= 0 && t - 1 - p > 3) p = -1; // the decoder gives up after 4 frames without a complete bit reservoir
+            }
+            if(p < 0) found = false; // not enough frames seen, try the next one
+            else {
+                e.offset = m_ring[p].pos;
+                e.preroll = m_samples - m_ring[p].sample;
+            }
+        }
+    }
+    if(found) {
+        if(!push(e)) {abortBuild(); return;}
+        while(m_nextMark <= m_samples) m_nextMark += interval;
+    }
+    m_samples += samples;
+}
+//----------------------------------------------------------------------------------------------------------------------
+void SeekIndex::abortBuild() { clear(); }
+//----------------------------------------------------------------------------------------------------------------------
+bool SeekIndex::finishBuild() {
+    if(!m_f_building) return false;
+    m_f_building = false;
+    m_ringCount = 0;
+    m_hdr.totalSamples = m_samples;
+    m_f_valid = (m_hdr.count > 0);
+    return m_f_valid;
+}
+//----------------------------------------------------------------------------------------------------------------------
+bool SeekIndex::push(const seekEntry_t& e) {
+    if(m_hdr.count == m_capacity) {
+        uint32_t cap = m_capacity ? m_capacity * 2 : 64;
+        seekEntry_t* n = (seekEntry_t*)realloc(m_entries, cap * sizeof(seekEntry_t));
+        if(!n) return false;
+        m_entries = n;
+        m_capacity = cap;
+    }
+    m_entries[m_hdr.count++] = e;
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t SeekIndex::reservoirStart(int32_t frame) {
+    int32_t need = m_ring[frame].mainDataBegin;
+    if(need == 0) return frame;
+    int32_t sum = 0;
+    for(int32_t k = frame - 1; k >= 0; k--) {
+        sum += m_ring[k].mainDataSize;
+        if(sum >= need) return k;
+    }
+    return -1;
+}
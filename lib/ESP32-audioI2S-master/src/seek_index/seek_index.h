@@ -0,0 +1,97 @@
+/*
+ *  seek_index.h
+ *
+ *  Time -> byte offset table of an audio file, stored as a sidecar next to the file ("<file>.sidx").
+ *  One entry every 'intervalMs', a seek is a binary search followed by a jump to the first byte of a frame (ogg page).
+ *  Samples are counted as they come out of the decoder (encoder delay and Xing frame included), 'preroll' is the number of
+ *  samples to decode and drop before the entry is reached (mp3: bit reservoir and overlap of the previous frame).
+ *  The table is built while a file is played from the beginning (mp3, flac) or on the host by tools/build_seek_index.py
+ *  (mp3, flac, ogg, m4a). No FS calls in here, the sidecar is read and written by the caller.
+ *  The samples are counted at the output rate of the decoder, 'sampleRate' is that rate and 'quality' the MP3 decoder
+ *  quality it was built with (MP3_QUALITY_HALFRATE halves both), an index of another quality does not fit.
+ *
+ *  File layout, little endian:
+ *    0  "SIDX"          4  version           5  codec        6  flags         7  quality
+ *    8  intervalMs(16)  10 entrySize(16)     12 sampleRate   16 fileSize      20 totalSamples
+ *    24 count           28 reserved          32 entries: sample, offset, preroll (3 x uint32)
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SEEK_INDEX_VERSION          2     // 2: quality in byte 7
+#define SEEK_INDEX_HEADER_SIZE      32
+#define SEEK_INDEX_ENTRY_SIZE       12
+#define SEEK_INDEX_F_SAMPLE_EXACT   0x01  // decoding from an entry yields the same samples as decoding from the start
+#define SEEK_INDEX_MP3_RING         16    // frames looked back to find the start of the bit reservoir
+
+typedef struct {
+    uint32_t sample;   // first sample of the entry frame
+    uint32_t offset;   // file position where decoding starts (preroll frames included)
+    uint32_t preroll;  // samples between 'offset' and 'sample'
+} seekEntry_t;
+
+typedef struct {
+    uint8_t  codec;
+    uint8_t  flags;
+    uint8_t  quality;      // MP3_QUALITY_xxx of the decoder that counted the samples, 0 for the other codecs
+    uint16_t intervalMs;
+    uint32_t sampleRate;
+    uint32_t fileSize;
+    uint32_t totalSamples;
+    uint32_t count;
+} seekIndexHeader_t;
+
+class SeekIndex {
+public:
+    SeekIndex();
+    ~SeekIndex();
+    void     clear();                                   // drops the table and an unfinished build
+    bool     isValid() { return m_f_valid; }
+    bool     isBuilding() { return m_f_building; }
+    uint8_t  codec() { return m_hdr.codec; }
+    uint8_t  flags() { return m_hdr.flags; }
+    uint8_t  quality() { return m_hdr.quality; }
+    uint32_t sampleRate() { return m_hdr.sampleRate; }
+    uint32_t totalSamples() { return m_hdr.totalSamples; }
+    uint32_t count() { return m_hdr.count; }
+    bool     lookup(uint32_t sample, seekEntry_t* e);   // last entry with e->sample <= sample
+
+    // sidecar
+    static bool parseHeader(const uint8_t* buf, size_t len, seekIndexHeader_t* h);   // false if it is not a seek index
+    bool     load(const seekIndexHeader_t* h, const uint8_t* entries, size_t len);  // entries as read from the file
+    size_t   serializedSize() { return SEEK_INDEX_HEADER_SIZE + m_hdr.count * SEEK_INDEX_ENTRY_SIZE; }
+    size_t   serialize(uint8_t* buf, size_t len);
+
+    // builder, fed with every decoded frame in file order
+    void     beginBuild(uint8_t codec, uint8_t flags, uint16_t intervalMs, uint32_t fileSize, uint8_t quality = 0);
+    void     addFrame(uint32_t pos, uint32_t samples, uint32_t sampleRate, int32_t mainDataBegin = -1, int32_t mainDataSize = 0);
+    void     addSamples(uint32_t samples) { if(m_f_building) m_samples += samples; } // rest of a frame that is output in pieces (flac)
+    void     abortBuild();
+    bool     finishBuild();                             // the table is valid if at least one entry was found
+
+private:
+    bool     push(const seekEntry_t& e);
+    int32_t  reservoirStart(int32_t frame);            // ring index of the first frame that holds main data of 'frame'
+
+    typedef struct {
+        uint32_t pos;
+        uint32_t sample;
+        int32_t  mainDataBegin;
+        int32_t  mainDataSize;
+    } frame_t;
+
+    seekIndexHeader_t m_hdr;
+    seekEntry_t*      m_entries = nullptr;
+    uint32_t          m_capacity = 0;
+    bool              m_f_valid = false;
+    bool              m_f_building = false;
+    uint32_t          m_samples = 0;                   // builder, decoded samples so far
+    uint32_t          m_nextMark = 0;                  // builder, sample of the next entry
+    frame_t           m_ring[SEEK_INDEX_MP3_RING];     // builder, last frames (mp3 only)
+    uint32_t          m_ringCount = 0;
+};
@@ -0,0 +1,115 @@
+/*
+ *  sync_scan.cpp
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "sync_scan.h"
+#include <string.h>
+
+#define ONES  0x01010101u
+#define HIGHS 0x80808080u
+
+int32_t SyncScan_Byte(const uint8_t* buf, int32_t len, uint8_t b) {
+    int32_t i = 0;
+    while(i < len && ((uintptr_t)(buf + i) & 3)) { // up to the first aligned word
+        if(buf[i] == b) return i;
+        i++;
+    }
+    const uint32_t pattern = b * ONES;
+    while(i + 4 <= len) {
+        uint32_t w;
+        memcpy(&w, buf + i, 4);
+        uint32_t x = w ^ pattern;              // a matching byte becomes 0
+        if((x - ONES) & ~x & HIGHS) {          // the word contains a zero byte
+            for(int32_t k = 0; k < 4; k++) if(buf[i + k] == b) return i + k;
+        }
+        i += 4;
+    }
+    while(i < len) {
+        if(buf[i] == b) return i;
+        i++;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t SyncScan_Sync(const uint8_t* buf, int32_t len, uint8_t mask, uint8_t value) {
+    int32_t i = 0;
+    while(i < len - 1) {
+        int32_t p = SyncScan_Byte(buf + i, len - 1 - i, 0xFF);
+        if(p < 0) return -1;
+        i += p;
+        if((buf[i + 1] & mask) == value) return i;
+        i++;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t SyncScan_Pattern(const uint8_t* buf, int32_t len, const uint8_t* pat, int32_t patLen) {
+    if(patLen <= 0 || patLen > len) return -1;
+    int32_t last = len - patLen; // last possible start
+    int32_t i = 0;
+    while(i <= last) {
+        int32_t p = SyncScan_Byte(buf + i, last - i + 1, pat[0]);
+        if(p < 0) return -1;
+        i += p;
+        if(memcmp(buf + i + 1, pat + 1, patLen - 1) == 0) return i;
+        i++;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t SyncScan_IndexOf(const uint8_t* base, const char* str, int32_t baselen, bool exact) {
+    int32_t n = strlen(str) + exact; // with exact the terminating '\0' is part of the pattern
+    // every start up to baselen - n is checked; specialIndexOf() skipped the last one without exact and gave 0 for
+    // baselen == strlen(str) without looking at the buffer
+    return SyncScan_Pattern(base, baselen, (const uint8_t*)str, n);
+}
+//----------------------------------------------------------------------------------------------------------------------
+uint8_t SyncScan_HeaderSize(uint8_t type) { return (type == SYNC_ADTS) ? 6 : 4; }
+//----------------------------------------------------------------------------------------------------------------------
+bool SyncScan_ValidHeader(const uint8_t* h, uint8_t type) {
+    if(h[0] != 0xFF) return false;
+    if(type == SYNC_MP3) {
+        if((h[1] & 0xE0) != 0xE0) return false;
+        if((h[1] & 0x18) == 0x08) return false; // reserved version
+        if((h[1] & 0x06) == 0x00) return false; // reserved layer
+        if((h[2] & 0xF0) == 0xF0) return false; // wrong bitrate index
+        if((h[2] & 0x0C) == 0x0C) return false; // wrong sampling rate frequency index
+        return true;
+    }
+    if(type == SYNC_ADTS) {
+        if((h[1] & 0xF6) != 0xF0) return false;  // 12 bit sync, layer 00
+        if(((h[2] & 0x3C) >> 2) > 12) return false; // sampling frequency index
+        int frame_length = ((h[3] & 0x03) << 11) | (h[4] << 3) | ((h[5] & 0xE0) >> 5);
+        if(frame_length < 7) return false;       // at least the header size
+        return true;
+    }
+    if(type == SYNC_FLAC) {
+        if((h[1] & 0xFE) != 0xF8) return false;  // 14 bit sync, reserved bit 0
+        if((h[2] >> 4) == 0) return false;       // reserved block size
+        if((h[2] & 0x0F) == 0x0F) return false;  // invalid sample rate
+        if((h[3] >> 4) > 10) return false;       // reserved channel assignment
+        if(((h[3] >> 1) & 0x07) == 3) return false; // reserved sample size
+        if(h[3] & 0x01) return false;            // reserved bit
+        return true;
+    }
+    return false;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int32_t SyncScan_Header(const uint8_t* buf, int32_t len, uint8_t type) {
+    // A sync word within the last bytes can't be checked yet, its position is returned so that the caller can wait for more data
+    const uint8_t mask  = (type == SYNC_MP3) ? 0xE0 : (type == SYNC_ADTS) ? 0xF6 : 0xFE;
+    const uint8_t value = (type == SYNC_MP3) ? 0xE0 : (type == SYNC_ADTS) ? 0xF0 : 0xF8;
+    const int32_t size = SyncScan_HeaderSize(type);
+    int32_t i = 0;
+    while(i < len) {
+        int32_t p = SyncScan_Sync(buf + i, len - i, mask, value);
+        if(p < 0) return -1;
+        i += p;
+        if(i + size > len) return i;
+        if(SyncScan_ValidHeader(buf + i, type)) return i;
+        i++;
+    }
+    return -1;
+}
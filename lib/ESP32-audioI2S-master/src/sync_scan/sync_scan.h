@@ -0,0 +1,28 @@
+/*
+ *  sync_scan.h
+ *
+ *  Sync word and pattern search, shared by Audio and the decoders. The buffer is scanned a 32 bit word at a time for the
+ *  first byte of the pattern (0xFF of a frame sync, 'O' of OggS, ...), only the candidates are compared byte by byte.
+ *  SyncScan_Header() also validates the frame header behind the sync word, a 0xFFF inside of audio data is skipped.
+ *
+ *    mp3   11 bit sync 0xFFE, version, layer, bitrate and sampling rate index must be valid
+ *    adts  12 bit sync 0xFFF, layer 00, sampling rate index <= 12, frame length >= header
+ *    flac  14 bit sync 0xFFF8, block size, sample rate, channel assignment and sample size must be valid
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum : uint8_t {SYNC_MP3 = 0, SYNC_ADTS = 1, SYNC_FLAC = 2};
+
+int32_t SyncScan_Byte(const uint8_t* buf, int32_t len, uint8_t b);                           // first 'b', -1 not found
+int32_t SyncScan_Sync(const uint8_t* buf, int32_t len, uint8_t mask, uint8_t value);         // 0xFF, then (byte & mask) == value
+int32_t SyncScan_Pattern(const uint8_t* buf, int32_t len, const uint8_t* pat, int32_t patLen);
+int32_t SyncScan_IndexOf(const uint8_t* base, const char* str, int32_t baselen, bool exact); // exact: '\0' behind str must match too
+int32_t SyncScan_Header(const uint8_t* buf, int32_t len, uint8_t type);                      // first valid frame header, see above
+bool    SyncScan_ValidHeader(const uint8_t* h, uint8_t type);                                // 4 bytes (mp3, flac) or 6 bytes (adts)
+uint8_t SyncScan_HeaderSize(uint8_t type);
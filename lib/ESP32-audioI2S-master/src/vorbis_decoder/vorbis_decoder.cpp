@@ -92,16 +92,19 @@ vector<uint32_t>s_vorbisBlockPicItem;
 
 
 bool VORBISDecoder_AllocateBuffers(){
-    s_vorbisSegmentTable = (uint16_t*)__calloc_heap_psram(256, sizeof(uint16_t));
-    s_vorbisChbuf = (char*)__calloc_heap_psram(256, sizeof(char));
-    s_lastSegmentTable = (uint8_t*)__malloc_heap_psram(4096);
+    s_vorbisSegmentTable = (uint16_t*)AudioArena_Calloc(256, sizeof(uint16_t));
+    s_vorbisChbuf = (char*)AudioArena_Calloc(256, sizeof(char));
+    s_lastSegmentTable = (uint8_t*)AudioArena_Malloc(4096);
     VORBISsetDefaults();
     return true;
 }
+size_t VORBISDecoder_StateSize(){ // bytes of VORBISDecoder_AllocateBuffers(), sizes the audio arena
+    return AUDIO_ARENA_ALIGN(256 * sizeof(uint16_t)) + AUDIO_ARENA_ALIGN(256) + AUDIO_ARENA_ALIGN(4096);
+}
 void VORBISDecoder_FreeBuffers(){
-    if(s_vorbisSegmentTable) {free(s_vorbisSegmentTable); s_vorbisSegmentTable = NULL;}
-    if(s_vorbisChbuf){free(s_vorbisChbuf); s_vorbisChbuf = NULL;}
-    if(s_lastSegmentTable){free(s_lastSegmentTable); s_lastSegmentTable = NULL;}
+    if(s_vorbisSegmentTable) {AudioArena_Free(s_vorbisSegmentTable); s_vorbisSegmentTable = NULL;}
+    if(s_vorbisChbuf){AudioArena_Free(s_vorbisChbuf); s_vorbisChbuf = NULL;}
+    if(s_lastSegmentTable){AudioArena_Free(s_lastSegmentTable); s_lastSegmentTable = NULL;}
 
     clearGlobalConfigurations();
 }
@@ -1063,19 +1066,7 @@ _eofout:
 
 //----------------------------------------------------------------------------------------------------------------------
 int32_t VORBIS_specialIndexOf(uint8_t* base, const char* str, int32_t baselen, bool exact){
-    int32_t result = -1;  // seek for str in buffer or in header up to baselen, not nullterninated
-    if (strlen(str) > baselen) return -1; // if exact == true seekstr in buffer must have "\0" at the end
-    for (int32_t i = 0; i < baselen - strlen(str); i++){
-        result = i;
-        for (int32_t j = 0; j < strlen(str) + exact; j++){
-            if (*(base + i + j) != *(str + j)){
-                result = -1;
-                break;
-            }
-        }
-        if (result >= 0) break;
-    }
-    return result;
+    return SyncScan_IndexOf(base, str, baselen, exact); // seek for str in buffer up to baselen, not nullterminated
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -28,6 +28,8 @@
 
 #include "Arduino.h"
 #include <vector>
+#include "../audio_arena/audio_arena.h"
+#include "../sync_scan/sync_scan.h"
 using namespace std;
 #define VI_FLOORB       2
 #define VIF_POSIT      63
@@ -218,6 +220,7 @@ inline int32_t CLIP_TO_15(int32_t x) {
 
 // ogg impl
 bool                  VORBISDecoder_AllocateBuffers();
+size_t                VORBISDecoder_StateSize();
 void                  VORBISDecoder_FreeBuffers();
 void                  VORBISDecoder_ClearBuffers();
 void                  VORBISsetDefaults();
@@ -329,6 +329,17 @@ void mettreAJourRainbowCarre() {
             led4.setPixel(i, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
         }
 
+        // Le carré pulse sur les basses pendant la lecture audio (niveau avant le volume)
+        audioMeter_t niveau;
+        uint8_t luminositeCarre = 255;
+        if (audio.getMeter(&niveau)) {
+            uint8_t basses = max(niveau.bands[0], max(niveau.bands[1], niveau.bands[2]));
+            luminositeCarre = 64 + basses * 191 / 255;
+        }
+        led2.setBrightness(luminositeCarre);
+        led3.setBrightness(luminositeCarre);
+        led4.setBrightness(luminositeCarre);
+
         // Afficher tous les strips en même temps
         led2.show();
         led3.show();
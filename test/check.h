@@ -0,0 +1,33 @@
+/*
+ *  check.h
+ *
+ *  Minimal checks for the host tests. A failed check prints its location and the values, main() returns
+ *  TEST_RESULT(), ctest counts a non zero exit as a failure.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+static int s_checksFailed = 0;
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if(!(cond)) {                                                                 \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);           \
+            s_checksFailed++;                                                         \
+        }                                                                             \
+    } while(0)
+
+#define CHECK_EQ(a, b)                                                                \
+    do {                                                                              \
+        long long va_ = (long long)(a), vb_ = (long long)(b);                         \
+        if(va_ != vb_) {                                                              \
+            printf("%s:%d: %s == %s failed (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, va_, vb_); \
+            s_checksFailed++;                                                         \
+        }                                                                             \
+    } while(0)
+
+#define TEST_RESULT() (printf("%s: %s\n", __FILE__, s_checksFailed ? "FAILED" : "ok"), s_checksFailed ? 1 : 0)
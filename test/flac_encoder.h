@@ -0,0 +1,288 @@
+/*
+ *  flac_encoder.h
+ *
+ *  A small FLAC frame encoder for the decoder tests, no metadata blocks: the raw frames as FLACSetRawBlockParams()
+ *  expects them. Every frame takes random choices (block size, channel assignment, subframe type, fixed and LPC orders,
+ *  rice parameters including escapes and non optimal ones, wasted bits) from a seeded generator, the same seed gives the
+ *  same stream. The samples are returned interleaved as the reference PCM.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+#include "esp_rom_md5.h"
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+class FlacEncoder {
+  public:
+    uint8_t               bps = 16;              // 16 or 24
+    uint8_t               lpcMaxOrder = 12;      // up to 32
+    bool                  fixedBlocksize = false; // only 4096 samples per frame
+    std::vector<uint32_t> frameOffsets;          // of the last makeStream(), byte offset of every frame
+    std::vector<uint32_t> frameSamples;          // and its block size
+
+    std::vector<uint8_t> makeStream(uint8_t nch, uint32_t frames, uint32_t seed, std::vector<int32_t>* pcm) {
+        m_rng = seed;
+        m_out.clear();
+        frameOffsets.clear();
+        frameSamples.clear();
+        static const uint8_t codes[4] = {12, 12, 7, 10}; // 4096, 4096, explicit 16 bit size, 1024
+        double ph1 = 0, ph2 = 0;
+        for(uint32_t f = 0; f < frames; f++) {
+            uint8_t  code = fixedBlocksize ? 12 : codes[rnd() % 4];
+            uint32_t n = code == 12 ? 4096 : code == 10 ? 1024 : 1000 + rnd() % 3000;
+            std::vector<int32_t> L(n), R(n);
+            uint32_t kind = rnd() % 6;  // 0 silence, 1 DC, 2 low bits zero, 3 L == R, 4 tones, 5 white noise
+            double   amp = kind == 5 ? 32767 : 1000 + rnd() % 20000;
+            for(uint32_t i = 0; i < n; i++) {
+                ph1 += 0.031;
+                ph2 += 0.0071;
+                double v = amp * 0.6 * sin(ph1) + amp * 0.3 * sin(ph2) + (int32_t)(rnd() % 200) - 100;
+                if(kind == 0) v = 0;
+                if(kind == 1) v = 1234;
+                if(kind == 2) v = (int32_t)v & ~15;
+                if(kind == 5) v = (int32_t)(rnd() % 65536) - 32768;
+                L[i] = clip16(v);
+                R[i] = kind == 3 ? L[i] : clip16(v * 0.7 + (int32_t)(rnd() % 50) - 25);
+                if(kind == 5) R[i] = (int32_t)(rnd() % 65536) - 32768;
+            }
+            if(bps == 24) {
+                for(uint32_t i = 0; i < n; i++) {
+                    L[i] = L[i] * 256 + (kind <= 2 ? 0 : (int32_t)(rnd() % 256));
+                    R[i] = kind == 3 ? L[i] : R[i] * 256 + (int32_t)(rnd() % 256);
+                }
+            }
+            frameOffsets.push_back(m_out.size());
+            frameSamples.push_back(n);
+            encodeFrame(L.data(), R.data(), nch, n, f, code);
+            if(pcm) {
+                for(uint32_t i = 0; i < n; i++) {
+                    pcm->push_back(L[i]);
+                    if(nch == 2) pcm->push_back(R[i]);
+                }
+            }
+        }
+        return m_out;
+    }
+
+    // STREAMINFO MD5: little endian samples of (bps + 7) / 8 bytes, interleaved (needs esp_rom_md5.h)
+    static void md5(const std::vector<int32_t>& pcm, uint8_t bps, uint8_t* digest) {
+        md5_context_t c;
+        esp_rom_md5_init(&c);
+        for(int32_t v : pcm) {
+            for(int k = 0; k < (bps + 7) / 8; k++) {
+                uint8_t b = v >> (8 * k);
+                esp_rom_md5_update(&c, &b, 1);
+            }
+        }
+        esp_rom_md5_final(digest, &c);
+    }
+
+    static uint16_t crc16(const uint8_t* p, size_t n) {
+        uint16_t c = 0;
+        for(size_t i = 0; i < n; i++) {
+            c ^= p[i] << 8;
+            for(int k = 0; k < 8; k++) c = (c & 0x8000) ? (c << 1) ^ 0x8005 : (c << 1);
+        }
+        return c;
+    }
+
+  private:
+    struct BitWriter {
+        std::vector<uint8_t> b;
+        uint32_t             n = 0;
+        void put(uint64_t v, int k) {
+            for(int i = k - 1; i >= 0; i--) {
+                if(n % 8 == 0) b.push_back(0);
+                if((v >> i) & 1) b.back() |= 0x80 >> (n % 8);
+                n++;
+            }
+        }
+        void putS(int64_t v, int k) { put((uint64_t)v & (k == 64 ? ~0ULL : (1ULL << k) - 1), k); }
+        void unary(uint32_t q) {
+            for(uint32_t i = 0; i < q; i++) put(0, 1);
+            put(1, 1);
+        }
+        void align() { while(n % 8) put(0, 1); }
+    };
+
+    uint32_t             m_rng = 1;
+    std::vector<uint8_t> m_out;
+
+    uint32_t rnd() {
+        m_rng = m_rng * 1103515245u + 12345u;
+        return m_rng >> 8;
+    }
+
+    static int32_t clip16(double v) { return v > 32767 ? 32767 : v < -32768 ? -32768 : (int32_t)v; }
+
+    static uint8_t crc8(const uint8_t* p, size_t n) {
+        uint8_t c = 0;
+        for(size_t i = 0; i < n; i++) {
+            c ^= p[i];
+            for(int k = 0; k < 8; k++) c = (c & 0x80) ? (c << 1) ^ 0x07 : (c << 1);
+        }
+        return c;
+    }
+
+    void residuals(BitWriter& w, const int32_t* r, uint32_t n, uint32_t warm) {
+        uint32_t porder = rnd() % 5;
+        while(porder && (n % (1 << porder) || (n >> porder) <= warm)) porder--;
+        uint32_t method = bps == 24 ? 1 : rnd() % 2;
+        int      pbits = method ? 5 : 4;
+        uint32_t esc = method ? 31 : 15;
+        w.put(method, 2);
+        w.put(porder, 4);
+        uint32_t ps = n >> porder;
+        for(uint32_t p = 0; p < (1u << porder); p++) {
+            uint32_t s = p * ps + (p == 0 ? warm : 0), e = (p + 1) * ps;
+            uint64_t sum = 0;
+            for(uint32_t i = s; i < e; i++) sum += r[i] < 0 ? -2 * (int64_t)r[i] - 1 : 2 * (int64_t)r[i];
+            uint32_t k = 0;
+            while(k < esc - 1 && ((uint64_t)(e - s) << (k + 1)) < sum) k++;
+            if(rnd() % 20 == 0) { // escape partition, raw samples
+                int nb = 0;
+                for(uint32_t i = s; i < e; i++) {
+                    int b = 1;
+                    while(r[i] < -(1 << (b - 1)) || r[i] >= (1 << (b - 1))) b++;
+                    if(b > nb) nb = b;
+                }
+                if(rnd() % 4 == 0 && nb == 1) {
+                    bool zero = true;
+                    for(uint32_t i = s; i < e; i++) if(r[i]) zero = false;
+                    if(zero) nb = 0;
+                }
+                w.put(esc, pbits);
+                w.put(nb, 5);
+                if(nb) for(uint32_t i = s; i < e; i++) w.putS(r[i], nb);
+                continue;
+            }
+            if(rnd() % 7 == 0) { // a non optimal parameter is legal too
+                int32_t k2 = (int32_t)k - 2 + (int32_t)(rnd() % 5);
+                k = k2 < 0 ? 0 : k2 > (int32_t)esc - 1 ? esc - 1 : k2;
+            }
+            w.put(k, pbits);
+            for(uint32_t i = s; i < e; i++) {
+                uint64_t u = r[i] < 0 ? -2 * (int64_t)r[i] - 1 : 2 * (int64_t)r[i];
+                w.unary((uint32_t)(u >> k));
+                if(k) w.put(u & ((1ULL << k) - 1), k);
+            }
+        }
+    }
+
+    void subframe(BitWriter& w, const int32_t* x, uint32_t n, int bits) {
+        uint32_t type = rnd() % 10; // 0 verbatim, 1..4 fixed, 5..9 LPC
+        bool     constant = true;
+        for(uint32_t i = 1; i < n; i++) if(x[i] != x[0]) constant = false;
+        int     wasted = 0;
+        int32_t any = 0;
+        for(uint32_t i = 0; i < n; i++) any |= x[i];
+        if(any) while(!((any >> wasted) & 1)) wasted++;
+        auto head = [&](uint32_t t) {
+            w.put(0, 1);
+            w.put(t, 6);
+            if(wasted) {
+                w.put(1, 1);
+                w.unary(wasted - 1);
+            }
+            else w.put(0, 1);
+        };
+        if(constant) {
+            head(0);
+            w.putS(x[0] >> wasted, bits - wasted);
+            return;
+        }
+        std::vector<int32_t> y(n), r(n);
+        for(uint32_t i = 0; i < n; i++) y[i] = x[i] >> wasted;
+        int b = bits - wasted;
+        if(type == 0) {
+            head(1);
+            for(uint32_t i = 0; i < n; i++) w.putS(y[i], b);
+            return;
+        }
+        if(type < 5) {
+            uint32_t o = rnd() % 5;
+            head(8 + o);
+            for(uint32_t i = 0; i < o; i++) w.putS(y[i], b);
+            for(uint32_t i = o; i < n; i++) {
+                int64_t p = 0;
+                if(o == 1) p = y[i - 1];
+                if(o == 2) p = 2LL * y[i - 1] - y[i - 2];
+                if(o == 3) p = 3LL * y[i - 1] - 3LL * y[i - 2] + y[i - 3];
+                if(o == 4) p = 4LL * y[i - 1] - 6LL * y[i - 2] + 4LL * y[i - 3] - y[i - 4];
+                r[i] = (int32_t)(y[i] - p);
+            }
+            residuals(w, r.data(), n, o);
+            return;
+        }
+        uint32_t order = 1 + rnd() % lpcMaxOrder;
+        int      prec = 12 + rnd() % 4, shift = 9 + rnd() % 4;
+        std::vector<int32_t> c(order); // a second order predictor plus noise
+        for(uint32_t j = 0; j < order; j++) {
+            double base = j == 0 ? 2 : j == 1 ? -1 : 0;
+            double v = base * (1 << shift) / (order > 1 ? 1 : 2) + (((int32_t)(rnd() % 64) - 32) >> (bps == 24 ? 5 : 0));
+            double lim = (1 << (prec - 1)) - 1;
+            c[j] = (int32_t)(v > lim ? lim : v < -lim ? -lim : v);
+        }
+        head(32 + order - 1);
+        for(uint32_t i = 0; i < order; i++) w.putS(y[i], b);
+        w.put(prec - 1, 4);
+        w.putS(shift, 5);
+        for(uint32_t j = 0; j < order; j++) w.putS(c[j], prec);
+        for(uint32_t i = order; i < n; i++) {
+            int64_t s = 0;
+            for(uint32_t j = 0; j < order; j++) s += (int64_t)y[i - 1 - j] * c[j];
+            r[i] = y[i] - (int32_t)(s >> shift);
+        }
+        residuals(w, r.data(), n, order);
+    }
+
+    void encodeFrame(const int32_t* L, const int32_t* R, uint8_t nch, uint32_t n, uint32_t frameNr, uint8_t code) {
+        BitWriter w;
+        w.put(0x3FFE, 14);
+        w.put(0, 2);                                     // reserved, fixed block size stream
+        w.put(code, 4);
+        w.put(9, 4);                                     // 44.1 kHz
+        uint32_t ca = nch == 1 ? 0 : rnd() % 4 == 0 ? 1 : 8 + rnd() % 3; // independent, left/side, side/right, mid/side
+        w.put(ca, 4);
+        w.put(bps == 24 ? 6 : 4, 3);
+        w.put(0, 1);
+        if(frameNr < 0x80) w.put(frameNr, 8);            // UTF-8 coded frame number
+        else if(frameNr < 0x800) {
+            w.put(0xC0 | (frameNr >> 6), 8);
+            w.put(0x80 | (frameNr & 63), 8);
+        }
+        else {
+            w.put(0xE0 | (frameNr >> 12), 8);
+            w.put(0x80 | ((frameNr >> 6) & 63), 8);
+            w.put(0x80 | (frameNr & 63), 8);
+        }
+        if(code == 7) w.put(n - 1, 16);
+        w.put(crc8(w.b.data(), w.b.size()), 8);
+        if(nch == 1) subframe(w, L, n, bps);
+        else if(ca == 1) {
+            subframe(w, L, n, bps);
+            subframe(w, R, n, bps);
+        }
+        else {
+            std::vector<int32_t> a(n), s(n);
+            for(uint32_t i = 0; i < n; i++) {
+                s[i] = L[i] - R[i];
+                a[i] = ca == 10 ? (L[i] + R[i]) >> 1 : ca == 8 ? L[i] : R[i];
+            }
+            if(ca == 9) {
+                subframe(w, s.data(), n, bps + 1);
+                subframe(w, a.data(), n, bps);
+            }
+            else {
+                subframe(w, a.data(), n, bps);
+                subframe(w, s.data(), n, bps + 1);
+            }
+        }
+        w.align();
+        w.put(crc16(w.b.data(), w.b.size()), 16);
+        m_out.insert(m_out.end(), w.b.begin(), w.b.end());
+    }
+};
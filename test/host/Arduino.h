@@ -0,0 +1,73 @@
+/*
+ *  Arduino.h (host)
+ *
+ *  The part of the Arduino core, ESP-IDF and FreeRTOS that the decoders use, for the host tests. The memory functions
+ *  map to the C heap, the tasks and semaphores to threads (host.cpp). Logs go to stdout.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#define log_e(fmt, ...) printf("[E] " fmt "\n", ##__VA_ARGS__)
+#define log_w(fmt, ...) printf("[W] " fmt "\n", ##__VA_ARGS__)
+#define log_i(fmt, ...) printf("[I] " fmt "\n", ##__VA_ARGS__)
+#define log_d(fmt, ...) do {} while(0)
+#define log_v(fmt, ...) do {} while(0)
+
+// memory
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+bool  psramFound();
+void* ps_malloc(size_t size);
+void* ps_calloc(size_t n, size_t size);
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void* heap_caps_malloc_prefer(size_t size, size_t num, ...);
+void  heap_caps_free(void* ptr);
+
+// FreeRTOS
+typedef void*    TaskHandle_t;
+typedef void*    SemaphoreHandle_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE        1
+#define pdFALSE       0
+#define pdPASS        1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) (ms)
+
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t sem);
+void              vSemaphoreDelete(SemaphoreHandle_t sem);
+BaseType_t        xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stackBytes, void* param, UBaseType_t prio, TaskHandle_t* task, BaseType_t core);
+void              vTaskDelete(TaskHandle_t task);
+uint32_t          ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t        xTaskNotifyGive(TaskHandle_t task);
+UBaseType_t       uxTaskGetStackHighWaterMark(TaskHandle_t task); // bytes, as in ESP-IDF
+void              vTaskDelay(TickType_t ticks);
@@ -0,0 +1,21 @@
+/*
+ *  esp_rom_md5.h (host)
+ *
+ *  MD5 (RFC 1321) with the interface of the ESP32 ROM functions.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t state[4];
+    uint64_t bytes;
+    uint8_t  block[64];
+} md5_context_t;
+
+void esp_rom_md5_init(md5_context_t* ctx);
+void esp_rom_md5_update(md5_context_t* ctx, const void* data, uint32_t len);
+void esp_rom_md5_final(uint8_t* digest, md5_context_t* ctx);
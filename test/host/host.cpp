@@ -0,0 +1,208 @@
+/*
+ *  host.cpp
+ *
+ *  Implementation of the stubs in Arduino.h and esp_rom_md5.h. A task is a thread with a stack of its own that is
+ *  filled with a pattern before it starts, uxTaskGetStackHighWaterMark() looks for the deepest byte that changed, as
+ *  FreeRTOS does. The host ABI needs more stack than the Xtensa one, the measured use is an upper bound.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "Arduino.h"
+#include "esp_rom_md5.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+bool  psramFound() { return false; }
+void* ps_malloc(size_t size) { return malloc(size); }
+void* ps_calloc(size_t n, size_t size) { return calloc(n, size); }
+void* heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) { return calloc(n, size); }
+void* heap_caps_malloc_prefer(size_t size, size_t num, ...) { return malloc(size); }
+void  heap_caps_free(void* ptr) { free(ptr); }
+//----------------------------------------------------------------------------------------------------------------------
+//          F R E E R T O S
+//----------------------------------------------------------------------------------------------------------------------
+struct HostSem {
+    std::mutex              m;
+    std::condition_variable cv;
+    uint32_t                count = 0;
+};
+
+struct HostTask {
+    HostSem  notify;
+    void   (*fn)(void*);
+    void*    param;
+    uint8_t* stack;
+    size_t   stackSize;
+    size_t   stackBytes; // as asked for
+    size_t   libcBytes;  // taken by the host libc (thread descriptor, TLS) above the entry of the task function
+};
+
+static const uint8_t       STACK_FILL = 0xA5;
+static thread_local HostTask* t_task = nullptr;
+static HostTask               s_mainTask; // the thread of main(), it can wait for notifications too
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new HostSem; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) {
+    HostSem*                     s = (HostSem*)sem;
+    std::unique_lock<std::mutex> lock(s->m);
+    s->cv.wait(lock, [s] { return s->count > 0; });
+    s->count = 0;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    HostSem* s = (HostSem*)sem;
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        s->count = 1;
+    }
+    s->cv.notify_one();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete (HostSem*)sem; }
+
+static void* taskEntry(void* arg) {
+    t_task = (HostTask*)arg;
+    uint8_t sp;
+    t_task->libcBytes = t_task->stack + t_task->stackSize - &sp;
+    t_task->fn(t_task->param);
+    return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stackBytes, void* param, UBaseType_t prio, TaskHandle_t* task, BaseType_t core) {
+    HostTask* t = new HostTask;
+    t->fn = fn;
+    t->param = param;
+    t->stackBytes = stackBytes;
+    t->stackSize = (stackBytes + 65536 + 4095) & ~(size_t)4095; // room for the host libc
+    t->stack = (uint8_t*)aligned_alloc(4096, t->stackSize);
+    memset(t->stack, STACK_FILL, t->stackSize);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack, t->stackSize);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t th;
+    int       err = pthread_create(&th, &attr, taskEntry, t);
+    pthread_attr_destroy(&attr);
+    if(err) return pdFALSE;
+    *task = t;
+    return pdPASS;
+}
+
+// a task is deleted while it waits for a notification, the thread stays blocked there with its stack (test lifetime)
+void vTaskDelete(TaskHandle_t task) {}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    HostTask*                    t = t_task ? t_task : &s_mainTask;
+    std::unique_lock<std::mutex> lock(t->notify.m);
+    t->notify.cv.wait(lock, [t] { return t->notify.count > 0; });
+    uint32_t n = t->notify.count;
+    t->notify.count = clear ? 0 : n - 1;
+    return n;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    HostTask* t = (HostTask*)task;
+    {
+        std::lock_guard<std::mutex> lock(t->notify.m);
+        t->notify.count++;
+    }
+    t->notify.cv.notify_one();
+    return pdPASS;
+}
+
+// the first blocking wait of the process initialises the host libc on the stack of the waiting thread, that is done
+// here once so that it is not counted for the first task
+static struct HostWarmUp {
+    HostWarmUp() {
+        HostSem     s;
+        std::thread th([&s] { xSemaphoreTake(&s, portMAX_DELAY); });
+        usleep(1000);
+        xSemaphoreGive(&s);
+        th.join();
+    }
+} s_warmUp;
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { // the stack grows down, count the untouched bytes at the low end
+    HostTask* t = (HostTask*)task;
+    size_t    n = 0;
+    while(n < t->stackSize && t->stack[n] == STACK_FILL) n++;
+    size_t used = t->stackSize - n - t->libcBytes;
+    return used < t->stackBytes ? t->stackBytes - used : 0; // of the stack the task asked for
+}
+
+void vTaskDelay(TickType_t ticks) { usleep(ticks * 1000); }
+//----------------------------------------------------------------------------------------------------------------------
+//          M D 5
+//----------------------------------------------------------------------------------------------------------------------
+static uint32_t rol(uint32_t x, int c) { return (x << c) | (x >> (32 - c)); }
+
+static void md5Block(md5_context_t* ctx, const uint8_t* p) {
+    static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1,
+        0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453,
+        0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a, 0xfffa3942,
+        0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+        0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d,
+        0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+    static const uint8_t R[4][4] = {{7, 12, 17, 22}, {5, 9, 14, 20}, {4, 11, 16, 23}, {6, 10, 15, 21}};
+    uint32_t w[16];
+    for(int i = 0; i < 16; i++) w[i] = p[4 * i] | (p[4 * i + 1] << 8) | (p[4 * i + 2] << 16) | ((uint32_t)p[4 * i + 3] << 24);
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    for(int i = 0; i < 64; i++) {
+        uint32_t f;
+        int      g;
+        if(i < 16)      {f = (b & c) | (~b & d); g = i;}
+        else if(i < 32) {f = (d & b) | (~d & c); g = (5 * i + 1) & 15;}
+        else if(i < 48) {f = b ^ c ^ d;          g = (3 * i + 5) & 15;}
+        else            {f = c ^ (b | ~d);       g = (7 * i) & 15;}
+        uint32_t t = d;
+        d = c;
+        c = b;
+        b = b + rol(a + f + K[i] + w[g], R[i / 16][i % 4]);
+        a = t;
+    }
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+}
+
+void esp_rom_md5_init(md5_context_t* ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->bytes = 0;
+}
+
+void esp_rom_md5_update(md5_context_t* ctx, const void* data, uint32_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while(len--) {
+        ctx->block[ctx->bytes++ & 63] = *p++;
+        if((ctx->bytes & 63) == 0) md5Block(ctx, ctx->block);
+    }
+}
+
+void esp_rom_md5_final(uint8_t* digest, md5_context_t* ctx) {
+    uint64_t bits = ctx->bytes * 8;
+    uint8_t  pad = 0x80;
+    esp_rom_md5_update(ctx, &pad, 1);
+    pad = 0;
+    while((ctx->bytes & 63) != 56) esp_rom_md5_update(ctx, &pad, 1);
+    for(int i = 0; i < 8; i++) {
+        uint8_t b = bits >> (8 * i);
+        esp_rom_md5_update(ctx, &b, 1);
+    }
+    for(int i = 0; i < 4; i++) {
+        for(int k = 0; k < 4; k++) digest[4 * i + k] = ctx->state[i] >> (8 * k);
+    }
+}
@@ -0,0 +1,218 @@
+/*
+ *  mp2_encoder.h
+ *
+ *  A small MPEG audio layer I and II frame encoder for the decoder tests, written from ISO 11172-3 and 13818-3 and not
+ *  from the decoder: the tables here are those of the standard (B.2a...d, B.1 of 13818-3, the levels of B.4), not the
+ *  quantization classes of mp3_decoder.cpp. There is no analysis filterbank, every frame takes random choices (bit
+ *  allocation, scfsi, scale factors, the codes) from a seeded generator and the requantized subband samples are
+ *  computed in double precision as the standard gives them (s''' = C * (s'' + D) * scale factor). They are kept in
+ *  Q23, the format of the decoder in front of the synthesis filter, as the reference of the frames.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+class Mp2Encoder {
+  public:
+    uint8_t              layer = 2;     // 1 or 2
+    bool                 lsf = false;   // MPEG-2 half sample rates
+    uint8_t              srIdx = 0;     // 44.1, 48, 32 kHz, MPEG-2: 22.05, 24, 16 kHz
+    uint8_t              brIdx = 10;    // 1...14
+    uint8_t              mode = 0;      // 0 stereo, 1 joint stereo, 2 dual channel, 3 mono
+    uint8_t              modeExt = 0;   // joint stereo: intensity stereo from subband 4, 8, 12, 16 on
+    int8_t               onlyBand = -1; // >= 0: no other subband is allocated, all its scale factors are 20
+    std::vector<int32_t> expected[2];   // of the last makeStream(), Q23, [block * 32 + subband] per channel
+
+    uint8_t  channels() const { return mode == 3 ? 1 : 2; }
+    uint32_t blocks() const { return layer == 1 ? 12 : 36; } // per frame
+    uint32_t sampleRate() const {
+        static const uint32_t sr[3] = {44100, 48000, 32000};
+        return sr[srIdx] >> lsf;
+    }
+    uint32_t bitRate() const { // ISO 11172-3 2.4.2.3, 13818-3 2.4.2.3
+        static const uint16_t kbps[2][2][15] = {
+            {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+             {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384}},
+            {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+             {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}};
+        return kbps[lsf][layer - 1][brIdx] * 1000;
+    }
+
+    std::vector<uint8_t> makeStream(uint32_t frames, uint32_t seed) {
+        m_rng = seed;
+        std::vector<uint8_t> out;
+        expected[0].clear();
+        expected[1].clear();
+        for(uint32_t f = 0; f < frames; f++) {
+            std::vector<uint8_t> fr = encodeFrame();
+            out.insert(out.end(), fr.begin(), fr.end());
+        }
+        return out;
+    }
+
+  private:
+    struct BitWriter {
+        std::vector<uint8_t> b;
+        uint32_t             n = 0;
+        void put(uint32_t v, int k) {
+            for(int i = k - 1; i >= 0; i--) {
+                if(n % 8 == 0) b.push_back(0);
+                if((v >> i) & 1) b.back() |= 0x80 >> (n % 8);
+                n++;
+            }
+        }
+    };
+
+    uint32_t m_rng = 1;
+
+    uint32_t rnd() {
+        m_rng = m_rng * 1103515245u + 12345u;
+        return m_rng >> 8;
+    }
+
+    // layer II: the bits of the allocation of subband sb and its number of levels per allocation value, 0: none
+    const uint16_t* l2Alloc(int sb, int* nbal, int* sbLimit) const {
+        static const uint16_t a[16] = {0, 3, 7, 15, 31, 63, 127, 255, 511, 1023, 2047, 4095, 8191, 16383, 32767, 65535};
+        static const uint16_t b[16] = {0, 3, 5, 7, 9, 15, 31, 63, 127, 255, 511, 1023, 2047, 4095, 8191, 65535};
+        static const uint16_t c[8] = {0, 3, 5, 7, 9, 15, 31, 65535};
+        static const uint16_t d[4] = {0, 3, 5, 65535};
+        static const uint16_t lo[16] = {0, 3, 5, 9, 15, 31, 63, 127, 255, 511, 1023, 2047, 4095, 8191, 16383, 32767};
+        static const uint16_t lsf4[16] = {0, 3, 5, 7, 9, 15, 31, 63, 127, 255, 511, 1023, 2047, 4095, 8191, 16383};
+        if(lsf) { // 13818-3 B.1
+            *sbLimit = 30;
+            *nbal = sb < 4 ? 4 : sb < 11 ? 3 : 2;
+            return sb < 4 ? lsf4 : lo;
+        }
+        uint32_t perCh = bitRate() / 1000 / channels();
+        if(perCh <= 48) { // B.2c (48, 44.1 kHz), B.2d (32 kHz)
+            *sbLimit = srIdx == 2 ? 12 : 8;
+            *nbal = sb < 2 ? 4 : 3;
+            return lo;
+        }
+        *sbLimit = (perCh <= 80 || srIdx == 1) ? 27 : 30; // B.2a, B.2b
+        *nbal = sb < 3 ? 4 : sb < 11 ? 4 : sb < 23 ? 3 : 2;
+        return sb < 3 ? a : sb < 11 ? b : sb < 23 ? c : d;
+    }
+
+    bool grouped(uint32_t levels) const { return layer == 2 && (levels == 3 || levels == 5 || levels == 9); } // 3 codes in one
+    int  codeBits(uint32_t levels) const { return !grouped(levels) ? (int)log2(levels + 1.0) : levels == 3 ? 5 : levels == 5 ? 7 : 10; }
+
+    // B.4: nb bits of the code, the MSB inverted gives s'' in [-1, 1), s''' = C * (s'' + D), C = 2^nb / levels
+    double requantize(uint32_t code, uint32_t levels, uint32_t sfIdx) const {
+        int    nb = (int)ceil(log2((double)levels));
+        double s = (double)code / (1 << (nb - 1)) - 1;
+        double C = (double)(1 << nb) / levels;
+        double D = grouped(levels) ? 0.5 : 1.0 / (1 << (nb - 1));
+        return C * (s + D) * pow(2.0, 1 - sfIdx / 3.0); // B.1: scale factor 2^(1 - index / 3)
+    }
+
+    std::vector<uint8_t> encodeFrame() {
+        uint8_t  nch = channels();
+        uint8_t  pad = rnd() % 2;
+        uint32_t frameBytes = layer == 1 ? (12 * bitRate() / sampleRate() + pad) * 4 : 144 * bitRate() / sampleRate() + pad;
+        int      sbLimit = 32, nbal[32];
+        const uint16_t* lev[32];
+        for(int sb = 0; sb < 32; sb++) {
+            nbal[sb] = 4;
+            lev[sb] = nullptr;
+            if(layer == 2) lev[sb] = l2Alloc(sb, &nbal[sb], &sbLimit);
+        }
+        int bound = mode == 1 ? (modeExt + 1) * 4 : sbLimit;
+        if(bound > sbLimit) bound = sbLimit;
+
+        // allocation, levels of each channel and subband, the right channel shares it from bound on
+        uint32_t alloc[2][32] = {}, levels[2][32] = {};
+        for(int sb = 0; sb < sbLimit; sb++) {
+            for(int ch = 0; ch < nch; ch++) {
+                if(ch && sb >= bound) {alloc[1][sb] = alloc[0][sb]; break;}
+                if(onlyBand >= 0 ? sb != onlyBand : rnd() % 5 < 2) continue;
+                alloc[ch][sb] = layer == 1 ? 1 + rnd() % 14 : 1 + rnd() % ((1 << nbal[sb]) - 1);
+            }
+        }
+        for(;;) { // fewer subbands until it fits, then the rest of the frame is ancillary data
+            uint32_t bits = 32;
+            for(int sb = 0; sb < sbLimit; sb++) {
+                for(int ch = 0; ch < nch; ch++) {
+                    bits += (ch && sb >= bound) ? 0 : nbal[sb];
+                    levels[ch][sb] = !alloc[ch][sb] ? 0 : layer == 1 ? (2u << alloc[ch][sb]) - 1 : lev[sb][alloc[ch][sb]];
+                    if(!alloc[ch][sb]) continue;
+                    bits += layer == 2 ? 2 + 18 : 6; // scfsi, three scale factors at most
+                    if(ch && sb >= bound) continue;
+                    uint32_t n = levels[ch][sb];
+                    bits += layer == 1 ? 12 * codeBits(n) : 12 * (grouped(n) ? codeBits(n) : 3 * codeBits(n));
+                }
+            }
+            if(bits <= frameBytes * 8) break;
+            int sb = rnd() % sbLimit;
+            alloc[0][sb] /= 2;
+            alloc[1][sb] = sb >= bound ? alloc[0][sb] : alloc[1][sb] / 2;
+        }
+
+        // scfsi and scale factors, layer I: one per subband, layer II: per part of 4 granules
+        uint32_t scfsi[2][32] = {}, sf[2][3][32] = {};
+        for(int sb = 0; sb < sbLimit; sb++) {
+            for(int ch = 0; ch < nch; ch++) {
+                scfsi[ch][sb] = layer == 2 ? rnd() % 4 : 2;
+                for(int p = 0; p < 3; p++) sf[ch][p][sb] = onlyBand >= 0 ? 20 : 10 + rnd() % 53; // 0...9 clip too often
+                if(scfsi[ch][sb] == 1) sf[ch][1][sb] = sf[ch][0][sb];
+                if(scfsi[ch][sb] == 2) sf[ch][1][sb] = sf[ch][2][sb] = sf[ch][0][sb];
+                if(scfsi[ch][sb] == 3) sf[ch][2][sb] = sf[ch][1][sb];
+            }
+        }
+
+        BitWriter w;
+        w.put(0xFFF, 12);
+        w.put(!lsf, 1);
+        w.put(4 - layer, 2);
+        w.put(1, 1);           // no CRC
+        w.put(brIdx, 4);
+        w.put(srIdx, 2);
+        w.put(pad, 1);
+        w.put(0, 1);           // private
+        w.put(mode, 2);
+        w.put(modeExt, 2);
+        w.put(0, 4);           // copyright, original, emphasis
+        for(int sb = 0; sb < sbLimit; sb++)
+            for(int ch = 0; ch < nch && !(ch && sb >= bound); ch++) w.put(alloc[ch][sb], nbal[sb]);
+        if(layer == 2)
+            for(int sb = 0; sb < sbLimit; sb++)
+                for(int ch = 0; ch < nch; ch++)
+                    if(alloc[ch][sb]) w.put(scfsi[ch][sb], 2);
+        for(int sb = 0; sb < sbLimit; sb++) {
+            for(int ch = 0; ch < nch; ch++) {
+                if(!alloc[ch][sb]) continue;
+                w.put(sf[ch][0][sb], 6);
+                if(scfsi[ch][sb] == 0 || scfsi[ch][sb] == 3) w.put(sf[ch][1][sb], 6);
+                if(scfsi[ch][sb] == 0 || scfsi[ch][sb] == 1) w.put(sf[ch][2][sb], 6);
+            }
+        }
+
+        // samples: 12 granules of 1 (layer I) or 3 (layer II) per subband
+        uint32_t nPerGr = layer == 1 ? 1 : 3, base = expected[0].size();
+        for(int ch = 0; ch < nch; ch++) expected[ch].resize(base + blocks() * 32, 0);
+        for(int gr = 0; gr < 12; gr++) {
+            for(int sb = 0; sb < sbLimit; sb++) {
+                uint32_t code[3];
+                for(int ch = 0; ch < nch; ch++) {
+                    uint32_t n = levels[ch][sb];
+                    if(!n) continue;
+                    if(ch == 0 || sb < bound) {
+                        for(uint32_t i = 0; i < nPerGr; i++) code[i] = rnd() % n;
+                        if(grouped(n)) w.put(code[0] + n * (code[1] + n * code[2]), codeBits(n));
+                        else for(uint32_t i = 0; i < nPerGr; i++) w.put(code[i], codeBits(n));
+                    }
+                    for(uint32_t i = 0; i < nPerGr; i++) {
+                        double x = requantize(code[i], n, sf[ch][layer == 2 ? gr / 4 : 0][sb]);
+                        expected[ch][base + (gr * nPerGr + i) * 32 + sb] = (int32_t)lround(x * (1 << 23));
+                    }
+                }
+            }
+        }
+        while(w.n < frameBytes * 8) w.put(0, 1);
+        return w.b;
+    }
+};
@@ -0,0 +1,192 @@
+/*
+ *  test_audio_arena.cpp
+ *
+ *  AudioArena: bump allocation, alignment, fallback to the heap when full, reset and statistics, the decoder functions
+ *  with and without a bound arena. Heap use over many streams: the MP3 and FLAC decoders behind AudioCodec play beep.mp3
+ *  and a FLAC stream in turn, with codec changes (all decoders released, arena reset) and streams of the same codec
+ *  (reset() only) as Audio::setDefaults() and initializeDecoder() do it. malloc() and friends are counted here: after
+ *  the first stream of each codec no block may come from the heap and the heap in use must not grow. Built for the
+ *  ESP32-S3, the classic ESP32 keeps the MP3 state in internal RAM.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_arena/audio_arena.h"
+#include "audio_codec/audio_codec.h"
+#include "flac_encoder.h"
+#include "check.h"
+#include <atomic>
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+// the heap of the process, counted while s_count is set
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void  __libc_free(void* ptr);
+
+static std::atomic<bool>     s_count{false};
+static std::atomic<uint32_t> s_mallocs{0}, s_frees{0};
+
+extern "C" void* malloc(size_t size) {
+    if(s_count) s_mallocs++;
+    return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t n, size_t size) {
+    if(s_count) s_mallocs++;
+    return __libc_calloc(n, size);
+}
+extern "C" void* realloc(void* ptr, size_t size) {
+    if(s_count) s_mallocs++;
+    return __libc_realloc(ptr, size);
+}
+extern "C" void free(void* ptr) {
+    if(s_count && ptr) s_frees++;
+    __libc_free(ptr);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testArena() {
+    AudioArena   a;
+    arenaStats_t st;
+    void*        h = AudioArena_Malloc(100);    // nothing bound: the heap
+    CHECK(h != NULL);
+    CHECK(!AudioArena_Owns(h));
+    AudioArena_Free(h);
+    CHECK(a.init(1000));
+    a.getStats(&st);
+    CHECK_EQ(st.size, 1000);
+    AudioArena_Bind(&a);
+    uint8_t* p1 = (uint8_t*)AudioArena_Malloc(3);
+    uint8_t* p2 = (uint8_t*)AudioArena_Calloc(10, 10);
+    CHECK(a.owns(p1) && AudioArena_Owns(p2));
+    CHECK_EQ(p2 - p1, 8);                        // 8 byte aligned
+    CHECK_EQ((uintptr_t)p2 & 7, 0);
+    bool zero = true;
+    for(int i = 0; i < 100; i++) zero &= p2[i] == 0;
+    CHECK(zero);
+    uint8_t* p3 = (uint8_t*)AudioArena_Malloc(1000); // does not fit
+    CHECK(p3 != NULL);
+    CHECK(!a.owns(p3));
+    AudioArena_Free(p3);
+    AudioArena_Free(p1);                        // no effect, the arena block stays until reset()
+    a.getStats(&st);
+    CHECK_EQ(st.used, 8 + 104);
+    CHECK_EQ(st.allocs, 2);
+    CHECK_EQ(st.heapFallbacks, 1);
+    a.reset();
+    CHECK(AudioArena_Malloc(16) == p1);         // from the beginning again
+    a.getStats(&st);
+    CHECK_EQ(st.used, 16);
+    CHECK_EQ(st.peak, 8 + 104);
+    CHECK_EQ(st.resets, 1);
+    AudioArena_Bind(nullptr);
+    a.deinit();
+    a.getStats(&st);
+    CHECK_EQ(st.size, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<uint8_t> readBeep() { // without the ID3v2 tag, 64 zero bytes behind it
+    std::vector<uint8_t> d;
+    FILE*                fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    if(!fp) return d;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    if(d.size() > 10 && !memcmp(d.data(), "ID3", 3)) {
+        size_t tag = 10 + ((d[6] & 0x7F) << 21 | (d[7] & 0x7F) << 14 | (d[8] & 0x7F) << 7 | (d[9] & 0x7F));
+        d.erase(d.begin(), d.begin() + tag);
+    }
+    d.resize(d.size() + 64, 0);
+    return d;
+}
+
+static uint32_t play(AudioCodec* c, const std::vector<uint8_t>& d, int16_t* out) { // the frames of the stream
+    int32_t  pos = 0, len = d.size() - 64;
+    uint32_t frames = 0;
+    bool     synced = false;
+    while(pos < len) {
+        if(!synced) {
+            int32_t o = c->findSync((uint8_t*)d.data() + pos, len - pos);
+            if(o < 0) break;
+            pos += o;
+            synced = true;
+        }
+        int32_t left = len - pos;
+        if(c->decode((uint8_t*)d.data() + pos, &left, out) < 0) {pos++; synced = false; continue;}
+        pos = len - left;
+        frames += c->outputFrames();
+    }
+    return frames;
+}
+
+static void testStreams() {
+    std::vector<uint8_t> mp3 = readBeep();
+    std::vector<int32_t> pcm;
+    FlacEncoder          enc;
+    std::vector<uint8_t> flac = enc.makeStream(2, 20, 5, &pcm);
+    flac.resize(flac.size() + 64, 0);
+    CHECK(mp3.size() > 1000);
+    std::vector<int16_t> out(8192 * 2);
+
+    AudioArena arena;                           // as the Audio constructor
+    CHECK(arena.init(AudioCodec_MaxStateSize()));
+    AudioArena_Bind(&arena);
+    AudioCodec* codecs[2] = {AudioCodec_NewMP3(), AudioCodec_NewFLAC()};
+    int         last = -1;
+    uint32_t    frames = 0, mallocs = 0, frees = 0;
+    size_t      inUse = 0;
+    const int   streams = 400;
+    for(int s = 0; s < streams; s++) {
+        int k = (s >> 1) & 1;                   // MP3 MP3 FLAC FLAC ...: codec changes and warm starts
+        if(s == 2) {                            // the first stream of each codec is behind, count from here on
+            inUse = mallinfo2().uordblks;
+            s_mallocs = 0;
+            s_frees = 0;
+            s_count = true;
+        }
+        AudioCodec* c = codecs[k];
+        if(k == last) c->reset();               // setDefaults()
+        else {
+            for(AudioCodec* r : codecs) r->release();
+            arena.reset();
+        }
+        last = k;
+        if(!c->isInit()) CHECK(c->init());      // initializeDecoder()
+        if(k == 1) {
+            c->setDualCore(-1, 2);
+            c->setCrcCheck(true, false);        // AUDIO_FLAC_CRC_CHECK
+            audioCodecRaw_t raw = {};
+            raw.sampleRate = 44100;
+            raw.channels = 2;
+            raw.bitsPerSample = 16;
+            raw.totalSamples = pcm.size() / 2;
+            raw.audioDataSize = flac.size() - 64;
+            c->setRawParams(&raw);
+        }
+        frames += play(c, k ? flac : mp3, out.data());
+    }
+    s_count = false;
+    mallocs = s_mallocs;
+    frees = s_frees;
+    size_t       grown = mallinfo2().uordblks - inUse;
+    arenaStats_t st;
+    arena.getStats(&st);
+    printf("%d streams, %u frames: %u mallocs, %u frees, heap +%zu bytes; arena %zu of %zu bytes, %u blocks, %u resets, "
+           "%u heap fallbacks\n", streams, frames, mallocs, frees, grown, st.peak, st.size, st.allocs, st.resets, st.heapFallbacks);
+    CHECK_EQ(frames, (streams / 2) * (27 * 1152 + pcm.size() / 2));
+    CHECK_EQ(mallocs, 0);
+    CHECK_EQ(frees, 0);
+    CHECK_EQ(grown, 0);
+    CHECK_EQ(st.heapFallbacks, 0);
+    CHECK(st.peak <= st.size);
+    for(AudioCodec* c : codecs) delete c;
+    AudioArena_Bind(nullptr);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testArena();
+    testStreams();
+    return TEST_RESULT();
+}
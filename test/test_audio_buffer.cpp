@@ -0,0 +1,232 @@
+/*
+ *  test_audio_buffer.cpp
+ *
+ *  AudioBuffer (InBuff): full and empty ring, the reserve behind the ring end, a writer and a reader thread on a small
+ *  ring with many wraps. Benchmark of the file prefetch: a file backed block device with the latency of an SD card
+ *  (a fixed cost per read, the transfer time and every 40th read a long busy phase), read as Audio::readFileToInBuff()
+ *  does it. A decoder takes one frame per period from InBuff, the output holds three frames. Reads in the decoder
+ *  task (without prefetch) are compared to reads in a prefetch thread, counted are the frames that were late.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_buffer/audio_buffer.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint8_t pattern(uint32_t pos) { return (pos * 131 + (pos >> 9)) & 0xFF; }
+
+static void write(AudioBuffer& b, uint32_t& pos, size_t n) {
+    uint8_t* w = b.getWritePtr();
+    for(size_t i = 0; i < n; i++) w[i] = pattern(pos++);
+    b.bytesWritten(n);
+}
+
+static bool verify(AudioBuffer& b, uint32_t& pos, size_t n) { // through the reserve if the block wraps
+    const uint8_t* r = b.getReadPtr();
+    bool ok = true;
+    for(size_t i = 0; i < n; i++) ok &= r[i] == pattern(pos++);
+    b.bytesWasRead(n);
+    return ok;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRing() {
+    AudioBuffer b;
+    b.setBufsize(4096 * 6 + 10000);          // ring of 10000 bytes and the reserve
+    CHECK_EQ(b.init(), 10000);
+    uint32_t wpos = 0, rpos = 0;
+    CHECK_EQ(b.bufferFilled(), 0);
+    CHECK_EQ(b.writeSpace(), 10000);
+    CHECK_EQ(b.getMaxAvailableBytes(), 0);
+    write(b, wpos, 10000);                   // full, the pointers are equal again
+    CHECK_EQ(b.getWritePos(), 0);
+    CHECK_EQ(b.bufferFilled(), 10000);
+    CHECK_EQ(b.freeSpace(), 0);
+    CHECK_EQ(b.writeSpace(), 0);
+    CHECK_EQ(b.getMaxAvailableBytes(), 10000);
+    CHECK(verify(b, rpos, 9000));
+    CHECK_EQ(b.getMaxAvailableBytes(), 1000);
+    CHECK_EQ(b.writeSpace(), 9000);          // up to the read pointer
+    write(b, wpos, 500);
+    CHECK_EQ(b.writeSpace(), 8500);
+    CHECK(verify(b, rpos, 1500));            // 1000 bytes from the end, 500 from the reserve
+    CHECK_EQ(b.bufferFilled(), 0);
+    CHECK_EQ(b.getReadPos(), 500);
+
+    // the reserve only gets bytes that were published: the writer may be behind them
+    write(b, wpos, 9500);                    // up to the ring end
+    CHECK(verify(b, rpos, 9000));            // 500 bytes left before the end
+    uint8_t* w = b.getWritePtr();
+    memset(w, 0xAA, 1100);                   // written, not published
+    uint8_t* r = b.getReadPtr();
+    CHECK(r[500] != 0xAA);                   // not copied
+    write(b, wpos, 600);
+    r = b.getReadPtr();
+    CHECK(r[500] == pattern(rpos + 500) && r[1099] == pattern(rpos + 1099));
+    CHECK_EQ(r[1100], 0);
+    b.resetBuffer();
+    CHECK_EQ(b.bufferFilled(), 0);
+    CHECK_EQ(b.writeSpace(), 10000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testThreads() {
+    AudioBuffer b;
+    b.setBufsize(4096 * 6 + 10007);
+    CHECK_EQ(b.init(), 10007);
+    const uint32_t total = 32 * 1024 * 1024;
+    std::thread writer([&]() {
+        std::mt19937 rnd(1);
+        uint32_t     pos = 0;
+        while(pos < total) {
+            size_t n = min(b.writeSpace(), (size_t)(total - pos));
+            if(!n) {std::this_thread::yield(); continue;}
+            write(b, pos, 1 + rnd() % n);
+        }
+    });
+    std::mt19937 rnd(2);
+    uint32_t     pos = 0;
+    bool         ok = true;
+    while(pos < total) {
+        size_t n = min(b.bufferFilled(), (size_t)b.getMaxBlockSize()); // a frame of up to maxBlockSize, may wrap
+        if(!n) {std::this_thread::yield(); continue;}
+        ok &= verify(b, pos, 1 + rnd() % n);
+    }
+    writer.join();
+    printf("two threads: %u bytes through a ring of %d bytes\n", total, b.getBufsize());
+    CHECK(ok);
+    CHECK_EQ(b.bufferFilled(), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// a file as SD card, the time of a read is slept
+typedef std::chrono::steady_clock clk;
+
+class BlockDevice {
+public:
+    BlockDevice(uint32_t size) : m_size(size) {
+        m_fp = tmpfile();
+        std::vector<uint8_t> d(size);
+        for(uint32_t i = 0; i < size; i++) d[i] = pattern(i);
+        fwrite(d.data(), 1, size, m_fp);
+        fflush(m_fp);
+    }
+    ~BlockDevice() { fclose(m_fp); }
+    uint32_t size() { return m_size; }
+    uint32_t position() { return m_pos; }
+    void     seek(uint32_t pos) { m_pos = pos; m_reads = 0; }
+    int32_t  read(uint8_t* buf, uint32_t len) {
+        uint32_t us = 500 + len / 10;                  // 0.5 ms per command, 10 MB/s
+        if(++m_reads % 40 == 0) us += 40000;           // busy, 40 ms
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+        int32_t n = pread(fileno(m_fp), buf, min(len, m_size - m_pos), m_pos);
+        if(n > 0) m_pos += n;
+        return n;
+    }
+
+private:
+    FILE*    m_fp;
+    uint32_t m_size;
+    std::atomic<uint32_t> m_pos{0}; // the position is polled by the decoder
+    uint32_t m_reads = 0;
+};
+
+static int32_t readFileToInBuff(AudioBuffer& b, BlockDevice& dev) { // as Audio::readFileToInBuff()
+    const uint32_t sectorSize = 512;
+    const uint32_t maxRead = 32768;
+    const uint32_t minRead = 4096;
+    uint32_t space = b.writeSpace();
+    if(!space) return 0;
+    uint32_t pos = dev.position();
+    uint32_t len = min(space, maxRead);
+    bool     toBuffEnd = (b.getWritePos() + space >= (uint32_t)b.getBufsize());
+    bool     toFileEnd = (pos + len >= dev.size());
+    if(!toBuffEnd && !toFileEnd) {
+        if(len < minRead) return 0;
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    else if(!toFileEnd && len > sectorSize) {
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    int32_t bytesRead = dev.read(b.getWritePtr(), len);
+    if(bytesRead > 0) b.bytesWritten(bytesRead);
+    return bytesRead;
+}
+
+struct playStats_t {
+    uint32_t frames;
+    uint32_t late;   // frames not decoded when the output needed them
+    uint32_t worst;  // µs
+    bool     ok;     // the data arrived unchanged
+};
+
+static playStats_t play(BlockDevice& dev, bool prefetch) {
+    const uint32_t frameBytes = 8192;               // a FLAC frame, 16 bit stereo at 44.1kHz: one per 92.9 ms, here 10 times
+    const auto     period = std::chrono::microseconds(9290); // faster: 880 kB/s from the card
+    const uint32_t outFrames = 3;                   // frames in the output stage
+    AudioBuffer    b;
+    b.init();                                       // the size of the firmware
+    b.changeMaxBlockSize(frameBytes);
+    dev.seek(0);
+    std::atomic<bool> stop{false};
+    std::thread       task;
+    if(prefetch) task = std::thread([&]() {        // Audio::prefetchTask()
+        while(!stop) {
+            if(readFileToInBuff(b, dev) <= 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    while(b.bufferFilled() < (size_t)b.getBufsize() / 4 && dev.position() < dev.size()) { // the header is read inline
+        if(!prefetch) readFileToInBuff(b, dev);
+        else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    playStats_t st = {0, 0, 0, true};
+    uint32_t    pos = 0;
+    clk::time_point t0 = clk::now();
+    while(pos < dev.size()) {
+        if(!prefetch) readFileToInBuff(b, dev);     // processLocalFile()
+        size_t n = min((size_t)frameBytes, (size_t)(dev.size() - pos));
+        while(b.bufferFilled() < n) {
+            if(!prefetch) readFileToInBuff(b, dev);
+            else std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        st.ok &= verify(b, pos, n);
+        clk::time_point due = t0 + (st.frames + outFrames) * period; // the output runs empty then
+        clk::time_point now = clk::now();
+        if(now > due) {
+            uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(now - due).count();
+            st.late++;
+            st.worst = max(st.worst, us);
+            t0 += now - due;                        // the output restarts
+        }
+        st.frames++;
+        std::this_thread::sleep_until(t0 + st.frames * period); // the output is full, wait for the DMA
+    }
+    stop = true;
+    if(task.joinable()) task.join();
+    return st;
+}
+
+static void testPrefetch() {
+    BlockDevice dev(2 * 1024 * 1024);
+    playStats_t st[2];
+    for(int p = 0; p < 2; p++) {
+        st[p] = play(dev, p);
+        printf("%s: %u frames, %u late, worst %.1f ms\n", p ? "prefetch thread" : "reads in the decoder",
+               st[p].frames, st[p].late, st[p].worst / 1000.0);
+    }
+    CHECK(st[0].ok && st[1].ok);
+    CHECK(st[0].late > 0);                          // the 40 ms busy phases are longer than the output
+    CHECK_EQ(st[1].late, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testRing();
+    testThreads();
+    testPrefetch();
+    return TEST_RESULT();
+}
@@ -0,0 +1,231 @@
+/*
+ *  test_audio_codec.cpp
+ *
+ *  The decoders behind the AudioCodec interface, as Audio drives them: findSync(), decode(), getInfo(). beep.mp3 (MPEG-1
+ *  Layer III, 48 kHz mono) must give the golden PCM (CRC32 of the samples of this decoder, its tone checked with a
+ *  Goertzel filter), two MP3 instances with different qualities and two FLAC instances decode interleaved without
+ *  seeing each other. Four threads that make the first MP3 decoders of the process at once (Huffman tables built
+ *  once) get the golden PCM. AAC, Opus and Vorbis are not compiled in (no host streams for them).
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_codec/audio_codec.h"
+#include "mp3_decoder/mp3_decoder.h"
+#include "flac_decoder/flac_decoder.h"
+#include "flac_encoder.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+
+static const uint32_t BEEP_CRC = 0xb6463355;  // CRC32 of the 16 bit samples, MP3_QUALITY_FULL
+static const uint32_t BEEP_FRAMES = 27 * 1152; // samples, the first frame is the Info tag (silence)
+
+static std::vector<uint8_t> readBeep() { // without the ID3v2 tag
+    std::vector<uint8_t> d;
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    if(!fp) return d;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    if(d.size() > 10 && !memcmp(d.data(), "ID3", 3)) {
+        size_t tag = 10 + ((d[6] & 0x7F) << 21 | (d[7] & 0x7F) << 14 | (d[8] & 0x7F) << 7 | (d[9] & 0x7F));
+        d.erase(d.begin(), d.begin() + tag);
+    }
+    return d;
+}
+
+static uint32_t crc32(const int16_t* p, size_t n, uint32_t crc = 0) {
+    const uint8_t* b = (const uint8_t*)p;
+    crc = ~crc;
+    for(size_t i = 0; i < n * 2; i++) {
+        crc ^= b[i];
+        for(int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+// the loop of Audio::sendBytes() for one instance, step() is one decode() call
+struct CodecRun {
+    AudioCodec*          c;
+    const uint8_t*       data;
+    int32_t              len;
+    int32_t              pos = 0;
+    int32_t              errors = 0;
+    bool                 synced = false;
+    std::vector<int16_t> pcm;
+    std::vector<int16_t> out = std::vector<int16_t>(8192 * 2);
+
+    CodecRun(AudioCodec* codec, const std::vector<uint8_t>& d) : c(codec), data(d.data()), len(d.size() - 64) {}
+    bool done() const { return pos >= len; }
+
+    void step() {
+        if(!synced) {
+            int32_t o = c->findSync((uint8_t*)data + pos, len - pos);
+            if(o < 0) {pos = len; return;}
+            pos += o;
+            synced = true;
+        }
+        int32_t left = len - pos;
+        int32_t ret = c->decode((uint8_t*)data + pos, &left, out.data());
+        if(ret < 0) { // as Audio: one byte on, find the next frame
+            errors++;
+            pos++;
+            synced = false;
+            return;
+        }
+        pos = len - left;
+        if(c->noOutput(ret)) return;
+        audioCodecInfo_t info;
+        c->getInfo(&info);
+        pcm.insert(pcm.end(), out.begin(), out.begin() + c->outputFrames() * info.channels);
+    }
+    void finish() {
+        while(!done()) step();
+    }
+};
+
+static double goertzel(const std::vector<int16_t>& x, double f, double rate) {
+    double w = 2 * M_PI * f / rate, k = 2 * cos(w), s1 = 0, s2 = 0;
+    for(int16_t v : x) {
+        double s = v + k * s1 - s2;
+        s2 = s1;
+        s1 = s;
+    }
+    return s1 * s1 + s2 * s2 - k * s1 * s2;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testMP3Golden() {
+    std::vector<uint8_t> beep = readBeep();
+    CHECK(beep.size() > 1000);
+    beep.resize(beep.size() + 64, 0);
+    AudioCodec* c = AudioCodec_NewMP3();
+    CHECK(c != nullptr);
+    CHECK(!c->isInit());
+    CHECK(c->init());
+    CodecRun r(c, beep);
+    r.finish();
+    audioCodecInfo_t info;
+    c->getInfo(&info);
+    CHECK_EQ(info.sampleRate, 48000);
+    CHECK_EQ(info.channels, 1);
+    CHECK_EQ(info.layer, 3);
+    CHECK_EQ(info.mpegVersion, 0);
+    CHECK(info.bitRate >= 32000);              // VBR, of the last frame
+    CHECK_EQ(r.errors, 0);
+    CHECK_EQ(r.pcm.size() % 1152, 0);
+    double best = 0, bestF = 0; // the tone: the strongest bin from 100 Hz to 8 kHz
+    for(double f = 100; f < 8000; f += 10) {
+        double e = goertzel(r.pcm, f, 48000);
+        if(e > best) {best = e; bestF = f;}
+    }
+    printf("beep.mp3: %u samples, tone %.0f Hz, crc %08x\n", (unsigned)r.pcm.size(), bestF, crc32(r.pcm.data(), r.pcm.size()));
+    CHECK_EQ(r.pcm.size(), BEEP_FRAMES);
+    CHECK_EQ(crc32(r.pcm.data(), r.pcm.size()), BEEP_CRC);
+    delete c;
+}
+//----------------------------------------------------------------------------------------------------------------------
+// the first decoders of the process are made by two threads at the same time, both build on the Huffman fast tables
+static void testMP3Threads() {
+    std::vector<uint8_t> beep = readBeep();
+    beep.resize(beep.size() + 64, 0);
+    uint32_t    crc[4] = {};
+    std::thread th[4];
+    for(int i = 0; i < 4; i++) {
+        th[i] = std::thread([&beep, &crc, i] {
+            AudioCodec* c = AudioCodec_NewMP3();
+            if(!c->init()) return;
+            CodecRun r(c, beep);
+            r.finish();
+            crc[i] = crc32(r.pcm.data(), r.pcm.size());
+            delete c;
+        });
+    }
+    for(int i = 0; i < 4; i++) {
+        th[i].join();
+        CHECK_EQ(crc[i], BEEP_CRC);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testMP3Instances() { // full and low pass quality in turn, each as if alone
+    std::vector<uint8_t> beep = readBeep();
+    beep.resize(beep.size() + 64, 0);
+    std::vector<int16_t> alone[2];
+    for(int q = 0; q < 2; q++) {
+        AudioCodec* c = AudioCodec_NewMP3();
+        c->setQuality(q ? MP3_QUALITY_LOWPASS : MP3_QUALITY_FULL); // before init(), as Audio after release()
+        CHECK(c->init());
+        CodecRun r(c, beep);
+        r.finish();
+        alone[q] = r.pcm;
+        delete c;
+    }
+    CHECK(alone[0] != alone[1]);
+    AudioCodec* a = AudioCodec_NewMP3();
+    AudioCodec* b = AudioCodec_NewMP3();
+    CHECK(a->init() && b->init());
+    b->setQuality(MP3_QUALITY_LOWPASS);
+    CodecRun ra(a, beep), rb(b, beep);
+    while(!ra.done() || !rb.done()) {
+        if(!ra.done()) ra.step();
+        if(!rb.done()) rb.step();
+    }
+    CHECK(ra.pcm == alone[0]);
+    CHECK(rb.pcm == alone[1]);
+    a->release();
+    CHECK(!a->isInit());
+    CHECK(b->isInit());
+    delete a;
+    delete b;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFLACInstances() { // raw parameters and MD5 per instance, 16 bit mono and stereo side by side
+    FlacEncoder          enc;
+    std::vector<int32_t> pcm[2];
+    std::vector<uint8_t> data[2];
+    AudioCodec*          c[2];
+    uint8_t              md5[2][16];
+    for(int i = 0; i < 2; i++) {
+        data[i] = enc.makeStream(i + 1, 20, 70 + i, &pcm[i]);
+        data[i].resize(data[i].size() + 64, 0);
+        FlacEncoder::md5(pcm[i], 16, md5[i]);
+        c[i] = AudioCodec_NewFLAC();
+        CHECK(c[i]->init());
+        audioCodecRaw_t raw = {};
+        raw.sampleRate = 44100;
+        raw.channels = i + 1;
+        raw.bitsPerSample = 16;
+        raw.totalSamples = pcm[i].size() / (i + 1);
+        raw.audioDataSize = data[i].size() - 64;
+        c[i]->setRawParams(&raw);
+        c[i]->startMD5(md5[i]);
+    }
+    CodecRun r0(c[0], data[0]), r1(c[1], data[1]);
+    while(!r0.done() || !r1.done()) {
+        if(!r0.done()) r0.step();
+        if(!r1.done()) r1.step();
+    }
+    CodecRun* r[2] = {&r0, &r1};
+    for(int i = 0; i < 2; i++) {
+        CHECK_EQ(r[i]->errors, 0);
+        CHECK(std::vector<int32_t>(r[i]->pcm.begin(), r[i]->pcm.end()) == pcm[i]);
+        CHECK_EQ(c[i]->md5Result(), FLAC_MD5_OK);
+        CHECK_EQ(c[i]->corruptFrames(), 0);
+        audioCodecInfo_t info;
+        c[i]->getInfo(&info);
+        CHECK_EQ(info.channels, i + 1);
+        delete c[i];
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    CHECK(AudioCodec_MaxStateSize() >= MP3Decoder_StateSize());
+    CHECK(AudioCodec_NewAAC() == nullptr);     // not compiled in here
+    testMP3Threads();                           // first, the Huffman tables are not built yet
+    testMP3Golden();
+    testMP3Instances();
+    testFLACInstances();
+    return TEST_RESULT();
+}
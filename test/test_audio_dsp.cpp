@@ -0,0 +1,257 @@
+/*
+ *  test_audio_dsp.cpp
+ *
+ *  The sample chain of Audio (AudioDsp: tone filters, forceMono, resampler to 48 kHz, the 16 bit conversions of the PCM
+ *  cache and the direct PCM path), built with 16 bit and with 32 bit samples (AUDIO_SAMPLE_32):
+ *  - mono is filtered and resampled as mono, the stereo output must be bit exact with the former path that expanded
+ *    mono to stereo in front of the filters (the stereo code of IIR_filterChain0..2() and resampleTo48kStereo()). The
+ *    direct PCM blocks are widened in place, the cache conversion is their inverse.
+ *  - 16 bit sources come out of the 32 bit chain bit exact where it has nothing to compute and within 1/4 LSB of a
+ *    double precision model where it has, the 16 bit chain within a few LSB
+ *  - 32 bit: samples beyond full scale keep their sign through forceMono, are saturated by GainRamp and by the 16 bit
+ *    conversion of the cache
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_dsp/audio_dsp.h"
+#include "output_stage/gain_ramp.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static const uint32_t s_rates[] = {8000, 11025, 22050, 32000, 44100, 48000};
+
+static std::vector<int16_t> noise(uint32_t frames, uint8_t ch, int amp, uint32_t seed) { // band limited, some clipping
+    std::vector<int16_t> v(frames * ch);
+    double               y[2] = {0, 0};
+    for(uint32_t i = 0; i < frames; i++) {
+        for(int c = 0; c < ch; c++) {
+            seed = seed * 1664525 + 1013904223;
+            y[c] = 0.7 * y[c] + 0.3 * ((int32_t)seed >> 16) * amp / 32768.0 * 3;
+            v[i * ch + c] = (int16_t)(y[c] > 32767 ? 32767 : y[c] < -32768 ? -32768 : y[c]);
+        }
+    }
+    return v;
+}
+
+// low shelf +6 dB at 500 Hz with the level correction of setTone(), peak EQ -10 dB at 3 kHz, high shelf +3 dB at 6 kHz:
+// the formulas of Audio::IIR_calculateCoefficients()
+static void tone(audioBiquad_t f[3], uint32_t rate) {
+    const float pi = 3.14159265f, r2 = sqrtf(2);
+    float K = tanf(pi * 500 / rate), V = powf(10, 6 / 20.0f), norm = 1 / (1 + r2 * K + K * K), corr = V;
+    f[0] = {(1 + sqrtf(2 * V) * K + V * K * K) * norm / corr, 2 * (V * K * K - 1) * norm / corr,
+            (1 - sqrtf(2 * V) * K + V * K * K) * norm / corr, 2 * (K * K - 1) * norm, (1 - r2 * K + K * K) * norm};
+    float Q = 2.5f;
+    K = tanf(pi * 3000 / rate);
+    V = powf(10, 10 / 20.0f);
+    norm = 1 / (1 + V / Q * K + K * K);
+    f[1] = {(1 + 1 / Q * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - 1 / Q * K + K * K) * norm, 2 * (K * K - 1) * norm,
+            (1 - V / Q * K + K * K) * norm};
+    float fc = rate < 12000 ? rate / 2 - 100 : 6000;
+    K = tanf(pi * fc / rate);
+    V = powf(10, 3 / 20.0f);
+    norm = 1 / (1 + r2 * K + K * K);
+    f[2] = {(V + sqrtf(2 * V) * K + K * K) * norm, 2 * (K * K - V) * norm, (V - sqrtf(2 * V) * K + K * K) * norm,
+            2 * (K * K - 1) * norm, (1 - r2 * K + K * K) * norm};
+}
+
+static std::vector<audio_sample_t> widen(const std::vector<int16_t>& v) {
+    std::vector<audio_sample_t> w(v.size());
+    for(size_t i = 0; i < v.size(); i++) w[i] = (audio_sample_t)(v[i] * (1 << AUDIO_SAMPLE_SHIFT));
+    return w;
+}
+
+// the stereo path before mono stayed mono: per frame the three filters on left and right, then the resampler
+struct StereoRef {
+    audioBiquad_t f[3];
+    float         mem[3][2][2][2] = {};
+    float         ratio, error = 0;
+
+    void filter(audio_sample_t* s) {
+        for(int n = 0; n < 3; n++) {
+            float in[2] = {(float)s[0], (float)s[1]}, out[2];
+            for(int c = 0; c < 2; c++) {
+                out[c] = f[n].a0 * in[c] + f[n].a1 * mem[n][0][0][c] + f[n].a2 * mem[n][1][0][c] - f[n].b1 * mem[n][0][1][c] -
+                         f[n].b2 * mem[n][1][1][c];
+                mem[n][1][0][c] = mem[n][0][0][c];
+                mem[n][0][0][c] = in[c];
+                mem[n][1][1][c] = mem[n][0][1][c];
+                mem[n][0][1][c] = out[c];
+            }
+            s[0] = (audio_sample_t)out[0];
+            s[1] = (audio_sample_t)out[1];
+        }
+    }
+    size_t resample(const audio_sample_t* in, size_t frames, audio_sample_t* out) {
+        float  exact = frames * ratio;
+        size_t n = (size_t)std::floor(exact + error);
+        error += exact - n;
+        for(size_t i = 0; i < n; i++) {
+            float  pos = i / ratio;
+            size_t idx = (size_t)pos;
+            float  frac = pos - idx;
+            size_t i1 = idx * 2, i2 = (idx + 1 < frames) ? (idx + 1) * 2 : i1;
+            for(int c = 0; c < 2; c++) out[i * 2 + c] = (audio_sample_t)(in[i1 + c] * (1.0f - frac) + in[i2 + c] * frac);
+        }
+        return n;
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+static void testMono() { // decoder frames of 1152 and 576 frames, then a short one
+    const uint32_t chunks[] = {1152, 576, 1152, 1152, 333, 1152};
+    for(uint32_t rate : s_rates) {
+        AudioDsp  dsp;
+        StereoRef ref;
+        tone(ref.f, rate);
+        dsp.setFilters(ref.f);
+        dsp.setResampleRatio(ref.ratio = 48000.0f / rate);
+        std::vector<audio_sample_t> src = widen(noise(6000, 1, 30000, rate));
+        std::vector<audio_sample_t> out(1152 * 7 * 2), expect(1152 * 7 * 2); // 8 kHz: 6 times the frames
+        size_t                      pos = 0, frames = 0, diffs = 0;
+        for(uint32_t n : chunks) {
+            std::vector<audio_sample_t> mono(src.begin() + pos, src.begin() + pos + n), stereo(n * 2);
+            for(uint32_t i = 0; i < n; i++) stereo[2 * i] = stereo[2 * i + 1] = mono[i];
+            pos += n;
+            dsp.filter(mono.data(), n, 1, false);
+            size_t k = dsp.resample(mono.data(), n, 1, out.data());
+            for(uint32_t i = 0; i < n; i++) ref.filter(&stereo[2 * i]);
+            size_t e = ref.resample(stereo.data(), n, expect.data());
+            CHECK_EQ(k, e);
+            for(size_t i = 0; i < 2 * k && i < 2 * e; i++) diffs += out[i] != expect[i];
+            frames += k;
+
+            int16_t* pcm = AudioDsp::toPcm16(out.data(), k, 1); // the cache file keeps mono
+            std::vector<audio_sample_t> again(expect.begin(), expect.begin() + 2 * e);
+            int16_t* pcm2 = AudioDsp::toPcm16(again.data(), e, 2);
+            for(size_t i = 0; i < k && i < e; i++) diffs += pcm[i] != pcm2[2 * i];
+        }
+        printf("%u bit, mono %5u Hz: %zu frames 48 kHz, %zu differences to the stereo path\n", (unsigned)sizeof(audio_sample_t) * 8,
+               (unsigned)rate, frames, diffs);
+        CHECK_EQ(diffs, 0);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDirect() { // direct PCM blocks: 16 bit read to the end of the block and widened in place
+    for(uint8_t ch = 1; ch <= 2; ch++) {
+        std::vector<int16_t>        pcm = noise(480, ch, 32767, 7 + ch);
+        std::vector<audio_sample_t> blk(480 * 2 + 1);
+        blk[480 * 2] = 0x5A5A;                                    // guard
+        for(uint32_t n : {480u, 300u}) {                          // a full block, a short read of 300 frames
+            int16_t* dst = AudioDsp::pcm16Tail(blk.data(), 480, ch);
+            memcpy(dst, pcm.data(), n * ch * 2);
+            AudioDsp::widenPcm16(blk.data(), dst, n, ch);
+            int bad = 0;
+            for(uint32_t i = 0; i < n; i++)
+                for(int c = 0; c < 2; c++) bad += blk[2 * i + c] != (audio_sample_t)(pcm[i * ch + (ch == 2 ? c : 0)] * (1 << AUDIO_SAMPLE_SHIFT));
+            CHECK_EQ(bad, 0);
+            CHECK_EQ(blk[480 * 2], 0x5A5A);
+            int16_t* back = AudioDsp::toPcm16(blk.data(), n, ch);   // the cache conversion is the inverse
+            CHECK(!memcmp(back, pcm.data(), n * ch * 2));
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+// the chain in double precision, no rounding in between: 16 bit LSB = 1
+static void model(const std::vector<int16_t>& in, const audioBiquad_t f[3], uint32_t rate, std::vector<double>& out) {
+    std::vector<double> x(in.begin(), in.end());
+    for(int n = 0; n < 3; n++) {
+        double z[4] = {0, 0, 0, 0};
+        for(double& s : x) {
+            double y = f[n].a0 * s + f[n].a1 * z[0] + f[n].a2 * z[1] - f[n].b1 * z[2] - f[n].b2 * z[3];
+            z[1] = z[0];
+            z[0] = s;
+            z[3] = z[2];
+            z[2] = y;
+            s = y;
+        }
+    }
+    float  ratio = 48000.0f / rate;
+    size_t n = (size_t)std::floor(x.size() * ratio);
+    out.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        float  pos = i / ratio;
+        size_t idx = (size_t)pos;
+        double frac = pos - idx, b = idx + 1 < x.size() ? x[idx + 1] : x[idx];
+        out[i] = x[idx] * (1 - frac) + b * frac;
+    }
+}
+
+static void testPrecision() {
+    const double scale = 1 << AUDIO_SAMPLE_SHIFT;
+    for(uint32_t rate : {48000u, 44100u, 22050u}) {
+        for(bool flat : {true, false}) {
+            AudioDsp      dsp;
+            audioBiquad_t f[3] = {{1, 0, 0, 0, 0}, {1, 0, 0, 0, 0}, {1, 0, 0, 0, 0}};
+            if(!flat) tone(f, rate);
+            dsp.setFilters(f);
+            dsp.setResampleRatio(48000.0f / rate);
+            std::vector<int16_t>        pcm = noise(4000, 1, 20000, rate + flat);
+            std::vector<audio_sample_t> buf = widen(pcm), out(4000 * 3 * 2);
+            dsp.filter(buf.data(), buf.size(), 1, false);
+            size_t              n = dsp.resample(buf.data(), buf.size(), 1, out.data());
+            std::vector<double> ref;
+            model(pcm, f, rate, ref);
+            CHECK_EQ(n, ref.size());
+            double maxErr = 0;
+            for(size_t i = 0; i < n && i < ref.size(); i++) maxErr = fmax(maxErr, fabs(out[2 * i] / scale - ref[i]));
+            printf("%u bit, %s %5u Hz: at most %.4f LSB (16 bit) from the double precision chain\n",
+                   (unsigned)sizeof(audio_sample_t) * 8, flat ? "flat" : "tone", (unsigned)rate, maxErr);
+            if(flat && rate == 48000) CHECK_EQ(maxErr, 0);       // nothing to compute: bit exact
+            else if(AUDIO_SAMPLE_32) CHECK(maxErr <= 1.0 / 4);  // the float filter memory
+            else CHECK(maxErr <= 5);                             // truncated after every stage
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testHeadroom() {
+#if AUDIO_SAMPLE_32
+    const int32_t fs = 0x7FFFFF;                                  // 24 bit full scale
+    AudioDsp      dsp;
+    audio_sample_t s[8] = {1 << 30, (1 << 30) + 256, -(1 << 30), -(1 << 30) - 256, 2 * fs, 2 * fs, -2 * fs, -2 * fs};
+    dsp.filter(s, 4, 2, true);                                    // forceMono of samples deep in the headroom (float exact)
+    CHECK_EQ(s[0], (1 << 30) + 128);
+    CHECK_EQ(s[1], (1 << 30) + 128);
+    CHECK_EQ(s[2], -(1 << 30) - 128);
+    CHECK_EQ(s[4], 2 * fs);
+    audio_sample_t c[8];
+    memcpy(c, s, sizeof(s));
+    int16_t* pcm = AudioDsp::toPcm16(c, 4, 2);                   // the cache saturates
+    CHECK_EQ(pcm[0], 32767);
+    CHECK_EQ(pcm[2], -32768);
+    CHECK_EQ(pcm[4], 32767);
+    CHECK_EQ(pcm[6], -32768);
+    GainRamp g;                                                   // unity: the final conversion saturates to 24 bit
+    g.process(s, 4);
+    CHECK_EQ(s[0], (int32_t)0x7FFFFF00);
+    CHECK_EQ(s[2], (int32_t)0x80000000);
+    CHECK_EQ(s[4], (int32_t)0x7FFFFF00);
+    CHECK_EQ(s[6], (int32_t)0x80000000);
+
+    // a +6 dB peak EQ on a full scale signal: the overshoot stays in the headroom and is not wrapped
+    audioBiquad_t f[3] = {{1, 0, 0, 0, 0}, {1, 0, 0, 0, 0}, {1, 0, 0, 0, 0}};
+    float         K = tanf(3.14159265f * 3000 / 48000), V = 2, Q = 2.5f, norm = 1 / (1 + 1 / Q * K + K * K);
+    f[1] = {(1 + V / Q * K + K * K) * norm, 2 * (K * K - 1) * norm, (1 - V / Q * K + K * K) * norm, 2 * (K * K - 1) * norm,
+            (1 - 1 / Q * K + K * K) * norm};
+    dsp.setFilters(f);
+    dsp.clearFilters();
+    std::vector<audio_sample_t> x(2000);
+    for(size_t i = 0; i < x.size(); i++) x[i] = (audio_sample_t)(fs * sin(2 * M_PI * 3000 * i / 48000));
+    dsp.filter(x.data(), x.size(), 1, false);
+    int32_t peak = 0;
+    for(size_t i = 500; i < x.size(); i++) peak = abs(x[i]) > peak ? abs(x[i]) : peak;
+    printf("32 bit, full scale 3 kHz sine through +6 dB: peak %.2f of full scale\n", (double)peak / fs);
+    CHECK(peak > 1.9 * fs && peak < 2.1 * fs);
+#endif
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testMono();
+    testDirect();
+    testPrecision();
+    testHeadroom();
+    return TEST_RESULT();
+}
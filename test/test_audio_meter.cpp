@@ -0,0 +1,209 @@
+/*
+ *  test_audio_meter.cpp
+ *
+ *  AudioMeter levels and bands on known signals, 16 and 24 bit input (also above full scale), and the sequence counter:
+ *  a writer thread publishes snapshots whose fields all derive from one value, reader threads must never see a mix of
+ *  two snapshots. The time per frame is compared with the per frame VU level of the former Audio::computeVUlevel().
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_meter/audio_meter.h"
+#include "check.h"
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+static std::vector<int16_t> sine(float hz, float amp, uint32_t frames) {
+    std::vector<int16_t> v(frames * 2);
+    for(uint32_t i = 0; i < frames; i++) v[2 * i] = v[2 * i + 1] = (int16_t)lrintf(amp * sinf(2 * 3.14159265f * hz * i / 48000));
+    return v;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testLevels() {
+    AudioMeter   m;
+    audioMeter_t r;
+    CHECK(m.read(&r));
+    CHECK_EQ(r.peak[0], 0);
+    CHECK_EQ(r.bands[0], 0);
+    uint32_t blocks = r.blocks;
+
+    std::vector<int16_t> s = sine(1000, 16384, AUDIO_METER_FRAMES);
+    m.process(s.data(), AUDIO_METER_FRAMES - 100);          // not a full block yet
+    CHECK(m.read(&r));
+    CHECK_EQ(r.blocks, blocks);
+    m.process(s.data() + 2 * (AUDIO_METER_FRAMES - 100), 100);
+    CHECK(m.read(&r));
+    CHECK_EQ(r.blocks, blocks + 1);
+    CHECK(r.peak[0] >= 16380 && r.peak[0] <= 16384);
+    CHECK(abs(r.rms[0] - 11585) < 20);                      // amp / sqrt(2)
+    int loudest = 0;
+    for(int b = 1; b < AUDIO_METER_BANDS; b++) if(r.bands[b] > r.bands[loudest]) loudest = b;
+    CHECK_EQ(loudest, 4);                                   // bins 16..31, 750 ... 1500 Hz
+    CHECK(r.bands[4] > 230);                                // -6 dBFS: 255 * (72 - 6) / 72 = 233
+    CHECK(r.bands[0] < r.bands[4] - 100);
+
+    std::vector<int32_t> s32(s.size());                     // the same signal with 24 bit samples
+    for(size_t i = 0; i < s.size(); i++) s32[i] = s[i] * 256;
+    audioMeter_t r32;
+    m.process(s32.data(), AUDIO_METER_FRAMES);
+    CHECK(m.read(&r32));
+    CHECK_EQ(r32.peak[0], r.peak[0]);
+    CHECK_EQ(r32.rms[0], r.rms[0]);
+    for(int b = 0; b < AUDIO_METER_BANDS; b++) CHECK_EQ(r32.bands[b], r.bands[b]);
+
+    std::vector<int32_t> hot(AUDIO_METER_FRAMES * 2);       // in the headroom before the gain: squares beyond 2^32
+    for(int i = 0; i < AUDIO_METER_FRAMES; i++) {hot[2 * i] = -60000 * 256; hot[2 * i + 1] = 70000 * 256;}
+    m.process(hot.data(), AUDIO_METER_FRAMES);
+    CHECK(m.read(&r32));
+    CHECK_EQ(r32.peak[0], 60000);
+    CHECK_EQ(r32.rms[0], 60000);
+    CHECK_EQ(r32.peak[1], 0xFFFF);                          // clamped
+    CHECK_EQ(r32.rms[1], 0xFFFF);
+
+    m.reset();                                              // silence
+    CHECK(m.read(&r));
+    CHECK_EQ(r.peak[0], 0);
+    CHECK_EQ(r.rms[1], 0);
+    CHECK_EQ(r.bands[4], 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+struct AudioMeterTest { // the writer side of the protocol, one step at a time
+    static void testSequence() {
+        AudioMeter   m;
+        audioMeter_t r;
+        uint32_t seq = m.m_seq.load();
+        CHECK_EQ(seq & 1, 0);
+        std::vector<int16_t> s = sine(1000, 1000, AUDIO_METER_FRAMES);
+        m.process(s.data(), AUDIO_METER_FRAMES);
+        CHECK_EQ(m.m_seq.load(), seq + 2);                 // one snapshot, even again
+        CHECK(m.read(&r));
+        m.m_seq.store(seq + 3);                             // the audio task is writing the next one
+        r.blocks = 12345;
+        CHECK(!m.read(&r));                                 // no copy while the counter is odd
+        CHECK_EQ(r.blocks, 12345);
+        m.m_seq.store(seq + 4);
+        CHECK(m.read(&r));
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+// the threads only race on a multicore host, on a single core the test above covers the protocol
+static void testSeqlock() {
+    AudioMeter        m;
+    std::atomic<bool> stop{false};
+    std::atomic<int>  torn{0}, failed{0}, reads{0};
+    // block k: left k, right k + 1 (DC), peak == rms exactly for k < 4096
+    std::thread writer([&] {
+        std::vector<int16_t> blk(AUDIO_METER_FRAMES * 2);
+        for(int round = 0; round < 3000; round++) {
+            int16_t k = 1 + round % 4000;
+            for(int i = 0; i < AUDIO_METER_FRAMES; i++) {blk[2 * i] = k; blk[2 * i + 1] = k + 1;}
+            m.process(blk.data(), AUDIO_METER_FRAMES);
+        }
+        stop = true;
+    });
+    auto reader = [&] {
+        uint32_t last = 0;
+        while(!stop) {
+            audioMeter_t r;
+            if(!m.read(&r)) {failed++; continue;}
+            reads++;
+            if(r.blocks < last) torn++;
+            last = r.blocks;
+            if(!r.peak[0]) continue;                       // the silence published by the constructor
+            if(r.peak[1] != r.peak[0] + 1 || r.rms[0] != r.peak[0] || r.rms[1] != r.peak[1]) torn++;
+        }
+    };
+    std::thread r1(reader), r2(reader);
+    writer.join();
+    r1.join();
+    r2.join();
+    printf("seqlock: %d reads, %d without a consistent copy after 8 tries\n", reads.load(), failed.load());
+    CHECK_EQ(torn, 0);
+    CHECK(reads > 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// Audio::computeVUlevel() as it was called for every output frame before AudioMeter, the reference of testTiming()
+static uint8_t s_vuLeft = 0, s_vuRight = 0;
+
+static void computeVUlevel(const int16_t sample[2]) {
+    static uint8_t sampleArray[2][4][8] = {0};
+    static uint8_t cnt0 = 0, cnt1 = 0, cnt2 = 0, cnt3 = 0, cnt4 = 0;
+    static bool    f_vu = false;
+
+    auto avg = [&](uint8_t* sampArr) {
+        uint16_t av = 0;
+        for(int i = 0; i < 8; i++) { av += sampArr[i]; }
+        return av >> 3;
+    };
+    auto largest = [&](uint8_t* sampArr) {
+        uint16_t maxValue = 0;
+        for(int i = 0; i < 8; i++) {
+            if(maxValue < sampArr[i]) maxValue = sampArr[i];
+        }
+        return maxValue;
+    };
+    if(cnt0 == 64) { cnt0 = 0; cnt1++; }
+    if(cnt1 == 8) { cnt1 = 0; cnt2++; }
+    if(cnt2 == 8) { cnt2 = 0; cnt3++; }
+    if(cnt3 == 8) { cnt3 = 0; cnt4++; f_vu = true; }
+    if(cnt4 == 8) { cnt4 = 0; }
+    if(!cnt0) {
+        sampleArray[0][0][cnt1] = abs(sample[0] >> 7);
+        sampleArray[1][0][cnt1] = abs(sample[1] >> 7);
+    }
+    if(!cnt1) {
+        sampleArray[0][1][cnt2] = largest(sampleArray[0][0]);
+        sampleArray[1][1][cnt2] = largest(sampleArray[1][0]);
+    }
+    if(!cnt2) {
+        sampleArray[0][2][cnt3] = largest(sampleArray[0][1]);
+        sampleArray[1][2][cnt3] = largest(sampleArray[1][1]);
+    }
+    if(!cnt3) {
+        sampleArray[0][3][cnt4] = avg(sampleArray[0][2]);
+        sampleArray[1][3][cnt4] = avg(sampleArray[1][2]);
+    }
+    if(f_vu) {
+        f_vu = false;
+        s_vuLeft = avg(sampleArray[0][3]);
+        s_vuRight = avg(sampleArray[1][3]);
+    }
+    cnt1++;
+}
+
+static double nowNs() { return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// 10s of 48kHz noise in chunks of 1152 frames (one MP3 frame), the best of 5 runs
+static void testTiming() {
+    const uint32_t       frames = 480000, chunk = 1152;
+    std::vector<int16_t> v(frames * 2);
+    uint32_t             rng = 1;
+    for(auto& s : v) s = (int16_t)((rng = rng * 1103515245u + 12345u) >> 16);
+    AudioMeter   m;
+    audioMeter_t snap;
+    double       tOld = 1e30, tNew = 1e30;
+    for(int run = 0; run < 5; run++) {
+        double t0 = nowNs();
+        for(uint32_t i = 0; i < frames; i++) computeVUlevel(&v[2 * i]);
+        double t1 = nowNs();
+        for(uint32_t i = 0; i < frames; i += chunk) m.process(&v[2 * i], frames - i < chunk ? frames - i : chunk);
+        double t2 = nowNs();
+        if(t1 - t0 < tOld) tOld = t1 - t0;
+        if(t2 - t1 < tNew) tNew = t2 - t1;
+    }
+    CHECK(m.read(&snap));
+    printf("ns per frame: computeVUlevel %.2f (VU %d %d), AudioMeter %.2f (peak, rms, 8 bands, rms L %d)\n", tOld / frames,
+           s_vuLeft, s_vuRight, tNew / frames, snap.rms[0]);
+    CHECK(tNew < tOld);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testLevels();
+    AudioMeterTest::testSequence();
+    testSeqlock();
+    testTiming();
+    return TEST_RESULT();
+}
@@ -0,0 +1,119 @@
+/*
+ *  test_audio_sched.cpp
+ *
+ *  AudioSched in a simulation of performAudioTask(): every millisecond the DMA may send a block, the audio task runs
+ *  when its wait is over unless the loop holds it off, one decoded frame fills one block.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_sched/audio_sched.h"
+#include "check.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+static void testBatch() {
+    AudioSched s;
+    s.begin(8, 0);
+    CHECK_EQ(s.target(), 8);
+    CHECK(!s.more(8, 0));
+    CHECK(s.more(7, 0));
+    CHECK(!s.more(7, 1));                    // one block missing: one frame
+    CHECK(s.more(0, 4));                     // empty: 1 + 8 / 2 frames
+    CHECK(!s.more(0, 5));
+    s.begin(40, 0);
+    CHECK(s.more(0, AUDIO_SCHED_MAX_BATCH - 1));
+    CHECK(!s.more(0, AUDIO_SCHED_MAX_BATCH)); // the mutex is not held longer than the batch
+    s.begin(8, 20);
+    CHECK_EQ(s.target(), 8);                 // limited to the capacity
+    s.begin(0, 0);
+    CHECK_EQ(s.target(), 1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testWait() {
+    AudioSched s;
+    s.begin(8, 6);
+    CHECK_EQ(s.waitMs(6, true, 5), 5);       // full: until the DMA has sent a block
+    CHECK_EQ(s.waitMs(6, true, 0), 1);
+    CHECK_EQ(s.waitMs(5, true, 5), 1);       // behind
+    CHECK_EQ(s.waitMs(6, false, 5), 1);      // no input, poll
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRaise() {
+    AudioSched s;
+    s.begin(8, 4);
+    s.observe(0, 2);                         // start of the stream, not counted
+    CHECK_EQ(s.minLevel(), 0xFF);
+    s.observe(2, 4);                         // filled
+    CHECK_EQ(s.minLevel(), 0xFF);
+    s.observe(3, 4);
+    s.observe(1, 3);                         // near underrun before the pass, the batch hides it
+    CHECK_EQ(s.target(), 5);
+    CHECK_EQ(s.raises(), 1);
+    CHECK_EQ(s.minLevel(), 1);
+    s.observe(0, 4);                         // refilling to the new target, not counted again
+    CHECK_EQ(s.target(), 5);
+    CHECK_EQ(s.raises(), 1);
+    for(int i = 0; i < 10; i++) {s.observe(4, 8); s.observe(1, 8);}
+    CHECK_EQ(s.target(), 8);                 // at most the capacity
+    s.restart();
+    CHECK_EQ(s.target(), 8);
+    s.begin(8, 4);                           // the configured target again
+    CHECK_EQ(s.target(), 4);
+    s.resetStats();
+    CHECK_EQ(s.raises(), 0);
+    CHECK_EQ(s.minLevel(), 0xFF);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// 'blockMs' per DMA block, the loop holds the task off for 'stallMs' every 'stallEvery' ms
+static void simulate(AudioSched* s, uint8_t capacity, uint32_t blockMs, uint32_t stallMs, uint32_t stallEvery, uint32_t* underruns, uint32_t* passes) {
+    uint8_t  level = 0;
+    uint32_t wakeAt = 0, sendAt = blockMs;
+    *underruns = 0;
+    *passes = 0;
+    for(uint32_t ms = 0; ms < 20000; ms++) {
+        if(ms == sendAt) {
+            if(level) level--;
+            else if(ms > 100) (*underruns)++;
+            sendAt += blockMs;
+            if(wakeAt > ms + 1) wakeAt = ms + 1;     // the 'on_sent' notification ends the wait
+        }
+        bool stalled = stallEvery && (ms % stallEvery) < stallMs;
+        if(ms >= wakeAt && !stalled) {
+            (*passes)++;
+            uint8_t before = level, done = 0;
+            while(level < capacity && s->more(level, done)) {level++; done++;}
+            s->observe(before, level);
+            wakeAt = ms + s->waitMs(level, true, blockMs);
+        }
+    }
+}
+
+static void testSimulation() {
+    AudioSched s;
+    uint32_t   underruns, passes;
+    s.begin(8, 0);
+    simulate(&s, 8, 5, 0, 0, &underruns, &passes);
+    CHECK_EQ(underruns, 0);
+    CHECK(passes < 20000 / 5 + 100);          // about one pass per block, not one per millisecond
+    CHECK_EQ(s.raises(), 0);
+
+    s.begin(8, 3);                            // small target, the loop stalls for 12 ms: the target grows
+    simulate(&s, 8, 5, 12, 200, &underruns, &passes);
+    CHECK(s.raises() > 0);
+    CHECK(s.target() > 3);
+    uint32_t first = underruns;
+    simulate(&s, 8, 5, 12, 200, &underruns, &passes); // with the raised target
+    CHECK(underruns < first || underruns == 0);
+
+    s.begin(8, 0);                            // the full pool covers the stall, one pass refills it
+    simulate(&s, 8, 5, 30, 200, &underruns, &passes);
+    CHECK_EQ(underruns, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testBatch();
+    testWait();
+    testRaise();
+    testSimulation();
+    return TEST_RESULT();
+}
@@ -0,0 +1,279 @@
+/*
+ *  test_direct_pcm.cpp
+ *
+ *  The direct PCM path of Audio (openDirectPCM(), directPCMFill()) against the decoder path a 48 kHz 16 bit WAV took
+ *  before (InBuff, readWaveHeader(), sendBytes(), playChunk() with the tone filters and the resampler), both built from
+ *  the modules of the library as Audio calls them, the I2S DMA takes every block at once. Both paths must give the same
+ *  48 kHz output (flat tone filters, ratio 1). Measured: the time to the first sample accepted by I2S with the read
+ *  times of an SD card (0.5 ms per command and 10 MB/s, as test_audio_buffer), and the CPU time per second of audio
+ *  without read times.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_buffer/audio_buffer.h"
+#include "audio_dsp/audio_dsp.h"
+#include "audio_meter/audio_meter.h"
+#include "output_stage/gain_ramp.h"
+#include "output_stage/output_stage.h"
+#include "check.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock clk;
+
+static void put16(std::vector<uint8_t>& d, uint16_t v) { d.push_back(v); d.push_back(v >> 8); }
+static void put32(std::vector<uint8_t>& d, uint32_t v) { put16(d, v); put16(d, v >> 16); }
+static uint32_t get32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static std::vector<uint8_t> makeWav(uint16_t channels, uint32_t frames) { // fmt, a LIST chunk, data
+    std::vector<uint8_t> d;
+    d.insert(d.end(), {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put32(d, 16);
+    put16(d, 1);
+    put16(d, channels);
+    put32(d, 48000);
+    put32(d, 48000 * 2 * channels);
+    put16(d, 2 * channels);
+    put16(d, 16);
+    d.insert(d.end(), {'L', 'I', 'S', 'T'});
+    put32(d, 27);                                       // odd, a pad byte follows
+    d.resize(d.size() + 28, 0);
+    d.insert(d.end(), {'d', 'a', 't', 'a'});
+    put32(d, frames * 2 * channels);
+    uint32_t rnd = 1;
+    for(uint32_t i = 0; i < frames * channels; i++) {
+        rnd = rnd * 1664525 + 1013904223;
+        put16(d, (int16_t)(12000 * sinf(i * 0.013f)) + (int16_t)(rnd >> 22) - 512);
+    }
+    return d;
+}
+//----------------------------------------------------------------------------------------------------------------------
+class SdFile { // a file on the SD card
+public:
+    SdFile(const std::vector<uint8_t>& d, bool sd) : m_d(d), m_sd(sd) {}
+    uint32_t size() { return m_d.size(); }
+    uint32_t position() { return m_pos; }
+    void     seek(uint32_t pos) { m_pos = pos; }
+    int32_t  read(uint8_t* buf, uint32_t len) {
+        if(m_sd) std::this_thread::sleep_for(std::chrono::microseconds(500 + len / 10));
+        len = min(len, size() - m_pos);
+        memcpy(buf, m_d.data() + m_pos, len);
+        m_pos += len;
+        return len;
+    }
+
+private:
+    const std::vector<uint8_t>& m_d;
+    bool                        m_sd;
+    uint32_t                    m_pos = 0;
+};
+
+class Sink { // the output stage and an I2S DMA that sends at once
+public:
+    Sink() { m_out.init(4, OutputStage::dmaFrames(0), 2); }
+    void feed() { // Audio::i2sFeed()
+        size_t   bytes = 0;
+        uint8_t* blk;
+        while((blk = m_out.front(&bytes)) != nullptr) {
+            if(!m_first.time_since_epoch().count()) m_first = clk::now();
+            for(size_t i = 0; i < bytes; i++) m_hash = (m_hash ^ blk[i]) * 16777619u;
+            m_out.consumed(bytes);
+            m_out.onDmaSent();
+        }
+    }
+    void put(const audio_sample_t* s, uint32_t frames) {
+        while(frames) {
+            uint16_t        room = 0;
+            audio_sample_t* blk = m_out.acquire(&room);
+            if(!blk) {feed(); continue;}
+            uint16_t n = min((uint32_t)room, frames);
+            memcpy(blk, s, n * 2 * sizeof(audio_sample_t));
+            m_out.produced(n);
+            s += n * 2;
+            frames -= n;
+        }
+        feed();
+    }
+    OutputStage     m_out;
+    clk::time_point m_first = {};
+    uint32_t        m_hash = 2166136261u;
+};
+
+struct run_t {
+    uint32_t ttfsUs;  // time to the first sample accepted by I2S
+    uint32_t totalUs;
+    uint32_t frames;  // 48 kHz frames
+    uint32_t hash;    // of the output
+};
+//----------------------------------------------------------------------------------------------------------------------
+static run_t directPath(SdFile& f) {
+    clk::time_point t0 = clk::now();
+    Sink       sink;
+    AudioMeter meter;
+    GainRamp   gain;
+    gain.set(0.7f, 0.7f, 0);
+    // openDirectPCM()
+    uint8_t  sec[512], h[24];
+    uint32_t dataStart = 0, dataSize = 0, pos = 12;
+    uint16_t channels = 0;
+    f.seek(0);
+    int32_t secLen = f.read(sec, sizeof(sec));
+    while(pos + 8 <= f.size()) {
+        if(pos + 24 <= (uint32_t)secLen) memcpy(h, sec + pos, 24);
+        else {
+            f.seek(pos);
+            if(f.read(h, 8) != 8) break;
+            if(!memcmp(h, "fmt ", 4) && f.read(h + 8, 16) != 16) break;
+        }
+        uint32_t len = get32(h + 4);
+        if(!memcmp(h, "fmt ", 4) && len >= 16) channels = h[10] | (h[11] << 8);
+        else if(!memcmp(h, "data", 4)) {
+            dataStart = pos + 8;
+            dataSize = min(len, f.size() - dataStart);
+            break;
+        }
+        pos += 8 + len + (len & 1);
+    }
+    f.seek(dataStart);
+    // directPCMFill()
+    uint32_t frameSize = 2 * channels, remain = dataSize, frames = 0;
+    while(remain >= frameSize) {
+        uint16_t        room = 0;
+        audio_sample_t* blk = sink.m_out.acquire(&room);
+        if(!blk) {sink.feed(); continue;}
+        uint32_t n = min((uint32_t)room, remain / frameSize);
+        int16_t* dst = AudioDsp::pcm16Tail(blk, n, channels);
+        f.read((uint8_t*)dst, n * frameSize);
+        remain -= n * frameSize;
+        AudioDsp::widenPcm16(blk, dst, n, channels);
+        meter.process(blk, n);
+        gain.process(blk, n);
+        sink.m_out.produced(n);
+        frames += n;
+        sink.feed();
+    }
+    sink.m_out.flush();
+    sink.feed();
+    clk::time_point t1 = clk::now();
+    return {(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(sink.m_first - t0).count(),
+            (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count(), frames, sink.m_hash};
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int32_t readFileToInBuff(AudioBuffer& b, SdFile& f) { // as Audio::readFileToInBuff()
+    const uint32_t sectorSize = 512;
+    const uint32_t maxRead = 32768;
+    const uint32_t minRead = 4096;
+    uint32_t space = b.writeSpace();
+    if(!space || f.position() >= f.size()) return 0;
+    uint32_t pos = f.position();
+    uint32_t len = min(space, maxRead);
+    bool     toBuffEnd = (b.getWritePos() + space >= (uint32_t)b.getBufsize());
+    bool     toFileEnd = (pos + len >= f.size());
+    if(!toBuffEnd && !toFileEnd) {
+        if(len < minRead) return 0;
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    else if(!toFileEnd && len > sectorSize) {
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    int32_t bytesRead = f.read(b.getWritePtr(), len);
+    if(bytesRead > 0) b.bytesWritten(bytesRead);
+    return bytesRead;
+}
+
+static run_t decoderPath(SdFile& f) {
+    static AudioBuffer in;                              // allocated once, as InBuff
+    if(!in.isInitialized()) in.init();
+    in.resetBuffer();
+    clk::time_point t0 = clk::now();
+    Sink       sink;
+    AudioMeter meter;
+    GainRamp   gain;
+    AudioDsp   dsp;                                     // flat tone filters
+    gain.set(0.7f, 0.7f, 0);
+    dsp.setResampleRatio(1.0f);
+    in.changeMaxBlockSize(4096);                        // m_frameSizeWav
+    std::vector<audio_sample_t> outBuff(4096), buff48(4096 + 4);
+    f.seek(0);
+    uint16_t channels = 0;
+    uint32_t remain = 0, frames = 0;
+    bool     header = false;
+    while(true) {
+        readFileToInBuff(in, f);                        // processLocalFile()
+        bool allIn = f.position() >= f.size();
+        if(!header) {                                   // readWaveHeader(), the header lies in the first read
+            const uint8_t* h = in.getReadPtr();
+            uint32_t       pos = 12;
+            while(pos + 8 <= in.bufferFilled()) {
+                uint32_t len = get32(h + pos + 4);
+                if(!memcmp(h + pos, "fmt ", 4)) channels = h[pos + 10] | (h[pos + 11] << 8);
+                if(!memcmp(h + pos, "data", 4)) {remain = len; pos += 8; break;}
+                pos += 8 + len + (len & 1);
+            }
+            in.bytesWasRead(pos);
+            header = true;
+        }
+        uint32_t frameSize = 2 * channels;
+        int32_t  n = min(in.bufferFilled(), (size_t)in.getMaxBlockSize());
+        n = min((uint32_t)n, remain);
+        n -= n % frameSize;
+        if(!n && allIn) break;
+        if(n < (int32_t)in.getMaxBlockSize() && !allIn) continue;
+        memmove(outBuff.data(), in.getReadPtr(), n);    // sendBytes()
+        in.bytesWasRead(n);
+        remain -= n;
+        uint32_t validSamples = n / frameSize;
+        dsp.filter(outBuff.data(), validSamples, channels, false); // playChunk()
+        uint32_t n48 = dsp.resample(outBuff.data(), validSamples, channels, buff48.data());
+        meter.process(buff48.data(), n48);
+        gain.process(buff48.data(), n48);
+        sink.put(buff48.data(), n48);
+        frames += n48;
+    }
+    sink.m_out.flush();
+    sink.feed();
+    clk::time_point t1 = clk::now();
+    return {(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(sink.m_first - t0).count(),
+            (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count(), frames, sink.m_hash};
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testPaths() {
+    for(uint16_t ch = 1; ch <= 2; ch++) {
+        std::vector<uint8_t> wav = makeWav(ch, 48000 * 10); // 10 s
+        std::vector<uint8_t> fx = makeWav(ch, 48000 / 2);   // an effect of 0.5 s
+        run_t    best[2][2];                            // [decoder, direct][cpu, sd]
+        for(int p = 0; p < 2; p++) {
+            for(int i = 0; i < 5; i++) {
+                SdFile cpu(wav, false), sd(fx, true);
+                run_t  r[2] = {p ? directPath(cpu) : decoderPath(cpu), p ? directPath(sd) : decoderPath(sd)};
+                for(int k = 0; k < 2; k++) {
+                    if(!i || r[k].totalUs < best[p][k].totalUs) best[p][k].totalUs = r[k].totalUs;
+                    if(!i || r[k].ttfsUs < best[p][k].ttfsUs) best[p][k].ttfsUs = r[k].ttfsUs;
+                    best[p][k].frames = r[k].frames;
+                    best[p][k].hash = r[k].hash;
+                }
+            }
+        }
+        for(int p = 0; p < 2; p++) {
+            printf("%s, %s: first sample %u us from the SD card, CPU %u us per second of audio\n",
+                   p ? "direct PCM" : "decoder path", ch == 1 ? "mono" : "stereo", best[p][1].ttfsUs, best[p][0].totalUs / 10);
+        }
+        for(int k = 0; k < 2; k++) {
+            CHECK_EQ(best[0][k].frames, best[1][k].frames);
+            CHECK_EQ(best[0][k].hash, best[1][k].hash); // the same output
+        }
+        CHECK_EQ(best[1][0].frames, 48000 * 10);
+        CHECK(best[1][1].ttfsUs < best[0][1].ttfsUs);
+        CHECK(best[1][0].totalUs < best[0][0].totalUs);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testPaths();
+    return TEST_RESULT();
+}
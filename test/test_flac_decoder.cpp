@@ -0,0 +1,431 @@
+/*
+ *  test_flac_decoder.cpp
+ *
+ *  The FLAC decoder against the PCM of flac_encoder.h: 16 and 24 bit, mono and stereo, 16 and 32 bit output, LPC up
+ *  to order 32, STREAMINFO MD5. Two instances decoding interleaved must not see each other, the dual core mode (worker
+ *  task decodes the next frame) must give the same samples as the single core mode, and the worker must stay within
+ *  its stack. Bit flips with the CRC check: the damaged frames are replaced by silence or by the previous frame. The
+ *  cost of the CRC check is timed against the decode time of 16 and 24 bit streams. The fixed and LPC kernels of each
+ *  order are timed against one generic prediction loop, readRicePartition() against the byte wise bit reader with the
+ *  unary prefix read bit by bit.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "flac_decoder/flac_decoder.h"
+#include "flac_encoder.h"
+#include "check.h"
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+struct FlacStream {
+    std::vector<uint8_t> data; // frames followed by 64 zero bytes, as the input buffer of Audio.cpp after the last read
+    std::vector<int32_t> pcm;
+    uint8_t              md5[16];
+    uint8_t              nch, bps;
+};
+
+static FlacStream makeStream(FlacEncoder& enc, uint8_t nch, uint32_t frames, uint32_t seed) {
+    FlacStream s;
+    s.nch = nch;
+    s.bps = enc.bps;
+    s.data = enc.makeStream(nch, frames, seed, &s.pcm);
+    s.data.resize(s.data.size() + 64, 0);
+    FlacEncoder::md5(s.pcm, s.bps, s.md5);
+    return s;
+}
+
+// the loop of Audio.cpp for one instance, step() is one FLACDecode() call
+struct FlacRun {
+    FLACDecoder_t*       d;
+    const FlacStream*    s;
+    bool                 out32;
+    int32_t              pos = 0;
+    int32_t              errors = 0;
+    uint32_t             corrupt = 0;
+    std::vector<int32_t> pcm;
+    std::vector<int16_t> out16 = std::vector<int16_t>(8192 * 2);
+    std::vector<int32_t> out32buf = std::vector<int32_t>(8192 * 2);
+
+    FlacRun(FLACDecoder_t* dec, const FlacStream* stream, bool o32) : d(dec), s(stream), out32(o32) {
+        FLACDecoderReset(d);
+        setParams();
+        FLACDecoder_StartMD5(d, s->md5);
+    }
+    void setParams() { FLACSetRawBlockParams(d, s->nch, 44100, s->bps, s->pcm.size() / s->nch, 0); }
+    int32_t total() const { return s->data.size() - 64; }
+    bool done() const { return pos >= total(); }
+
+    void step() {
+        int32_t len = total() - pos;
+        if(len > 40000) len = 40000;
+        int32_t left = len;
+        uint8_t* in = (uint8_t*)s->data.data() + pos;
+        int8_t ret = out32 ? FLACDecode32(d, in, &left, out32buf.data()) : FLACDecode(d, in, &left, out16.data());
+        if(ret < 0) { // as Audio.cpp: find the next frame
+            errors++;
+            int32_t o = FLACFindSyncWord(d, in + 1, total() - pos - 1);
+            if(o < 0) {pos = total(); return;}
+            pos += o + 1;
+            corrupt += FLACDecoder_CorruptFrames(d);
+            setParams();
+            return;
+        }
+        uint32_t n = FLACGetOutputSamps(d);
+        for(uint32_t i = 0; i < n; i++) pcm.push_back(out32 ? out32buf[i] : out16[i]);
+        pos += len - left;
+    }
+    void finish() {
+        while(!done()) step();
+        corrupt += FLACDecoder_CorruptFrames(d);
+    }
+    // the reference as the decoder outputs it: 16 bit as it is or from 24 bit >> 8, 32 bit: 24 bit, 16 bit << 8
+    size_t mismatches() const {
+        size_t m = pcm.size() == s->pcm.size() ? 0 : 1;
+        for(size_t i = 0; i < pcm.size() && i < s->pcm.size(); i++) {
+            int32_t e = s->pcm[i];
+            if(out32 && s->bps == 16) e *= 256;
+            if(!out32 && s->bps == 24) e >>= 8;
+            if(e != pcm[i]) m++;
+        }
+        return m;
+    }
+};
+//----------------------------------------------------------------------------------------------------------------------
+static void testGolden() {
+    FLACDecoder_t* d = FLACDecoder_New();
+    CHECK(d != NULL);
+    FlacEncoder enc;
+    for(uint8_t nch = 1; nch <= 2; nch++) {
+        for(int out32 = 0; out32 < 2; out32++) {
+            FlacStream s = makeStream(enc, nch, 40, 10 + nch);
+            FlacRun r(d, &s, out32);
+            r.finish();
+            CHECK_EQ(r.errors, 0);
+            CHECK_EQ(r.mismatches(), 0);
+            CHECK_EQ(FLACDecoder_MD5Result(d), FLAC_MD5_OK);
+        }
+    }
+    enc.bps = 24;
+    enc.lpcMaxOrder = 32;
+    FlacStream s = makeStream(enc, 2, 40, 3);
+    for(int out32 = 0; out32 < 2; out32++) {
+        FlacRun r(d, &s, out32);
+        r.finish();
+        CHECK_EQ(r.errors, 0);
+        CHECK_EQ(r.mismatches(), 0);
+        CHECK_EQ(FLACDecoder_MD5Result(d), FLAC_MD5_OK);
+        CHECK_EQ(FLACGetBitsPerSample(d), 24);
+    }
+    FLACDecoder_Delete(d);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testTwoInstances() { // 16 bit mono and 24 bit stereo, one call each in turn
+    FlacEncoder enc;
+    FlacStream  a = makeStream(enc, 1, 30, 21);
+    enc.bps = 24;
+    FlacStream b = makeStream(enc, 2, 30, 22);
+    FLACDecoder_t* d1 = FLACDecoder_New();
+    FLACDecoder_t* d2 = FLACDecoder_New();
+    FlacRun r1(d1, &a, false), r2(d2, &b, true);
+    while(!r1.done() || !r2.done()) {
+        if(!r1.done()) r1.step();
+        if(!r2.done()) r2.step();
+    }
+    CHECK_EQ(r1.errors + r2.errors, 0);
+    CHECK_EQ(r1.mismatches(), 0);
+    CHECK_EQ(r2.mismatches(), 0);
+    CHECK_EQ(FLACGetChannels(d1), 1);
+    CHECK_EQ(FLACGetChannels(d2), 2);
+    CHECK_EQ(FLACDecoder_MD5Result(d1), FLAC_MD5_OK);
+    CHECK_EQ(FLACDecoder_MD5Result(d2), FLAC_MD5_OK);
+    FLACDecoder_Delete(d1);
+    FLACDecoder_Delete(d2);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDualCore() { // bit exact to the single core mode, with and without the CRC check
+    FlacEncoder enc;
+    enc.lpcMaxOrder = 32;
+    for(int bps = 16; bps <= 24; bps += 8) {
+        enc.bps = bps;
+        FlacStream s = makeStream(enc, 2, 60, 30 + bps);
+        for(int crc = 0; crc < 2; crc++) {
+            FLACDecoder_t* single = FLACDecoder_New();
+            FLACDecoder_t* dual = FLACDecoder_New();
+            FLACDecoder_SetCrcCheck(single, crc);
+            FLACDecoder_SetCrcCheck(dual, crc);
+            FLACDecoder_SetDualCore(dual, 1, 2);
+            CHECK(dual->worker != NULL);
+            FlacRun r1(single, &s, true), r2(dual, &s, true);
+            r1.finish();
+            r2.finish();
+            CHECK_EQ(r2.errors, 0);
+            CHECK(r1.pcm == r2.pcm);
+            CHECK_EQ(r2.mismatches(), 0);
+            CHECK_EQ(FLACDecoder_MD5Result(dual), FLAC_MD5_OK);
+            uint32_t free = FLACDecoder_WorkerStackFree(dual); // the host ABI takes more stack than the ESP32
+            printf("flac worker, %d bit, crc %d: %u of %u bytes stack not used\n", bps, crc, free, FLAC_WORKER_STACK);
+            CHECK(free >= FLAC_WORKER_STACK_MARGIN);
+            FLACDecoder_Delete(single);
+            FLACDecoder_Delete(dual);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+// one bit in each of some frames is flipped (header or subframes), with the CRC check these frames are concealed, all
+// others must come out exactly, the stream keeps its length and the MD5 tells that it was damaged
+static void testBitFlips() {
+    FlacEncoder enc;
+    enc.fixedBlocksize = true;                          // a repeated frame has the length of the lost one
+    for(int repeat = 0; repeat < 2; repeat++) {
+        for(int dual = 0; dual < 2; dual++) {
+            FlacStream s = makeStream(enc, 2, 40, 51);
+            std::vector<bool> hit(40, false);
+            uint32_t rng = 7 + repeat + 2 * dual;
+            for(int f = 3; f < 40; f += 5) {            // never the first frame, the reference for the headers
+                rng = rng * 1103515245u + 12345u;
+                uint32_t len = enc.frameOffsets[f + 1 < 40 ? f + 1 : f] - enc.frameOffsets[f];
+                if(f == 39) len = s.data.size() - 64 - enc.frameOffsets[f];
+                uint32_t at = (f % 10 == 3) ? 2 : 8 + (rng >> 8) % (len - 10); // block size / rate byte or the subframes
+                s.data[enc.frameOffsets[f] + at] ^= 1 << ((rng >> 4) & 7);
+                hit[f] = true;
+            }
+            FLACDecoder_t* d = FLACDecoder_New();
+            FLACDecoder_SetCrcCheck(d, true);
+            FLACDecoder_SetConcealment(d, repeat ? FLAC_CONCEAL_REPEAT : FLAC_CONCEAL_SILENCE);
+            if(dual) FLACDecoder_SetDualCore(d, 1, 2);
+            FlacRun r(d, &s, true);
+            r.finish();
+            CHECK_EQ(r.errors, 0);
+            CHECK_EQ(r.corrupt, 8);
+            CHECK_EQ(r.pcm.size(), s.pcm.size());
+            CHECK_EQ(FLACDecoder_MD5Result(d), FLAC_MD5_WRONG);
+            size_t bad = 0;
+            for(int f = 0; f < 40 && r.pcm.size() == s.pcm.size(); f++) {
+                size_t from = (size_t)f * 4096 * 2;
+                for(size_t i = from; i < from + 4096 * 2; i++) {
+                    int32_t e = s.pcm[i] * 256;                                // 16 bit in 32
+                    if(hit[f]) e = repeat ? s.pcm[i - 4096 * 2] * 256 : 0;     // the previous frame or silence
+                    if(r.pcm[i] != e) bad++;
+                }
+            }
+            CHECK_EQ(bad, 0);
+            FLACDecoder_Delete(d);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testLegacyInstance() { // the functions without instance argument of Audio.cpp
+    FlacEncoder enc;
+    FlacStream  s = makeStream(enc, 2, 10, 41);
+    CHECK(FLACDecoder_AllocateBuffers());
+    FLACDecoderReset();
+    FLACSetRawBlockParams(s.nch, 44100, s.bps, s.pcm.size() / s.nch, 0);
+    std::vector<int32_t> pcm;
+    int16_t              out[8192 * 2];
+    int32_t              pos = 0, total = s.data.size() - 64;
+    while(pos < total) {
+        int32_t left = total - pos;
+        int32_t len = left;
+        CHECK(FLACDecode(s.data.data() + pos, &left, out) >= 0);
+        uint32_t n = FLACGetOutputSamps();                  // once, it clears the count
+        for(uint32_t i = 0; i < n; i++) pcm.push_back(out[i]);
+        pos += len - left;
+    }
+    CHECK(pcm == s.pcm);
+    CHECK_EQ(FLACGetSampRate(), 44100);
+    FLACDecoder_FreeBuffers();
+    CHECK_EQ(FLACGetChannels(), 0);
+    CHECK_EQ(FLACDecoder_CorruptFrames(), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static double decodeNs(FLACDecoder_t* d, const FlacStream& s, bool crc) { // the whole stream, nothing kept
+    static int32_t out[8192 * 2];
+    FLACDecoderReset(d);
+    FLACSetRawBlockParams(d, s.nch, 44100, s.bps, s.pcm.size() / s.nch, 0);
+    FLACDecoder_SetCrcCheck(d, crc);
+    int32_t pos = 0, total = s.data.size() - 64;
+    auto    t0 = std::chrono::steady_clock::now();
+    while(pos < total) {
+        int32_t len = total - pos < 40000 ? total - pos : 40000;
+        int32_t left = len;
+        if(FLACDecode32(d, (uint8_t*)s.data.data() + pos, &left, out) < 0) return 0;
+        pos += len - left;
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void testCrcCost() { // the CRC-8 and CRC-16 of every frame against the decode time, the best of 31 runs
+    FlacEncoder    enc;
+    FLACDecoder_t* d = FLACDecoder_New();
+    for(uint8_t bps = 16; bps <= 24; bps += 8) {
+        enc.bps = bps;
+        FlacStream s = makeStream(enc, 2, 200, 51);
+        double     t[2] = {1e30, 1e30};
+        for(int run = 0; run < 31; run++) {
+            for(int crc = 0; crc < 2; crc++) {
+                double ns = decodeNs(d, s, crc);
+                CHECK(ns > 0);
+                if(ns < t[crc]) t[crc] = ns;
+            }
+        }
+        double bytesPerSample = (double)(s.data.size() - 64) / s.pcm.size();
+        printf("CRC check, %d bit stereo (%.2f bytes per sample): decode %.2f ns per sample, CRC +%.2f%%\n", bps,
+               bytesPerSample, t[0] / s.pcm.size(), (t[1] / t[0] - 1) * 100);
+        CHECK(t[1] < t[0] * 1.20); // +5...15% for 24 bit on a loaded host, slice-by-8 was above
+    }
+    FLACDecoder_Delete(d);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// the prediction loop before the kernels of each order: one loop for all orders, the fixed orders with their coefficients
+template <typename ACC>
+static void lpcGeneric(int32_t* x, int32_t n, const int32_t* coefs, uint8_t order, int32_t shift) {
+    for(int32_t i = order; i < n; i++) {
+        ACC sum = 0;
+        for(int32_t j = 0; j < order; j++) sum += (ACC)x[i - 1 - j] * coefs[j];
+        x[i] += (int32_t)(sum >> shift);
+    }
+}
+
+static void testKernels() { // every order against the generic loop: bit exact and the time, 16 blocks of 4096, best of 20
+    const int32_t        n = 4096, blocks = 16;
+    std::vector<int32_t> res(n * blocks), x(n * blocks), y(n * blocks);
+    uint32_t             rnd = 7;
+    for(int32_t i = 0; i < n * blocks; i++) {
+        rnd = rnd * 1664525 + 1013904223;
+        res[i] = (int32_t)(rnd >> 20) - 2048;   // residuals of 12 bit, the warm-up samples too
+    }
+    auto timeNs = [&](std::vector<int32_t>& v, auto kernel) {
+        double best = 1e30;
+        for(int run = 0; run < 20; run++) {
+            v = res;
+            auto t0 = std::chrono::steady_clock::now();
+            for(int32_t b = 0; b < blocks; b++) kernel(v.data() + b * n);
+            best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+        }
+        return best / (n * blocks);
+    };
+    static const int32_t fixedCoefs[5][4] = {{0}, {1}, {2, -1}, {3, -3, 1}, {4, -6, 4, -1}};
+    double total[2] = {0, 0};
+    bool   exact = true;
+    printf("prediction, ns per sample: generic / kernel\n");
+    for(uint8_t order = 1; order <= 4; order++) {
+        double g = timeNs(x, [&](int32_t* p) { lpcGeneric<int32_t>(p, n, fixedCoefs[order], order, 0); });
+        double k = timeNs(y, [&](int32_t* p) { restoreFixedPrediction(p, n, order); });
+        exact &= x == y;
+        total[0] += g;
+        total[1] += k;
+        printf("  fixed %u: %.2f / %.2f\n", order, g, k);
+    }
+    for(uint8_t order = 1; order <= 32; order++) {
+        int32_t coefs[32], shift = 14;
+        for(int j = 0; j < order; j++) { // a stable predictor: the sum of |coefs| below 1 << shift
+            rnd = rnd * 1664525 + 1013904223;
+            coefs[j] = (int32_t)(rnd >> 16) % ((1 << shift) / (2 * order));
+        }
+        double t[2][2];
+        for(int acc64 = 0; acc64 < 2; acc64++) {
+            t[acc64][0] = timeNs(x, [&](int32_t* p) {
+                if(acc64) lpcGeneric<int64_t>(p, n, coefs, order, shift);
+                else lpcGeneric<int32_t>(p, n, coefs, order, shift);
+            });
+            t[acc64][1] = timeNs(y, [&](int32_t* p) { restoreLinearPrediction(p, n, coefs, order, shift, acc64); });
+            exact &= x == y;
+            total[0] += t[acc64][0];
+            total[1] += t[acc64][1];
+        }
+        printf("  LPC %2u: 32 bit %.2f / %.2f, 64 bit %.2f / %.2f\n", order, t[0][0], t[0][1], t[1][0], t[1][1]);
+    }
+    printf("  all orders: %.1f / %.1f\n", total[0], total[1]);
+    CHECK(exact);
+    CHECK(total[1] < total[0]);
+}
+//----------------------------------------------------------------------------------------------------------------------
+struct ByteReader { // the bit reader before the 64 bit one: a byte per refill, the unary prefix bit by bit
+    const uint8_t* p;
+    uint64_t       buf = 0;
+    uint8_t        len = 0;
+    uint32_t readUint(uint8_t nBits, int32_t* bytesLeft) {
+        while(len < nBits) {
+            uint8_t temp = *p++;
+            (*bytesLeft)--;
+            if(*bytesLeft < 0) break;
+            buf = (buf << 8) | temp;
+            len += 8;
+        }
+        len -= nBits;
+        uint32_t result = buf >> len;
+        if(nBits < 32) result &= (1u << nBits) - 1;
+        return result;
+    }
+    int64_t readRiceSignedInt(uint8_t param, int32_t* bytesLeft) {
+        long val = 0;
+        while(readUint(1, bytesLeft) == 0) val++;
+        val = (val << param) | readUint(param, bytesLeft);
+        return (val >> 1) ^ -(val & 1);
+    }
+};
+
+static void testRice() { // 16 partitions of 4096 residuals per Rice parameter, both readers, best of 20
+    const int32_t n = 4096, parts = 16;
+    uint32_t      rnd = 3;
+    double        total[2] = {0, 0};
+    bool          exact = true;
+    printf("Rice partitions, ns per residual: byte wise / 64 bit\n");
+    for(uint8_t param = 0; param <= 16; param += 2) {
+        std::vector<int32_t> res(n * parts), out(n * parts);
+        std::vector<uint8_t> data;
+        uint32_t             bits = 0;
+        auto put = [&](uint32_t v, int k) {
+            for(int i = k - 1; i >= 0; i--, bits++) {
+                if(bits % 8 == 0) data.push_back(0);
+                if((v >> i) & 1) data.back() |= 0x80 >> (bits % 8);
+            }
+        };
+        for(int32_t i = 0; i < n * parts; i++) { // Laplacian residuals, the mean fits the parameter
+            rnd = rnd * 1664525 + 1013904223;
+            uint32_t u = (uint32_t)(-log(((rnd >> 8) + 1) / 16777217.0) * (1 << param) * 0.7);
+            res[i] = (u & 1) ? -(int32_t)(u >> 1) - 1 : (int32_t)(u >> 1);
+            for(uint32_t q = u >> param; q; q--) put(0, 1);
+            put(1, 1);
+            put(u, param);
+        }
+        double bitsPerResidual = (double)bits / (n * parts);
+        data.resize(data.size() + 8, 0); // the stream goes on behind the partitions
+        double t[2] = {1e30, 1e30};
+        for(int run = 0; run < 20; run++) {
+            ByteReader r = {data.data()};
+            int32_t    left = data.size();
+            auto       t0 = std::chrono::steady_clock::now();
+            for(int32_t i = 0; i < n * parts; i++) out[i] = r.readRiceSignedInt(param, &left);
+            t[0] = std::min(t[0], std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+            exact &= out == res;
+            FLACFrameDecoder_t fd = {};
+            fd.inptr = data.data();
+            fd.quiet = true;
+            left = data.size();
+            t0 = std::chrono::steady_clock::now();
+            for(int32_t k = 0; k < parts; k++) exact &= readRicePartition(&fd, out.data() + k * n, n, param, &left) == 0;
+            t[1] = std::min(t[1], std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+            exact &= out == res;
+        }
+        total[0] += t[0];
+        total[1] += t[1];
+        printf("  parameter %2u (%.1f bits): %.2f / %.2f\n", param, bitsPerResidual, t[0] / (n * parts), t[1] / (n * parts));
+    }
+    CHECK(exact);
+    CHECK(total[1] < total[0]);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testGolden();
+    testTwoInstances();
+    testDualCore();
+    testBitFlips();
+    testLegacyInstance();
+    testCrcCost();
+    testKernels();
+    testRice();
+    return TEST_RESULT();
+}
@@ -0,0 +1,137 @@
+/*
+ *  test_flac_verify.cpp
+ *
+ *  The idle time check of whole FLAC files: a file of "fLaC", STREAMINFO with the MD5, a large block to skip (as a
+ *  picture) and the frames of flac_encoder.h is fed in chunks as AudioCache reads it. A good file is OK, without MD5 it
+ *  is NO_MD5, bit flips, a wrong MD5 and a truncated file are WRONG, a file that is no FLAC is ERROR.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "flac_verify/flac_verify.h"
+#include "flac_encoder.h"
+#include "check.h"
+#include <string.h>
+
+struct FlacFile {
+    std::vector<uint8_t>  data;
+    std::vector<uint32_t> frameOffsets; // in data
+    uint64_t              samples;      // per channel
+};
+
+static void putBE(std::vector<uint8_t>& v, uint32_t x, int bytes) {
+    for(int i = bytes - 1; i >= 0; i--) v.push_back(x >> (8 * i));
+}
+
+static FlacFile makeFile(uint8_t nch, uint8_t bps, uint32_t frames, bool withMD5, uint32_t id3 = 0) {
+    FlacEncoder enc;
+    enc.bps = bps;
+    std::vector<int32_t> pcm;
+    std::vector<uint8_t> raw = enc.makeStream(nch, frames, 60 + nch, &pcm);
+    uint8_t md5[16] = {0};
+    if(withMD5) FlacEncoder::md5(pcm, bps, md5);
+    FlacFile f;
+    f.samples = pcm.size() / nch;
+    if(id3) { // ID3v2 header, the size syncsafe
+        for(char c : {'I', 'D', '3', '\x04', '\x00', '\x00'}) f.data.push_back(c);
+        for(int i = 3; i >= 0; i--) f.data.push_back((id3 >> (7 * i)) & 0x7F);
+        f.data.resize(f.data.size() + id3, 0);
+    }
+    for(char c : {'f', 'L', 'a', 'C'}) f.data.push_back(c);
+    f.data.push_back(0);                              // STREAMINFO, not the last block
+    putBE(f.data, 34, 3);
+    putBE(f.data, 1000, 2);                           // min, max block size
+    putBE(f.data, 4096, 2);
+    putBE(f.data, 0, 3);                              // min, max frame size unknown
+    putBE(f.data, 0, 3);
+    putBE(f.data, 44100 << 12 | (nch - 1) << 9 | (bps - 1) << 4 | (uint32_t)(f.samples >> 32), 4);
+    putBE(f.data, (uint32_t)f.samples, 4);
+    f.data.insert(f.data.end(), md5, md5 + 16);
+    f.data.push_back(0x80 | 6);                       // PICTURE, the last block, larger than the input buffer
+    putBE(f.data, 50000, 3);
+    for(uint32_t i = 0; i < 50000; i++) f.data.push_back(i * 7);
+    uint32_t start = f.data.size();
+    for(uint32_t o : enc.frameOffsets) f.frameOffsets.push_back(start + o);
+    f.data.insert(f.data.end(), raw.begin(), raw.end());
+    return f;
+}
+
+// the loop of AudioCache: read up to 16 KB into space(), step()
+static int8_t verify(FlacVerify& v, const std::vector<uint8_t>& data, uint64_t* samples = nullptr) {
+    CHECK(v.begin());
+    size_t pos = 0;
+    int8_t r = FLAC_VERIFY_RUNNING;
+    while(r == FLAC_VERIFY_RUNNING) {
+        size_t   len;
+        uint8_t* p = v.space(&len);
+        if(len > 16384) len = 16384;
+        if(len > data.size() - pos) len = data.size() - pos;
+        memcpy(p, data.data() + pos, len);
+        pos += len;
+        r = v.step(len, pos == data.size());
+    }
+    CHECK(!v.isRunning());
+    if(samples) *samples = v.samples();
+    return r;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testGood() {
+    FlacVerify v;
+    for(uint8_t nch = 1; nch <= 2; nch++) {
+        for(uint8_t bps = 16; bps <= 24; bps += 8) {
+            FlacFile f = makeFile(nch, bps, 25, true);
+            uint64_t n;
+            CHECK_EQ(verify(v, f.data, &n), FLAC_VERIFY_OK);
+            CHECK_EQ(n, f.samples);
+            CHECK_EQ(v.corruptFrames(), 0);
+        }
+    }
+    FlacFile f = makeFile(2, 16, 10, true, 3000);     // behind an ID3v2 tag
+    CHECK_EQ(verify(v, f.data), FLAC_VERIFY_OK);
+    f = makeFile(2, 16, 10, false);                   // the encoder wrote no MD5
+    CHECK_EQ(verify(v, f.data), FLAC_VERIFY_NO_MD5);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDamaged() {
+    FlacVerify v;
+    FlacFile   f = makeFile(2, 16, 25, true);
+    for(int k = 1; k < 25; k += 6) { // a bit in a frame, the CRC finds it
+        std::vector<uint8_t> d = f.data;
+        uint32_t o = f.frameOffsets[k] + (f.frameOffsets[k + 1] - f.frameOffsets[k]) / 2;
+        d[o] ^= 0x10;
+        CHECK_EQ(verify(v, d), FLAC_VERIFY_WRONG);
+        CHECK(v.corruptFrames() > 0);
+    }
+    std::vector<uint8_t> d = f.data;
+    d[8 + 18] ^= 1;                  // the MD5 in STREAMINFO
+    CHECK_EQ(verify(v, d), FLAC_VERIFY_WRONG);
+    CHECK_EQ(v.corruptFrames(), 0);
+    d = f.data;
+    d.resize(f.frameOffsets[20]);    // frames missing
+    CHECK_EQ(verify(v, d), FLAC_VERIFY_WRONG);
+    d = f.data;
+    memcpy(d.data(), "OggS", 4);
+    CHECK_EQ(verify(v, d), FLAC_VERIFY_ERROR);
+    d.assign(f.data.begin(), f.data.begin() + 20); // ends in the metadata
+    CHECK_EQ(verify(v, d), FLAC_VERIFY_ERROR);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testAbort() { // end() in the middle, the next file starts clean
+    FlacVerify v;
+    FlacFile   f = makeFile(1, 16, 10, true);
+    CHECK(v.begin());
+    size_t   len;
+    uint8_t* p = v.space(&len);
+    memcpy(p, f.data.data(), 16384);
+    CHECK_EQ(v.step(16384, false), FLAC_VERIFY_RUNNING);
+    v.end();
+    CHECK(!v.isRunning());
+    CHECK_EQ(verify(v, f.data), FLAC_VERIFY_OK);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testGood();
+    testDamaged();
+    testAbort();
+    return TEST_RESULT();
+}
@@ -0,0 +1,143 @@
+/*
+ *  test_gain_ramp.cpp
+ *
+ *  GainRamp on a DC signal processed in odd block sizes: no step between two frames may be larger than the per frame
+ *  factor allows (no click at the block borders, at the end of a ramp or when a new target arrives during a ramp), the
+ *  target is reached exactly, a fade out ends in digital silence. 32 bit slots: scaling, saturation and alignment.
+ *  set() from two threads while a third one processes blocks: the audio side must never take over half of a target.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "output_stage/gain_ramp.h"
+#include "check.h"
+#include <math.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// runs 'frames' frames of DC through the ramp in blocks of 'block' frames, appends the left channel to 'out'
+static void run(GainRamp* g, int16_t dc, uint32_t frames, uint32_t block, std::vector<int32_t>* out) {
+    std::vector<int16_t> buf(block * 2);
+    while(frames) {
+        uint32_t n = frames < block ? frames : block;
+        for(uint32_t i = 0; i < n * 2; i++) buf[i] = dc;
+        g->process(buf.data(), n);
+        for(uint32_t i = 0; i < n; i++) out->push_back(buf[2 * i]);
+        frames -= n;
+    }
+}
+
+static int32_t maxStep(const std::vector<int32_t>& v) {
+    int32_t m = 0;
+    for(size_t i = 1; i < v.size(); i++) if(abs(v[i] - v[i - 1]) > m) m = abs(v[i] - v[i - 1]);
+    return m;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRampDown() {
+    GainRamp g;
+    std::vector<int32_t> out;
+    run(&g, 20000, 100, 37, &out);
+    CHECK_EQ(out.back(), 20000);                          // unity gain, untouched
+    g.set(0.25f, 0.25f, 480);                             // -12 dB in 10 ms
+    CHECK(g.isRamping());
+    run(&g, 20000, 1000, 37, &out);
+    CHECK(!g.isRamping());
+    CHECK_EQ(out.back(), 5000);
+    int32_t bound = (int32_t)ceilf(20000 * (1 - powf(0.25f, 1.0f / 480))) + 2;
+    CHECK(maxStep(out) <= bound);
+    CHECK(abs(out[100 + 479] - 5000) <= 1);               // the last ramp frame meets the steady gain (float rounding)
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFadeOut() {
+    GainRamp g;
+    std::vector<int32_t> out;
+    run(&g, 30000, 50, 64, &out);
+    g.set(0, 0, 1440);                                    // fadeOutAndStop(30)
+    run(&g, 30000, 2000, 61, &out);
+    CHECK(g.isSilent());
+    CHECK_EQ(out.back(), 0);
+    int32_t bound = (int32_t)ceilf(30000 * (1 - powf(GAIN_RAMP_FLOOR, 1.0f / 1440))) + 2;
+    CHECK(maxStep(out) <= bound);                         // the floor (-60 dB) to 0 is below that
+    g.set(1, 1, 0);                                       // stopSong(): the next stream at full volume at once
+    out.clear();
+    run(&g, 30000, 10, 10, &out);
+    CHECK_EQ(out[0], 30000);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testRetarget() { // a new volume during a ramp continues from the current gain
+    GainRamp g;
+    std::vector<int32_t> out;
+    g.set(0.1f, 0.1f, 960);
+    run(&g, 20000, 300, 50, &out);
+    g.set(0.8f, 0.8f, 960);
+    run(&g, 20000, 2000, 50, &out);
+    CHECK_EQ(out.back(), (20000 * (int32_t)(0.8f * 32768 + 0.5f)) >> 15);
+    int32_t down = (int32_t)ceilf(20000 * (1 - powf(0.1f, 1.0f / 960))) + 2;
+    CHECK(maxStep(out) <= down);
+    g.set(0.2f, 0.8f, 0);                                 // balance, instantly
+    out.clear();
+    std::vector<int16_t> st = {10000, 10000};
+    g.process(st.data(), 1);
+    CHECK_EQ(st[0], (10000 * (int32_t)(0.2f * 32768 + 0.5f)) >> 15);
+    CHECK_EQ(st[1], (10000 * (int32_t)(0.8f * 32768 + 0.5f)) >> 15);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSlots32() {
+    GainRamp g;
+    int32_t  s[6] = {0x123456, -0x123456, 0x7FFFFF, -0x800000, 0x1000000, -0x1000000}; // the last two need saturation
+    g.process(s, 3);
+    CHECK_EQ(s[0], 0x123456 << 8);
+    CHECK_EQ(s[1], (int32_t)((uint32_t)-0x123456 << 8));
+    CHECK_EQ(s[2], 0x7FFFFF00);
+    CHECK_EQ(s[3], INT32_MIN);
+    CHECK_EQ(s[4], 0x7FFFFF00);
+    CHECK_EQ(s[5], INT32_MIN);
+    g.set(0.5f, 0.5f, 0);
+    int32_t h[2] = {0x200000, -0x200000};
+    g.process(h, 1);
+    CHECK_EQ(h[0], 0x100000 << 8);
+    CHECK_EQ(h[1], (int32_t)((uint32_t)-0x100000 << 8));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testConcurrentSet() { // every set() has left == right, a torn target shows up as different channel gains
+    GainRamp          g;
+    std::atomic<bool> done{false};
+    int               torn = 0, blocks = 0;
+    auto writer = [&](uint32_t seed) {
+        for(int i = 0; i < 200000; i++) {
+            float v = (float)((seed = seed * 1103515245u + 12345u) >> 16 & 0x7FFF) / 32767;
+            g.set(v, v, 0);
+        }
+    };
+    std::thread audio([&] {
+        int16_t buf[2];
+        while(!done.load()) {
+            buf[0] = buf[1] = 30000;
+            g.process(buf, 1);
+            if(g.gain(0) != g.gain(1) || buf[0] != buf[1]) torn++;
+            blocks++;
+        }
+    });
+    std::thread w1(writer, 1), w2(writer, 2);
+    w1.join();
+    w2.join();
+    done = true;
+    audio.join();
+    int16_t buf[2] = {0, 0};
+    g.process(buf, 1);
+    printf("concurrent set(): %d blocks, %d with a torn target\n", blocks, torn);
+    CHECK_EQ(torn, 0);
+    CHECK(!g.isRamping());
+    CHECK(g.gain(0) == g.gain(1));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testRampDown();
+    testFadeOut();
+    testRetarget();
+    testSlots32();
+    testConcurrentSet();
+    return TEST_RESULT();
+}
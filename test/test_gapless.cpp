@@ -0,0 +1,155 @@
+/*
+ *  test_gapless.cpp
+ *
+ *  Xing/LAME parsing (with and without CRC protection, MPEG-1 and MPEG-2, half rate output) and the gap between two
+ *  files played back to back: the decoder output of both files is trimmed frame by frame, the concatenation must be
+ *  exactly the two source signals.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "gapless/gapless.h"
+#include "check.h"
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+// first frame of an mp3 file with an Info header and a LAME tag, 'crc': protection bit clear, 2 bytes CRC
+static std::vector<uint8_t> infoFrame(bool mpeg1, bool mono, bool crc, uint32_t frames, uint32_t delay, uint32_t padding) {
+    std::vector<uint8_t> f(417, 0);
+    f[0] = 0xFF;
+    f[1] = (mpeg1 ? 0xFA : 0xF2) | (crc ? 0 : 1); // 11 bit sync, version, layer III, protection bit
+    f[2] = 0x90;                                  // 128 kbit/s (MPEG-1) / 80 kbit/s (MPEG-2), 44.1 / 22.05 kHz
+    f[3] = mono ? 0xC4 : 0x44;
+    int x = 4 + (crc ? 2 : 0) + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+    memcpy(&f[x], "Info", 4);
+    f[x + 7] = 0x0F;                              // frames, bytes, TOC, quality
+    f[x + 8] = frames >> 24; f[x + 9] = frames >> 16; f[x + 10] = frames >> 8; f[x + 11] = frames;
+    int idx = x + 8 + 4 + 4 + 100 + 4;
+    memcpy(&f[idx], "LAME3.100", 9);
+    f[idx + 21] = delay >> 4;
+    f[idx + 22] = ((delay & 0x0F) << 4) | (padding >> 8);
+    f[idx + 23] = padding & 0xFF;
+    return f;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testParse() {
+    gaplessInfo_t gi;
+    for(int crc = 0; crc < 2; crc++) {
+        std::vector<uint8_t> f = infoFrame(true, false, crc, 100, 576, 1234);
+        CHECK(Gapless_MP3Info(f.data(), (int32_t)f.size(), false, &gi));
+        CHECK_EQ(gi.frames, 100);
+        CHECK_EQ(gi.delay, 576);
+        CHECK_EQ(gi.padding, 1234);
+        CHECK_EQ(gi.skip, 1152 + 576 + GAPLESS_DECODER_DELAY);
+        CHECK_EQ(gi.total, 100 * 1152 - 576 - 1234);
+
+        CHECK(Gapless_MP3Info(f.data(), (int32_t)f.size(), true, &gi)); // half rate output
+        CHECK_EQ(gi.skip, (1152 >> 1) + ((576 + GAPLESS_DECODER_DELAY) >> 1));
+        CHECK_EQ(gi.total, (100 * 1152 - 576 - 1234) >> 1);
+
+        f = infoFrame(false, true, crc, 40, 1105, 300); // MPEG-2 mono, half rate does not apply
+        CHECK(Gapless_MP3Info(f.data(), (int32_t)f.size(), true, &gi));
+        CHECK_EQ(gi.delay, 1105);
+        CHECK_EQ(gi.skip, 576 + 1105 + GAPLESS_DECODER_DELAY);
+        CHECK_EQ(gi.total, 40 * 576 - 1105 - 300);
+    }
+    // a CRC protected frame read at the offset of an unprotected one has no Info tag
+    std::vector<uint8_t> f = infoFrame(true, false, true, 100, 576, 1234);
+    f[1] |= 1;
+    CHECK(!Gapless_MP3Info(f.data(), (int32_t)f.size(), false, &gi));
+    CHECK_EQ(gi.skip, 0);
+    CHECK_EQ(gi.total, -1);
+    // behind a few bytes of garbage, truncated
+    f = infoFrame(true, false, false, 100, 576, 1234);
+    f.insert(f.begin(), 7, 0x11);
+    CHECK(Gapless_MP3Info(f.data(), (int32_t)f.size(), false, &gi));
+    CHECK_EQ(gi.delay, 576);
+    CHECK(!Gapless_MP3Info(f.data(), 7 + 30, false, &gi));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testBeep() { // the mp3 in the repository, LAME 3.100
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    CHECK(fp != nullptr);
+    if(!fp) return;
+    uint8_t buf[512];
+    size_t  n = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    CHECK(n == sizeof(buf));
+    uint32_t id3 = 10 + ((buf[6] << 21) | (buf[7] << 14) | (buf[8] << 7) | buf[9]);
+    gaplessInfo_t gi;
+    CHECK(Gapless_MP3Info(buf + id3, (int32_t)(n - id3), false, &gi));
+    CHECK_EQ(gi.frames, 26);
+    CHECK_EQ(gi.delay, 576);
+    CHECK_EQ(gi.padding, 844);
+    CHECK_EQ(gi.total, 26 * 1152 - 576 - 844);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// decoder output of one file: Info frame, decoder and encoder delay, the signal, the rest of the last frame
+static std::vector<audio_sample_t> decodedFile(const std::vector<audio_sample_t>& sig, uint32_t delay, uint32_t* frames, uint32_t* padding) {
+    uint32_t len = (uint32_t)sig.size() / 2;
+    *frames = (delay + len + GAPLESS_DECODER_DELAY + 1151) / 1152; // like LAME, the padding covers the decoder delay
+    *padding = *frames * 1152 - delay - len;
+    std::vector<audio_sample_t> out((size_t)(*frames + 1) * 1152 * 2, 9999); // 9999: not signal
+    size_t start = 1152 + delay + GAPLESS_DECODER_DELAY;
+    for(uint32_t i = 0; i < len; i++) {
+        out[(start + i) * 2] = sig[i * 2];
+        out[(start + i) * 2 + 1] = sig[i * 2 + 1];
+    }
+    return out;
+}
+
+static void testNoGap() {
+    std::vector<audio_sample_t> sig[2];
+    uint32_t len[2] = {20000, 7777};
+    for(int k = 0; k < 2; k++) {
+        sig[k].resize(len[k] * 2);
+        for(uint32_t i = 0; i < len[k] * 2; i++) sig[k][i] = (audio_sample_t)((k + 1) * 1000 + i % 997);
+    }
+    for(int crc = 0; crc < 2; crc++) {
+        std::vector<audio_sample_t> joined;
+        for(int k = 0; k < 2; k++) {
+            uint32_t frames, padding;
+            std::vector<audio_sample_t> dec = decodedFile(sig[k], 576, &frames, &padding);
+            std::vector<uint8_t> hdr = infoFrame(true, false, crc, frames, 576, padding);
+            gaplessInfo_t gi;
+            CHECK(Gapless_MP3Info(hdr.data(), (int32_t)hdr.size(), false, &gi));
+            uint32_t skip = gi.skip;
+            int32_t  remain = gi.total;
+            for(size_t pos = 0; pos < dec.size(); pos += 1152 * 2) { // one decoded frame at a time, as playAudioData()
+                audio_sample_t frame[1152 * 2];
+                memcpy(frame, &dec[pos], sizeof(frame));
+                uint32_t n = Gapless_Trim(frame, 1152, 2, &skip, &remain);
+                joined.insert(joined.end(), frame, frame + n * 2);
+            }
+            CHECK_EQ(skip, 0);
+            CHECK_EQ(remain, 0);
+        }
+        CHECK_EQ(joined.size(), (len[0] + len[1]) * 2); // gap length 0
+        std::vector<audio_sample_t> expect(sig[0]);
+        expect.insert(expect.end(), sig[1].begin(), sig[1].end());
+        CHECK(joined == expect);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testTrimMono() {
+    audio_sample_t buf[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    uint32_t skip = 3;
+    int32_t  remain = 4;
+    CHECK_EQ(Gapless_Trim(buf, 10, 1, &skip, &remain), 4);
+    CHECK_EQ(buf[0], 4);
+    CHECK_EQ(buf[3], 7);
+    CHECK_EQ(remain, 0);
+    skip = 0;
+    remain = -1; // unknown length, nothing is cut at the end
+    CHECK_EQ(Gapless_Trim(buf, 10, 1, &skip, &remain), 10);
+    CHECK_EQ(remain, -1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testParse();
+    testBeep();
+    testNoGap();
+    testTrimMono();
+    return TEST_RESULT();
+}
@@ -0,0 +1,367 @@
+/*
+ *  test_m4a_index.cpp
+ *
+ *  M4AIndex on a synthetic moov atom: frame offsets and times of a valid track, then malformed sample tables that must
+ *  be rejected without reading or writing outside the buffers (run it under ASan/valgrind to see the latter). Opening
+ *  and resuming an m4a of one hour with moov behind mdat: the atom walk of seek_m4a_stsz() and seek_m4a_ilst() and
+ *  the stsz read of m4a_correctResumeFilePos() as they were before M4AIndex, against parse_m4a_moov(). The file calls
+ *  are counted on an SD card model (every call through VFS and FATFS, an SD command for sectors not in the sector
+ *  buffer of FATFS).
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "m4a_index/m4a_index.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> bytes_t;
+
+static void put32(bytes_t& b, uint32_t v) {
+    b.push_back(v >> 24); b.push_back(v >> 16); b.push_back(v >> 8); b.push_back(v);
+}
+static bytes_t atom(const char* name, const bytes_t& payload) {
+    bytes_t b;
+    put32(b, (uint32_t)payload.size() + 8);
+    b.insert(b.end(), name, name + 4);
+    b.insert(b.end(), payload.begin(), payload.end());
+    return b;
+}
+static bytes_t cat(std::initializer_list<bytes_t> parts) {
+    bytes_t b;
+    for(const bytes_t& p : parts) b.insert(b.end(), p.begin(), p.end());
+    return b;
+}
+static bytes_t table(std::initializer_list<uint32_t> words) { // full atom: version/flags, then the words
+    bytes_t b;
+    put32(b, 0);
+    for(uint32_t w : words) put32(b, w);
+    return b;
+}
+
+// sample tables of an aac track, given as the atom payloads
+struct Tables {
+    bytes_t stts = table({1, 10, 1024});                        // 10 frames of 1024 samples
+    bytes_t stsz = table({0, 10, 300, 301, 302, 303, 304, 305, 306, 307, 308, 309});
+    bytes_t stsc = table({2, 1, 4, 1, 3, 2, 1});                // chunk 1-2: 4 frames, chunk 3: 2 frames
+    bytes_t stco = table({3, 1000, 5000, 9000});
+};
+
+static bytes_t moov(const Tables& tb) {
+    bytes_t mp4a(36, 0);
+    memcpy(&mp4a[4], "mp4a", 4);
+    mp4a[25] = 2;                                   // channels
+    mp4a[27] = 16;                                  // bits per sample
+    mp4a[32] = 44100 >> 8; mp4a[33] = 44100 & 0xFF; // sample rate, 16.16
+    bytes_t stsd = cat({table({1}), mp4a});
+    bytes_t stbl = atom("stbl", cat({atom("stsd", stsd), atom("stts", tb.stts), atom("stsz", tb.stsz),
+                                     atom("stsc", tb.stsc), atom("stco", tb.stco)}));
+    bytes_t mdhd = table({0, 0, 44100, 10240, 0});
+    bytes_t hdlr = table({0});
+    hdlr.insert(hdlr.end(), {'s', 'o', 'u', 'n', 0, 0, 0, 0});
+    bytes_t mdia = atom("mdia", cat({atom("mdhd", mdhd), atom("hdlr", hdlr), atom("minf", stbl)}));
+    return atom("moov", atom("trak", mdia));
+}
+
+static bool parse(const Tables& tb, M4AIndex* idx) {
+    bytes_t m = moov(tb);
+    return idx->parse(m.data(), (uint32_t)m.size());
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testValid() {
+    Tables   tb;
+    M4AIndex idx;
+    CHECK(parse(tb, &idx));
+    CHECK_EQ(idx.frames(), 10);
+    CHECK_EQ(idx.channels(), 2);
+    CHECK_EQ(idx.sampleRate(), 44100);
+    CHECK_EQ(idx.timescale(), 44100);
+    CHECK_EQ(idx.frameOffset(0), 1000);
+    CHECK_EQ(idx.frameOffset(3), 1000 + 300 + 301 + 302);
+    CHECK_EQ(idx.frameOffset(4), 5000);
+    CHECK_EQ(idx.frameOffset(9), 9000 + 308);
+    CHECK_EQ(idx.frameSize(9), 309);
+    CHECK_EQ(idx.frameSize(10), 0);
+    CHECK_EQ(idx.frameAtOffset(1001), 1);
+    CHECK_EQ(idx.frameAtOffset(5000), 4);
+    CHECK_EQ(idx.frameAtOffset(20000), -1);
+    CHECK_EQ(idx.frameAtTime(1024 * 5 + 10), 5);
+    CHECK_EQ(idx.frameTime(7), 7 * 1024);
+
+    tb.stsz = table({400, 10});  // fixed frame size
+    CHECK(parse(tb, &idx));
+    CHECK_EQ(idx.frames(), 10);
+    CHECK_EQ(idx.frameOffset(6), 5000 + 2 * 400);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFixedSizeCount() { // a fixed size with a huge count: no table backs it, the count comes from stts/stsc
+    Tables   tb;
+    M4AIndex idx;
+    tb.stsz = table({400, 0xFFFFFFFF});
+    CHECK(parse(tb, &idx));
+    CHECK_EQ(idx.frames(), 10);
+    tb.stsz = table({400, 0x80000001}); // numFrames * 2 + 1 wraps on 32 bit
+    CHECK(parse(tb, &idx));
+    CHECK_EQ(idx.frames(), 10);
+    // stts and stsc claim more than M4A_MAX_FRAMES
+    tb.stts = table({1, 0xFFFFFFFF, 1024});
+    tb.stsc = table({1, 1, 0x7FFFFFFF});
+    CHECK(!parse(tb, &idx));
+    CHECK(!idx.isValid());
+    // fewer frames in stts than in stsz/stsc
+    tb = Tables();
+    tb.stts = table({1, 6, 1024});
+    CHECK(parse(tb, &idx));
+    CHECK_EQ(idx.frames(), 6);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testStsc() {
+    Tables   tb;
+    M4AIndex idx;
+    tb.stsc = table({1, 2, 4, 1});         // first run starts at chunk 2, chunk 1 would have no first frame
+    CHECK(!parse(tb, &idx));
+    tb.stsc = table({2, 1, 4, 1, 1, 2, 1}); // not ascending
+    CHECK(!parse(tb, &idx));
+    tb.stsc = table({2, 1, 4, 1, 7, 2, 1}); // behind the last chunk
+    CHECK(!parse(tb, &idx));
+    tb.stsc = table({0});                   // no runs
+    CHECK(!parse(tb, &idx));
+    tb.stsc = table({5, 1, 4, 1});          // more runs than the atom holds
+    CHECK(!parse(tb, &idx));
+    tb = Tables();
+    tb.stco = table({0});                   // no chunks
+    CHECK(!parse(tb, &idx));
+    tb.stco = table({1000, 1000});          // more chunks than the atom holds
+    CHECK(!parse(tb, &idx));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testTruncated() {
+    Tables   tb;
+    M4AIndex idx;
+    tb.stsz = table({0, 11, 300});          // sizes table shorter than its count
+    CHECK(!parse(tb, &idx));
+    tb = Tables();
+    tb.stts = table({2, 10, 1024});
+    CHECK(!parse(tb, &idx));
+    tb = Tables();
+    tb.stsz = table({0x10000, 10});         // an aac frame is smaller than 64kB
+    CHECK(!parse(tb, &idx));
+    // every truncation of a valid moov, the atom sizes then point behind the buffer
+    bytes_t m = moov(Tables());
+    int ok = 0;
+    for(uint32_t len = 0; len < m.size(); len++) {
+        bytes_t part(m.begin(), m.begin() + len);
+        ok += idx.parse(part.data(), len);
+    }
+    CHECK_EQ(ok, 0);
+    CHECK(idx.parse(m.data(), (uint32_t)m.size()));
+}
+//----------------------------------------------------------------------------------------------------------------------
+// an m4a file on the SD card: ftyp, mdat (zeros), moov; the calls and SD commands are counted
+class SdFile {
+public:
+    SdFile(const bytes_t& head, uint32_t mdatLen, const bytes_t& tail) : m_head(head), m_tail(tail), m_mdatLen(mdatLen) {}
+    uint32_t size() { return m_head.size() + m_mdatLen + m_tail.size(); }
+    uint32_t position() { m_calls++; return m_pos; }
+    bool     seek(uint32_t pos) { m_calls++; m_pos = pos; return pos <= size(); }
+    int      read() { uint8_t b; return read(&b, 1) == 1 ? b : -1; }
+    size_t   readBytes(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+    size_t   read(uint8_t* buf, size_t len) {
+        m_calls++;
+        if(m_pos + len > size()) len = size() - m_pos;
+        if(!len) return 0;
+        uint32_t first = m_pos / 512, last = (m_pos + len - 1) / 512;
+        if(first == m_sector) first++;                   // in the sector buffer
+        if(first <= last) {                              // one command, multi sector
+            m_commands++;
+            m_sectors += last - first + 1;
+            m_sector = last;
+        }
+        for(size_t i = 0; i < len; i++) buf[i] = at(m_pos + i);
+        m_pos += len;
+        return len;
+    }
+    void   resetCounters() { m_calls = m_commands = m_sectors = 0; m_sector = ~0u; }
+    double ms() { return (m_calls * 10 + m_commands * 500 + m_sectors * 51) / 1000.0; } // 10 µs per call, 10 MB/s
+    uint32_t m_calls = 0, m_commands = 0, m_sectors = 0;
+
+private:
+    uint8_t at(uint32_t pos) {
+        if(pos < m_head.size()) return m_head[pos];
+        pos -= m_head.size();
+        if(pos < m_mdatLen) return 0;
+        return m_tail[pos - m_mdatLen];
+    }
+    bytes_t  m_head, m_tail;
+    uint32_t m_mdatLen, m_pos = 0, m_sector = ~0u;
+};
+
+static uint32_t bigEndian(const uint8_t* p, int n) { uint32_t v = 0; while(n--) v = (v << 8) | *p++; return v; }
+
+static uint32_t old_find_m4a_atom(SdFile& f, uint32_t fileSize, const char* atomName) { // Audio::find_m4a_atom()
+    while(f.position() < fileSize) {
+        uint32_t atomStart = f.position();
+        uint8_t  b[8];
+        char     atomType[5] = {0};
+        f.read(b, 4);
+        uint32_t atomSize = bigEndian(b, 4);
+        if(!atomSize) {f.read(b, 4); atomSize = bigEndian(b, 4);}
+        f.read((uint8_t*)atomType, 4);
+        if(strncmp(atomType, atomName, 4) == 0) return atomStart;
+        if(atomSize == 1) {f.read(b, 8); atomSize = bigEndian(b + 4, 4);}
+        if(!strncmp(atomType, "moov", 4) || !strncmp(atomType, "trak", 4) || !strncmp(atomType, "mdia", 4) ||
+           !strncmp(atomType, "minf", 4) || !strncmp(atomType, "stbl", 4) || !strncmp(atomType, "meta", 4) ||
+           !strncmp(atomType, "udta", 4)) {
+            uint32_t pos = old_find_m4a_atom(f, atomStart + atomSize, atomName);
+            if(pos) return pos;
+        }
+        else f.seek(atomStart + atomSize);
+    }
+    return 0;
+}
+
+static uint32_t old_open(SdFile& f, uint32_t* stszPos) { // Audio::seek_m4a_stsz() and seek_m4a_ilst(), the stsz entries
+    struct {uint32_t pos, size; char name[5];} at = {0, f.size(), ""}, tmp;
+    const char name[6][5] = {"moov", "trak", "mdia", "minf", "stbl", "stsz"};
+    uint32_t   seekpos = 0, stsdPos = 0, numEntries = 0;
+    char       b[8] = {0};
+    for(int i = 0; i < 6; i++) {
+        bool found = false;
+        while(seekpos < at.pos + at.size) {
+            f.seek(seekpos);
+            f.readBytes(b, 4);
+            tmp.size = bigEndian((uint8_t*)b, 4);
+            if(!tmp.size) tmp.size = 4;
+            f.readBytes(tmp.name, 4);
+            tmp.name[4] = '\0';
+            tmp.pos = seekpos;
+            seekpos += tmp.size;
+            if(!strcmp(tmp.name, name[i])) {at = tmp; found = true;}
+            if(!strcmp(tmp.name, "stsd")) stsdPos = tmp.pos;
+        }
+        if(!found) return 0;
+        seekpos = at.pos + 8;
+    }
+    seekpos += 8;
+    f.seek(seekpos);
+    f.readBytes(b, 4);
+    numEntries = bigEndian((uint8_t*)b, 4);
+    *stszPos = seekpos + 4;
+    uint8_t data[1024];
+    f.seek(stsdPos);
+    f.readBytes((char*)data, 128);                       // mp4a
+    f.seek(0);
+    f.seek(0);                                           // seek_m4a_ilst()
+    uint32_t ilst = old_find_m4a_atom(f, f.size(), "ilst");
+    if(ilst) {
+        f.seek(ilst);
+        f.readBytes(b, 4);
+        uint32_t len = bigEndian((uint8_t*)b, 4);
+        if(!len) {f.readBytes(b, 4); len = bigEndian((uint8_t*)b, 4) + 16;}
+        if(len > 1024) len = 1024;
+        f.seek(ilst);
+        f.read(data, len - 4);
+    }
+    f.seek(0);
+    return numEntries;
+}
+
+static int32_t old_resume(SdFile& f, uint32_t stszPos, uint32_t numEntries, uint32_t dataStart, uint32_t resumePos) {
+    uint32_t i = 0, pos = dataStart, filePtr = f.position();      // Audio::m4a_correctResumeFilePos()
+    f.seek(stszPos);
+    while(i < numEntries) {
+        i++;
+        uint32_t size = f.read() << 24;
+        size |= f.read() << 16;
+        size |= f.read() << 8;
+        size |= f.read();
+        pos += size;
+        if(pos >= resumePos) break;
+    }
+    if(pos < resumePos) return -1;
+    f.seek(filePtr);
+    return pos - resumePos;
+}
+
+static bool new_open(SdFile& f, M4AIndex* idx) { // Audio::parse_m4a_moov()
+    uint8_t  hdr[16];
+    uint32_t pos = 0, moovPos = 0, moovSize = 0, fileSize = f.size();
+    while(pos + 8 <= fileSize) {
+        f.seek(pos);
+        if(f.read(hdr, 16) < 8) break;
+        uint32_t atomSize = bigEndian(hdr, 4);
+        if(atomSize < 8) break;
+        if(!memcmp(hdr + 4, "moov", 4)) {moovPos = pos; moovSize = atomSize; break;}
+        pos += atomSize;
+    }
+    if(!moovSize) return false;
+    bytes_t moov(moovSize);
+    f.seek(moovPos);
+    bool ok = f.read(moov.data(), moovSize) == moovSize && idx->parse(moov.data(), moovSize);
+    f.seek(0);
+    return ok;
+}
+
+static void testOpen() {
+    const uint32_t frames = 155040, perChunk = 20;       // one hour at 44.1kHz
+    bytes_t        head = cat({atom("ftyp", bytes_t(24, 0))});
+    uint32_t       dataStart = head.size() + 8, dataLen = 0;
+    bytes_t        sizes = table({0, frames}), offsets = table({frames / perChunk});
+    uint32_t       rnd = 5;
+    for(uint32_t i = 0; i < frames; i++) {
+        if(i % perChunk == 0) put32(offsets, dataStart + dataLen);
+        rnd = rnd * 1664525 + 1013904223;
+        uint32_t size = 300 + (rnd >> 24);
+        put32(sizes, size);
+        dataLen += size;
+    }
+    put32(head, dataLen + 8);
+    head.insert(head.end(), {'m', 'd', 'a', 't'});
+    Tables tb;
+    tb.stts = table({1, frames, 1024});
+    tb.stsz = sizes;
+    tb.stsc = table({1, 1, perChunk, 1});
+    tb.stco = offsets;
+    bytes_t m = moov(tb), title = atom("data", cat({table({1}), bytes_t{'B', 'e', 'e', 'p'}}));
+    bytes_t udta = atom("udta", atom("meta", cat({table({}), atom("ilst", atom("\xA9nam", title))})));
+    m.insert(m.end(), udta.begin(), udta.end());
+    m[0] = m.size() >> 24; m[1] = m.size() >> 16; m[2] = m.size() >> 8; m[3] = m.size();
+    SdFile   f(head, dataLen, m);
+    uint32_t resumePos = dataStart + dataLen / 2 + 7;
+
+    uint32_t stszPos = 0;
+    uint32_t numEntries = old_open(f, &stszPos);
+    SdFile   o = f;
+    int32_t  oldSkip = old_resume(f, stszPos, numEntries, dataStart, resumePos);
+    printf("per atom:  open %u calls, %u SD commands, %.1f ms; resume %u calls, %u SD commands, %.1f ms\n",
+           o.m_calls, o.m_commands, o.ms(), f.m_calls - o.m_calls, f.m_commands - o.m_commands, f.ms() - o.ms());
+    double oldMs = f.ms();
+    CHECK_EQ(numEntries, frames);
+
+    M4AIndex idx;
+    f.resetCounters();
+    auto t0 = std::chrono::steady_clock::now();
+    CHECK(new_open(f, &idx));
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    int32_t newSkip = idx.frameOffset(idx.frameAtOffset(resumePos)) - resumePos; // no file access
+    printf("M4AIndex:  open %u calls, %u SD commands (%u kB moov), %.1f ms, parse on the host %.0f µs; resume 0 calls\n",
+           f.m_calls, f.m_commands, (unsigned)m.size() / 1024, f.ms(), us);
+    CHECK_EQ(idx.frames(), frames);
+    CHECK(idx.ilstOffset() > 0);
+    CHECK_EQ(newSkip, oldSkip);
+    CHECK(f.m_calls < 10);
+    CHECK(f.ms() * 5 < oldMs);                          // open and resume; the open alone is faster per atom
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testValid();
+    testFixedSizeCount();
+    testStsc();
+    testTruncated();
+    testOpen();
+    return TEST_RESULT();
+}
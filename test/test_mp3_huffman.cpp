@@ -0,0 +1,164 @@
+/*
+ *  test_mp3_huffman.cpp
+ *
+ *  The Huffman fast path of the MP3 decoder (DecodeHuffmanPairsFast(), DecodeHuffmanQuadsFast()) against the code
+ *  without it, the file is built with several MP3_HUFF_FAST_BITS. test_mp3_huffman_ref (0, no fast path) decodes random
+ *  bit streams with every pair table and both quad tables (random lengths, bit offsets, bits left, biased bits for
+ *  short and long codewords and escapes) and beep.mp3, and writes the results to mp3_huffman_ref.bin. The builds with
+ *  the fast path must give the same values and bit counts. All print the throughput on the host.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "mp3_decoder/mp3_decoder.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#define REF_FILE   "mp3_huffman_ref.bin"
+#define CASES      40                                   // per table
+#define BENCH_RUNS 4000
+
+static std::vector<int32_t> s_rec;                      // return values and decoded values of all cases, in order
+
+static uint32_t next(uint32_t* rng) {
+    *rng = *rng * 1103515245u + 12345u;
+    return *rng >> 8;
+}
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// random bytes, 'bias' 0: even, 1: more zeros (long codewords, escapes), 2: more ones (short codewords)
+static void fill(std::vector<uint8_t>& buf, uint32_t* rng, int bias) {
+    for(uint8_t& b : buf) {
+        b = next(rng);
+        if(bias == 1) b &= next(rng);
+        if(bias == 2) b |= next(rng);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void fuzzPairs() {
+    uint32_t rng = 1;
+    std::vector<uint8_t> buf(576 * 5 + 16);              // linbits 13 + sign + 19 bit codeword per value at most, read ahead
+    std::vector<int32_t> xy(576 + 2);
+    for(int tab = 0; tab < m_HUFF_PAIRTABS; tab++) {
+        for(int c = 0; c < CASES; c++) {
+            fill(buf, &rng, c % 3);
+            int32_t nVals = 2 * (1 + next(&rng) % 288);
+            int32_t bitOffset = next(&rng) % 8;
+            int32_t bitsLeft = (c % 4 == 0) ? next(&rng) % 64 : next(&rng) % ((buf.size() - 16) * 8 - bitOffset); // few bits: ends early
+            memset(xy.data(), 0x55, xy.size() * 4);
+            int32_t used = DecodeHuffmanPairs(xy.data(), nVals, tab, bitsLeft, buf.data(), bitOffset);
+            s_rec.push_back(used);
+            s_rec.insert(s_rec.end(), xy.begin(), xy.begin() + nVals);
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void fuzzQuads() {
+    uint32_t rng = 2;
+    std::vector<uint8_t> buf(576 + 16);
+    std::vector<int32_t> vwxy(576 + 4);
+    for(int tab = 0; tab < 2; tab++) {
+        for(int c = 0; c < CASES * 4; c++) {
+            fill(buf, &rng, c % 3);
+            int32_t nVals = 4 * (1 + next(&rng) % 144);
+            int32_t bitOffset = next(&rng) % 8;
+            int32_t bitsLeft = (c % 4 == 0) ? next(&rng) % 40 : next(&rng) % ((buf.size() - 16) * 8 - bitOffset);
+            memset(vwxy.data(), 0x55, vwxy.size() * 4);
+            int32_t n = DecodeHuffmanQuads(vwxy.data(), nVals, tab, bitsLeft, buf.data(), bitOffset);
+            s_rec.push_back(n);
+            s_rec.insert(s_rec.end(), vwxy.begin(), vwxy.begin() + (n > 0 && n <= nVals ? n : 0));
+        }
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void decodeBeep() { // the whole decoder, the PCM goes into the record
+    std::vector<uint8_t> d;
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    CHECK(fp != NULL);
+    if(!fp) return;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    int32_t total = d.size(), pos = 0;
+    d.resize(d.size() + 64, 0);
+    MP3Decoder_t* dec = MP3Decoder_New();
+    int16_t       out[1152 * 2];
+    while(pos < total) {
+        int32_t o = MP3FindSyncWord(d.data() + pos, total - pos);
+        if(o < 0) break;
+        pos += o;
+        int32_t left = total - pos;
+        if(MP3Decode(dec, d.data() + pos, &left, out, 0) < 0) {pos++; continue;}
+        pos = total - left;
+        s_rec.insert(s_rec.end(), out, out + MP3GetOutputSamps(dec));
+    }
+    MP3Decoder_Delete(dec);
+}
+//----------------------------------------------------------------------------------------------------------------------
+// values per microsecond of full granules (576 values, no early end) for some typical tables, [4]: the quads
+static void bench(double rate[5]) {
+    static const int tabs[4] = {1, 7, 15, 24};           // 2x2 one shot, 6x6, 16x16, 16x16 with linbits
+    uint32_t rng = 3;
+    std::vector<uint8_t> buf(576 * 5 + 16);
+    std::vector<int32_t> xy(576 + 4);
+    fill(buf, &rng, 2);
+    for(int k = 0; k < 5; k++) {
+        uint64_t t0 = nowNs();
+        int64_t  vals = 0;
+        for(int r = 0; r < BENCH_RUNS; r++) {
+            if(k < 4) vals += DecodeHuffmanPairs(xy.data(), 576, tabs[k], (buf.size() - 16) * 8, buf.data(), 0) > 0 ? 576 : 0;
+            else vals += DecodeHuffmanQuads(xy.data(), 576, r & 1, 576 * 8, buf.data(), 0);
+        }
+        rate[k] = vals * 1000.0 / (nowNs() - t0 + 1);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+#if MP3_HUFF_FAST_BITS
+    InitHuffmanFastTables();                            // as MP3Decoder_Init(), else every lookup misses
+#endif
+    fuzzPairs();
+    fuzzQuads();
+    decodeBeep();
+    double rate[5];
+    bench(rate);
+    printf("MP3_HUFF_FAST_BITS %d: %zu values, values per us: pairs 1: %.0f, 7: %.0f, 15: %.0f, 24: %.0f, quads: %.0f\n",
+           MP3_HUFF_FAST_BITS, s_rec.size(), rate[0], rate[1], rate[2], rate[3], rate[4]);
+#if MP3_HUFF_FAST_BITS == 0
+    FILE* fp = fopen(REF_FILE, "wb");
+    CHECK(fp != NULL);
+    if(fp) {
+        uint32_t n = s_rec.size();
+        CHECK_EQ(fwrite(&n, 4, 1, fp), 1);
+        CHECK_EQ(fwrite(s_rec.data(), 4, n, fp), n);
+        CHECK_EQ(fwrite(rate, sizeof(rate), 1, fp), 1);
+        fclose(fp);
+    }
+#else
+    FILE* fp = fopen(REF_FILE, "rb");
+    CHECK(fp != NULL);                                  // written by test_mp3_huffman_ref
+    if(!fp) return TEST_RESULT();
+    uint32_t n = 0;
+    CHECK_EQ(fread(&n, 4, 1, fp), 1);
+    std::vector<int32_t> ref(n);
+    double               refRate[5];
+    CHECK_EQ(fread(ref.data(), 4, n, fp), n);
+    CHECK_EQ(fread(refRate, sizeof(refRate), 1, fp), 1);
+    fclose(fp);
+    CHECK_EQ(n, s_rec.size());
+    size_t first = 0;
+    while(first < n && first < s_rec.size() && ref[first] == s_rec[first]) first++;
+    if(first < n) printf("first difference at %zu: %d != %d\n", first, s_rec[first], ref[first]);
+    CHECK_EQ(first, n);
+    printf("speed against no fast path: pairs 1: %.2fx, 7: %.2fx, 15: %.2fx, 24: %.2fx, quads: %.2fx\n",
+           rate[0] / refRate[0], rate[1] / refRate[1], rate[2] / refRate[2], rate[3] / refRate[3], rate[4] / refRate[4]);
+#endif
+    return TEST_RESULT();
+}
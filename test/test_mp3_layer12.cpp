@@ -0,0 +1,205 @@
+/*
+ *  test_mp3_layer12.cpp
+ *
+ *  MPEG audio layer I and II in the MP3 decoder (DecodeLayer12()) against the frames of mp2_encoder.h. The ISO 11172-4
+ *  conformance bitstreams and a layer II encoder are not at hand on the host, the encoder generates the vectors from
+ *  the tables of the standard: layer I and II, MPEG-1 with the four allocation tables of layer II, MPEG-2 half rates,
+ *  mono, stereo, dual channel and joint stereo with every bound, padding, random allocations, scfsi and scale factors.
+ *  The reference PCM is the synthesis filter of the decoder (checked on its own by test_mp3_synth) run on the subband
+ *  samples requantized in double precision, the decoded PCM must meet the full accuracy of 11172-4 against it (rms
+ *  below 2^-15 / sqrt(12) of full scale, no sample off by more than 2^-14, 1 LSB here). A single allocated subband must
+ *  come out in its band of the spectrum, a bad allocation and a short frame are errors.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "mp3_decoder/mp3_decoder.h"
+#include "mp2_encoder.h"
+#include "check.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAMES 12
+
+struct Layer12Case {
+    uint8_t     layer, lsf, srIdx, brIdx, mode, modeExt;
+    const char* name;
+};
+
+static const Layer12Case s_cases[] = {
+    {1, 0, 1,  6, 3, 0, "I 48 kHz mono 192 kbps"},
+    {1, 0, 0, 12, 0, 0, "I 44.1 kHz stereo 384 kbps"},
+    {1, 0, 2,  8, 1, 1, "I 32 kHz joint stereo bound 8 256 kbps"},
+    {1, 0, 1, 14, 2, 0, "I 48 kHz dual channel 448 kbps"},
+    {1, 1, 1, 12, 0, 0, "I 24 kHz stereo 192 kbps"},
+    {2, 0, 1, 10, 0, 0, "II 48 kHz stereo 192 kbps (B.2a)"},
+    {2, 0, 0, 12, 0, 0, "II 44.1 kHz stereo 256 kbps (B.2b)"},
+    {2, 0, 0,  5, 3, 0, "II 44.1 kHz mono 80 kbps (B.2a)"},
+    {2, 0, 2, 14, 3, 0, "II 32 kHz mono 384 kbps (B.2b)"},
+    {2, 0, 1,  2, 3, 0, "II 48 kHz mono 48 kbps (B.2c)"},
+    {2, 0, 0,  4, 0, 0, "II 44.1 kHz stereo 64 kbps (B.2c)"},
+    {2, 0, 2,  4, 2, 0, "II 32 kHz dual channel 64 kbps (B.2d)"},
+    {2, 0, 0, 11, 1, 0, "II 44.1 kHz joint stereo bound 4 224 kbps"},
+    {2, 0, 1, 10, 1, 2, "II 48 kHz joint stereo bound 12 192 kbps"},
+    {2, 0, 0, 13, 1, 3, "II 44.1 kHz joint stereo bound 16 320 kbps"},
+    {2, 1, 1, 14, 0, 0, "II 24 kHz stereo 160 kbps (MPEG-2)"},
+    {2, 1, 2,  8, 3, 0, "II 16 kHz mono 64 kbps (MPEG-2)"},
+    {2, 1, 0, 12, 1, 1, "II 22.05 kHz joint stereo bound 8 128 kbps (MPEG-2)"},
+};
+
+static Mp2Encoder encoder(const Layer12Case& c) {
+    Mp2Encoder e;
+    e.layer = c.layer;
+    e.lsf = c.lsf;
+    e.srIdx = c.srIdx;
+    e.brIdx = c.brIdx;
+    e.mode = c.mode;
+    e.modeExt = c.modeExt;
+    return e;
+}
+
+// frame by frame as Audio feeds the decoder, the frames back to back
+static std::vector<int16_t> decode(std::vector<uint8_t> d, MP3Decoder_t* dec, int32_t* errors) {
+    std::vector<int16_t> pcm;
+    int16_t              out[1152 * 2];
+    int32_t              total = d.size(), pos = 0;
+    d.resize(d.size() + 64, 0);
+    *errors = 0;
+    while(pos < total) {
+        int32_t o = MP3FindSyncWord(d.data() + pos, total - pos);
+        if(o < 0) break;
+        pos += o;
+        int32_t left = total - pos;
+        if(MP3Decode(dec, d.data() + pos, &left, out, 0) < 0) {(*errors)++; pos++; continue;}
+        pos = total - left;
+        pcm.insert(pcm.end(), out, out + MP3GetOutputSamps(dec));
+    }
+    return pcm;
+}
+
+// the synthesis filter on the requantized samples of the encoder, 12 (layer I) or 18 (layer II) blocks per call
+static std::vector<int16_t> reference(const Mp2Encoder& e) {
+    MP3Decoder_t* d = MP3Decoder_New();
+    d->decInfo.nChans = e.channels();
+    uint32_t             nBlocks = e.layer == 1 ? 12 : m_BLOCK_SIZE, total = e.expected[0].size() / m_NBANDS;
+    std::vector<int16_t> pcm(total * m_NBANDS * e.channels());
+    for(uint32_t b0 = 0; b0 < total; b0 += nBlocks) {
+        for(int ch = 0; ch < e.channels(); ch++) {
+            uint32_t mask = 0;
+            for(uint32_t b = 0; b < nBlocks; b++) {
+                for(int k = 0; k < m_NBANDS; k++) {
+                    int32_t v = e.expected[ch][(b0 + b) * m_NBANDS + k];
+                    d->imdctInfo.outBuf[ch][b][k] = v;
+                    mask |= FASTABS(v);
+                }
+            }
+            d->imdctInfo.gb[ch] = mask ? CLZ(mask) - 1 : 31;
+        }
+        Subband(d, pcm.data() + b0 * m_NBANDS * e.channels(), nBlocks);
+    }
+    MP3Decoder_Delete(d);
+    return pcm;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testConformance() {
+    for(const Layer12Case& c : s_cases) {
+        MP3Decoder_t*        dec = MP3Decoder_New();         // a new stream, the synthesis filter starts empty
+        Mp2Encoder           e = encoder(c);
+        std::vector<uint8_t> data = e.makeStream(FRAMES, 7 + c.brIdx * 3 + c.srIdx);
+        int32_t              errors;
+        std::vector<int16_t> pcm = decode(data, dec, &errors);
+        std::vector<int16_t> ref = reference(e);
+        CHECK_EQ(errors, 0);
+        CHECK_EQ(pcm.size(), ref.size());
+        CHECK_EQ(dec->frameInfo.layer, c.layer);
+        CHECK_EQ(dec->frameInfo.nChans, e.channels());
+        CHECK_EQ(dec->frameInfo.samprate, (int32_t)e.sampleRate());
+        CHECK_EQ(dec->frameInfo.bitrate, (int32_t)e.bitRate());
+        CHECK_EQ(dec->frameInfo.outputSamps, (int32_t)(e.blocks() * m_NBANDS * e.channels()));
+        if(pcm.size() != ref.size()) {MP3Decoder_Delete(dec); continue;}
+        double sum = 0;
+        int    maxDiff = 0;
+        size_t clipped = 0;
+        for(size_t i = 0; i < pcm.size(); i++) {
+            int diff = abs(pcm[i] - ref[i]);
+            sum += (double)diff * diff;
+            if(diff > maxDiff) maxDiff = diff;
+            if(ref[i] == 32767 || ref[i] == -32768) clipped++;
+        }
+        double rms = sqrt(sum / pcm.size());
+        printf("layer %-52s rms %.4f LSB, max %d LSB, %zu clipped\n", c.name, rms, maxDiff, clipped);
+        CHECK(rms < 1 / sqrt(12.0));                     // 2^-15 / sqrt(12) of full scale
+        CHECK(maxDiff <= 1);
+        CHECK(clipped < pcm.size() / 100);
+        MP3Decoder_Delete(dec);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+// white noise in one subband: the energy of the PCM must lie in that band, up to the overlap of the filters
+static void testBands() {
+    MP3Decoder_t* dec = MP3Decoder_New();
+    for(int8_t sb : {0, 5, 20, 26}) {
+        for(uint8_t layer = 1; layer <= 2; layer++) {
+            Mp2Encoder e;
+            e.layer = layer;
+            e.srIdx = 1;
+            e.brIdx = 10;
+            e.mode = 3;
+            e.onlyBand = sb;
+            int32_t              errors;
+            std::vector<int16_t> pcm = decode(e.makeStream(FRAMES, 11 + sb), dec, &errors);
+            CHECK_EQ(errors, 0);
+            const size_t N = 2048, start = 1152;           // past the delay of the filter
+            if(pcm.size() < start + N) {CHECK(false); continue;}
+            double inBand = 0, nearBand = 0, total = 0;
+            for(size_t k = 1; k < N / 2; k++) {              // DFT bins by Goertzel, band sb is bins 32 sb ... 32 sb + 32
+                double w = 2 * M_PI * k / N, cw = 2 * cos(w), s1 = 0, s2 = 0;
+                for(size_t i = 0; i < N; i++) {
+                    double s = pcm[start + i] * (1 - cos(2 * M_PI * i / N)) + cw * s1 - s2; // Hann window
+                    s2 = s1;
+                    s1 = s;
+                }
+                double p = s1 * s1 + s2 * s2 - cw * s1 * s2;
+                total += p;
+                if(k >= 32u * sb && k < 32u * sb + 32) inBand += p;
+                if(k + 16 >= 32u * sb && k < 32u * sb + 48) nearBand += p;
+            }
+            printf("layer %d, noise in subband %2d: %.4f of the energy in the band, %.6f with half a band around\n",
+                   layer, sb, inBand / total, nearBand / total);
+            CHECK(inBand > 0.8 * total);                     // the filters overlap by half a band
+            CHECK(nearBand > 0.9999 * total);
+        }
+    }
+    MP3Decoder_Delete(dec);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testErrors() {
+    MP3Decoder_t*        dec = MP3Decoder_New();
+    Mp2Encoder           e;
+    e.layer = 1;
+    e.srIdx = 1;
+    e.brIdx = 6;
+    e.mode = 3;
+    std::vector<uint8_t> d = e.makeStream(1, 5);
+    int16_t              out[1152 * 2];
+    d.resize(d.size() + 64, 0);
+    std::vector<uint8_t> bad = d;
+    bad[4] = 0xF0;                                       // allocation 15 of subband 0 is not allowed in layer I
+    int32_t left = d.size() - 64;
+    CHECK_EQ(MP3Decode(dec, bad.data(), &left, out, 0), ERR_MP3_INVALID_SIDEINFO);
+    left = d.size() - 64 - 1;                            // a byte of the frame missing
+    CHECK_EQ(MP3Decode(dec, d.data(), &left, out, 0), ERR_MP3_INDATA_UNDERFLOW);
+    left = d.size() - 64;
+    CHECK_EQ(MP3Decode(dec, d.data(), &left, out, 0), ERR_MP3_NONE);
+    CHECK_EQ(left, 0);
+    MP3Decoder_Delete(dec);
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testConformance();
+    testBands();
+    testErrors();
+    return TEST_RESULT();
+}
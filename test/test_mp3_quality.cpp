@@ -0,0 +1,171 @@
+/*
+ *  test_mp3_quality.cpp
+ *
+ *  The reduced MP3 decode modes (MP3Decoder_SetQuality()) against the full decode: SNR against the full decode low
+ *  passed at fs / 4 (255 tap FIR, decimated by 2 for MP3_QUALITY_HALFRATE), SNR of both below fs / 5, out of the
+ *  transition band of the subband filters, and the time per frame of each mode.
+ *  beep.mp3 is a tone well below fs / 4, the broadband input are random long block spectra over all 32 subbands
+ *  (-12dB at the top) fed to IMDCT() and Subband() as MP3Decode() runs them, stereo. The half rate output must be every
+ *  second sample of the LOWPASS output.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "mp3_decoder/mp3_decoder.h"
+#include "check.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define GRANULES 800                                    // broadband: 400 frames, 10.4s at 44.1kHz
+
+static const char* s_names[3] = {"full", "lowpass", "half rate"};
+
+static std::vector<uint8_t> readBeep() { // without the ID3v2 tag, 64 zero bytes behind it
+    std::vector<uint8_t> d;
+    FILE*                fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    if(!fp) return d;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    if(d.size() > 10 && !memcmp(d.data(), "ID3", 3)) {
+        size_t tag = 10 + ((d[6] & 0x7F) << 21 | (d[7] & 0x7F) << 14 | (d[8] & 0x7F) << 7 | (d[9] & 0x7F));
+        d.erase(d.begin(), d.begin() + tag);
+    }
+    d.resize(d.size() + 64, 0);
+    return d;
+}
+
+static std::vector<int16_t> decodeBeep(const std::vector<uint8_t>& d, uint8_t quality, double* ns) { // the loop of Audio
+    std::vector<int16_t> pcm;
+    MP3Decoder_t*        dec = MP3Decoder_New();
+    MP3Decoder_SetQuality(dec, quality);
+    int16_t out[1152 * 2];
+    int32_t pos = 0, total = d.size() - 64;
+    auto    t0 = std::chrono::steady_clock::now();
+    while(pos < total) {
+        int32_t o = MP3FindSyncWord((uint8_t*)d.data() + pos, total - pos);
+        if(o < 0) break;
+        pos += o;
+        int32_t left = total - pos;
+        if(MP3Decode(dec, (uint8_t*)d.data() + pos, &left, out, 0) < 0) {pos++; continue;}
+        pos = total - left;
+        pcm.insert(pcm.end(), out, out + MP3GetOutputSamps(dec));
+    }
+    *ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    MP3Decoder_Delete(dec);
+    return pcm;
+}
+
+static std::vector<int16_t> decodeBroadband(uint8_t quality, double* ns) { // GRANULES long block granules, stereo
+    MP3Decoder_t* d = MP3Decoder_New();
+    MP3Decoder_SetQuality(d, quality);
+    d->decInfo.nChans = 2;
+    d->decInfo.samprate = 44100;
+    int32_t              shift = quality == MP3_QUALITY_HALFRATE ? 1 : 0;
+    std::vector<int16_t> pcm(GRANULES * (m_MAX_NSAMP >> shift) * 2);
+    uint32_t             rng = 17;
+    *ns = 0;
+    for(int g = 0; g < GRANULES; g++) {
+        for(int ch = 0; ch < 2; ch++) { // the dequantized spectrum, as DequantChannel() leaves it
+            uint32_t mask = 0;
+            for(int i = 0; i < m_MAX_NSAMP; i++) {
+                rng = rng * 1103515245u + 12345u;
+                int32_t v = (int32_t)rng >> 12;       // 2^19
+                v -= v * i / (m_MAX_NSAMP * 4 / 3);   // -12dB at the top
+                d->huffmanInfo.huffDecBuf[ch][i] = v;
+                mask |= FASTABS(v);
+            }
+            d->huffmanInfo.nonZeroBound[ch] = m_MAX_NSAMP;
+            d->huffmanInfo.gb[ch] = CLZ(mask) - 1;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        for(int ch = 0; ch < 2; ch++) IMDCT(d, 0, ch);
+        Subband(d, pcm.data() + g * (m_MAX_NSAMP >> shift) * 2, m_BLOCK_SIZE);
+        *ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    }
+    MP3Decoder_Delete(d);
+    return pcm;
+}
+
+static std::vector<double> lowpass(const std::vector<int16_t>& x, int nch, int step, double fc = 0.25) { // fc * fs, 255 taps
+    const int           taps = 255, half = taps / 2;
+    std::vector<double> h(taps), y;
+    for(int k = 0; k < taps; k++) {
+        double n = k - half, w = 0.42 - 0.5 * cos(2 * M_PI * k / (taps - 1)) + 0.08 * cos(4 * M_PI * k / (taps - 1));
+        h[k] = (n == 0 ? 2 * fc : sin(2 * M_PI * fc * n) / (M_PI * n)) * w; // Blackman window
+    }
+    int32_t frames = x.size() / nch;
+    for(int32_t i = 0; i < frames; i += step) {
+        for(int ch = 0; ch < nch; ch++) {
+            double s = 0;
+            for(int k = 0; k < taps; k++) {
+                int32_t j = i + k - half;
+                if(j >= 0 && j < frames) s += h[k] * x[j * nch + ch];
+            }
+            y.push_back(s);
+        }
+    }
+    return y;
+}
+
+template <typename T>
+static double snr(const std::vector<double>& ref, const std::vector<T>& x, int32_t skip) { // dB, without the edges
+    double sig = 0, err = 0;
+    for(size_t i = skip; i + skip < ref.size() && i < x.size(); i++) {
+        sig += ref[i] * ref[i];
+        err += (x[i] - ref[i]) * (x[i] - ref[i]);
+    }
+    return 10 * log10(sig / (err + 1e-9));
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testModes(const char* name, std::vector<int16_t> (*decode)(uint8_t, double*), int nch, double minSnr,
+                      int frames) {
+    std::vector<int16_t> pcm[3];
+    double               ns[3] = {1e30, 1e30, 1e30};
+    for(int run = 0; run < 5; run++) { // best of 5
+        for(uint8_t q = MP3_QUALITY_FULL; q <= MP3_QUALITY_HALFRATE; q++) {
+            double t;
+            pcm[q] = decode(q, &t);
+            ns[q] = std::min(ns[q], t);
+        }
+    }
+    CHECK_EQ(pcm[0].size(), pcm[1].size());
+    CHECK_EQ(pcm[0].size(), pcm[2].size() * 2);
+    std::vector<double> ref[2] = {lowpass(pcm[0], nch, 1), lowpass(pcm[0], nch, 2)};
+    double              s[3] = {snr(ref[0], pcm[0], 1152 * nch), snr(ref[0], pcm[1], 1152 * nch), snr(ref[1], pcm[2], 576 * nch)};
+    double              inBand = snr(lowpass(pcm[0], nch, 1, 0.2), lowpass(pcm[1], nch, 1, 0.2), 1152 * nch); // below fs / 5
+    int                 maxDiff = 0; // half rate: every second sample of lowpass
+    for(size_t i = 0; i < pcm[2].size(); i++) {
+        size_t j = (i / nch) * 2 * nch + i % nch;
+        maxDiff = std::max(maxDiff, abs(pcm[2][i] - pcm[1][j]));
+    }
+    printf("%s:\n", name);
+    for(int q = 0; q < 3; q++) {
+        printf("  %-9s %6.1f µs per frame, SNR against the low passed full decode %5.1fdB\n", s_names[q],
+               ns[q] / frames / 1000, s[q]);
+    }
+    printf("  lowpass below fs / 5 against the full decode %.1fdB, half rate against every second lowpass sample: at most "
+           "%d LSB\n", inBand, maxDiff);
+    CHECK(s[1] >= minSnr);
+    CHECK(s[2] >= minSnr);
+    CHECK(inBand >= 40);
+    CHECK(maxDiff <= 1);
+    CHECK(ns[2] < ns[0]);
+}
+
+static std::vector<uint8_t> s_beep;
+
+static std::vector<int16_t> beep(uint8_t quality, double* ns) { return decodeBeep(s_beep, quality, ns); }
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    s_beep = readBeep();
+    CHECK(s_beep.size() > 1000);
+    testModes("beep.mp3, mono", beep, 1, 55, 27);
+    testModes("broadband, stereo", decodeBroadband, 2, 20, GRANULES / 2);
+    return TEST_RESULT();
+}
@@ -0,0 +1,161 @@
+/*
+ *  test_mp3_synth.cpp
+ *
+ *  The synthesis filter of the MP3 decoder (FDCT32() and the polyphase filter, as Subband() runs them) in both variants
+ *  of MP3_POLYPHASE_ACC32, the file is built twice. test_mp3_synth_64 (64 bit accumulators, bit exact with helix)
+ *  writes the PCM of beep.mp3 and of random subband samples to mp3_synth_ref.pcm, test_mp3_synth (32 bit, the default)
+ *  must stay within 1 LSB of it. Both print the cycles per frame of the synthesis on the host (MPEG-1, 2 x 18 blocks)
+ *  as a benchmark of the portable code, there is no PIE kernel for the ESP32-S3 (see PolyphaseMono()).
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "mp3_decoder/mp3_decoder.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define REF_FILE    "mp3_synth_ref.pcm"
+#define RAND_FRAMES 200                                 // random granule pairs, stereo and mono
+
+static const uint32_t BEEP_CRC_64 = 0x7e028e62;         // CRC32 of the 16 bit samples with 64 bit accumulators
+
+static uint64_t ticks(const char** unit) { // TSC cycles on x86, else ns
+#if defined(__x86_64__) || defined(__i386__)
+    *unit = "cycles";
+    return __rdtsc();
+#else
+    *unit = "ns";
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static uint32_t crc32(const int16_t* p, size_t n) {
+    const uint8_t* b = (const uint8_t*)p;
+    uint32_t crc = ~0u;
+    for(size_t i = 0; i < n * 2; i++) {
+        crc ^= b[i];
+        for(int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static std::vector<int16_t> decodeBeep() { // the loop of Audio, without the ID3v2 tag
+    std::vector<int16_t> pcm;
+    std::vector<uint8_t> d;
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    if(!fp) return pcm;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    size_t pos = 0;
+    if(d.size() > 10 && !memcmp(d.data(), "ID3", 3)) pos = 10 + ((d[6] & 0x7F) << 21 | (d[7] & 0x7F) << 14 | (d[8] & 0x7F) << 7 | (d[9] & 0x7F));
+    int32_t total = d.size();
+    d.resize(d.size() + 64, 0);
+    MP3Decoder_t* dec = MP3Decoder_New();
+    int16_t       out[1152 * 2];
+    while((int32_t)pos < total) {
+        int32_t o = MP3FindSyncWord(d.data() + pos, total - pos);
+        if(o < 0) break;
+        pos += o;
+        int32_t left = total - pos;
+        if(MP3Decode(dec, d.data() + pos, &left, out, 0) < 0) {pos++; continue;}
+        pos = total - left;
+        pcm.insert(pcm.end(), out, out + MP3GetOutputSamps(dec));
+    }
+    MP3Decoder_Delete(dec);
+    return pcm;
+}
+
+// subband samples as the IMDCT leaves them, loud and quiet granules, guard bits as IMDCT() counts them
+static void randomGranule(MP3Decoder_t* d, uint32_t* rng) {
+    for(int ch = 0; ch < d->decInfo.nChans; ch++) {
+        *rng = *rng * 1103515245u + 12345u;
+        int32_t  bits = 12 + (*rng >> 16) % 8;            // peak 2^12 ... 2^19
+        uint32_t mask = 0;
+        for(int b = 0; b < m_BLOCK_SIZE; b++) {
+            for(int k = 0; k < m_NBANDS; k++) {
+                *rng = *rng * 1103515245u + 12345u;
+                int32_t v = (int32_t)(*rng >> 1) >> (31 - bits);
+                if(k > 20) v >>= 3;                       // less energy up high, as music
+                d->imdctInfo.outBuf[ch][b][k] = v;
+                mask |= FASTABS(v);
+            }
+        }
+        d->imdctInfo.gb[ch] = mask ? CLZ(mask) - 1 : 31;
+    }
+}
+
+static std::vector<int16_t> synthRandom(uint8_t nch, uint64_t* t) { // RAND_FRAMES frames of two granules
+    MP3Decoder_t* d = MP3Decoder_New();
+    d->decInfo.nChans = nch;
+    std::vector<int16_t> pcm(RAND_FRAMES * 2 * m_BLOCK_SIZE * m_NBANDS * nch);
+    uint32_t rng = 99 + nch;
+    const char* unit;
+    *t = 0;
+    for(int g = 0; g < RAND_FRAMES * 2; g++) {
+        randomGranule(d, &rng);
+        uint64_t t0 = ticks(&unit);
+        Subband(d, pcm.data() + g * m_BLOCK_SIZE * m_NBANDS * nch, m_BLOCK_SIZE);
+        *t += ticks(&unit) - t0;
+    }
+    MP3Decoder_Delete(d);
+    return pcm;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    std::vector<int16_t> beep = decodeBeep();
+    CHECK_EQ(beep.size(), 27 * 1152);
+    uint64_t tMono, tStereo;
+    std::vector<int16_t> mono = synthRandom(1, &tMono);
+    std::vector<int16_t> stereo = synthRandom(2, &tStereo);
+    const char* unit;
+    ticks(&unit);
+    printf("synthesis, %d bit accumulators: %.0f %s per frame mono, %.0f stereo, beep.mp3 crc %08x\n",
+           MP3_POLYPHASE_ACC32 ? 32 : 64, (double)tMono / RAND_FRAMES, unit, (double)tStereo / RAND_FRAMES,
+           crc32(beep.data(), beep.size()));
+
+    std::vector<int16_t> all(beep);
+    all.insert(all.end(), mono.begin(), mono.end());
+    all.insert(all.end(), stereo.begin(), stereo.end());
+#if !MP3_POLYPHASE_ACC32
+    CHECK_EQ(crc32(beep.data(), beep.size()), BEEP_CRC_64);
+    FILE* fp = fopen(REF_FILE, "wb");
+    CHECK(fp != NULL);
+    if(fp) {
+        CHECK_EQ(fwrite(all.data(), 2, all.size(), fp), all.size());
+        fclose(fp);
+    }
+#else
+    std::vector<int16_t> ref(all.size());
+    FILE* fp = fopen(REF_FILE, "rb");
+    CHECK(fp != NULL);                                  // written by test_mp3_synth_64
+    if(fp) {
+        CHECK_EQ(fread(ref.data(), 2, ref.size(), fp), all.size());
+        fclose(fp);
+    }
+    size_t diff = 0, diffBeep = 0, clipped = 0;
+    int    maxDiff = 0;
+    for(size_t i = 0; i < all.size(); i++) {
+        int e = abs(all[i] - ref[i]);
+        if(e) diff++;
+        if(e && i < beep.size()) diffBeep++;
+        if(e > maxDiff) maxDiff = e;
+        if(ref[i] == 32767 || ref[i] == -32768) clipped++;
+    }
+    printf("against the 64 bit reference: %zu of %zu samples differ (beep.mp3 %zu of %zu), at most %d LSB, %zu clipped\n",
+           diff, all.size(), diffBeep, beep.size(), maxDiff, clipped);
+    CHECK(maxDiff <= 1);
+    CHECK(diff < all.size() / 6);                       // the truncation of 16 products is 1/8 LSB on average
+    CHECK(diffBeep < beep.size() / 6);
+    CHECK(clipped < all.size() / 100);                  // the random input stays mostly in range
+#endif
+    return TEST_RESULT();
+}
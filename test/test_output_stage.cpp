@@ -0,0 +1,201 @@
+/*
+ *  test_output_stage.cpp
+ *
+ *  OutputStage driven by a simulated I2S DMA: credits, underruns, late blocks, end of stream and stop.
+ *  SimDma plays the IDF driver with auto_clear: one DMA buffer leaves per tick, then 'on_sent' follows.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "output_stage/output_stage.h"
+#include "check.h"
+
+struct SimDma {
+    OutputStage* out;
+    int          depth;          // buffers that can be written ahead (dma_desc_num - 1)
+    int          filled = 0;     // buffers with audio, not yet sent
+    uint32_t     audioSent = 0;
+    uint32_t     silenceSent = 0;
+    uint32_t     overruns = 0;   // writes while the driver had no free buffer
+
+    SimDma(OutputStage* o, int d) : out(o), depth(d) {}
+
+    void feed() { // Audio::i2sFeed(), i2s_channel_write() with timeout 0
+        size_t   bytes = 0;
+        uint8_t* blk;
+        while((blk = out->front(&bytes)) != nullptr) {
+            if(filled >= depth) {overruns++; break;} // the credits must have prevented this
+            filled++;
+            out->consumed(bytes);
+        }
+    }
+    void tick() { // one DMA buffer transmitted
+        if(filled) {filled--; audioSent++;}
+        else silenceSent++;
+        out->onDmaSent();
+    }
+};
+
+static void produceBlock(OutputStage* out, int16_t value) {
+    uint16_t room = 0;
+    audio_sample_t* p = out->acquire(&room);
+    CHECK(p != nullptr);
+    if(!p) return;
+    for(uint32_t i = 0; i < (uint32_t)room * 2; i++) p[i] = value;
+    out->produced(room);
+}
+
+// the credits of the output stage must always match the audio buffers in the DMA
+static void checkCredits(OutputStage* out, SimDma* dma) {
+    outputStats_t st;
+    out->getStats(&st);
+    CHECK_EQ(st.dmaDepth - st.dmaFree, dma->filled);
+    CHECK_EQ(out->level(), st.queued + dma->filled);
+    CHECK_EQ(dma->overruns, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDmaFrames() {
+    CHECK(OUTPUT_MAX_BLOCK_FRAMES * 2 * sizeof(audio_sample_t) <= OUTPUT_DMA_BUFFER_MAX);
+    CHECK_EQ(OutputStage::dmaFrames(0), OUTPUT_MAX_BLOCK_FRAMES);
+    CHECK_EQ(OutputStage::dmaFrames(1024), OUTPUT_MAX_BLOCK_FRAMES);
+    CHECK_EQ(OutputStage::dmaFrames(256), 256);
+#if AUDIO_SAMPLE_32
+    CHECK_EQ(OUTPUT_MAX_BLOCK_FRAMES, 511);
+#else
+    CHECK_EQ(OUTPUT_MAX_BLOCK_FRAMES, 1023);
+#endif
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSteadyState() { // the producer keeps the pool full, no underruns
+    OutputStage out;
+    CHECK(out.init(4, 256, 7));
+    SimDma dma(&out, 7);
+    uint16_t room;
+    uint32_t sentBefore = 0;
+    for(int t = 0; t < 1000; t++) {
+        if(t == 10) { // after the start, the pool was emptied into the DMA once
+            out.resetStats();
+            sentBefore = dma.audioSent + dma.filled;
+        }
+        while(out.acquire(&room)) produceBlock(&out, (int16_t)t);
+        dma.feed();
+        checkCredits(&out, &dma);
+        while(out.acquire(&room)) produceBlock(&out, (int16_t)t);
+        if(t > 0) CHECK_EQ(out.level(), out.capacity()); // pool and DMA full
+        dma.tick();
+        checkCredits(&out, &dma);
+    }
+    outputStats_t st;
+    out.getStats(&st);
+    CHECK_EQ(st.underruns, 0);
+    CHECK_EQ(st.lateBlocks, 0);
+    CHECK_EQ(dma.silenceSent, 0);
+    CHECK_EQ(st.blocksSent + sentBefore, dma.audioSent + dma.filled);
+    CHECK_EQ(st.minQueued, 3); // one block goes to the DMA per tick and is refilled before the next one
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testUnderrun() { // the producer stalls: every silent DMA buffer is an underrun, the next block is late
+    OutputStage out;
+    CHECK(out.init(4, 256, 3));
+    SimDma dma(&out, 3);
+    produceBlock(&out, 1);
+    dma.feed();
+    for(int t = 0; t < 5; t++) dma.tick(); // 1 with audio, 4 silent
+    checkCredits(&out, &dma);
+    outputStats_t st;
+    out.getStats(&st);
+    CHECK_EQ(st.underruns, 4);
+    CHECK_EQ(st.lateBlocks, 0);
+    CHECK_EQ(st.maxDmaFree, 3);
+    produceBlock(&out, 2);
+    dma.feed();
+    produceBlock(&out, 3);
+    dma.feed();
+    out.getStats(&st);
+    CHECK_EQ(st.lateBlocks, 1); // only the first block after the gap
+    CHECK_EQ(st.blocksSent, 3);
+    checkCredits(&out, &dma);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFlush() { // end of stream: the partial block is padded, the DMA may run dry without underruns
+    OutputStage out;
+    CHECK(out.init(4, 256, 3));
+    SimDma dma(&out, 3);
+    uint16_t room;
+    audio_sample_t* p = out.acquire(&room);
+    for(int i = 0; i < 100 * 2; i++) p[i] = 1000;
+    out.produced(100);
+    CHECK_EQ(out.queued(), 0);
+    out.flush();
+    CHECK_EQ(out.queued(), 1);
+    size_t bytes;
+    const audio_sample_t* blk = (const audio_sample_t*)out.front(&bytes);
+    CHECK_EQ(bytes, 256 * 2 * sizeof(audio_sample_t));
+    CHECK_EQ(blk[199], 1000);
+    int nonZero = 0;
+    for(int i = 200; i < 256 * 2; i++) nonZero += blk[i] != 0;
+    CHECK_EQ(nonZero, 0);
+    dma.feed();
+    CHECK(out.front(&bytes) == nullptr);
+    for(int t = 0; t < 10; t++) dma.tick();
+    outputStats_t st;
+    out.getStats(&st);
+    CHECK_EQ(st.underruns, 0);
+    CHECK_EQ(dma.audioSent, 1);
+    checkCredits(&out, &dma);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDrop() { // stopSong() / pauseResume(): the DMA still holds audio, its credits come back with 'on_sent'
+    OutputStage out;
+    CHECK(out.init(4, 256, 7));
+    SimDma dma(&out, 7);
+    uint16_t room;
+    for(int t = 0; t < 20; t++) {
+        while(out.acquire(&room)) produceBlock(&out, 5);
+        dma.feed();
+        dma.tick();
+    }
+    dma.feed();
+    CHECK_EQ(dma.filled, 7);
+    out.drop();
+    CHECK_EQ(out.queued(), 0);
+    checkCredits(&out, &dma); // level() still shows the audio in the DMA
+    CHECK_EQ(out.level(), 7);
+    for(int t = 0; t < 3; t++) dma.tick();
+    checkCredits(&out, &dma);
+    // the next stream starts while the DMA plays out the old one
+    produceBlock(&out, 6);
+    produceBlock(&out, 6);
+    dma.feed();
+    checkCredits(&out, &dma);
+    for(int t = 0; t < 12; t++) {dma.feed(); dma.tick(); checkCredits(&out, &dma);}
+    outputStats_t st;
+    out.getStats(&st);
+    CHECK_EQ(dma.filled, 0);
+    CHECK_EQ(st.dmaFree, 7);
+    CHECK_EQ(st.underruns, 6); // the silent buffers after the second stream's two blocks, none from the stop
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testReset() { // I2Sstart(): channel disabled, the driver dropped its buffers, all credits
+    OutputStage out;
+    CHECK(out.init(2, 128, 3));
+    SimDma dma(&out, 3);
+    produceBlock(&out, 1);
+    produceBlock(&out, 1);
+    dma.feed();
+    dma.filled = 0; // i2s_channel_disable()
+    out.reset();
+    checkCredits(&out, &dma);
+    CHECK(!out.init(1, 128, 3));
+    CHECK(!out.init(2, 0, 3));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testDmaFrames();
+    testSteadyState();
+    testUnderrun();
+    testFlush();
+    testDrop();
+    testReset();
+    return TEST_RESULT();
+}
@@ -0,0 +1,205 @@
+/*
+ *  test_pcm_cache.cpp
+ *
+ *  The transcode core of the 48 kHz PCM cache (PcmCache, used by tools/pcm_cache_cli.cpp): the 68 byte header, the
+ *  CRC32 (as esp_rom_crc32_le), beep.mp3 (48 kHz, the PCM of the decoder without the encoder delay and padding of its
+ *  LAME tag) and native FLAC files of flac_encoder.h at 44.1 kHz, resampled linearly. A FLAC file with a bad frame or a
+ *  wrong MD5 is damaged (AudioCache makes no cache of it), a failed write stops, a source that is no MP3 or FLAC is
+ *  refused.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "pcm_cache/pcm_cache.h"
+#include "gapless/gapless.h"
+#include "flac_encoder.h"
+#include "check.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct Sink {
+    std::vector<int16_t> pcm;
+    uint32_t             limit = 0xFFFFFFFF; // frames, the write after it fails
+};
+
+static bool sinkWrite(const int16_t* pcm, uint32_t frames, uint8_t channels, void* user) {
+    Sink* s = (Sink*)user;
+    if(s->pcm.size() / channels + frames > s->limit) return false;
+    s->pcm.insert(s->pcm.end(), pcm, pcm + frames * channels);
+    return true;
+}
+
+static std::vector<uint8_t> readBeep() { // with its ID3v2 tag
+    std::vector<uint8_t> d;
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");
+    if(!fp) return d;
+    uint8_t buf[4096];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    return d;
+}
+
+static void putBE(std::vector<uint8_t>& v, uint32_t x, int bytes) {
+    for(int i = bytes - 1; i >= 0; i--) v.push_back(x >> (8 * i));
+}
+
+// "fLaC", STREAMINFO with the MD5 of the samples, the frames of flac_encoder.h
+static std::vector<uint8_t> makeFlac(uint8_t nch, uint32_t frames, std::vector<int32_t>* pcm, std::vector<uint32_t>* offsets) {
+    FlacEncoder          enc;
+    std::vector<uint8_t> raw = enc.makeStream(nch, frames, 80 + nch, pcm);
+    uint8_t              md5[16];
+    FlacEncoder::md5(*pcm, 16, md5);
+    std::vector<uint8_t> f;
+    uint32_t             samples = pcm->size() / nch;
+    for(char c : {'f', 'L', 'a', 'C'}) f.push_back(c);
+    f.push_back(0x80);                                   // STREAMINFO, the last block
+    putBE(f, 34, 3);
+    putBE(f, 1000, 2);
+    putBE(f, 4096, 2);
+    putBE(f, 0, 3);
+    putBE(f, 0, 3);
+    putBE(f, 44100 << 12 | (nch - 1) << 9 | (16 - 1) << 4, 4);
+    putBE(f, samples, 4);
+    f.insert(f.end(), md5, md5 + 16);
+    for(uint32_t o : enc.frameOffsets) offsets->push_back(f.size() + o);
+    f.insert(f.end(), raw.begin(), raw.end());
+    return f;
+}
+
+static bool run(std::vector<uint8_t> d, Sink* s, pcmTranscodeResult_t* r) {
+    size_t len = d.size();
+    d.resize(len + 64, 0);
+    return PcmCache::transcode(d.data(), len, sinkWrite, s, r);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testHeader() {
+    pcmCacheHeader_t c = {2, 4000, 123456, 0x5F000000, 0xDEADBEEF}, p;
+    uint8_t          h[PCM_CACHE_HEADER_SIZE];
+    PcmCache::makeHeader(h, &c);
+    CHECK(!memcmp(h, "RIFF", 4) && !memcmp(h + 36, "bzsc", 4) && !memcmp(h + 60, "data", 4));
+    CHECK(PcmCache::parseHeader(h, PCM_CACHE_HEADER_SIZE + 4000, &p));
+    CHECK_EQ(p.channels, 2);
+    CHECK_EQ(p.dataSize, 4000);
+    CHECK_EQ(p.srcSize, 123456);
+    CHECK_EQ(p.srcTime, 0x5F000000);
+    CHECK_EQ(p.crc, 0xDEADBEEF);
+    CHECK(!PcmCache::parseHeader(h, PCM_CACHE_HEADER_SIZE + 3999, &p)); // truncated
+    h[44] = PCM_CACHE_VERSION + 1;
+    CHECK(!PcmCache::parseHeader(h, PCM_CACHE_HEADER_SIZE + 4000, &p));
+    CHECK_EQ(PcmCache::crc32(0, (const uint8_t*)"123456789", 9), 0xCBF43926);
+    CHECK_EQ(PcmCache::crc32(PcmCache::crc32(0, (const uint8_t*)"1234", 4), (const uint8_t*)"56789", 5), 0xCBF43926);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testMP3() { // 48 kHz: no resampling, the decoded PCM from the end of the encoder delay on
+    std::vector<uint8_t> beep = readBeep();
+    CHECK(beep.size() > 1000);
+    Sink                 s;
+    pcmTranscodeResult_t r;
+    CHECK(run(beep, &s, &r));
+    CHECK(r.done);
+    CHECK_EQ(r.channels, 1);
+    CHECK_EQ(r.sampleRate, 48000);
+    CHECK_EQ(r.errors, 0);
+    CHECK_EQ(r.md5, 0);
+    CHECK(!PcmCache::damaged(&r));
+    CHECK_EQ(r.frames, s.pcm.size());
+    CHECK_EQ(r.crc32, PcmCache::crc32(0, (const uint8_t*)s.pcm.data(), s.pcm.size() * 2));
+
+    AudioCodec*          c = AudioCodec_NewMP3();         // the same frames straight from the decoder
+    std::vector<int16_t> all, out(1152 * 2);
+    size_t               pos = 10 + ((beep[6] & 0x7F) << 21 | (beep[7] & 0x7F) << 14 | (beep[8] & 0x7F) << 7 | (beep[9] & 0x7F));
+    gaplessInfo_t        gi;
+    CHECK(Gapless_MP3Info(beep.data() + pos, beep.size() - pos, false, &gi));
+    int32_t              len = beep.size();
+    beep.resize(len + 64, 0);
+    CHECK(c->init());
+    while((int32_t)pos < len) {
+        int32_t o = c->findSync(beep.data() + pos, len - pos);
+        if(o < 0) break;
+        pos += o;
+        int32_t left = len - pos;
+        if(c->decode(beep.data() + pos, &left, out.data()) < 0) {pos++; continue;}
+        pos = len - left;
+        all.insert(all.end(), out.begin(), out.begin() + c->outputFrames());
+    }
+    delete c;
+    size_t n = gi.total >= 0 && gi.skip + gi.total <= all.size() ? gi.total : all.size() - gi.skip;
+    printf("beep.mp3: %zu decoded, skip %u, %u frames in the cache\n", all.size(), (unsigned)gi.skip, (unsigned)r.frames);
+    CHECK(gi.skip >= 1152);                               // the Info frame at least
+    CHECK_EQ(r.frames, n);
+    CHECK(std::vector<int16_t>(all.begin() + gi.skip, all.begin() + gi.skip + n) == s.pcm);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testFLAC() { // 44.1 kHz -> 48 kHz, output frame k interpolated at k * 44100 / 48000
+    for(uint8_t nch = 1; nch <= 2; nch++) {
+        std::vector<int32_t>  pcm;
+        std::vector<uint32_t> offsets;
+        std::vector<uint8_t>  f = makeFlac(nch, 12, &pcm, &offsets);
+        Sink                  s;
+        pcmTranscodeResult_t  r;
+        CHECK(run(f, &s, &r));
+        CHECK(r.done);
+        CHECK_EQ(r.channels, nch);
+        CHECK_EQ(r.sampleRate, 44100);
+        CHECK_EQ(r.md5, 1);
+        CHECK_EQ(r.corrupt, 0);
+        CHECK(!PcmCache::damaged(&r));
+        uint64_t in = pcm.size() / nch;
+        CHECK_EQ(r.frames, (in * 48000 + 44099) / 44100);
+        CHECK_EQ(s.pcm.size(), r.frames * nch);
+        int maxDiff = 0;
+        for(uint32_t k = 0; k < r.frames && k * nch < s.pcm.size(); k++) {
+            double   p = k * 44100.0 / 48000;
+            uint64_t i = (uint64_t)p;
+            for(int c = 0; c < nch; c++) {
+                double a = pcm[i * nch + c], b = i + 1 < in ? pcm[(i + 1) * nch + c] : a;
+                int    e = abs((int)lround(a + (b - a) * (p - i)) - s.pcm[k * nch + c]);
+                if(e > maxDiff) maxDiff = e;
+            }
+        }
+        printf("FLAC %u channel(s): %u frames 44.1 kHz -> %u frames 48 kHz, at most %d LSB from the interpolation\n",
+               nch, (unsigned)in, (unsigned)r.frames, maxDiff);
+        CHECK(maxDiff <= 1);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testDamaged() { // the cases in which AudioCache::finishRender() and the CLI make no cache
+    std::vector<int32_t>  pcm;
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t>  f = makeFlac(2, 12, &pcm, &offsets);
+    Sink                  s;
+    pcmTranscodeResult_t  r;
+    std::vector<uint8_t>  d = f;
+    d[offsets[5] + (offsets[6] - offsets[5]) / 2] ^= 0x10; // a bit in frame 5, its CRC finds it
+    CHECK(run(d, &s, &r));
+    CHECK(r.corrupt > 0);
+    CHECK(PcmCache::damaged(&r));
+    d = f;
+    d[8 + 18] ^= 1;                                      // the MD5 in STREAMINFO
+    s.pcm.clear();
+    CHECK(run(d, &s, &r));
+    CHECK(r.done);
+    CHECK_EQ(r.md5, -1);
+    CHECK_EQ(r.corrupt, 0);
+    CHECK(PcmCache::damaged(&r));
+    s.pcm.clear();
+    s.limit = 5000;                                      // card full
+    CHECK(run(f, &s, &r));
+    CHECK(!r.done);
+    CHECK(r.frames <= 5000);
+    d.assign(f.begin(), f.end());
+    memcpy(d.data(), "OggS", 4);                         // not compiled into the core
+    CHECK(!run(d, &s, &r));
+    d.assign(1000, 0x55);
+    CHECK(!run(d, &s, &r));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testHeader();
+    testMP3();
+    testFLAC();
+    testDamaged();
+    return TEST_RESULT();
+}
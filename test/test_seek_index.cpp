@@ -0,0 +1,120 @@
+/*
+ *  test_seek_index.cpp
+ *
+ *  SeekIndex builder (flac-like frames, mp3 frames with a bit reservoir), lookup, and the sidecar round trip including
+ *  the MP3 decoder quality and damaged files.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "seek_index/seek_index.h"
+#include "check.h"
+#include <string.h>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+static void testBuildFlac() { // 4096 samples per frame at 44.1 kHz, one entry every 500 ms
+    SeekIndex idx;
+    idx.beginBuild(5, SEEK_INDEX_F_SAMPLE_EXACT, 500, 123456);
+    CHECK(idx.isBuilding());
+    for(uint32_t f = 0; f < 100; f++) idx.addFrame(1000 + f * 3000, 4096, 44100);
+    CHECK(idx.finishBuild());
+    CHECK(!idx.isBuilding());
+    CHECK_EQ(idx.totalSamples(), 100 * 4096);
+    CHECK_EQ(idx.sampleRate(), 44100);
+    // marks at 0, 22050, 44100, ... -> the first frame at or behind each mark, 100 frames cover 9.3 s
+    CHECK_EQ(idx.count(), 19);
+    seekEntry_t e;
+    CHECK(idx.lookup(0, &e));
+    CHECK_EQ(e.sample, 0);
+    CHECK_EQ(e.offset, 1000);
+    CHECK(idx.lookup(22050, &e));         // the entry of the second mark is frame 6 (24576), 22050 is still in entry 0
+    CHECK_EQ(e.sample, 0);
+    CHECK(idx.lookup(24576, &e));
+    CHECK_EQ(e.sample, 24576);
+    CHECK_EQ(e.offset, 1000 + 6 * 3000);
+    CHECK_EQ(e.preroll, 0);
+    CHECK(idx.lookup(100 * 4096, &e));    // behind the end: the last entry
+    CHECK_EQ(e.sample, 97 * 4096);  // the mark at 396900
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testBuildMp3() { // 417 byte frames, every frame takes 200 bytes of the reservoir of the previous frames
+    SeekIndex idx;
+    idx.beginBuild(2, 0, 1000, 0);
+    for(uint32_t f = 0; f < 200; f++) idx.addFrame(f * 417, 1152, 44100, f ? 200 : 0, 417 - 36);
+    CHECK(idx.finishBuild());
+    seekEntry_t e;
+    for(uint32_t i = 1; i < idx.count(); i++) {
+        CHECK(idx.lookup(i * 44100 + 1152, &e));
+        uint32_t frame = e.sample / 1152;
+        // the previous frame (overlap) and its reservoir frame must be decoded first
+        CHECK_EQ(e.offset, (frame - 2) * 417);
+        CHECK_EQ(e.preroll, 2 * 1152);
+    }
+    // a sample rate change can't be indexed
+    idx.beginBuild(2, 0, 1000, 0);
+    idx.addFrame(0, 1152, 44100, 0, 381);
+    idx.addFrame(417, 1152, 48000, 0, 381);
+    CHECK(!idx.isBuilding());
+    CHECK(!idx.finishBuild());
+    CHECK(!idx.isValid());
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testSidecar() {
+    SeekIndex idx;
+    idx.beginBuild(2, SEEK_INDEX_F_SAMPLE_EXACT, 250, 99999, 2); // mp3, built with MP3_QUALITY_HALFRATE
+    for(uint32_t f = 0; f < 50; f++) idx.addFrame(f * 2000, 4608, 48000);
+    CHECK(idx.finishBuild());
+    std::vector<uint8_t> file(idx.serializedSize());
+    CHECK_EQ(idx.serialize(file.data(), file.size()), file.size());
+    CHECK_EQ(idx.serialize(file.data(), file.size() - 1), 0);
+
+    seekIndexHeader_t h;
+    CHECK(SeekIndex::parseHeader(file.data(), file.size(), &h));
+    CHECK_EQ(h.codec, 2);
+    CHECK_EQ(h.flags, SEEK_INDEX_F_SAMPLE_EXACT);
+    CHECK_EQ(h.quality, 2);
+    CHECK_EQ(file[7], 2);
+    CHECK_EQ(h.intervalMs, 250);
+    CHECK_EQ(h.sampleRate, 48000);
+    CHECK_EQ(h.fileSize, 99999);
+    CHECK_EQ(h.totalSamples, 50 * 4608);
+    CHECK_EQ(h.count, idx.count());
+    SeekIndex copy;
+    CHECK(copy.load(&h, file.data() + SEEK_INDEX_HEADER_SIZE, file.size() - SEEK_INDEX_HEADER_SIZE));
+    std::vector<uint8_t> again(copy.serializedSize());
+    CHECK_EQ(copy.serialize(again.data(), again.size()), file.size());
+    CHECK(again == file);
+
+    // damaged sidecars
+    CHECK(!copy.load(&h, file.data() + SEEK_INDEX_HEADER_SIZE, file.size() - SEEK_INDEX_HEADER_SIZE - 1)); // truncated
+    CHECK(!copy.isValid());
+    std::vector<uint8_t> bad(file);
+    bad[0] = 'X';
+    CHECK(!SeekIndex::parseHeader(bad.data(), bad.size(), &h));
+    bad = file;
+    bad[4] = SEEK_INDEX_VERSION + 1;
+    CHECK(!SeekIndex::parseHeader(bad.data(), bad.size(), &h));
+    bad[4] = 1;                                             // version 1 had no quality, rebuilt
+    CHECK(!SeekIndex::parseHeader(bad.data(), bad.size(), &h));
+    bad = file;
+    bad[10] = 16;                                           // other entry size
+    CHECK(!SeekIndex::parseHeader(bad.data(), bad.size(), &h));
+    CHECK(!SeekIndex::parseHeader(file.data(), SEEK_INDEX_HEADER_SIZE - 1, &h));
+    bad = file;
+    uint8_t* e2 = bad.data() + SEEK_INDEX_HEADER_SIZE + 2 * SEEK_INDEX_ENTRY_SIZE;
+    memset(e2, 0, 4);                                       // samples not ascending
+    CHECK(SeekIndex::parseHeader(bad.data(), bad.size(), &h));
+    CHECK(!copy.load(&h, bad.data() + SEEK_INDEX_HEADER_SIZE, bad.size() - SEEK_INDEX_HEADER_SIZE));
+    bad = file;
+    e2 = bad.data() + SEEK_INDEX_HEADER_SIZE + 2 * SEEK_INDEX_ENTRY_SIZE;
+    e2[11] = 0x7F;                                          // preroll larger than the sample
+    CHECK(!copy.load(&h, bad.data() + SEEK_INDEX_HEADER_SIZE, bad.size() - SEEK_INDEX_HEADER_SIZE));
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testBuildFlac();
+    testBuildMp3();
+    testSidecar();
+    return TEST_RESULT();
+}
@@ -0,0 +1,181 @@
+/*
+ *  test_sync_scan.cpp
+ *
+ *  The word-at-a-time scanner against a byte by byte reference: random buffers rich in 0xFF, every start alignment and
+ *  every length up to a few words, so that the head, the aligned words and the tail are all covered. Then the header
+ *  validation of mp3, adts and flac on known headers. Throughput of the scanner and of the byte wise search it replaced
+ *  (specialIndexOf() with strlen() in the loop for the pattern) on random data and on beep.mp3, every match counted.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "sync_scan/sync_scan.h"
+#include "check.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+static int32_t refByte(const uint8_t* buf, int32_t len, uint8_t b) {
+    for(int32_t i = 0; i < len; i++) if(buf[i] == b) return i;
+    return -1;
+}
+static int32_t refSync(const uint8_t* buf, int32_t len, uint8_t mask, uint8_t value) {
+    for(int32_t i = 0; i + 1 < len; i++) if(buf[i] == 0xFF && (buf[i + 1] & mask) == value) return i;
+    return -1;
+}
+static int32_t refPattern(const uint8_t* buf, int32_t len, const uint8_t* pat, int32_t patLen) {
+    if(patLen <= 0) return -1;
+    for(int32_t i = 0; i + patLen <= len; i++) if(memcmp(buf + i, pat, patLen) == 0) return i;
+    return -1;
+}
+static int32_t refHeader(const uint8_t* buf, int32_t len, uint8_t type) {
+    const uint8_t mask  = (type == SYNC_MP3) ? 0xE0 : (type == SYNC_ADTS) ? 0xF6 : 0xFE;
+    const uint8_t value = (type == SYNC_MP3) ? 0xE0 : (type == SYNC_ADTS) ? 0xF0 : 0xF8;
+    for(int32_t i = 0; i + 1 < len; i++) {
+        if(buf[i] != 0xFF || (buf[i + 1] & mask) != value) continue;
+        if(i + SyncScan_HeaderSize(type) > len) return i; // incomplete, the caller waits for more data
+        if(SyncScan_ValidHeader(buf + i, type)) return i;
+    }
+    return -1;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testAgainstReference() {
+    static uint8_t mem[64 + 8];
+    const uint8_t  pats[][4] = {{0xFF, 0xFB, 0, 0}, {'O', 'g', 'g', 'S'}, {0xFF, 0xFF, 0xFF, 0xFF}, {0x00, 0xFF, 0, 0}};
+    const int32_t  patLens[] = {2, 4, 3, 1};
+    srand(1234);
+    int mismatches = 0;
+    for(int round = 0; round < 3000; round++) {
+        for(size_t i = 0; i < sizeof(mem); i++) {
+            int r = rand() % 8;
+            mem[i] = r < 3 ? 0xFF : r == 3 ? (uint8_t)(0xE0 | rand()) : r == 4 ? "OggS"[rand() % 4] : (uint8_t)rand();
+        }
+        for(int32_t start = 0; start < 4; start++) {
+            const uint8_t* buf = mem + start;
+            for(int32_t len = 0; len <= 64; len++) {
+                uint8_t b = (round & 1) ? 0xFF : (uint8_t)rand();
+                mismatches += SyncScan_Byte(buf, len, b) != refByte(buf, len, b);
+                mismatches += SyncScan_Sync(buf, len, 0xE0, 0xE0) != refSync(buf, len, 0xE0, 0xE0);
+                for(int p = 0; p < 4; p++) mismatches += SyncScan_Pattern(buf, len, pats[p], patLens[p]) != refPattern(buf, len, pats[p], patLens[p]);
+                for(uint8_t type = SYNC_MP3; type <= SYNC_FLAC; type++) mismatches += SyncScan_Header(buf, len, type) != refHeader(buf, len, type);
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int specialIndexOf(uint8_t* base, const char* str, int baselen, bool exact = false) { // Audio.h before SyncScan
+    int result = 0;
+    if((int)strlen(str) > baselen) return -1;
+    for(int i = 0; i < baselen - (int)strlen(str); i++) {
+        result = i;
+        for(int j = 0; j < (int)strlen(str) + exact; j++) {
+            if(*(base + i + j) != *(str + j)) {
+                result = -1;
+                break;
+            }
+        }
+        if(result >= 0) break;
+    }
+    return result;
+}
+
+static void testIndexOf() {
+    const uint8_t txt[] = "xxOggSyyOggS\0zz";
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", sizeof(txt) - 1, false), 2);
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", sizeof(txt) - 1, true), 8); // the '\0' behind the second one
+    CHECK_EQ(SyncScan_IndexOf(txt, "fLaC", sizeof(txt) - 1, false), -1);
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", 5, false), -1);
+    // the last start position is checked, specialIndexOf() stopped one before it
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", 6, false), 2);
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", 6, true), -1);       // no room for the '\0'
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", 13, true), 8);
+    CHECK_EQ(SyncScan_IndexOf(txt + 2, "OggS", 4, false), 0);
+    CHECK_EQ(SyncScan_IndexOf(txt, "OggS", 4, false), -1);      // specialIndexOf() gave 0 for any buffer of this length
+    CHECK_EQ(specialIndexOf((uint8_t*)txt, "OggS", 6), -1);     // the old search, see above
+    CHECK_EQ(specialIndexOf((uint8_t*)txt, "OggS", 4), 0);
+}
+//----------------------------------------------------------------------------------------------------------------------
+static void testHeaders() {
+    const uint8_t mp3[]  = {0xFF, 0xFB, 0x90, 0x44};                 // MPEG-1 layer III 128k 44.1k
+    const uint8_t adts[] = {0xFF, 0xF1, 0x50, 0x80, 0x2E, 0x7F};     // AAC LC 44.1k stereo, 371 bytes
+    const uint8_t flac[] = {0xFF, 0xF8, 0xC9, 0x18};                 // 4096 samples 44.1k stereo 16 bit
+    CHECK(SyncScan_ValidHeader(mp3, SYNC_MP3));
+    CHECK(SyncScan_ValidHeader(adts, SYNC_ADTS));
+    CHECK(SyncScan_ValidHeader(flac, SYNC_FLAC));
+    uint8_t h[6];
+    memcpy(h, mp3, 4); h[2] = 0xF0;  CHECK(!SyncScan_ValidHeader(h, SYNC_MP3));  // bitrate index 15
+    memcpy(h, mp3, 4); h[2] = 0x9C;  CHECK(!SyncScan_ValidHeader(h, SYNC_MP3));  // sampling rate index 3
+    memcpy(h, mp3, 4); h[1] = 0xE9;  CHECK(!SyncScan_ValidHeader(h, SYNC_MP3));  // reserved version
+    memcpy(h, mp3, 4); h[1] = 0xF9;  CHECK(!SyncScan_ValidHeader(h, SYNC_MP3));  // reserved layer
+    memcpy(h, adts, 6); h[2] = 0x7C; CHECK(!SyncScan_ValidHeader(h, SYNC_ADTS)); // sampling frequency index 15
+    memcpy(h, adts, 6); h[3] = 0x80; h[4] = 0; h[5] = 0x1F; CHECK(!SyncScan_ValidHeader(h, SYNC_ADTS)); // length 0
+    memcpy(h, flac, 4); h[2] = 0x09; CHECK(!SyncScan_ValidHeader(h, SYNC_FLAC)); // reserved block size
+    memcpy(h, flac, 4); h[3] = 0xB8; CHECK(!SyncScan_ValidHeader(h, SYNC_FLAC)); // reserved channel assignment
+    memcpy(h, flac, 4); h[3] = 0x16; CHECK(!SyncScan_ValidHeader(h, SYNC_FLAC)); // reserved sample size
+
+    // a false sync inside of audio data is skipped, a sync at the end is returned for the caller to wait
+    uint8_t buf[16] = {0x12, 0xFF, 0xFB, 0xF0, 0x00, 0x34};
+    memcpy(buf + 8, mp3, 4);
+    CHECK_EQ(SyncScan_Header(buf, 16, SYNC_MP3), 8);
+    CHECK_EQ(SyncScan_Header(buf, 10, SYNC_MP3), 8);
+    CHECK_EQ(SyncScan_Header(buf, 8, SYNC_MP3), -1);
+}
+//----------------------------------------------------------------------------------------------------------------------
+template <typename F>
+static double mbPerS(const std::vector<uint8_t>& d, uint32_t* matches, F find) { // every match up to the end, best of 5
+    double best = 1e30;
+    for(int run = 0; run < 5; run++) {
+        uint32_t n = 0;
+        int32_t  pos = 0, len = d.size();
+        auto     t0 = std::chrono::steady_clock::now();
+        for(int32_t p; pos < len && (p = find(d.data() + pos, len - pos)) >= 0; pos += p + 1) n++;
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+        *matches = n;
+    }
+    return d.size() / best / 1e6;
+}
+
+static void testThroughput() {
+    std::vector<uint8_t> data[2];
+    srand(99);
+    for(int i = 0; i < 4 << 20; i++) data[0].push_back(rand());
+    FILE* fp = fopen(TEST_DATA_DIR "/beep.mp3", "rb");       // real frames, repeated to 4 MB
+    CHECK(fp != NULL);
+    if(!fp) return;
+    std::vector<uint8_t> mp3(8192);
+    mp3.resize(fread(mp3.data(), 1, mp3.size(), fp));
+    fclose(fp);
+    while(data[1].size() < data[0].size()) data[1].insert(data[1].end(), mp3.begin(), mp3.end());
+    const char* names[2] = {"random", "beep.mp3"};
+    for(int k = 0; k < 2; k++) {
+        const std::vector<uint8_t>& d = data[k];
+        uint32_t m[2];
+        double   t[2];
+        bool     same = true;
+        printf("%s, %zu kB, MB/s byte wise / word wise, matches:\n", names[k], d.size() / 1024);
+        for(uint8_t type : {SYNC_MP3, SYNC_FLAC}) {
+            t[0] = mbPerS(d, &m[0], [&](const uint8_t* b, int32_t n) { return refHeader(b, n, type); });
+            t[1] = mbPerS(d, &m[1], [&](const uint8_t* b, int32_t n) { return SyncScan_Header(b, n, type); });
+            printf("  %s header: %.0f / %.0f, %u\n", type == SYNC_MP3 ? "mp3 " : "flac", t[0], t[1], m[1]);
+            same &= m[0] == m[1];
+            CHECK(t[1] > t[0]);
+        }
+        t[0] = mbPerS(d, &m[0], [&](const uint8_t* b, int32_t n) { return specialIndexOf((uint8_t*)b, "OggS", n); });
+        t[1] = mbPerS(d, &m[1], [&](const uint8_t* b, int32_t n) { return SyncScan_IndexOf(b, "OggS", n, false); });
+        printf("  OggS:        %.0f / %.0f, %u\n", t[0], t[1], m[1]);
+        same &= m[0] == m[1];
+        CHECK(t[1] > t[0]);
+        CHECK(same);
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main() {
+    testAgainstReference();
+    testIndexOf();
+    testHeaders();
+    testThroughput();
+    return TEST_RESULT();
+}
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Construit le cache PCM 48 kHz (include/drivers/AudioCache.h) sur le PC, à partir de la carte SD montée.
+
+Même format que l'ESP32 : WAV 48 kHz 16 bit (mono si la source est mono), en-tête de 68 octets avec
+un bloc "bzsc" (version, taille et date de la source, CRC32 des données PCM). La date est mise à 0 :
+l'heure des fichiers FAT vue par le PC et par l'ESP32 peut différer, seule la taille de la source est
+comparée. L'ESP32 vérifie le CRC au démarrage et refait lui-même les caches manquants ou périmés.
+Le décodage et le rééchantillonnage utilisent ffmpeg.
+
+Usage : python3 tools/build_pcm_cache.py [-f] [--verify] /chemin/vers/la/carte_sd
+"""
+
+import argparse
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import zlib
+
+AUDIO_PATH = "audio"           # SD_AUDIO_PATH sans le "/" initial
+CACHE_DIR = ".cache"           # AUDIO_CACHE_PATH = SD_AUDIO_PATH "/.cache"
+CACHE_VERSION = 1
+HEADER_SIZE = 68
+EXTENSIONS = (".mp3", ".mp2", ".m4a", ".aac", ".flac", ".ogg", ".oga", ".opus", ".wav")
+
+
+def cache_name(device_path):
+    """'/audio/sfx/tada.mp3' -> 'audio_sfx_tada.mp3.wav', comme AudioCache::cachePathOf()."""
+    return device_path.lstrip("/").replace("/", "_") + ".wav"
+
+
+def make_header(channels, data_size, src_size, src_time, crc):
+    return (b"RIFF" + struct.pack("<I", HEADER_SIZE - 8 + data_size) + b"WAVEfmt " +
+            struct.pack("<IHHIIHH", 16, 1, channels, 48000, 48000 * 2 * channels, 2 * channels, 16) +
+            b"bzsc" + struct.pack("<IIIII", 16, CACHE_VERSION, src_size, src_time, crc) +
+            b"data" + struct.pack("<I", data_size))
+
+
+def read_header(path):
+    with open(path, "rb") as f:
+        h = f.read(HEADER_SIZE)
+    if len(h) != HEADER_SIZE or h[0:4] != b"RIFF" or h[8:16] != b"WAVEfmt " or h[36:40] != b"bzsc" or h[60:64] != b"data":
+        return None
+    channels, rate = struct.unpack_from("<HI", h, 22)
+    version, src_size, src_time, crc = struct.unpack_from("<IIII", h, 44)
+    data_size = struct.unpack_from("<I", h, 64)[0]
+    if version != CACHE_VERSION or rate != 48000 or channels not in (1, 2):
+        return None
+    if os.path.getsize(path) != HEADER_SIZE + data_size:
+        return None
+    return {"channels": channels, "src_size": src_size, "src_time": src_time, "crc": crc, "data_size": data_size}
+
+
+def source_channels(src):
+    out = subprocess.run(["ffprobe", "-v", "error", "-select_streams", "a:0", "-show_entries", "stream=channels",
+                          "-of", "csv=p=0", src], check=True, capture_output=True, text=True).stdout.strip()
+    return 1 if out == "1" else 2
+
+
+def decode(src, channels):
+    cmd = ["ffmpeg", "-v", "error", "-i", src, "-map", "0:a:0", "-ar", "48000", "-ac", str(channels),
+           "-f", "s16le", "-c:a", "pcm_s16le", "-"]
+    return subprocess.run(cmd, check=True, capture_output=True).stdout
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Construit le cache PCM 48 kHz des sons de la carte SD")
+    parser.add_argument("sd_root", help="point de montage de la carte SD")
+    parser.add_argument("-f", "--force", action="store_true", help="refait tous les caches")
+    parser.add_argument("--verify", action="store_true", help="vérifie seulement le CRC des caches existants")
+    args = parser.parse_args()
+
+    audio_dir = os.path.join(args.sd_root, AUDIO_PATH)
+    cache_dir = os.path.join(audio_dir, CACHE_DIR)
+    if not os.path.isdir(audio_dir):
+        print("%s introuvable" % audio_dir)
+        return 1
+    if not args.verify and not shutil.which("ffmpeg"):
+        print("ffmpeg introuvable")
+        return 1
+    os.makedirs(cache_dir, exist_ok=True)
+
+    errors = 0
+    for root, dirs, names in os.walk(audio_dir):
+        dirs[:] = sorted(d for d in dirs if os.path.join(root, d) != cache_dir)
+        for name in sorted(names):
+            if not name.lower().endswith(EXTENSIONS):
+                continue
+            src = os.path.join(root, name)
+            device_path = "/" + os.path.relpath(src, args.sd_root).replace(os.sep, "/")
+            dst = os.path.join(cache_dir, cache_name(device_path))
+            src_size = os.path.getsize(src)
+            h = read_header(dst) if os.path.exists(dst) else None
+
+            if args.verify:
+                if h is None:
+                    continue
+                with open(dst, "rb") as f:
+                    f.seek(HEADER_SIZE)
+                    ok = zlib.crc32(f.read()) == h["crc"]
+                print("%s : %s" % (dst, "ok" if ok else "CRC FAUX"))
+                errors += 0 if ok else 1
+                continue
+
+            if h and h["src_size"] == src_size and not args.force:
+                continue
+            try:
+                channels = source_channels(src)
+                pcm = decode(src, channels)
+            except subprocess.CalledProcessError as e:
+                print("%s : erreur ffmpeg (%d)" % (src, e.returncode))
+                errors += 1
+                continue
+            with open(dst, "wb") as f:
+                f.write(make_header(channels, len(pcm), src_size, 0, zlib.crc32(pcm)))
+                f.write(pcm)
+            print("%s -> %s (%d octets)" % (device_path, dst, len(pcm)))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
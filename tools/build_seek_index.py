@@ -0,0 +1,469 @@
+#!/usr/bin/env python3
+"""
+Construit les index de recherche (seek index) "<fichier>.sidx" des fichiers audio d'un répertoire.
+
+Même format que lib/ESP32-audioI2S-master/src/seek_index/seek_index.h : une entrée
+(échantillon, position dans le fichier, preroll) toutes les N ms. L'ESP32 construit lui-même
+l'index des MP3/FLAC lors de la première lecture complète, ce script le fait à l'avance sur le PC
+et couvre aussi les fichiers Ogg (Opus, Vorbis, FLAC) et M4A.
+
+Usage : python3 tools/build_seek_index.py [-i 500] [-f] /chemin/vers/la/carte_sd
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+# Doivent correspondre à l'enum CODEC_xxx de Audio.h
+CODEC_MP3 = 2
+CODEC_M4A = 4
+CODEC_FLAC = 5
+CODEC_OPUS = 7
+CODEC_VORBIS = 9
+
+SEEK_INDEX_VERSION = 2  # 2 : qualité du décodeur MP3 dans l'octet 7
+SEEK_INDEX_ENTRY_SIZE = 12
+SEEK_INDEX_F_SAMPLE_EXACT = 0x01
+MP3_QUALITY_FULL = 0  # échantillons comptés comme le décodeur complet les sort (fréquence du flux)
+SEEK_INDEX_MP3_RING = 16
+OPUS_PREROLL = 3840  # 80 ms à 48 kHz, convergence du décodeur (RFC 7845)
+EXTENSIONS = (".mp3", ".flac", ".ogg", ".oga", ".opus", ".m4a")
+
+
+class Builder:
+    """Même algorithme que SeekIndex::addFrame() côté ESP32."""
+
+    def __init__(self, codec, flags, interval_ms):
+        self.codec = codec
+        self.flags = flags
+        self.interval_ms = interval_ms
+        self.sample_rate = 0
+        self.samples = 0
+        self.next_mark = 0
+        self.entries = []
+        self.ring = []
+
+    def add_frame(self, pos, samples, sample_rate, main_data_begin=-1, main_data_size=0):
+        if not samples:
+            return
+        if not self.sample_rate:
+            self.sample_rate = sample_rate
+        if sample_rate != self.sample_rate:
+            raise ValueError("changement de fréquence d'échantillonnage")
+        interval = max(1, self.sample_rate * self.interval_ms // 1000)
+        entry = [self.samples, pos, 0]
+        found = self.samples >= self.next_mark
+        if main_data_begin >= 0:  # mp3, le décodage commence là où débute le réservoir de bits
+            if len(self.ring) == SEEK_INDEX_MP3_RING:
+                self.ring.pop(0)
+            self.ring.append((pos, self.samples, main_data_begin, main_data_size))
+            if found:
+                t = len(self.ring) - 1
+                p = self._reservoir_start(t)
+                if t > 0:  # la trame précédente doit aussi être correcte (recouvrement)
+                    q = self._reservoir_start(t - 1)
+                    if q < 0:
+                        p = -1
+                    if p >= 0:
+                        p = min(p, q, t - 1)
+                    if p >= 0 and t - 1 - p > 3:
+                        p = -1
+                if p < 0:
+                    found = False
+                else:
+                    entry[1] = self.ring[p][0]
+                    entry[2] = self.samples - self.ring[p][1]
+        if found:
+            self.entries.append(tuple(entry))
+            while self.next_mark <= self.samples:
+                self.next_mark += interval
+        self.samples += samples
+
+    def add_entry(self, sample, pos, preroll, sample_rate):
+        """Entrée calculée par l'appelant (ogg, m4a)."""
+        self.sample_rate = sample_rate
+        if sample >= self.next_mark:
+            self.entries.append((sample, pos, preroll))
+            interval = max(1, self.sample_rate * self.interval_ms // 1000)
+            while self.next_mark <= sample:
+                self.next_mark += interval
+
+    def _reservoir_start(self, frame):
+        need = self.ring[frame][2]
+        if need == 0:
+            return frame
+        total = 0
+        for k in range(frame - 1, -1, -1):
+            total += self.ring[k][3]
+            if total >= need:
+                return k
+        return -1
+
+    def serialize(self, file_size, total_samples):
+        out = bytearray(b"SIDX")
+        out += struct.pack("<BBBBHHIIIII", SEEK_INDEX_VERSION, self.codec, self.flags, MP3_QUALITY_FULL, self.interval_ms,
+                           SEEK_INDEX_ENTRY_SIZE, self.sample_rate, file_size & 0xFFFFFFFF,
+                           total_samples & 0xFFFFFFFF, len(self.entries), 0)
+        for sample, pos, preroll in self.entries:
+            out += struct.pack("<III", sample, pos, preroll)
+        return bytes(out)
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+#   MP3
+# ---------------------------------------------------------------------------------------------------------------------
+MP3_BITRATES = {
+    3: (0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320),   # MPEG-1 layer 3
+    2: (0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160),       # MPEG-2 layer 3
+    0: (0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160),       # MPEG-2.5 layer 3
+}
+MP3_SAMPLERATES = {3: (44100, 48000, 32000), 2: (22050, 24000, 16000), 0: (11025, 12000, 8000)}
+
+
+def mp3_frame(data, pos):
+    """(taille, échantillons, fréquence, main_data_begin, taille des données principales) ou None."""
+    if pos + 4 > len(data) or data[pos] != 0xFF or (data[pos + 1] & 0xE0) != 0xE0:
+        return None
+    ver = (data[pos + 1] >> 3) & 3
+    layer = (data[pos + 1] >> 1) & 3
+    crc = 2 if not (data[pos + 1] & 1) else 0
+    br_idx = data[pos + 2] >> 4
+    sr_idx = (data[pos + 2] >> 2) & 3
+    pad = (data[pos + 2] >> 1) & 1
+    mono = (data[pos + 3] >> 6) == 3
+    if ver == 1 or layer != 1 or br_idx in (0, 15) or sr_idx == 3:  # layer 3 uniquement, pas de "free format"
+        return None
+    bitrate = MP3_BITRATES[ver][br_idx] * 1000
+    sample_rate = MP3_SAMPLERATES[ver][sr_idx]
+    if ver == 3:
+        size = 144 * bitrate // sample_rate + pad
+        side = 17 if mono else 32
+        spf = 1152
+    else:
+        size = 72 * bitrate // sample_rate + pad
+        side = 9 if mono else 17
+        spf = 576
+    si = pos + 4 + crc
+    if si + 2 > len(data):
+        return None
+    mdb = ((data[si] << 1) | (data[si + 1] >> 7)) if ver == 3 else data[si]
+    return size, spf, sample_rate, mdb, size - 4 - crc - side
+
+
+def id3v2_size(data):
+    if len(data) < 10 or data[:3] != b"ID3":
+        return 0
+    size = (data[6] << 21) | (data[7] << 14) | (data[8] << 7) | data[9]
+    return size + 10 + (10 if data[5] & 0x10 else 0)
+
+
+def build_mp3(data, interval_ms):
+    b = Builder(CODEC_MP3, SEEK_INDEX_F_SAMPLE_EXACT, interval_ms)
+    pos = id3v2_size(data)
+    while pos + 4 <= len(data):
+        if data[pos:pos + 3] == b"TAG" or data[pos:pos + 8] == b"APETAGEX":
+            break
+        f = mp3_frame(data, pos)
+        if f:  # faux synchronisme ? la trame suivante (ou la fin du fichier) doit suivre immédiatement
+            nxt = pos + f[0]
+            if nxt + 4 <= len(data) and not mp3_frame(data, nxt) and data[nxt:nxt + 3] not in (b"TAG", b"APE"):
+                f = None
+        if not f:
+            pos = data.find(b"\xff", pos + 1)
+            if pos < 0:
+                break
+            continue
+        size, spf, sample_rate, mdb, slots = f
+        b.add_frame(pos, spf, sample_rate, mdb, slots)
+        pos += size
+    return b, b.samples
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+#   FLAC
+# ---------------------------------------------------------------------------------------------------------------------
+def crc8(buf):
+    crc = 0
+    for byte in buf:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def flac_frame_header(data, pos, fixed_block):
+    """(échantillon, taille de bloc) si pos est un en-tête de trame valide (CRC-8 inclus), sinon None."""
+    if pos + 6 > len(data) or data[pos] != 0xFF or (data[pos + 1] & 0xFE) != 0xF8:
+        return None
+    variable = data[pos + 1] & 1
+    bs_code = data[pos + 2] >> 4
+    sr_code = data[pos + 2] & 0x0F
+    if bs_code == 0 or sr_code == 15 or (data[pos + 3] >> 4) > 10 or data[pos + 3] & 1:
+        return None
+    i = pos + 4
+    # nombre codé en UTF-8 (numéro de trame ou d'échantillon)
+    first = data[i]
+    n = 0
+    while n < 7 and first & (0x80 >> n):
+        n += 1
+    if n == 1 or n > 7:
+        return None
+    value = first & (0x7F >> n) if n else first
+    for k in range(1, n):
+        if i + k >= len(data) or (data[i + k] & 0xC0) != 0x80:
+            return None
+        value = (value << 6) | (data[i + k] & 0x3F)
+    i += max(n, 1)
+    if bs_code == 1:
+        block = 192
+    elif bs_code <= 5:
+        block = 576 << (bs_code - 2)
+    elif bs_code == 6:
+        block = data[i] + 1
+        i += 1
+    elif bs_code == 7:
+        block = ((data[i] << 8) | data[i + 1]) + 1
+        i += 2
+    else:
+        block = 256 << (bs_code - 8)
+    if sr_code == 12:
+        i += 1
+    elif sr_code in (13, 14):
+        i += 2
+    if i >= len(data) or crc8(data[pos:i]) != data[i]:
+        return None
+    sample = value if variable else value * fixed_block
+    return sample, block
+
+
+def build_flac(data, interval_ms):
+    pos = id3v2_size(data)
+    if data[pos:pos + 4] != b"fLaC":
+        raise ValueError("pas de marqueur fLaC")
+    pos += 4
+    sample_rate = total = min_block = 0
+    while True:
+        hdr = data[pos]
+        length = int.from_bytes(data[pos + 1:pos + 4], "big")
+        if hdr & 0x7F == 0:  # STREAMINFO
+            si = data[pos + 4:pos + 4 + length]
+            min_block = (si[0] << 8) | si[1]
+            bits = int.from_bytes(si[10:18], "big")
+            sample_rate = bits >> 44
+            total = bits & 0xFFFFFFFFF
+        pos += 4 + length
+        if hdr & 0x80:
+            break
+    b = Builder(CODEC_FLAC, SEEK_INDEX_F_SAMPLE_EXACT, interval_ms)
+    expected = 0
+    while True:
+        h = flac_frame_header(data, pos, min_block)
+        if h and h[0] == expected:
+            b.add_frame(pos, h[1], sample_rate)
+            expected += h[1]
+            pos += 6
+        pos = data.find(b"\xff", pos + 1)
+        if pos < 0:
+            break
+    return b, total or expected
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+#   Ogg (Opus, Vorbis, FLAC)
+# ---------------------------------------------------------------------------------------------------------------------
+def ogg_pages(data):
+    pos = 0
+    while True:
+        pos = data.find(b"OggS", pos)
+        if pos < 0 or pos + 27 > len(data):
+            return
+        nsegs = data[pos + 26]
+        lacing = data[pos + 27:pos + 27 + nsegs]
+        header_type = data[pos + 5]
+        granule = struct.unpack_from("<q", data, pos + 6)[0]
+        serial = struct.unpack_from("<I", data, pos + 14)[0]
+        body = pos + 27 + nsegs
+        yield pos, header_type, granule, serial, lacing, data[body:body + sum(lacing)]
+        pos = body + sum(lacing)
+
+
+def build_ogg(data, interval_ms):
+    b = None
+    serial = None
+    headers = 0       # paquets d'en-tête à passer
+    packets = 0
+    sample_rate = 0
+    last_granule = 0
+    candidates = []   # (échantillon, position) des pages qui commencent par un paquet complet
+    for pos, header_type, granule, ser, lacing, body in ogg_pages(data):
+        if serial is None:
+            serial = ser
+            if body.startswith(b"OpusHead"):
+                b = Builder(CODEC_OPUS, SEEK_INDEX_F_SAMPLE_EXACT, interval_ms)
+                headers, sample_rate = 2, 48000
+            elif body.startswith(b"\x01vorbis"):
+                b = Builder(CODEC_VORBIS, 0, interval_ms)
+                headers, sample_rate = 3, struct.unpack_from("<I", body, 12)[0]
+            elif body.startswith(b"\x7fFLAC"):
+                b = Builder(CODEC_FLAC, 0, interval_ms)
+                headers = 1 + ((body[7] << 8) | body[8])
+                sample_rate = int.from_bytes(body[27:30], "big") >> 4
+            else:
+                raise ValueError("flux ogg inconnu")
+        if ser != serial:
+            continue
+        if packets >= headers and not header_type & 0x01:
+            sample = last_granule
+            preroll_pos, preroll = pos, 0
+            if b.codec == CODEC_OPUS:
+                for s, p in reversed(candidates):
+                    preroll_pos, preroll = p, sample - s
+                    if preroll >= OPUS_PREROLL:
+                        break
+            candidates.append((sample, pos))
+            b.add_entry(sample, preroll_pos, preroll, sample_rate)
+        packets += sum(1 for v in lacing if v < 255)
+        if granule >= 0 and packets > headers:
+            last_granule = granule
+    if b is None:
+        raise ValueError("pas de page ogg")
+    return b, last_granule
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+#   M4A
+# ---------------------------------------------------------------------------------------------------------------------
+def atoms(data, start, end):
+    pos = start
+    while pos + 8 <= end:
+        size, name = struct.unpack_from(">I4s", data, pos)
+        hdr = 8
+        if size == 1:
+            size = struct.unpack_from(">Q", data, pos + 8)[0]
+            hdr = 16
+        elif size == 0:
+            size = end - pos
+        if size < hdr:
+            return
+        yield name, pos + hdr, pos + size
+        pos += size
+
+
+def child(data, start, end, path):
+    for name in path:
+        for n, s, e in atoms(data, start, end):
+            if n == name:
+                start, end = s, e
+                break
+        else:
+            return None
+    return start, end
+
+
+def build_m4a(data, interval_ms):
+    moov = child(data, 0, len(data), [b"moov"])
+    if not moov:
+        raise ValueError("atome moov absent")
+    for name, s, e in atoms(data, *moov):
+        if name != b"trak":
+            continue
+        hdlr = child(data, s, e, [b"mdia", b"hdlr"])
+        if not hdlr or data[hdlr[0] + 8:hdlr[0] + 12] != b"soun":
+            continue
+        mdhd = child(data, s, e, [b"mdia", b"mdhd"])
+        stbl = child(data, s, e, [b"mdia", b"minf", b"stbl"])
+        break
+    else:
+        raise ValueError("pas de piste audio")
+    p = mdhd[0]
+    timescale = struct.unpack_from(">I", data, p + (20 if data[p] == 1 else 12))[0]
+
+    def table(name):
+        return child(data, stbl[0], stbl[1], [name])
+
+    stts, stsz, stsc = table(b"stts"), table(b"stsz"), table(b"stsc")
+    stco, co64 = table(b"stco"), table(b"co64")
+    n = struct.unpack_from(">I", data, stts[0] + 4)[0]
+    durations = []
+    for k in range(n):
+        count, delta = struct.unpack_from(">II", data, stts[0] + 8 + 8 * k)
+        durations += [delta] * count
+    fixed, count = struct.unpack_from(">II", data, stsz[0] + 4)
+    sizes = [fixed] * count if fixed else list(struct.unpack_from(">%dI" % count, data, stsz[0] + 12))
+    if co64:
+        n = struct.unpack_from(">I", data, co64[0] + 4)[0]
+        chunks = list(struct.unpack_from(">%dQ" % n, data, co64[0] + 8))
+    else:
+        n = struct.unpack_from(">I", data, stco[0] + 4)[0]
+        chunks = list(struct.unpack_from(">%dI" % n, data, stco[0] + 8))
+    n = struct.unpack_from(">I", data, stsc[0] + 4)[0]
+    runs = [struct.unpack_from(">III", data, stsc[0] + 8 + 12 * k)[:2] for k in range(n)]
+
+    b = Builder(CODEC_M4A, 0, interval_ms)  # aac : précis à la trame près seulement
+    frame = sample = 0
+    for k, (first, per_chunk) in enumerate(runs):
+        last = runs[k + 1][0] - 1 if k + 1 < len(runs) else len(chunks)
+        for c in range(first - 1, last):
+            pos = chunks[c]
+            for _ in range(per_chunk):
+                if frame >= len(sizes):
+                    break
+                b.add_entry(sample, pos, 0, timescale)
+                pos += sizes[frame]
+                sample += durations[frame] if frame < len(durations) else 1024
+                frame += 1
+    return b, sample
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+def build(path, interval_ms):
+    with open(path, "rb") as f:
+        data = f.read()
+    ext = os.path.splitext(path)[1].lower()
+    if ext == ".mp3":
+        b, total = build_mp3(data, interval_ms)
+    elif ext == ".flac":
+        b, total = build_flac(data, interval_ms)
+    elif ext == ".m4a":
+        b, total = build_m4a(data, interval_ms)
+    else:
+        b, total = build_ogg(data, interval_ms)
+    if not b.entries:
+        raise ValueError("aucune trame trouvée")
+    return b.serialize(len(data), total), len(b.entries)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Construit les fichiers .sidx (index de recherche) à côté des fichiers audio")
+    parser.add_argument("dirs", nargs="+", help="répertoires (ou fichiers) à traiter")
+    parser.add_argument("-i", "--interval", type=int, default=500, help="ms entre deux entrées (défaut : 500)")
+    parser.add_argument("-f", "--force", action="store_true", help="reconstruit même si l'index est à jour")
+    args = parser.parse_args()
+
+    files = []
+    for d in args.dirs:
+        if os.path.isfile(d):
+            files.append(d)
+        for root, _, names in os.walk(d):
+            files += [os.path.join(root, n) for n in sorted(names) if n.lower().endswith(EXTENSIONS)]
+
+    errors = 0
+    for path in files:
+        sidx = path + ".sidx"
+        if not args.force and os.path.exists(sidx) and os.path.getmtime(sidx) >= os.path.getmtime(path):
+            continue
+        try:
+            blob, count = build(path, args.interval)
+        except (ValueError, IndexError, TypeError, struct.error) as e:
+            print("%s : ignoré (%s)" % (path, e))
+            errors += 1
+            continue
+        with open(sidx, "wb") as f:
+            f.write(blob)
+        print("%s : %d entrées" % (path, count))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""
+Convertit les effets sonores en PCM 48 kHz 16 bit stéréo, le format de sortie I2S de l'ESP32.
+
+Ces fichiers sont lus directement dans les blocs DMA, sans décodeur ni rééchantillonnage
+(voir Audio::openDirectPCM()) : le son démarre plus vite et le CPU reste libre. Sortie .wav
+(en-tête RIFF de 44 octets) ou, avec --raw, .pcm sans en-tête. La conversion utilise ffmpeg.
+
+Usage : python3 tools/convert_pcm.py [--raw] [--mono] [-o sortie] fichier_ou_répertoire ...
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+
+EXTENSIONS = (".mp3", ".wav", ".flac", ".ogg", ".oga", ".opus", ".m4a", ".aac")
+
+
+def convert(src, dst, raw, mono):
+    cmd = ["ffmpeg", "-v", "error", "-y", "-i", src, "-map", "0:a:0", "-map_metadata", "-1",
+           "-ar", "48000", "-ac", "1" if mono else "2", "-c:a", "pcm_s16le", "-f", "s16le" if raw else "wav",
+           "-bitexact", dst]
+    subprocess.run(cmd, check=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convertit des fichiers audio en PCM 48 kHz 16 bit pour la lecture directe")
+    parser.add_argument("paths", nargs="+", help="fichiers ou répertoires à convertir")
+    parser.add_argument("-o", "--output", help="répertoire de sortie (défaut : à côté de la source)")
+    parser.add_argument("--raw", action="store_true", help="fichier .pcm sans en-tête (toujours stéréo)")
+    parser.add_argument("--mono", action="store_true", help="wav mono, deux fois plus petit (élargi en stéréo à la lecture)")
+    args = parser.parse_args()
+
+    if not shutil.which("ffmpeg"):
+        print("ffmpeg introuvable")
+        return 1
+    if args.raw and args.mono:
+        print("--raw est toujours stéréo, --mono ignoré")
+        args.mono = False
+
+    files = []
+    for p in args.paths:
+        if os.path.isfile(p):
+            files.append(p)
+        for root, _, names in os.walk(p):
+            files += [os.path.join(root, n) for n in sorted(names) if n.lower().endswith(EXTENSIONS)]
+
+    errors = 0
+    ext = ".pcm" if args.raw else ".wav"
+    for src in files:
+        base = os.path.splitext(os.path.basename(src))[0]
+        out_dir = args.output or os.path.dirname(src)
+        dst = os.path.join(out_dir, base + ext)
+        if os.path.abspath(dst) == os.path.abspath(src):
+            dst = os.path.join(out_dir, base + "_48k" + ext)  # jamais écraser la source
+        os.makedirs(out_dir or ".", exist_ok=True)
+        try:
+            convert(src, dst, args.raw, args.mono)
+        except subprocess.CalledProcessError as e:
+            print("%s : erreur ffmpeg (%d)" % (src, e.returncode))
+            errors += 1
+            continue
+        print("%s -> %s (%d octets)" % (src, dst, os.path.getsize(dst)))
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
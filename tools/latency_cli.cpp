@@ -0,0 +1,281 @@
+/*
+ *  latency_cli.cpp
+ *
+ *  Mesure de latence hors ligne (Audio::setLatencyMeasurement()) : la chaîne de lecture d'un fichier local tourne sur
+ *  le PC avec les mêmes pièces que sur l'ESP32, InBuff (AudioBuffer), les décodeurs derrière AudioCodec, le
+ *  rééchantillonneur d'AudioDsp et les blocs de l'OutputStage, l'I2S est un DMA qui envoie tout de suite. Les étapes de
+ *  la première trame sont datées comme sur l'ESP32 (ouverture et init du décodeur, premier remplissage d'InBuff,
+ *  en-tête lu, première trame décodée, rééchantillonnée, acceptée par l'I2S), suivies du temps de décodage par trame en
+ *  régime établi. Les lignes ont le format de celles d'AUDIO_INFO, les deux se comparent. MP3/MP2 et FLAC natif.
+ *  --sd <µs> ajoute un temps d'accès par lecture (carte SD). Construit avec les tests PC :
+ *
+ *      cmake -S test -B build/test && cmake --build build/test -j --target latency_cli
+ *      build/test/latency_cli /media/carte_sd/audio/tada.mp3 /media/carte_sd/audio/buzz.flac
+ *      build/test/latency_cli --sd 2000 /media/carte_sd/audio/tada.mp3
+ *
+ *  Les temps du PC ne sont pas ceux de l'ESP32-S3, la répartition entre les étapes et l'effet de --sd le sont à peu
+ *  près. Code de sortie : 0 bon, 1 échec, 2 usage.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "audio_buffer/audio_buffer.h"
+#include "audio_codec/audio_codec.h"
+#include "audio_dsp/audio_dsp.h"
+#include "output_stage/output_stage.h"
+#include "flac_decoder/flac_decoder.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock clk;
+
+enum : int { LAT_PLAY = 0, LAT_OPEN = 1, LAT_FILL = 2, LAT_HEADER = 3, LAT_DECODE = 4, LAT_RESAMPLE = 5, LAT_I2S = 6, LAT_NUM = 7};
+
+static uint32_t be32(const uint8_t* p) { return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+class Pipeline {
+public:
+    Pipeline(uint32_t sdUs) : m_sdUs(sdUs) {}
+    ~Pipeline() {
+        if(m_fp) fclose(m_fp);
+        delete m_codec;
+    }
+    int  run(const char* path);
+
+private:
+    int32_t readFileToInBuff();
+    int     readHeader(); // 1 : lu, 0 : il manque des données, -1 : ni MP3 ni FLAC natif
+    void    output(const audio_sample_t* s, uint32_t frames);
+    void    i2sFeed();
+    bool    reached(int stage) { return m_t[stage].time_since_epoch().count() != 0; }
+    void    mark(int stage) { if(!reached(stage)) m_t[stage] = clk::now(); }
+    unsigned long since(int stage) { // µs depuis LAT_PLAY, 0 si l'étape n'a pas été atteinte
+        if(!reached(stage)) return 0;
+        return std::chrono::duration_cast<std::chrono::microseconds>(m_t[stage] - m_t[LAT_PLAY]).count();
+    }
+
+    FILE*           m_fp = nullptr;
+    uint32_t        m_fileSize = 0;
+    uint32_t        m_filePos = 0;
+    uint32_t        m_sdUs;
+    AudioBuffer     m_inBuff;
+    AudioCodec*     m_codec = nullptr;
+    AudioDsp        m_dsp;
+    OutputStage     m_out;
+    clk::time_point m_t[LAT_NUM] = {};
+    audioCodecRaw_t m_raw = {};        // FLAC : STREAMINFO
+    uint32_t        m_skip = 0;        // octets de l'en-tête encore à sauter
+    bool            m_flac = false;
+    bool            m_lastBlock = false;
+};
+//----------------------------------------------------------------------------------------------------------------------
+int32_t Pipeline::readFileToInBuff() { // comme Audio::readFileToInBuff()
+    const uint32_t sectorSize = 512;
+    const uint32_t maxRead = 32768;
+    const uint32_t minRead = 4096;
+    uint32_t space = m_inBuff.writeSpace();
+    if(!space || m_filePos >= m_fileSize) return 0;
+    uint32_t pos = m_filePos;
+    uint32_t len = min(space, maxRead);
+    bool     toBuffEnd = (m_inBuff.getWritePos() + space >= (uint32_t)m_inBuff.getBufsize());
+    bool     toFileEnd = (pos + len >= m_fileSize);
+    if(!toBuffEnd && !toFileEnd) {
+        if(len < minRead) return 0;
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    else if(!toFileEnd && len > sectorSize) {
+        len = ((pos + len) & ~(sectorSize - 1)) - pos;
+    }
+    if(m_sdUs) std::this_thread::sleep_for(std::chrono::microseconds(m_sdUs));
+    int32_t bytesRead = fread(m_inBuff.getWritePtr(), 1, len, m_fp);
+    if(bytesRead > 0) {
+        m_inBuff.bytesWritten(bytesRead);
+        m_filePos += bytesRead;
+        mark(LAT_FILL);
+    }
+    return bytesRead;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int Pipeline::readHeader() { // ID3v2 sauté, puis les blocs de métadonnées FLAC ou la première trame MP3
+    while(true) {
+        size_t n = m_inBuff.getMaxAvailableBytes();
+        if(m_skip) {
+            if(!n) return 0;
+            n = min(n, (size_t)m_skip);
+            m_inBuff.bytesWasRead(n);
+            m_skip -= n;
+            continue;
+        }
+        size_t filled = m_inBuff.bufferFilled();
+        bool   allIn = m_filePos >= m_fileSize;
+        const uint8_t* h = m_inBuff.getReadPtr(); // 4 + 34 octets d'un bloc STREAMINFO au plus, dans la réserve
+        if(m_flac) {
+            if(m_lastBlock) { // les trames suivent
+                if(!m_raw.sampleRate) return -1;
+                m_raw.audioDataSize = m_fileSize - (m_filePos - filled);
+                m_codec->setRawParams(&m_raw);
+                m_codec->setCrcCheck(true, false); // AUDIO_FLAC_CRC_CHECK
+                return 1;
+            }
+            if(filled < 4 + 34 && !allIn) return 0;
+            if(filled < 4) return -1;
+            m_lastBlock = h[0] & 0x80;
+            uint32_t blockLen = (h[1] << 16) | (h[2] << 8) | h[3];
+            if((h[0] & 0x7F) == 0 && blockLen >= 34 && filled >= 4 + 34) { // STREAMINFO
+                const uint8_t* s = h + 4;
+                m_raw.sampleRate = (s[10] << 12) | (s[11] << 4) | (s[12] >> 4);
+                m_raw.channels = ((s[12] >> 1) & 0x07) + 1;
+                m_raw.bitsPerSample = (((s[12] & 0x01) << 4) | (s[13] >> 4)) + 1;
+                m_raw.totalSamples = be32(s + 14);
+            }
+            m_skip = 4 + blockLen;
+            continue;
+        }
+        if(filled < 10 && !allIn) return 0;
+        if(filled >= 10 && !memcmp(h, "ID3", 3)) {
+            m_skip = 10 + ((h[6] & 0x7F) << 21 | (h[7] & 0x7F) << 14 | (h[8] & 0x7F) << 7 | (h[9] & 0x7F));
+            if(h[5] & 0x10) m_skip += 10; // footer
+            continue;
+        }
+        if(filled >= 4 && !memcmp(h, "fLaC", 4)) {
+            delete m_codec;
+            m_codec = AudioCodec_NewFLAC();
+            if(!m_codec || !m_codec->init()) return -1;
+            m_inBuff.changeMaxBlockSize(4096 * 6); // m_frameSizeFLAC
+            m_flac = true;
+            m_skip = 4;
+            continue;
+        }
+        return 1; // MP3, findSync() trouve la trame
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+void Pipeline::i2sFeed() { // le DMA envoie tout de suite ce qu'il accepte
+    size_t   bytes = 0;
+    uint8_t* blk;
+    while((blk = m_out.front(&bytes)) != nullptr) {
+        m_out.consumed(bytes);
+        mark(LAT_I2S);
+        m_out.onDmaSent();
+    }
+}
+
+void Pipeline::output(const audio_sample_t* s, uint32_t frames) { // les trames 48 kHz stéréo dans les blocs
+    while(frames) {
+        uint16_t        room = 0;
+        audio_sample_t* blk = m_out.acquire(&room);
+        if(!blk) {i2sFeed(); continue;}
+        uint16_t n = min((uint32_t)room, frames);
+        memcpy(blk, s, n * 2 * sizeof(audio_sample_t));
+        m_out.produced(n);
+        s += n * 2;
+        frames -= n;
+        i2sFeed();
+    }
+}
+//----------------------------------------------------------------------------------------------------------------------
+int Pipeline::run(const char* path) {
+    m_t[LAT_PLAY] = clk::now(); // connecttoFS()
+    m_fp = fopen(path, "rb");
+    if(!m_fp) {fprintf(stderr, "%s : illisible\n", path); return 1;}
+    fseek(m_fp, 0, SEEK_END);
+    m_fileSize = ftell(m_fp);
+    fseek(m_fp, 0, SEEK_SET);
+    if(!m_inBuff.isInitialized()) m_inBuff.init();
+    m_codec = AudioCodec_NewMP3(); // remplacé par le FLAC si l'en-tête le dit
+    if(!m_codec || !m_codec->init() || !m_out.init(4, OutputStage::dmaFrames(0), 2)) {fprintf(stderr, "mémoire\n"); return 1;}
+    m_inBuff.changeMaxBlockSize(1600); // m_frameSizeMP3
+    mark(LAT_OPEN);
+
+    std::vector<int16_t>        pcm(MAX_BLOCKSIZE * 2);
+    std::vector<audio_sample_t> pcm48;
+    audioCodecInfo_t            info = {};
+    bool          header = false, synced = false;
+    uint32_t      frames48 = 0, errors = 0, frames = 0;
+    unsigned long sumUs = 0, maxUs = 0;
+    while(true) {
+        readFileToInBuff(); // processLocalFile(), sans tâche de lecture
+        bool allIn = m_filePos >= m_fileSize;
+        if(!header) {
+            int h = readHeader();
+            if(h < 0 || (!h && allIn)) {fprintf(stderr, "%s : ni MP3 ni FLAC natif\n", path); return 1;}
+            if(!h) continue;
+            header = true;
+            mark(LAT_HEADER);
+        }
+        size_t filled = m_inBuff.bufferFilled();
+        size_t mbs = m_inBuff.getMaxBlockSize();
+        if(!filled && allIn) break;
+        if(filled < mbs && !allIn) continue; // playAudioData() attend une trame entière
+        int32_t  avail = min(filled, mbs);
+        uint8_t* data = m_inBuff.getReadPtr();
+        if(!synced) {
+            int32_t o = m_codec->findSync(data, avail);
+            if(o < 0) { // rien dans ce bloc, les 3 derniers octets peuvent commencer un en-tête
+                if(allIn) break;
+                m_inBuff.bytesWasRead(max(avail - 3, 1));
+                continue;
+            }
+            m_inBuff.bytesWasRead(o);
+            synced = true;
+            continue;
+        }
+        int32_t         left = avail;
+        clk::time_point t = clk::now();
+        int32_t         ret = m_codec->decode(data, &left, pcm.data());
+        unsigned long   us = std::chrono::duration_cast<std::chrono::microseconds>(clk::now() - t).count();
+        m_inBuff.bytesWasRead(ret < 0 ? max(avail - left, 1) : avail - left);
+        if(ret < 0) {errors++; synced = false; continue;}
+        uint32_t n = m_codec->outputFrames();
+        if(m_codec->noOutput(ret) || !n) continue;
+        if(m_t[LAT_DECODE].time_since_epoch().count()) { // régime établi, la première trame est dans la latence
+            frames++;
+            sumUs += us;
+            maxUs = max(maxUs, us);
+        }
+        mark(LAT_DECODE);
+        m_codec->getInfo(&info);
+        if(!info.sampleRate || info.channels < 1 || info.channels > 2) {fprintf(stderr, "%s : format inconnu\n", path); return 1;}
+        m_dsp.setResampleRatio(48000.0f / info.sampleRate);
+        pcm48.resize(((size_t)n * 48000 / info.sampleRate + 2) * 2);
+        uint32_t n48 = m_dsp.resample(pcm.data(), n, info.channels, pcm48.data()); // audio_sample_t en 16 bit
+        mark(LAT_RESAMPLE);
+        output(pcm48.data(), n48);
+        frames48 += n48;
+    }
+    m_out.flush();
+    i2sFeed();
+
+    const char* codec = m_codec->name();
+    printf("%s : %u Hz, %u canal(aux), %u trames 48 kHz, %u erreurs%s\n", path, (unsigned)info.sampleRate,
+           (unsigned)info.channels, (unsigned)frames48, (unsigned)errors, m_sdUs ? ", carte SD simulée" : "");
+    printf("%s latency [us]: open %lu, fill %lu, header %lu, decode %lu, resample %lu, i2s %lu\n", codec, since(LAT_OPEN),
+           since(LAT_FILL), since(LAT_HEADER), since(LAT_DECODE), since(LAT_RESAMPLE), since(LAT_I2S));
+    if(frames) printf("%s decode time: avg %lu us/frame, max %lu us, %lu frames\n", codec, sumUs / frames, maxUs,
+                      (unsigned long)frames);
+    for(int s = LAT_OPEN; s < LAT_NUM; s++) if(!reached(s)) return 1; // une étape n'a pas été atteinte
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv) {
+    uint32_t sdUs = 0;
+    int      first = 1;
+    if(argc >= 3 && !strcmp(argv[1], "--sd")) {
+        sdUs = atoi(argv[2]);
+        first = 3;
+    }
+    if(first >= argc || argv[first][0] == '-') {
+        fprintf(stderr, "usage : %s [--sd <µs par lecture>] <fichier>...\n", argv[0]);
+        return 2;
+    }
+    int ret = 0;
+    for(int i = first; i < argc; i++) {
+        Pipeline p(sdUs);
+        ret |= p.run(argv[i]);
+    }
+    return ret;
+}
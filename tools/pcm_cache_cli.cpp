@@ -0,0 +1,105 @@
+/*
+ *  pcm_cache_cli.cpp
+ *
+ *  Cache PCM 48 kHz (include/drivers/AudioCache.h) sur le PC avec les décodeurs de l'ESP32 : le cœur PcmCache de
+ *  lib/ESP32-audioI2S-master/src/pcm_cache passe par l'interface AudioCodec, comme la lecture. MP3/MP2 et FLAC natif ;
+ *  les autres formats passent par tools/build_pcm_cache.py (ffmpeg). Construit avec les tests PC :
+ *
+ *      cmake -S test -B build/test && cmake --build build/test -j --target pcm_cache_cli
+ *      build/test/pcm_cache_cli /media/carte_sd/audio/tada.mp3 /media/carte_sd/audio/.cache/audio_tada.mp3.wav
+ *      build/test/pcm_cache_cli --verify /media/carte_sd/audio/.cache/audio_tada.mp3.wav
+ *
+ *  La date de la source est mise à 0 (ignorée, voir build_pcm_cache.py). Comme AudioCache::finishRender(), une source
+ *  FLAC abîmée (MD5 faux ou trames corrompues) ne donne pas de cache. Code de sortie : 0 bon, 1 échec, 2 usage.
+ *
+ *  Created on: Oct 19.2026
+ */
+
+#include "pcm_cache/pcm_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static bool writePcm(const int16_t* pcm, uint32_t frames, uint8_t channels, void* user) {
+    return fwrite(pcm, 2 * channels, frames, (FILE*)user) == frames;
+}
+
+static bool readFile(const char* path, std::vector<uint8_t>& d) {
+    FILE* fp = fopen(path, "rb");
+    if(!fp) return false;
+    uint8_t buf[65536];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) d.insert(d.end(), buf, buf + n);
+    fclose(fp);
+    return true;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int transcode(const char* src, const char* dst) {
+    std::vector<uint8_t> d;
+    if(!readFile(src, d)) {fprintf(stderr, "%s : illisible\n", src); return 1;}
+    size_t srcSize = d.size();
+    d.resize(srcSize + 64, 0);                          // lus d'avance par les décodeurs
+    std::string tmp = std::string(dst) + ".tmp";
+    FILE*       fp = fopen(tmp.c_str(), "wb");
+    if(!fp) {fprintf(stderr, "%s : impossible d'écrire\n", tmp.c_str()); return 1;}
+    uint8_t h[PCM_CACHE_HEADER_SIZE] = {0};
+    fwrite(h, 1, sizeof(h), fp);                        // réécrit à la fin
+    pcmTranscodeResult_t r;
+    bool known = PcmCache::transcode(d.data(), srcSize, writePcm, fp, &r);
+    if(!known || !r.done || !r.frames || PcmCache::damaged(&r)) {
+        fclose(fp);
+        remove(tmp.c_str());
+        if(!known) fprintf(stderr, "%s : ni MP3 ni FLAC natif\n", src);
+        else if(PcmCache::damaged(&r)) fprintf(stderr, "%s : abîmé, pas de cache (MD5 FLAC %s, %u trames corrompues)\n",
+                                               src, r.md5 < 0 ? "faux" : "non vérifié", (unsigned)r.corrupt);
+        else fprintf(stderr, "%s : échec du décodage\n", src);
+        return 1;
+    }
+    pcmCacheHeader_t c;
+    c.channels = r.channels;
+    c.dataSize = r.frames * 2 * r.channels;
+    c.srcSize = srcSize;
+    c.srcTime = 0;
+    c.crc = r.crc32;
+    PcmCache::makeHeader(h, &c);
+    bool ok = fseek(fp, 0, SEEK_SET) == 0 && fwrite(h, 1, sizeof(h), fp) == sizeof(h);
+    ok = (fclose(fp) == 0) && ok;
+    if(!ok || rename(tmp.c_str(), dst) != 0) {
+        remove(tmp.c_str());
+        fprintf(stderr, "%s : impossible d'écrire\n", dst);
+        return 1;
+    }
+    printf("%s -> %s : %u Hz %u canal(aux), %lu trames 48 kHz, CRC %08x%s\n", src, dst, (unsigned)r.sampleRate,
+           (unsigned)r.channels, (unsigned long)r.frames, (unsigned)r.crc32, r.md5 > 0 ? ", MD5 FLAC bon" : "");
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+static int verify(const char* path) {
+    std::vector<uint8_t> d;
+    pcmCacheHeader_t     c;
+    if(!readFile(path, d) || d.size() < PCM_CACHE_HEADER_SIZE || !PcmCache::parseHeader(d.data(), d.size(), &c)) {
+        fprintf(stderr, "%s : pas un cache PCM\n", path);
+        return 1;
+    }
+    uint32_t crc = PcmCache::crc32(0, d.data() + PCM_CACHE_HEADER_SIZE, c.dataSize);
+    if(crc != c.crc) {
+        fprintf(stderr, "%s : CRC faux (%08x au lieu de %08x)\n", path, (unsigned)crc, (unsigned)c.crc);
+        return 1;
+    }
+    printf("%s : bon\n", path);
+    return 0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+int main(int argc, char** argv) {
+    if(argc >= 3 && !strcmp(argv[1], "--verify")) {
+        int ret = 0;
+        for(int i = 2; i < argc; i++) ret |= verify(argv[i]);
+        return ret;
+    }
+    if(argc != 3 || argv[1][0] == '-') {
+        fprintf(stderr, "usage : %s <source> <cache.wav>\n        %s --verify <cache.wav>...\n", argv[0], argv[0]);
+        return 2;
+    }
+    return transcode(argv[1], argv[2]);
+}